@@ -28,10 +28,40 @@ static const uint8_t fontset[80] = {
     0xF0, 0x80, 0xF0, 0x80, 0x80, //F
 };
 
+//SUPER-CHIP Fx30 digits, 8x10, A-F as in XO-CHIP
+static const uint8_t big_fontset[160] = {
+    0x3C, 0x7E, 0xE7, 0xC3, 0xC3, 0xC3, 0xC3, 0xE7, 0x7E, 0x3C, //0
+    0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, //1
+    0x3E, 0x7F, 0xC3, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFF, 0xFF, //2
+    0x3C, 0x7E, 0xC3, 0x03, 0x0E, 0x0E, 0x03, 0xC3, 0x7E, 0x3C, //3
+    0x06, 0x0E, 0x1E, 0x36, 0x66, 0xC6, 0xFF, 0xFF, 0x06, 0x06, //4
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFE, 0x03, 0xC3, 0x7E, 0x3C, //5
+    0x3E, 0x7C, 0xC0, 0xC0, 0xFC, 0xFE, 0xC3, 0xC3, 0x7E, 0x3C, //6
+    0xFF, 0xFF, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x60, 0x60, //7
+    0x3C, 0x7E, 0xC3, 0xC3, 0x7E, 0x7E, 0xC3, 0xC3, 0x7E, 0x3C, //8
+    0x3C, 0x7E, 0xC3, 0xC3, 0x7F, 0x3F, 0x03, 0x03, 0x3E, 0x7C, //9
+    0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, //A
+    0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, //B
+    0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, //C
+    0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, //D
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, //E
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0, //F
+};
+
+
+#if CHIP8_PAGED_MEMORY
+//Shared by every untouched page. Holds one reference of its own so it is never freed.
+static Chip8Page zero_page = { .refs = 1 };
+static long pages_live;
+#endif
+
 
 void chip8_reset(Chip8 * chip8){
     /*
     Reset chip to 0 state and set PC address to 0x200
+
+    With CHIP8_PAGED_MEMORY the old pages are not released, call
+    chip8_release first when reusing a Chip8.
     */
     memset(chip8, 0x0, sizeof(*chip8));
     chip8->pc = 0x200;
@@ -39,65 +69,133 @@ void chip8_reset(Chip8 * chip8){
     chip8->waiting_for_key = false;
     chip8->wait_key_reg = 0;
     chip8->wait_key_value = 0xFF;
-    memcpy(&chip8->memory[FONT_ADDRESS], fontset, sizeof(fontset));
+    //XO-CHIP default sound: 500 Hz square wave at pitch 64
+    memset(chip8->audio_pattern, 0xF0, sizeof(chip8->audio_pattern));
+    chip8->pitch = 64;
+#if CHIP8_PAGED_MEMORY
+    for (int i = 0; i < MEM_PAGES; i++){
+        __atomic_add_fetch(&zero_page.refs, 1, __ATOMIC_RELAXED);
+        chip8->pages[i] = &zero_page;
+    }
+#endif
+    for (size_t i = 0; i < sizeof(fontset); i++){
+        chip8_mem_write(chip8, FONT_ADDRESS + i, fontset[i]);
+    }
+    for (size_t i = 0; i < sizeof(big_fontset); i++){
+        chip8_mem_write(chip8, BIG_FONT_ADDRESS + i, big_fontset[i]);
+    }
+
+    //Random num gen, chip8_seed after reset for a reproducible run. The
+    //address keeps instances reset in the same second apart.
+    chip8_seed(chip8, (uint32_t)chip8_hash_mix((uint64_t)time(NULL) ^ (uint64_t)(uintptr_t)chip8));
+}
+
+int chip8_load(Chip8 *chip8, const uint8_t *rom, size_t len){
+    /*
+    Copy a ROM image to 0x200, one memcpy per page. Returns CHIP8_OK or
+    CHIP8_ERR_TOO_LARGE.
+    */
+    if (len > MEM_SIZE - 0x200){
+        return CHIP8_ERR_TOO_LARGE;
+    }
+
+#if CHIP8_STATE_HASH
+    for (size_t i = 0; i < len; i++){
+        uint16_t addr = (uint16_t)(0x200 + i);
+        chip8->mem_hash ^= chip8_hash_mem_key(addr, chip8_mem_read(chip8, addr)) ^ chip8_hash_mem_key(addr, rom[i]);
+    }
+#endif
+
+#if CHIP8_PAGED_MEMORY
+    for (size_t done = 0; done < len; ){
+        uint16_t addr = (uint16_t)(0x200 + done);
+        int index = addr >> MEM_PAGE_SHIFT;
+        size_t offset = addr & (MEM_PAGE_SIZE - 1);
+        size_t chunk = MEM_PAGE_SIZE - offset < len - done ? MEM_PAGE_SIZE - offset : len - done;
+        if (__atomic_load_n(&chip8->pages[index]->refs, __ATOMIC_ACQUIRE) > 1 &&
+            !chip8_page_unshare(chip8, index)){
+            return CHIP8_ERR_NOMEM;
+        }
+        memcpy(chip8->pages[index]->data + offset, rom + done, chunk);
+        done += chunk;
+    }
+#else
+    memcpy(chip8->memory + 0x200, rom, len);
+#endif
+    return CHIP8_OK;
+}
 
-    //Random num gen
-    srand((unsigned)time(NULL));
+const char *chip8_strerror(int err){
+    switch (err){
+    case CHIP8_OK: return "ok";
+    case CHIP8_ERR_IO: return "I/O error";
+    case CHIP8_ERR_TOO_LARGE: return "ROM too large";
+    case CHIP8_ERR_FORMAT: return "bad file format";
+    case CHIP8_ERR_NOT_FOUND: return "not found";
+    case CHIP8_ERR_NOMEM: return "out of memory";
+    case CHIP8_ERR_OPCODE: return "unknown opcode";
+    case CHIP8_ERR_STACK: return "stack overflow or underflow";
+    case CHIP8_ERR_PC: return "PC out of memory";
+    default: return "unknown error";
+    }
 }
 
-void load_rom(char * filename, Chip8 *chip8){
+int load_rom(const char *filename, Chip8 *chip8){
+    /*
+    Read a ROM file to 0x200. Returns CHIP8_OK or a Chip8Error, the reason
+    is also printed to stderr. To start many instances from one ROM, load
+    it once (chip8_romlib_open) and use chip8_load instead.
+    */
 
     //Open file
     FILE *fp = fopen(filename, "rb");
     if (!fp) {
         perror("load_rom: fopen");
-        return;
+        return CHIP8_ERR_IO;
     }
 
-    //Fine len of file
-    if (fseek(fp, 0, SEEK_END) != 0){
-        perror("load_rom: fseek(end)");
+    // Read one byte past the limit to tell a full-size ROM from a too large one
+    uint8_t rom[MEM_SIZE - 0x200 + 1];
+    size_t ROM_len = fread(rom, 1, sizeof(rom), fp);
+    if (ferror(fp)){
+        perror("load_rom: fread");
         fclose(fp);
-        return;
+        return CHIP8_ERR_IO;
     }
-
-    long ROM_len_long = ftell(fp);
-    if (ROM_len_long < 0) {
-    perror("load_rom: ftell");
     fclose(fp);
-    return;
-    }
-
-    if(fseek(fp, 0, SEEK_SET) != 0){
-        perror("load_rom: fseek(set)");
-        fclose(fp);
-        return;
-    }
-
-    size_t ROM_len = (size_t)ROM_len_long;
 
     //ROM + 0x200 <= memsize
     if (ROM_len > MEM_SIZE - 0x200){
-        fprintf(stderr, "load_rom: ROM_len + 0x200 > MEM_SIZE. ROM too large");
-        fclose(fp);
-        return;
+        fprintf(stderr, "load_rom: ROM_len + 0x200 > MEM_SIZE. ROM too large\n");
+        return CHIP8_ERR_TOO_LARGE;
     }
 
-    // Read binary ROM file into memory 0x200
-    size_t len_read = fread(&chip8->memory[0x200], 1, ROM_len, fp);
-    if (len_read != ROM_len){
-        fprintf(stderr, "load_rom: Lenght of ROM file does not match length read into memory");
-        fclose(fp);
-        return;
-    }
-    
-    fclose(fp);
-    return;
+    return chip8_load(chip8, rom, ROM_len);
 }
 
-void chip8_step (Chip8 *chip8){
-    // Fetch, decode, execute 1 opp code
+static int fault(Chip8 *chip8, int err){
+    //leave the PC on the instruction that could not run
+    chip8->pc -= 2;
+    chip8->cycles--;
+    return err;
+}
+
+int chip8_step (Chip8 *chip8){
+    /*
+    Fetch, decode, execute 1 opp code. Returns CHIP8_OK or the Chip8Error
+    of an instruction that could not run, see libchip8.h.
+    */
+    if (chip8->vblank_wait){
+        //display-wait: nothing runs until the next frame
+        return CHIP8_OK;
+    }
+    if (chip8->pc > MEM_SIZE - 2){
+        return CHIP8_ERR_PC;
+    }
     uint16_t opcode = chip8_fetch_opcode(chip8);
+    chip8->opcode = opcode;
+    chip8->cycles++;
+    int err = CHIP8_OK;
 
     uint16_t nnn = opcode &0x0FFF; //low 12 bits address
     uint8_t n = opcode & 0x000F; //nibble low 4 bits
@@ -118,12 +216,32 @@ void chip8_step (Chip8 *chip8){
         case (0x00EE):
             //RET
             //Return from subroutine
-            op_00EE(chip8);
+            err = op_00EE(chip8);
             break;
-        default:
-            printf("Unknown opcode: 0x%04X at PC: 0x%03X\n", opcode, (unsigned)(chip8->pc - 2));
-            assert(0 && "Unknown opcode");
+        case (0x00FB):
+            //SUPER-CHIP: scroll right 4 pixels
+            op_00FB(chip8);
+            break;
+        case (0x00FC):
+            //SUPER-CHIP: scroll left 4 pixels
+            op_00FC(chip8);
+            break;
+        case (0x00FD):
+            //SUPER-CHIP: exit
+            op_00FD(chip8);
+            break;
+        case (0x00FE):
+        case (0x00FF):
+            //SUPER-CHIP: 64x32 / 128x64
+            op_00FE(chip8, opcode == 0x00FF);
             break;
+        default:
+            if ((opcode & 0xFFF0) == 0x00C0){
+                //SUPER-CHIP: scroll down n rows
+                op_00Cn(chip8, n);
+                break;
+            }
+            return fault(chip8, CHIP8_ERR_OPCODE);
         }
         break;
 
@@ -134,7 +252,7 @@ void chip8_step (Chip8 *chip8){
     
     case (0x2000):
         //call addr
-        op_2nnn(chip8, nnn);
+        err = op_2nnn(chip8, nnn);
         break;
 
     case (0x3000):
@@ -259,6 +377,11 @@ void chip8_step (Chip8 *chip8){
 
     case (0xF000):
         switch (opcode & 0xF0FF){
+            case (0xF002):
+                //F002: AUDIO
+                op_F002(chip8);
+                break;
+
             case (0xF007):
                 //Fx07: LD VX, DT
                 op_Fx07(chip8, x);
@@ -289,6 +412,16 @@ void chip8_step (Chip8 *chip8){
                 op_Fx29(chip8, x);
                 break;
 
+            case (0xF030):
+                //Fx30: LD HF, Vx
+                op_Fx30(chip8, x);
+                break;
+
+            case (0xF03A):
+                //Fx3A: PITCH Vx
+                op_Fx3A(chip8, x);
+                break;
+
             case (0xF033):
                 //Fx33: LD B, Vx
                 op_Fx33(chip8, x);
@@ -304,16 +437,33 @@ void chip8_step (Chip8 *chip8){
                 op_Fx65(chip8, x);
                 break;
 
+            case (0xF075):
+                //Fx75: LD R, Vx
+                op_Fx75(chip8, x);
+                break;
+
+            case (0xF085):
+                //Fx85: LD Vx, R
+                op_Fx85(chip8, x);
+                break;
+
             default:
                 break;
         }
         break;
     
     default:
-        printf("Unknown opcode: 0x%04X at PC: 0x%03X\n", opcode, (unsigned)(chip8->pc - 2));
-        assert(0 && "Unknown opcode");
-        break;
+        return fault(chip8, CHIP8_ERR_OPCODE);
+    }
+    if (err != CHIP8_OK){
+        chip8->cycles--;
     }
+#if CHIP8_PAGED_MEMORY
+    else if (chip8->fault != CHIP8_OK){
+        err = chip8->fault;
+    }
+#endif
+    return err;
 }
 
 
@@ -329,11 +479,9 @@ void chip8_step (Chip8 *chip8){
 
     @return 16 bit opcode
     */
-    assert(chip8->pc <= MEM_SIZE - 2);
-
     uint16_t instruction;
-    uint16_t high_byte = chip8->memory[chip8->pc];
-    uint16_t low_byte = chip8->memory[chip8->pc + 1];
+    uint16_t high_byte = chip8_mem_read(chip8, chip8->pc);
+    uint16_t low_byte = chip8_mem_read(chip8, chip8->pc + 1);
     //left shift high byte and stitch together
     high_byte = high_byte << 8;
     instruction = high_byte | low_byte;
@@ -348,7 +496,10 @@ void chip8_timer_tick(Chip8 *chip8){
     /*
     Decrements delay_timer if > 0
     Decrements sound timer if > 0
+    Ends a display-wait
+    Calls the on_frame hook
     */
+    chip8->vblank_wait = false;
 
     if (chip8->delay_timer > 0){
         chip8->delay_timer --;
@@ -357,13 +508,239 @@ void chip8_timer_tick(Chip8 *chip8){
     if (chip8->sound_timer > 0){
         chip8->sound_timer --;
     }
+
+    if (chip8->hooks && chip8->hooks->hooks.on_frame){
+        chip8->hooks->hooks.on_frame(chip8, chip8->hooks->hooks.ctx);
+    }
 }
 
-void chip8_disp_to_pixels(Chip8 *chip8, uint32_t *pixels){
-    for (int y = 0; y < DISP_HEIGHT; y++) {
-        for (int x = 0; x < DISP_WIDTH; x++) {
-            pixels[y * DISP_WIDTH + x] =
-                chip8->display[y][x] ? 0xFFFFFFFFu : 0xFF000000u;
+void chip8_disp_to_pixels(const Chip8 *chip8, uint32_t *pixels){
+    /*
+    ARGB for the active resolution, chip8_disp_width pixels per row.
+    pixels must hold DISP_HIRES_WIDTH * DISP_HIRES_HEIGHT.
+    */
+    int width = chip8_disp_width(chip8);
+    int height = chip8_disp_height(chip8);
+    for (int y = 0; y < height; y++) {
+        Chip8Row row = chip8->display[y];
+        for (int x = 0; x < width; x++) {
+            pixels[y * width + x] =
+                (row >> (DISP_HIRES_WIDTH - 1 - x)) & 1 ? 0xFFFFFFFFu : 0xFF000000u;
         }
     }
-}
\ No newline at end of file
+}
+
+static uint32_t pair_or(uint64_t bits){
+    //OR each pair of adjacent bits and pack the 32 results in order
+    uint64_t t = (bits | (bits >> 1)) & 0x5555555555555555ull;
+    t = (t | (t >> 1)) & 0x3333333333333333ull;
+    t = (t | (t >> 2)) & 0x0F0F0F0F0F0F0F0Full;
+    t = (t | (t >> 4)) & 0x00FF00FF00FF00FFull;
+    t = (t | (t >> 8)) & 0x0000FFFF0000FFFFull;
+    return (uint32_t)(t | (t >> 16));
+}
+
+uint64_t chip8_disp_lores_row(const Chip8 *chip8, int y){
+    /*
+    Row y of a 64x32 view, bit 63 = x 0, for outputs that stay at CHIP-8
+    resolution. In 128x64 each bit is the OR of a 2x2 block.
+    */
+    if (!chip8->hires){
+        return (uint64_t)(chip8->display[y] >> 64);
+    }
+    Chip8Row both = chip8->display[2 * y] | chip8->display[2 * y + 1];
+    return (uint64_t)pair_or((uint64_t)(both >> 64)) << 32 | pair_or((uint64_t)both);
+}
+
+
+void chip8_seed(Chip8 *chip8, uint32_t seed){
+    /*
+    Seed this Chip8's Cxkk generator. Same seed and input, same run.
+    */
+    chip8->rng = seed ? seed : 0x9E3779B9u; //xorshift32 never leaves 0
+}
+
+void chip8_fork(Chip8 *dst, const Chip8 *src){
+    /*
+    Make dst an independent copy of src
+
+    With CHIP8_PAGED_MEMORY only the registers, stack, display and page
+    table are copied. The pages are shared until one side writes to them.
+    Release dst with chip8_release when done.
+    */
+    *dst = *src;
+#if CHIP8_PAGED_MEMORY
+    for (int i = 0; i < MEM_PAGES; i++){
+        __atomic_add_fetch(&dst->pages[i]->refs, 1, __ATOMIC_RELAXED);
+    }
+#endif
+}
+
+void chip8_release(Chip8 *chip8){
+    /*
+    Drop this Chip8's page references. Nothing to do for flat memory.
+    */
+#if CHIP8_PAGED_MEMORY
+    for (int i = 0; i < MEM_PAGES; i++){
+        Chip8Page *page = chip8->pages[i];
+        if (page && __atomic_sub_fetch(&page->refs, 1, __ATOMIC_ACQ_REL) == 0){
+            free(page);
+            __atomic_sub_fetch(&pages_live, 1, __ATOMIC_RELAXED);
+        }
+        chip8->pages[i] = NULL;
+    }
+#else
+    (void)chip8;
+#endif
+}
+
+#if CHIP8_PAGED_MEMORY
+bool chip8_page_unshare(Chip8 *chip8, int index){
+    /*
+    Give chip8 its own copy of a shared page before writing to it. When
+    that fails the page stays shared, chip8->fault is set and false returned.
+    */
+    Chip8Page *old = chip8->pages[index];
+    Chip8Page *page = malloc(sizeof(*page));
+    if (!page){
+        chip8->fault = CHIP8_ERR_NOMEM;
+        return false;
+    }
+
+    memcpy(page->data, old->data, MEM_PAGE_SIZE);
+    page->refs = 1;
+    chip8->pages[index] = page;
+    __atomic_add_fetch(&pages_live, 1, __ATOMIC_RELAXED);
+
+    //another owner may have unshared at the same time, last one out frees
+    if (__atomic_sub_fetch(&old->refs, 1, __ATOMIC_ACQ_REL) == 0){
+        free(old);
+        __atomic_sub_fetch(&pages_live, 1, __ATOMIC_RELAXED);
+    }
+    return true;
+}
+#endif
+
+long chip8_pages_live(void){
+    /*
+    Pages currently allocated by all Chip8s (0 for flat memory)
+    */
+#if CHIP8_PAGED_MEMORY
+    return __atomic_load_n(&pages_live, __ATOMIC_RELAXED);
+#else
+    return 0;
+#endif
+}
+
+double chip8_mem_resident(const Chip8 *chip8){
+    /*
+    Bytes of RAM charged to this Chip8: each page split evenly between
+    the Chip8s sharing it. The shared zero page costs nothing.
+    */
+#if CHIP8_PAGED_MEMORY
+    double bytes = 0.0;
+    for (int i = 0; i < MEM_PAGES; i++){
+        const Chip8Page *page = chip8->pages[i];
+        if (page != &zero_page){
+            bytes += (double)sizeof(*page) / (double)__atomic_load_n(&page->refs, __ATOMIC_RELAXED);
+        }
+    }
+    return bytes;
+#else
+    (void)chip8;
+    return MEM_SIZE;
+#endif
+}
+
+
+static uint64_t hash_memory(const Chip8 *chip8){
+    uint64_t h = 0;
+    for (int addr = 0; addr < MEM_SIZE; addr++){
+        h ^= chip8_hash_mem_key((uint16_t)addr, chip8_mem_read(chip8, (uint16_t)addr));
+    }
+    return h;
+}
+
+static uint64_t hash_display(const Chip8 *chip8){
+    uint64_t h = 0;
+    for (int y = 0; y < DISP_HIRES_HEIGHT; y++){
+        h ^= chip8_hash_row(y, chip8->display[y]);
+    }
+    return h;
+}
+
+static uint64_t hash_registers(const Chip8 *chip8){
+    /*
+    Registers, stack, timers, keypad, Fx0A, resolution, RPL flags, audio
+    pattern and pitch and RNG state, hashed from scratch on every query. At
+    ~100 bytes this is cheaper than keeping them incremental in every opcode.
+    */
+    uint8_t regs[112];
+    int n = 0;
+
+    for (int i = 0; i < 16; i++){
+        regs[n++] = chip8->V[i];
+    }
+    for (int i = 0; i < 16; i++){
+        regs[n++] = (uint8_t)(chip8->stack[i] >> 8);
+        regs[n++] = (uint8_t)chip8->stack[i];
+    }
+    regs[n++] = (uint8_t)(chip8->pc >> 8);
+    regs[n++] = (uint8_t)chip8->pc;
+    regs[n++] = (uint8_t)(chip8->I >> 8);
+    regs[n++] = (uint8_t)chip8->I;
+    regs[n++] = chip8->sp;
+    regs[n++] = chip8->delay_timer;
+    regs[n++] = chip8->sound_timer;
+    regs[n++] = (uint8_t)(chip8->keypad >> 8);
+    regs[n++] = (uint8_t)chip8->keypad;
+    regs[n++] = (uint8_t)(chip8->waiting_for_key | chip8->vblank_wait << 1 | chip8->hires << 2);
+    regs[n++] = chip8->wait_key_reg;
+    regs[n++] = chip8->wait_key_value;
+    for (int b = 0; b < 4; b++){
+        regs[n++] = (uint8_t)(chip8->rng >> (8 * b));
+    }
+    for (int i = 0; i < 16; i++){
+        regs[n++] = chip8->rpl[i];
+    }
+    for (int i = 0; i < 16; i++){
+        regs[n++] = chip8->audio_pattern[i];
+    }
+    regs[n++] = chip8->pitch;
+
+    uint64_t h = 0;
+    for (int i = 0; i < n; i++){
+        h ^= chip8_hash_key(HASH_SLOT_REGS + ((uint32_t)i << 8) + regs[i]);
+    }
+    return h;
+}
+
+uint64_t chip8_state_hash(const Chip8 *chip8){
+    /*
+    64-bit hash of the architectural state: memory, display, registers,
+    stack, timers, keypad and RNG. Equal states give equal hashes across
+    builds, with or without CHIP8_STATE_HASH.
+    */
+#if CHIP8_STATE_HASH
+#if CHIP8_STATE_HASH_CHECK
+    assert(chip8->mem_hash == hash_memory(chip8) && "chip8_state_hash: stale memory hash");
+    assert(chip8->disp_hash == hash_display(chip8) && "chip8_state_hash: stale display hash");
+#endif
+    return chip8->mem_hash ^ chip8->disp_hash ^ hash_registers(chip8);
+#else
+    return hash_memory(chip8) ^ hash_display(chip8) ^ hash_registers(chip8);
+#endif
+}
+
+void chip8_state_hash_rebuild(Chip8 *chip8){
+    /*
+    Recompute the incremental hash after memory or display were written
+    directly rather than through chip8_mem_write/Dxyn/00E0
+    */
+#if CHIP8_STATE_HASH
+    chip8->mem_hash = hash_memory(chip8);
+    chip8->disp_hash = hash_display(chip8);
+#else
+    (void)chip8;
+#endif
+}
@@ -1,32 +1,260 @@
+#ifndef CHIP8_H
+#define CHIP8_H
+
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include "libchip8.h"
+
+// The Chip8 that libchip8.h keeps opaque, plus the helpers the other
+// modules share. Not part of the library interface.
 
 #define MEM_SIZE 4096
-#define DISP_WIDTH 64
+#define DISP_WIDTH 64           //CHIP-8 resolution
 #define DISP_HEIGHT 32
+#define DISP_HIRES_WIDTH 128    //SUPER-CHIP 00FF
+#define DISP_HIRES_HEIGHT 64
 #define FONT_ADDRESS 0x0
+#define BIG_FONT_ADDRESS 0x50   //SUPER-CHIP 8x10 digits, after the 5-byte font
+
+// One display row, pixel x is bit 127 - x. In low resolution only the top
+// DISP_HEIGHT rows and the high 64 bits are used, so a low-resolution row
+// is (uint64_t)(row >> 64) with bit 63 = x 0. Scrolling is a shift of the
+// whole row, sprites are an XOR of a shifted mask.
+typedef unsigned __int128 Chip8Row;
+
+// Copy-on-write RAM: memory is 16 refcounted 256-byte pages so chip8_fork
+// copies the registers, stack and display and only shares the pages. A page
+// is duplicated the first time a fork writes to it (Fx33/Fx55).
+#ifndef CHIP8_PAGED_MEMORY
+#define CHIP8_PAGED_MEMORY 0
+#endif
+
+// Incremental 64-bit Zobrist hash of memory and display rows, kept up to
+// date by chip8_mem_write and the display opcodes so chip8_state_hash costs
+// O(registers) instead of O(5 KB). Without it chip8_state_hash recomputes everything.
+// CHIP8_STATE_HASH_CHECK asserts the incremental hash against a recompute.
+#ifndef CHIP8_STATE_HASH
+#define CHIP8_STATE_HASH 0
+#endif
+
+#ifndef CHIP8_STATE_HASH_CHECK
+#define CHIP8_STATE_HASH_CHECK 0
+#endif
+
+// Debugger watchpoints in Dxyn/Fx33/Fx55/Fx65, checked only while the
+// debugger has a flag table attached (Chip8.mem_flags). Build with 0 to
+// drop the checks entirely.
+#ifndef CHIP8_WATCHPOINTS
+#define CHIP8_WATCHPOINTS 1
+#endif
+
+// Chip8.mem_flags entries
+#define CHIP8_BREAK 0x01        //PC breakpoint
+#define CHIP8_WATCH_READ 0x02
+#define CHIP8_WATCH_WRITE 0x04
+
+// Chip8.quirks: CHIP8_QUIRK_* in libchip8.h
+
+#define MEM_PAGE_SHIFT 8
+#define MEM_PAGE_SIZE (1 << MEM_PAGE_SHIFT)
+#define MEM_PAGES (MEM_SIZE / MEM_PAGE_SIZE)
+
+#if CHIP8_PAGED_MEMORY
+typedef struct Chip8Page {
+    uint32_t refs;                  //Chip8s sharing this page
+    uint8_t data[MEM_PAGE_SIZE];
+} Chip8Page;
+#endif
+
+// The hot line pays off where many Chip8 structs are stepped from an array
+// (the scalar half of chip8_batch_bench, fork searches). chip8_batch keeps its lanes
+// in Chip8Lanes and only reads or writes a Chip8 in chip8_batch_set/get.
+#define CHIP8_HOT_SIZE 64 //one cache line
 
 typedef struct Chip8 {
 // Add in chip8 struct
+    // Hot: state touched by nearly every instruction, one cache line at the front
+    union {
+        struct {
+            uint8_t V[16]; //16 8 bit regs
+            uint16_t pc; //program counter
+            uint16_t I; // 16 bit index reg
+            uint16_t keypad; //bit k set = key k down
+            uint8_t sp; //stack pointer
+            uint8_t delay_timer; //8 bit delay timer
+            uint8_t sound_timer; //8 bit sound timer
+            bool draw_flag; //flag to see if image needs to be drawn
+            bool waiting_for_key;       //flag to track if Fx0A is waiting for key release
+            uint8_t wait_key_reg;       //register to store pressed key into after release
+            uint8_t wait_key_value;     //key value captured by Fx0A, 0xFF means no key captured yet
+            uint8_t quirks;             //CHIP8_QUIRK_*, set after chip8_reset
+            bool vblank_wait;           //Dxyn in display-wait mode, cleared by chip8_timer_tick
+            bool hires;                 //128x64 after 00FF, 64x32 after 00FE and reset
+            uint32_t rng;               //xorshift32 state for Cxkk, see chip8_seed
+            uint16_t opcode;            //last one chip8_step fetched, chip8_trace records it
+            uint64_t cycles;            //instructions executed since reset
+#if CHIP8_STATE_HASH
+            uint64_t mem_hash;          //XOR of chip8_hash_key over non-zero memory bytes
+            uint64_t disp_hash;         //XOR of chip8_hash_key over lit pixels
+#endif
+        };
+        uint8_t hot[CHIP8_HOT_SIZE];
+    };
+
+    // Cold: memory, stack and display
+#if CHIP8_PAGED_MEMORY
+    Chip8Page *pages[MEM_PAGES]; //RAM, use chip8_mem_read/chip8_mem_write
+#else
     uint8_t memory[MEM_SIZE]; //RAM
-    uint8_t V[16]; //16 8 bit regs
-    uint8_t delay_timer; //8 bit delay timer
-    uint8_t sound_timer; //8 bit sound timer
-    uint16_t pc; //program counter
-    uint8_t sp; //stack pointer
-    uint16_t I; // 16 bit index reg
+#endif
     uint16_t stack[16]; //stack
-    uint16_t keypad[16]; //16 bit keypad state
-    uint8_t display[DISP_HEIGHT][DISP_WIDTH]; //display buffer
-    bool draw_flag; //flag to see if image needs to be drawn
-    bool waiting_for_key;       //flag to track if Fx0A is waiting for key release
-    uint8_t wait_key_reg;       //register to store pressed key into after release
-    uint8_t wait_key_value;     //key value captured by Fx0A, 0xFF means no key captured yet
+    Chip8Row display[DISP_HIRES_HEIGHT]; //display buffer, see Chip8Row
+    uint8_t rpl[16];            //SUPER-CHIP Fx75/Fx85 flags
+    uint8_t audio_pattern[16];  //XO-CHIP F002 1-bit sample loop, MSB of byte 0 first
+    uint8_t pitch;              //XO-CHIP Fx3A, playback at 4000 * 2^((pitch - 64) / 48) Hz
+#if CHIP8_PAGED_MEMORY
+    int8_t fault;               //CHIP8_ERR_NOMEM once a page copy failed and a write was dropped
+#endif
+
+    // Debugger, see debug.c
+    uint8_t *mem_flags;         //[MEM_SIZE] CHIP8_BREAK/CHIP8_WATCH_*, NULL when nothing is set
+    uint16_t watch_addr;        //address of the last watchpoint hit
+    uint8_t watch_hit;          //CHIP8_WATCH_* of that hit, 0 if none
+
+    struct Chip8HookTable *hooks; //chip8_set_hooks, NULL when none
 } Chip8;
 
+// Installed hooks. While set, Chip8.mem_flags points at flags, so the
+// debugger's breakpoints and hooks are not used on the same instance, and
+// on_mem_write comes from the watchpoint checks (CHIP8_WATCHPOINTS).
+typedef struct Chip8HookTable {
+    Chip8Hooks hooks;
+    uint8_t flags[MEM_SIZE];    //CHIP8_BREAK: on_pc, CHIP8_WATCH_WRITE: on_mem_write
+} Chip8HookTable;
+
+_Static_assert(sizeof(((Chip8 *)0)->hot) == CHIP8_HOT_SIZE, "Chip8 hot state must fit one cache line");
+
+// Zobrist key slots: memory (addr << 8 | value), display rows, registers
+#define HASH_SLOT_DISP 0x100000u
+#define HASH_SLOT_REGS 0x200000u
+
 void chip8_reset(Chip8 * chip8);
-void load_rom(char * filename, Chip8 *chip8);
-void chip8_step (Chip8 *chip8);
+int load_rom(const char *filename, Chip8 *chip8);
 uint16_t chip8_fetch_opcode (Chip8 *chip8);
-void chip8_timer_tick(Chip8 *chip8);
-void chip8_disp_to_pixels(Chip8 *chip8, uint32_t *pixels);
+uint64_t chip8_disp_lores_row(const Chip8 *chip8, int y);
+void chip8_fork(Chip8 *dst, const Chip8 *src);
+void chip8_release(Chip8 *chip8);
+long chip8_pages_live(void);
+double chip8_mem_resident(const Chip8 *chip8);
+void chip8_state_hash_rebuild(Chip8 *chip8);
+
+static inline uint64_t chip8_hash_mix(uint64_t z){
+    //splitmix64 finalizer
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t chip8_hash_key(uint32_t slot){
+    //stands in for a table of random keys
+    return chip8_hash_mix((uint64_t)slot + 0x9E3779B97F4A7C15ull);
+}
+
+static inline uint64_t chip8_hash_row(int y, Chip8Row row){
+    //blank rows hash to 0 so a cleared display starts at hash 0
+    uint64_t hi = (uint64_t)(row >> 64);
+    uint64_t lo = (uint64_t)row;
+    if (!(hi | lo)){
+        return 0;
+    }
+    return chip8_hash_mix(hi ^ chip8_hash_key(HASH_SLOT_DISP + 2 * (uint32_t)y)) ^
+           chip8_hash_mix(lo + chip8_hash_key(HASH_SLOT_DISP + 2 * (uint32_t)y + 1));
+}
+
+static inline int chip8_disp_width(const Chip8 *chip8){
+    return chip8->hires ? DISP_HIRES_WIDTH : DISP_WIDTH;
+}
+
+static inline int chip8_disp_height(const Chip8 *chip8){
+    return chip8->hires ? DISP_HIRES_HEIGHT : DISP_HEIGHT;
+}
+
+static inline bool chip8_pixel(const Chip8 *chip8, int x, int y){
+    return (chip8->display[y] >> (DISP_HIRES_WIDTH - 1 - x)) & 1;
+}
+
+static inline uint64_t chip8_hash_mem_key(uint16_t addr, uint8_t value){
+    //zero bytes hash to 0 so a memset Chip8 starts at hash 0
+    return value ? chip8_hash_key(((uint32_t)addr << 8) | value) : 0;
+}
+
+static inline uint16_t chip8_mem_addr(uint32_t addr){
+    //addresses wrap at 4 KB in every build, I + n past 0xFFF included
+    return (uint16_t)(addr & (MEM_SIZE - 1));
+}
+
+static inline void chip8_watch(Chip8 *chip8, uint16_t addr, unsigned len, uint8_t kind){
+    //record the first flagged byte of [addr, addr + len) for the debugger
+#if CHIP8_WATCHPOINTS
+    if (chip8->mem_flags){
+        for (unsigned i = 0; i < len; i++){
+            uint16_t a = chip8_mem_addr(addr + i);
+            if (chip8->mem_flags[a] & kind){
+                chip8->watch_addr = a;
+                chip8->watch_hit = kind;
+                return;
+            }
+        }
+    }
+#else
+    (void)chip8;
+    (void)addr;
+    (void)len;
+    (void)kind;
+#endif
+}
+
+#if CHIP8_PAGED_MEMORY
+bool chip8_page_unshare(Chip8 *chip8, int index);
+
+static inline uint8_t chip8_mem_read(const Chip8 *chip8, uint16_t addr){
+    addr = chip8_mem_addr(addr);
+    return chip8->pages[addr >> MEM_PAGE_SHIFT]->data[addr & (MEM_PAGE_SIZE - 1)];
+}
+
+static inline void chip8_mem_write(Chip8 *chip8, uint16_t addr, uint8_t value){
+    addr = chip8_mem_addr(addr);
+    int index = addr >> MEM_PAGE_SHIFT;
+    //only the sole owner may write in place
+    if (__atomic_load_n(&chip8->pages[index]->refs, __ATOMIC_ACQUIRE) > 1 &&
+        !chip8_page_unshare(chip8, index)){
+        return;
+    }
+    uint8_t *byte = &chip8->pages[index]->data[addr & (MEM_PAGE_SIZE - 1)];
+#if CHIP8_STATE_HASH
+    chip8->mem_hash ^= chip8_hash_mem_key(addr, *byte) ^ chip8_hash_mem_key(addr, value);
+#endif
+    *byte = value;
+}
+#else
+static inline uint8_t chip8_mem_read(const Chip8 *chip8, uint16_t addr){
+    return chip8->memory[chip8_mem_addr(addr)];
+}
+
+static inline void chip8_mem_write(Chip8 *chip8, uint16_t addr, uint8_t value){
+    addr = chip8_mem_addr(addr);
+#if CHIP8_STATE_HASH
+    chip8->mem_hash ^= chip8_hash_mem_key(addr, chip8->memory[addr]) ^ chip8_hash_mem_key(addr, value);
+#endif
+    chip8->memory[addr] = value;
+}
+#endif
+
+static inline bool chip8_exited(const Chip8 *chip8){
+    //SUPER-CHIP 00FD stops on itself
+    return chip8_mem_read(chip8, chip8->pc) == 0x00 && chip8_mem_read(chip8, chip8->pc + 1) == 0xFD;
+}
+
+
+#endif
\ No newline at end of file
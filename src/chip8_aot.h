@@ -0,0 +1,12 @@
+#ifndef CHIP8_AOT_H
+#define CHIP8_AOT_H
+
+#include "chip8.h"
+
+// Implemented by the C file that tools/chip8_aotc.c generates for one ROM.
+// Only linked into the `make aot` build (CHIP8_AOT=1).
+
+void chip8_aot_load(Chip8 *chip8);
+int chip8_aot_run(Chip8 *chip8, int cycles, int *ran);
+
+#endif
@@ -0,0 +1,124 @@
+#include "chip8_audio.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+
+static uint64_t now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t load_be64(const uint8_t *bytes){
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++){
+        v = v << 8 | bytes[i];
+    }
+    return v;
+}
+
+void chip8_audio_init(Chip8Audio *audio, int out_hz){
+    /*
+    out_hz: the device's sample rate (SDL_AudioSpec.freq as obtained)
+    */
+    memset(audio, 0, sizeof(*audio));
+    audio->out_hz = out_hz;
+    //4000 Hz at pitch 64, 2^(1/48) per pitch step
+    const double semi = 1.0145453349375237;
+    double hz = 4000.0;
+    for (int p = 0; p < 64; p++){
+        hz /= semi;
+    }
+    for (int pitch = 0; pitch < 256; pitch++){
+        audio->steps[pitch] = (uint32_t)(hz / out_hz * (double)(1u << AUDIO_PHASE_SHIFT) + 0.5);
+        hz *= semi;
+    }
+    audio->play_step = audio->steps[64];
+}
+
+void chip8_audio_update(Chip8Audio *audio, const Chip8 *chip8){
+    /*
+    Emulator thread: publish what should be playing now
+    */
+    uint32_t seq = atomic_load_explicit(&audio->seq, memory_order_relaxed);
+    atomic_store_explicit(&audio->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    atomic_store_explicit(&audio->pattern_hi, load_be64(chip8->audio_pattern), memory_order_relaxed);
+    atomic_store_explicit(&audio->pattern_lo, load_be64(chip8->audio_pattern + 8), memory_order_relaxed);
+    atomic_store_explicit(&audio->step, audio->steps[chip8->pitch], memory_order_relaxed);
+    atomic_store_explicit(&audio->enabled, chip8->sound_timer > 0, memory_order_relaxed);
+
+    atomic_store_explicit(&audio->seq, seq + 2, memory_order_release);
+}
+
+static void sync(Chip8Audio *audio){
+    //take the published state if no update overlapped, else keep the last one
+    uint32_t seq = atomic_load_explicit(&audio->seq, memory_order_acquire);
+    uint64_t hi = atomic_load_explicit(&audio->pattern_hi, memory_order_relaxed);
+    uint64_t lo = atomic_load_explicit(&audio->pattern_lo, memory_order_relaxed);
+    uint32_t step = atomic_load_explicit(&audio->step, memory_order_relaxed);
+    bool enabled = atomic_load_explicit(&audio->enabled, memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    if ((seq & 1) || atomic_load_explicit(&audio->seq, memory_order_relaxed) != seq){
+        chip8_counter_add(&audio->stats.torn, 1);
+        return;
+    }
+    audio->words[0] = hi;
+    audio->words[1] = lo;
+    audio->play_step = step;
+    audio->playing = enabled;
+}
+
+void chip8_audio_render(Chip8Audio *audio, int16_t *out, int count){
+    /*
+    Audio thread: fill count mono samples
+    */
+    uint64_t start = now_ns();
+    if (audio->last_start_ns &&
+        (start - audio->last_start_ns) * (uint64_t)audio->out_hz > 1500000000ull * (uint64_t)count){
+        chip8_counter_add(&audio->stats.late, 1);
+    }
+    audio->last_start_ns = start;
+
+    sync(audio);
+    if (!audio->playing){
+        //keep the phase so a restarted tone continues where it stopped
+        memset(out, 0, sizeof(*out) * (size_t)count);
+    } else {
+        const uint64_t words[2] = {audio->words[0], audio->words[1]};
+        const uint32_t step = audio->play_step;
+        uint32_t phase = audio->phase;
+        for (int i = 0; i < count; i++){
+            //bits 0-63 are in words[0], MSB first
+            uint32_t bit_index = phase >> AUDIO_PHASE_SHIFT;
+            int bit = (int)(words[bit_index >> 6] >> (~bit_index & 63)) & 1;
+            out[i] = (int16_t)((2 * bit - 1) * AUDIO_VOLUME);
+            phase += step;
+        }
+        audio->phase = phase;
+    }
+
+    chip8_counter_add(&audio->stats.samples, (uint64_t)count);
+    chip8_hist_add(&audio->stats.render, now_ns() - start);
+}
+
+void chip8_audio_report(FILE *out, const Chip8Audio *audio){
+    /*
+    Call after the audio device is closed
+    */
+    const Chip8AudioStats *s = &audio->stats;
+    uint64_t callbacks = s->render.count;
+    if (!callbacks){
+        return;
+    }
+    double played = (double)s->samples / audio->out_hz;
+    fprintf(out, "audio: %llu callbacks of %llu samples, %.2f us mean, %.2f us max, "
+            "%.4f%% of a core over %.1f s, %llu late, %llu torn\n",
+            (unsigned long long)callbacks, (unsigned long long)(s->samples / callbacks),
+            chip8_hist_mean(&s->render) * 1e-3, (double)s->render.max_ns * 1e-3,
+            played > 0 ? (double)s->render.sum_ns * 1e-9 / played * 100.0 : 0.0, played,
+            (unsigned long long)s->late, (unsigned long long)s->torn);
+}
@@ -0,0 +1,63 @@
+#ifndef CHIP8_AUDIO_H
+#define CHIP8_AUDIO_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "chip8.h"
+#include "chip8_metrics.h"
+
+// XO-CHIP audio mixer.
+//
+// While sound_timer > 0 the 128-bit pattern loaded by F002 plays in a loop,
+// one bit per sample at 4000 * 2^((pitch - 64) / 48) Hz (Fx3A). The default
+// pattern after reset is a 500 Hz square wave.
+//
+// The emulator thread calls chip8_audio_update once per main loop pass; it
+// publishes the pattern, step and enable flag under a seqlock, so neither
+// side ever blocks. chip8_audio_render, from the audio callback, resamples
+// whole buffers: the phase is a 32-bit fixed-point bit index (top 7 bits)
+// advanced by a per-pitch step from a table built at init, and each sample
+// is one shift and mask of a 64-bit pattern word, without branches.
+//
+// The callback also times itself; chip8_audio_report prints the audio
+// thread's CPU use and callbacks that came late, chip8_metrics exports them.
+
+#define AUDIO_VOLUME 3000
+#define AUDIO_PHASE_SHIFT 25        //phase >> 25 = bit 0-127 of the pattern
+
+// Written by the audio thread only, readable from any (see chip8_metrics.h)
+typedef struct Chip8AudioStats {
+    Chip8Histogram render;          //time spent in chip8_audio_render, count = callbacks
+    _Atomic uint64_t samples;
+    _Atomic uint64_t late;          //underruns: callbacks more than 1.5 buffers after the previous one
+    _Atomic uint64_t torn;          //renders that kept the previous state over a concurrent update
+} Chip8AudioStats;
+
+typedef struct Chip8Audio {
+    int out_hz;
+    uint32_t steps[256];            //phase step per output sample for each pitch
+
+    // Emulator -> audio thread, under seq (odd while written)
+    _Atomic uint32_t seq;
+    _Atomic uint64_t pattern_hi;    //pattern bytes 0-7, bit 63 plays first
+    _Atomic uint64_t pattern_lo;    //bytes 8-15
+    _Atomic uint32_t step;
+    _Atomic bool enabled;
+
+    // Audio thread only
+    uint64_t words[2];              //last consistent pattern
+    uint32_t play_step;
+    bool playing;
+    uint32_t phase;
+    uint64_t last_start_ns;
+    Chip8AudioStats stats;
+} Chip8Audio;
+
+void chip8_audio_init(Chip8Audio *audio, int out_hz);
+void chip8_audio_update(Chip8Audio *audio, const Chip8 *chip8);
+void chip8_audio_render(Chip8Audio *audio, int16_t *out, int count);
+void chip8_audio_report(FILE *out, const Chip8Audio *audio);
+
+#endif
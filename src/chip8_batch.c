@@ -0,0 +1,901 @@
+//src/chip8_batch.c
+#include "chip8_batch.h"
+#include "chip8_exec.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// Register ops the lockstep path runs across a whole tile
+typedef enum {
+    ALU_NONE,
+    ALU_LD_K,   //6xkk
+    ALU_ADD_K,  //7xkk
+    ALU_LD,     //8xy0
+    ALU_OR,     //8xy1
+    ALU_AND,    //8xy2
+    ALU_XOR,    //8xy3
+    ALU_ADD,    //8xy4
+    ALU_SUB,    //8xy5
+    ALU_SHR,    //8xy6
+    ALU_SUBN,   //8xy7
+    ALU_SHL,    //8xyE
+    ALU_SE_K,   //3xkk
+    ALU_SNE_K,  //4xkk
+    ALU_SE,     //5xy0
+    ALU_SNE     //9xy0
+} AluOp;
+
+
+Chip8Batch *chip8_batch_create(int count){
+    /*
+    Allocate a batch of `count` lanes, all zeroed.
+    Load them with chip8_batch_set.
+    */
+    if (count <= 0){
+        return NULL;
+    }
+
+    Chip8Batch *batch = calloc(1, sizeof(*batch));
+    if (!batch){
+        return NULL;
+    }
+
+    int groups = (count + BATCH_GROUP - 1) / BATCH_GROUP;
+    size_t lanes = (size_t)groups * BATCH_GROUP;
+    size_t group_bytes = (size_t)groups * sizeof(Chip8Lanes);
+
+    batch->block = calloc(1, 64 + group_bytes + lanes * MEM_SIZE);
+    if (!batch->block){
+        free(batch);
+        return NULL;
+    }
+
+    //tiles on a cache line boundary so each register row is one aligned load
+    uint8_t *base = (uint8_t *)(((uintptr_t)batch->block + 63) & ~(uintptr_t)63);
+    batch->group = (Chip8Lanes *)base;
+    batch->memory = base + group_bytes;
+    batch->count = count;
+    batch->groups = groups;
+
+    for (int lane = 0; lane < (int)lanes; lane++){
+        batch->group[lane / BATCH_GROUP].wait_key_value[lane % BATCH_GROUP] = 0xFF;
+        chip8_batch_seed(batch, lane, (uint32_t)lane + 1);
+    }
+
+    return batch;
+}
+
+void chip8_batch_destroy(Chip8Batch *batch){
+    if (!batch){
+        return;
+    }
+    free(batch->block);
+    free(batch);
+}
+
+
+void chip8_batch_set(Chip8Batch *batch, int lane, const Chip8 *chip8){
+    /*
+    Copy a scalar Chip8 into one lane.
+    The usual setup is chip8_reset + load_rom once, then set every lane.
+    */
+    Chip8Lanes *g = &batch->group[lane / BATCH_GROUP];
+    int l = lane % BATCH_GROUP;
+
+    for (int r = 0; r < 16; r++){
+        g->V[r][l] = chip8->V[r];
+    }
+    g->I[l] = chip8->I;
+    g->rng[l] = chip8->rng;
+    g->pc[l] = chip8->pc;
+    g->sp[l] = chip8->sp;
+    g->delay_timer[l] = chip8->delay_timer;
+    g->sound_timer[l] = chip8->sound_timer;
+    g->draw_flag[l] = chip8->draw_flag;
+    g->waiting_for_key[l] = chip8->waiting_for_key;
+    g->wait_key_reg[l] = chip8->wait_key_reg;
+    g->wait_key_value[l] = chip8->wait_key_value;
+    g->quirks[l] = chip8->quirks;
+    g->vblank_wait[l] = chip8->vblank_wait;
+    g->hires[l] = chip8->hires;
+    g->err[l] = CHIP8_OK;
+    g->pitch[l] = chip8->pitch;
+
+    g->keypad[l] = chip8->keypad;
+
+    for (int s = 0; s < 16; s++){
+        g->stack[l][s] = chip8->stack[s];
+        g->rpl[l][s] = chip8->rpl[s];
+        g->audio_pattern[l][s] = chip8->audio_pattern[s];
+    }
+    memcpy(g->display[l], chip8->display, sizeof(chip8->display));
+
+    uint8_t *mem = &batch->memory[(size_t)lane * MEM_SIZE];
+    for (int addr = 0; addr < MEM_SIZE; addr++){
+        mem[addr] = chip8_mem_read(chip8, (uint16_t)addr);
+    }
+
+    if (!batch->has_image){
+        memcpy(batch->image, mem, MEM_SIZE);
+        batch->has_image = true;
+    } else {
+        for (int addr = 0; addr < MEM_SIZE; addr++){
+            if (mem[addr] != batch->image[addr]){
+                batch->written[addr] = 1;
+            }
+        }
+    }
+}
+
+void chip8_batch_get(const Chip8Batch *batch, int lane, Chip8 *chip8){
+    /*
+    Expand one lane back into a scalar Chip8, for the debugger and front end.
+    A stopped lane is left on the instruction that failed, see
+    chip8_batch_error.
+    */
+    const Chip8Lanes *g = &batch->group[lane / BATCH_GROUP];
+    int l = lane % BATCH_GROUP;
+
+    for (int r = 0; r < 16; r++){
+        chip8->V[r] = g->V[r][l];
+    }
+    chip8->I = g->I[l];
+    chip8->rng = g->rng[l];
+    chip8->pc = g->pc[l];
+    chip8->sp = g->sp[l];
+    chip8->delay_timer = g->delay_timer[l];
+    chip8->sound_timer = g->sound_timer[l];
+    chip8->draw_flag = g->draw_flag[l];
+    chip8->waiting_for_key = g->waiting_for_key[l];
+    chip8->wait_key_reg = g->wait_key_reg[l];
+    chip8->wait_key_value = g->wait_key_value[l];
+    chip8->quirks = g->quirks[l];
+    chip8->vblank_wait = g->vblank_wait[l];
+    chip8->hires = g->hires[l];
+    chip8->pitch = g->pitch[l];
+
+    chip8->keypad = g->keypad[l];
+
+    for (int s = 0; s < 16; s++){
+        chip8->stack[s] = g->stack[l][s];
+        chip8->rpl[s] = g->rpl[l][s];
+        chip8->audio_pattern[s] = g->audio_pattern[l][s];
+    }
+    memcpy(chip8->display, g->display[l], sizeof(chip8->display));
+
+    //chip8 must already own pages (chip8_reset) in CHIP8_PAGED_MEMORY builds
+    const uint8_t *mem = &batch->memory[(size_t)lane * MEM_SIZE];
+    for (int addr = 0; addr < MEM_SIZE; addr++){
+        chip8_mem_write(chip8, (uint16_t)addr, mem[addr]);
+    }
+    chip8_state_hash_rebuild(chip8); //display was written directly
+}
+
+void chip8_batch_seed(Chip8Batch *batch, int lane, uint32_t seed){
+    //xorshift32 never leaves 0
+    batch->group[lane / BATCH_GROUP].rng[lane % BATCH_GROUP] = seed ? seed : 0x9E3779B9u;
+}
+
+void chip8_batch_set_keys(Chip8Batch *batch, int lane, uint16_t mask){
+    batch->group[lane / BATCH_GROUP].keypad[lane % BATCH_GROUP] = mask;
+}
+
+
+int chip8_batch_error(const Chip8Batch *batch, int lane){
+    //CHIP8_OK while the lane runs, else what stopped it
+    return batch->group[lane / BATCH_GROUP].err[lane % BATCH_GROUP];
+}
+
+
+static uint8_t lane_read(const Chip8Batch *batch, const uint8_t *mem, uint16_t addr){
+    //bytes nobody wrote are read from the shared image, which stays in cache
+    addr = chip8_mem_addr(addr);
+    return batch->written[addr] ? mem[addr] : batch->image[addr];
+}
+
+static bool lane_modified(const Chip8Batch *batch, uint16_t pc){
+    //some lane wrote to the opcode at pc
+    return batch->written[chip8_mem_addr(pc)] | batch->written[chip8_mem_addr(pc + 1)];
+}
+
+static uint16_t lane_fetch(const Chip8Batch *batch, int lane, uint16_t pc){
+    const uint8_t *mem = lane_modified(batch, pc)
+        ? &batch->memory[(size_t)lane * MEM_SIZE]
+        : batch->image;
+    return (uint16_t)((mem[chip8_mem_addr(pc)] << 8) | mem[chip8_mem_addr(pc + 1)]);
+}
+
+static void lane_write(Chip8Batch *batch, uint8_t *mem, uint16_t addr, uint8_t value){
+    addr = chip8_mem_addr(addr);
+    mem[addr] = value;
+    batch->written[addr] = 1;
+}
+
+static bool lane_ready(Chip8Lanes *g, int l){
+    //the checks at the top of chip8_step, a PC past memory stops the lane
+    if (g->err[l] != CHIP8_OK || g->vblank_wait[l]){
+        return false;
+    }
+    if (g->pc[l] > MEM_SIZE - 2){
+        g->err[l] = CHIP8_ERR_PC;
+        return false;
+    }
+    return true;
+}
+
+static int lane_exec(Chip8Batch *batch, Chip8Lanes *g, int l, uint8_t *mem, uint16_t opcode){
+    /*
+    Execute one already fetched opcode on one lane, PC already past it.
+    Decoded like chip8_step, the bodies are those of chip8_exec.h on the
+    tiled layout. Returns CHIP8_OK or the Chip8Error chip8_step would
+    return, with the PC back on the instruction.
+    Addresses wrap at MEM_SIZE so a bad I cannot reach the next lane.
+    */
+    uint16_t nnn = opcode & 0x0FFF;
+    uint8_t n = opcode & 0x000F;
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    uint8_t y = (opcode & 0x00F0) >> 4;
+    uint8_t kk = opcode & 0x00FF;
+
+    //lane l of every register row, stride BATCH_GROUP
+    uint8_t *V = &g->V[0][l];
+    Chip8Row *display = g->display[l];
+    uint8_t vx = V[x * BATCH_GROUP];
+    uint8_t vy = V[y * BATCH_GROUP];
+
+    switch (opcode & 0xF000){
+    case 0x0000:
+        switch (opcode){
+        case 0x00E0:
+            chip8_exec_clear(display);
+            break;
+        case 0x00EE:
+            return chip8_exec_ret(g->stack[l], &g->sp[l], &g->pc[l]);
+        case 0x00FB:
+            chip8_exec_scroll_right(display, g->hires[l]);
+            break;
+        case 0x00FC:
+            chip8_exec_scroll_left(display, g->hires[l]);
+            break;
+        case 0x00FD:
+            //exit: stays on itself
+            g->pc[l] -= 2;
+            return CHIP8_OK;
+        case 0x00FE:
+        case 0x00FF:
+            g->hires[l] = opcode == 0x00FF;
+            chip8_exec_clear(display);
+            break;
+        default:
+            if ((opcode & 0xFFF0) != 0x00C0){
+                g->pc[l] -= 2;
+                return CHIP8_ERR_OPCODE;
+            }
+            chip8_exec_scroll_down(display, n, g->hires[l]);
+            break;
+        }
+        g->draw_flag[l] = 1;
+        break;
+
+    case 0x1000:
+        g->pc[l] = nnn;
+        break;
+
+    case 0x2000:
+        return chip8_exec_call(g->stack[l], &g->sp[l], &g->pc[l], nnn);
+
+    case 0x3000:
+        if (vx == kk) g->pc[l] += 2;
+        break;
+
+    case 0x4000:
+        if (vx != kk) g->pc[l] += 2;
+        break;
+
+    case 0x5000:
+        if (vx == vy) g->pc[l] += 2;
+        break;
+
+    case 0x6000:
+        V[x * BATCH_GROUP] = kk;
+        break;
+
+    case 0x7000:
+        V[x * BATCH_GROUP] = vx + kk;
+        break;
+
+    case 0x8000: {
+        uint8_t result = 0;
+        uint8_t vf = 0;
+        int store = chip8_exec_alu(n, vx, vy, &result, &vf);
+        if (store != CHIP8_ALU_NONE){
+            V[x * BATCH_GROUP] = result;
+        }
+        if (store == CHIP8_ALU_VX_VF){
+            V[0xF * BATCH_GROUP] = vf;
+        }
+        break;
+    }
+
+    case 0x9000:
+        if (vx != vy) g->pc[l] += 2;
+        break;
+
+    case 0xA000:
+        g->I[l] = nnn;
+        break;
+
+    case 0xB000:
+        g->pc[l] = nnn + V[0];
+        break;
+
+    case 0xC000:
+        V[x * BATCH_GROUP] = chip8_exec_rnd(&g->rng[l], kk);
+        break;
+
+    case 0xD000: {
+        uint8_t sprite[32];
+        unsigned bytes = chip8_exec_sprite_bytes(n);
+        for (unsigned i = 0; i < bytes; i++){
+            sprite[i] = lane_read(batch, mem, g->I[l] + i);
+        }
+        chip8_exec_draw(display, V, BATCH_GROUP, sprite, x, y, n, g->hires[l], NULL);
+        g->draw_flag[l] = 1;
+        if (g->quirks[l] & CHIP8_QUIRK_DISPLAY_WAIT){
+            g->vblank_wait[l] = true;
+        }
+        break;
+    }
+
+    case 0xE000:
+        switch (opcode & 0xF0FF){
+        case 0xE09E:
+            if (chip8_exec_key_down(g->keypad[l], vx)) g->pc[l] += 2;
+            break;
+        case 0xE0A1:
+            if (!chip8_exec_key_down(g->keypad[l], vx)) g->pc[l] += 2;
+            break;
+        default:
+            break;
+        }
+        break;
+
+    default:
+        switch (opcode & 0xF0FF){
+        case 0xF002:
+            for (int i = 0; i < 16; i++){
+                g->audio_pattern[l][i] = lane_read(batch, mem, g->I[l] + i);
+            }
+            break;
+
+        case 0xF007:
+            V[x * BATCH_GROUP] = g->delay_timer[l];
+            break;
+
+        case 0xF00A: {
+            uint8_t dest = 0;
+            int key = chip8_exec_wait_key(&g->waiting_for_key[l], &g->wait_key_reg[l], &g->wait_key_value[l],
+                                          g->keypad[l], x, &dest);
+            if (key < 0){
+                g->pc[l] -= 2;
+            } else {
+                V[dest * BATCH_GROUP] = (uint8_t)key;
+            }
+            break;
+        }
+
+        case 0xF015:
+            g->delay_timer[l] = vx;
+            break;
+
+        case 0xF018:
+            g->sound_timer[l] = vx;
+            break;
+
+        case 0xF01E:
+            g->I[l] += vx;
+            break;
+
+        case 0xF029:
+            g->I[l] = chip8_exec_font(vx);
+            break;
+
+        case 0xF030:
+            g->I[l] = chip8_exec_big_font(vx);
+            break;
+
+        case 0xF033: {
+            uint8_t digits[3];
+            chip8_exec_bcd(vx, digits);
+            for (int i = 0; i < 3; i++){
+                lane_write(batch, mem, g->I[l] + i, digits[i]);
+            }
+            break;
+        }
+
+        case 0xF03A:
+            g->pitch[l] = vx;
+            break;
+
+        case 0xF055:
+            for (int r = 0; r <= x; r++){
+                lane_write(batch, mem, g->I[l] + r, V[r * BATCH_GROUP]);
+            }
+            g->I[l] += x + 1;
+            break;
+
+        case 0xF065:
+            for (int r = 0; r <= x; r++){
+                V[r * BATCH_GROUP] = lane_read(batch, mem, g->I[l] + r);
+            }
+            g->I[l] += x + 1;
+            break;
+
+        case 0xF075:
+            for (int r = 0; r <= x; r++){
+                g->rpl[l][r] = V[r * BATCH_GROUP];
+            }
+            break;
+
+        case 0xF085:
+            for (int r = 0; r <= x; r++){
+                V[r * BATCH_GROUP] = g->rpl[l][r];
+            }
+            break;
+
+        default:
+            break;
+        }
+        break;
+    }
+    return CHIP8_OK;
+}
+
+static void lane_step(Chip8Batch *batch, Chip8Lanes *g, int l, int lane){
+    //fetch and run one instruction of a lane lane_ready said can run
+    uint16_t pc = g->pc[l];
+    uint16_t opcode = lane_fetch(batch, lane, pc);
+    g->pc[l] = pc + 2;
+    g->err[l] = (int8_t)lane_exec(batch, g, l, &batch->memory[(size_t)lane * MEM_SIZE], opcode);
+}
+
+
+static AluOp alu_op(uint16_t opcode){
+    switch (opcode & 0xF000){
+    case 0x3000: return ALU_SE_K;
+    case 0x4000: return ALU_SNE_K;
+    case 0x5000: return ALU_SE;
+    case 0x6000: return ALU_LD_K;
+    case 0x7000: return ALU_ADD_K;
+    case 0x9000: return ALU_SNE;
+    case 0x8000:
+        switch (opcode & 0x000F){
+        case 0x0: return ALU_LD;
+        case 0x1: return ALU_OR;
+        case 0x2: return ALU_AND;
+        case 0x3: return ALU_XOR;
+        case 0x4: return ALU_ADD;
+        case 0x5: return ALU_SUB;
+        case 0x6: return ALU_SHR;
+        case 0x7: return ALU_SUBN;
+        case 0xE: return ALU_SHL;
+        default: return ALU_NONE;
+        }
+    default:
+        return ALU_NONE;
+    }
+}
+
+#ifdef __AVX2__
+static __m256i lanes_mask(uint32_t bits){
+    //lane bits to 0xFF/0 bytes for blendv: byte l gets byte l / 8 of bits,
+    //then its own bit is tested
+    const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                            2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i bit = _mm256_set1_epi64x((long long)0x8040201008040201ull);
+    __m256i b = _mm256_shuffle_epi8(_mm256_set1_epi32((int)bits), spread);
+    return _mm256_cmpeq_epi8(_mm256_and_si256(b, bit), bit);
+}
+#endif
+
+static uint32_t group_alu(Chip8Lanes *g, uint32_t cohort, uint16_t opcode, AluOp op){
+    /*
+    Run one register op on the cohort lanes of a tile. Skip ops return
+    the lanes that take the skip.
+    The AVX2 path is the vector form of chip8_exec_alu, the bench compares
+    its results against chip8_step.
+    */
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    uint8_t y = (opcode & 0x00F0) >> 4;
+    uint8_t kk = opcode & 0x00FF;
+
+    uint8_t *vx = g->V[x];
+    uint8_t *vy = g->V[y];
+    uint8_t *vf = g->V[0xF];
+
+#ifdef __AVX2__
+    __m256i m = lanes_mask(cohort);
+    __m256i a = _mm256_loadu_si256((const __m256i *)vx);
+    __m256i b = _mm256_loadu_si256((const __m256i *)vy);
+    __m256i k = _mm256_set1_epi8((char)kk);
+    __m256i one = _mm256_set1_epi8(1);
+    __m256i r = a;
+    __m256i f = _mm256_setzero_si256();
+    bool set_f = true;
+
+    switch (op){
+    case ALU_LD_K:  r = k; set_f = false; break;
+    case ALU_ADD_K: r = _mm256_add_epi8(a, k); set_f = false; break;
+    case ALU_LD:    r = b; set_f = false; break;
+    case ALU_OR:    r = _mm256_or_si256(a, b); break;
+    case ALU_AND:   r = _mm256_and_si256(a, b); break;
+    case ALU_XOR:   r = _mm256_xor_si256(a, b); break;
+    case ALU_ADD:
+        r = _mm256_add_epi8(a, b);
+        //carry when the wrapped sum is below an operand
+        f = _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(r, a), r), one);
+        break;
+    case ALU_SUB:
+        r = _mm256_sub_epi8(a, b);
+        f = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(a, b), a), one);
+        break;
+    case ALU_SUBN:
+        r = _mm256_sub_epi8(b, a);
+        f = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(b, a), b), one);
+        break;
+    case ALU_SHR:
+        //no 8 bit shifts in AVX2, shift 16 bit lanes and drop the carried bit
+        r = _mm256_and_si256(_mm256_srli_epi16(b, 1), _mm256_set1_epi8(0x7F));
+        f = _mm256_and_si256(b, one);
+        break;
+    case ALU_SHL:
+        r = _mm256_add_epi8(b, b);
+        f = _mm256_and_si256(_mm256_srli_epi16(b, 7), one);
+        break;
+    case ALU_SE_K:
+        return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, k)) & cohort;
+    case ALU_SNE_K:
+        return ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, k)) & cohort;
+    case ALU_SE:
+        return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)) & cohort;
+    case ALU_SNE:
+        return ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)) & cohort;
+    case ALU_NONE:
+        return 0;
+    }
+
+    _mm256_storeu_si256((__m256i *)vx, _mm256_blendv_epi8(a, r, m));
+    if (set_f){
+        //reload, x may be F
+        __m256i old_f = _mm256_loadu_si256((const __m256i *)vf);
+        _mm256_storeu_si256((__m256i *)vf, _mm256_blendv_epi8(old_f, f, m));
+    }
+    return 0;
+#else
+    uint32_t skip = 0;
+    for (; cohort; cohort &= cohort - 1){
+        int l = __builtin_ctz(cohort);
+        uint8_t a = vx[l];
+        uint8_t b = vy[l];
+        bool taken = false;
+
+        switch (op){
+        case ALU_LD_K:  vx[l] = kk; break;
+        case ALU_ADD_K: vx[l] = a + kk; break;
+        case ALU_SE_K:  taken = a == kk; break;
+        case ALU_SNE_K: taken = a != kk; break;
+        case ALU_SE:    taken = a == b; break;
+        case ALU_SNE:   taken = a != b; break;
+        case ALU_NONE:  break;
+        default: {
+            //8xyn, the body chip8_step runs
+            uint8_t result = 0;
+            uint8_t flag = 0;
+            int store = chip8_exec_alu(opcode & 0x000F, a, b, &result, &flag);
+            if (store != CHIP8_ALU_NONE){
+                vx[l] = result;
+            }
+            if (store == CHIP8_ALU_VX_VF){
+                vf[l] = flag;
+            }
+            break;
+        }
+        }
+        skip |= (uint32_t)taken << l;
+    }
+    return skip;
+#endif
+}
+
+static bool group_simple(Chip8Lanes *g, uint32_t cohort, uint16_t opcode, uint16_t next){
+    /*
+    Ops that only move values between per lane arrays, run lane by lane
+    over the cohort. Returns false if the opcode needs lane_exec.
+    */
+    uint16_t nnn = opcode & 0x0FFF;
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    uint8_t *vx = g->V[x];
+
+    switch (opcode & 0xF000){
+    case 0x1000:
+        for (; cohort; cohort &= cohort - 1){
+            g->pc[__builtin_ctz(cohort)] = nnn;
+        }
+        return true;
+
+    case 0xA000:
+        for (; cohort; cohort &= cohort - 1){
+            int l = __builtin_ctz(cohort);
+            g->I[l] = nnn;
+            g->pc[l] = next;
+        }
+        return true;
+
+    case 0xE000: {
+        if ((opcode & 0xF0FF) != 0xE09E && (opcode & 0xF0FF) != 0xE0A1){
+            return false;
+        }
+        bool when_down = (opcode & 0x00FF) == 0x9E;
+        for (; cohort; cohort &= cohort - 1){
+            int l = __builtin_ctz(cohort);
+            bool skip = chip8_exec_key_down(g->keypad[l], vx[l]) == when_down;
+            g->pc[l] = (uint16_t)(next + 2 * skip);
+        }
+        return true;
+    }
+
+    case 0xF000:
+        switch (opcode & 0xF0FF){
+        case 0xF007:
+        case 0xF015:
+        case 0xF018:
+        case 0xF01E:
+        case 0xF029:
+            break;
+        default:
+            return false;
+        }
+        for (; cohort; cohort &= cohort - 1){
+            int l = __builtin_ctz(cohort);
+            switch (opcode & 0xF0FF){
+            case 0xF007: vx[l] = g->delay_timer[l]; break;
+            case 0xF015: g->delay_timer[l] = vx[l]; break;
+            case 0xF018: g->sound_timer[l] = vx[l]; break;
+            case 0xF01E: g->I[l] += vx[l]; break;
+            default:     g->I[l] = chip8_exec_font(vx[l]); break;
+            }
+            g->pc[l] = next;
+        }
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+typedef enum {
+    STEP_LOCKSTEP,  //most lanes shared the instruction
+    STEP_DIVERGED,  //too few lanes agreed for lockstep to pay off
+    STEP_PARKED,    //every running lane spins on a jump to itself
+    STEP_IDLE       //no lane can run until the next timer tick, if ever
+} StepResult;
+
+static uint32_t lanes_at(const Chip8Lanes *g, uint16_t pc){
+    //bit l set when lane l is on pc
+#ifdef __AVX2__
+    __m256i p = _mm256_set1_epi16((short)pc);
+    __m256i lo = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i *)&g->pc[0]), p);
+    __m256i hi = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i *)&g->pc[16]), p);
+    //packs works per 128-bit half, put the quarters back in lane order
+    __m256i eq = _mm256_permute4x64_epi64(_mm256_packs_epi16(lo, hi), 0xD8);
+    return (uint32_t)_mm256_movemask_epi8(eq);
+#else
+    uint32_t bits = 0;
+    for (int l = 0; l < BATCH_GROUP; l++){
+        bits |= (uint32_t)(g->pc[l] == pc) << l;
+    }
+    return bits;
+#endif
+}
+
+static uint32_t lanes_ready(const Chip8Lanes *g, int live){
+    //bit l set when lane_ready(g, l) would be true, without stopping any lane
+    uint32_t bits = 0;
+#ifdef __AVX2__
+    __m256i zero = _mm256_setzero_si256();
+    __m256i stop = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)g->err),
+                                   _mm256_loadu_si256((const __m256i *)g->vblank_wait));
+    //pc <= MEM_SIZE - 2 where min(pc, MEM_SIZE - 2) == pc
+    __m256i top = _mm256_set1_epi16((short)(MEM_SIZE - 2));
+    __m256i lo = _mm256_loadu_si256((const __m256i *)&g->pc[0]);
+    __m256i hi = _mm256_loadu_si256((const __m256i *)&g->pc[16]);
+    __m256i in = _mm256_permute4x64_epi64(_mm256_packs_epi16(_mm256_cmpeq_epi16(_mm256_min_epu16(lo, top), lo),
+                                                             _mm256_cmpeq_epi16(_mm256_min_epu16(hi, top), hi)), 0xD8);
+    bits = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(stop, zero)) & (uint32_t)_mm256_movemask_epi8(in);
+#else
+    for (int l = 0; l < BATCH_GROUP; l++){
+        bool ready = (g->err[l] == CHIP8_OK) & !g->vblank_wait[l] & (g->pc[l] <= MEM_SIZE - 2);
+        bits |= (uint32_t)ready << l;
+    }
+#endif
+    return live == BATCH_GROUP ? bits : bits & ((1u << live) - 1);
+}
+
+static void group_exec(Chip8Batch *batch, int index, uint32_t cohort, uint16_t pc0, uint16_t opcode){
+    /*
+    Run the opcode at pc0 on the lanes of a tile set in cohort: register
+    ops through group_alu, register/timer moves through group_simple,
+    everything else through lane_exec with a single fetch and decode.
+    */
+    Chip8Lanes *g = &batch->group[index];
+    int base = index * BATCH_GROUP;
+    uint16_t next = pc0 + 2;
+    int members = __builtin_popcount(cohort);
+
+    if (members > 1){
+        AluOp op = alu_op(opcode);
+        batch->simd_lane_steps += members;
+
+        if (op != ALU_NONE){
+            uint32_t skip = group_alu(g, cohort, opcode, op);
+            for (; cohort; cohort &= cohort - 1){
+                int l = __builtin_ctz(cohort);
+                g->pc[l] = (uint16_t)(next + 2 * ((skip >> l) & 1));
+            }
+            return;
+        }
+        if (group_simple(g, cohort, opcode, next)){
+            return;
+        }
+    } else {
+        batch->scalar_lane_steps++;
+    }
+
+    for (; cohort; cohort &= cohort - 1){
+        int l = __builtin_ctz(cohort);
+        g->pc[l] = next;
+        g->err[l] = (int8_t)lane_exec(batch, g, l, &batch->memory[(size_t)(base + l) * MEM_SIZE], opcode);
+    }
+}
+
+static StepResult group_step(Chip8Batch *batch, int index, int *members){
+    /*
+    Retire one instruction on every lane of a tile lane_ready lets run.
+
+    Lanes on the same PC (and opcode, where code was written) form a
+    cohort that runs together through group_exec, one cohort after the
+    other. *members is the size of the largest.
+    */
+    Chip8Lanes *g = &batch->group[index];
+    int base = index * BATCH_GROUP;
+    int live = batch->count - base;
+    if (live > BATCH_GROUP){
+        live = BATCH_GROUP;
+    }
+
+    uint32_t left = lanes_ready(g, live);
+    int running = __builtin_popcount(left);
+    if (running < live){
+        //stop lanes on a bad PC
+        for (int l = 0; l < live; l++){
+            lane_ready(g, l);
+        }
+        if (!running){
+            return STEP_IDLE;
+        }
+    }
+
+    int cohorts = 0;
+    uint16_t pc0 = 0;
+    uint16_t opcode = 0;
+    *members = 0;
+    while (left){
+        int lead = __builtin_ctz(left);
+        pc0 = g->pc[lead];
+        opcode = lane_fetch(batch, base + lead, pc0);
+        uint32_t cohort = lanes_at(g, pc0) & left;
+        if (lane_modified(batch, pc0)){
+            //modified code has to be compared lane by lane
+            for (uint32_t rest = cohort & (cohort - 1); rest; rest &= rest - 1){
+                int l = __builtin_ctz(rest);
+                if (lane_fetch(batch, base + l, pc0) != opcode){
+                    cohort &= ~(1u << l);
+                }
+            }
+        }
+        left &= ~cohort;
+        group_exec(batch, index, cohort, pc0, opcode);
+
+        cohorts++;
+        if (__builtin_popcount(cohort) > *members){
+            *members = __builtin_popcount(cohort);
+        }
+    }
+
+    if (cohorts == 1){
+        //every running lane parked on a jump to itself, nothing can change
+        //until the next timer tick or key event
+        return opcode == (0x1000 | pc0) ? STEP_PARKED : STEP_LOCKSTEP;
+    }
+    //no cohort holds half the lanes: stepping lanes on their own is cheaper
+    return (*members * 2 < running) ? STEP_DIVERGED : STEP_LOCKSTEP;
+}
+
+static void group_run_scalar(Chip8Batch *batch, int index, int cycles){
+    /*
+    Run each lane of a diverged tile on its own for `cycles` instructions,
+    or until it stops. Saves the per step vote when lanes have nothing in
+    common.
+    */
+    Chip8Lanes *g = &batch->group[index];
+    int base = index * BATCH_GROUP;
+    int live = batch->count - base;
+    if (live > BATCH_GROUP){
+        live = BATCH_GROUP;
+    }
+
+    for (int l = 0; l < live; l++){
+        int c = 0;
+        //nothing clears a stop within a call
+        for (; c < cycles && lane_ready(g, l); c++){
+            lane_step(batch, g, l, base + l);
+        }
+        batch->scalar_lane_steps += (uint64_t)c;
+    }
+}
+
+int chip8_batch_run(Chip8Batch *batch, int cycles){
+    /*
+    Run `cycles` instructions on every lane, like `cycles` chip8_step calls
+    on each instance: lanes in display-wait or stopped on an error skip
+    them. Tiles are independent, so each one runs all its cycles while it
+    is hot in cache. A tile that stops converging finishes the call lane by
+    lane.
+
+    Returns CHIP8_OK, or the Chip8Error of the first lane that is stopped,
+    see chip8_batch_error.
+    */
+    for (int index = 0; index < batch->groups; index++){
+        for (int c = 0; c < cycles; c++){
+            int members;
+            StepResult result = group_step(batch, index, &members);
+
+            if (result == STEP_IDLE){
+                break;
+            }
+            if (result == STEP_PARKED){
+                batch->simd_lane_steps += (uint64_t)members * (uint64_t)(cycles - c - 1);
+                break;
+            }
+            if (result == STEP_DIVERGED){
+                //lockstep is retried on the next call
+                group_run_scalar(batch, index, cycles - c - 1);
+                break;
+            }
+        }
+    }
+
+    for (int lane = 0; lane < batch->count; lane++){
+        int err = chip8_batch_error(batch, lane);
+        if (err != CHIP8_OK){
+            return err;
+        }
+    }
+    return CHIP8_OK;
+}
+
+void chip8_batch_timer_tick(Chip8Batch *batch){
+    for (int index = 0; index < batch->groups; index++){
+        Chip8Lanes *g = &batch->group[index];
+        for (int l = 0; l < BATCH_GROUP; l++){
+            g->delay_timer[l] -= g->delay_timer[l] > 0;
+            g->sound_timer[l] -= g->sound_timer[l] > 0;
+            g->vblank_wait[l] = false;
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef CHIP8_BATCH_H
+#define CHIP8_BATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "chip8.h"
+
+// Lockstep engine for many instances of the same ROM.
+//
+// Instances are stored structure-of-arrays in tiles of BATCH_GROUP lanes:
+// V[r][lane], I[lane], pc[lane], ... so one AVX2 register holds the same
+// register for a whole tile. Lanes of a tile whose PC and opcode agree are
+// executed together, the rest run one at a time.
+// Both paths run the opcode bodies of chip8_exec.h, the ones chip8_step
+// runs, except 3xkk-9xy0 and 8xyn on whole cohorts, which have an AVX2 form
+// that the bench checks against chip8_step. A lane does what a Chip8 would:
+// SUPER-CHIP and XO-CHIP instructions and Chip8.quirks (display-wait) included.
+// A lane stops on the first instruction chip8_step would fail, with the
+// Chip8Error in chip8_batch_error, until chip8_batch_set reloads it.
+// Memory stays per lane. Opcodes and sprite data are read from a shared
+// image unless some lane has written to that address.
+
+#define BATCH_GROUP 32 //lanes per AVX2 register of uint8_t
+
+typedef struct Chip8Lanes {
+    uint8_t V[16][BATCH_GROUP];
+    uint16_t I[BATCH_GROUP];
+    uint16_t pc[BATCH_GROUP];
+    uint8_t sp[BATCH_GROUP];
+    uint8_t delay_timer[BATCH_GROUP];
+    uint8_t sound_timer[BATCH_GROUP];
+    uint8_t draw_flag[BATCH_GROUP];
+    bool waiting_for_key[BATCH_GROUP];
+    uint8_t wait_key_reg[BATCH_GROUP];
+    uint8_t wait_key_value[BATCH_GROUP];
+    uint8_t quirks[BATCH_GROUP];            //CHIP8_QUIRK_*
+    bool vblank_wait[BATCH_GROUP];          //display-wait until chip8_batch_timer_tick
+    bool hires[BATCH_GROUP];
+    int8_t err[BATCH_GROUP];                //Chip8Error that stopped the lane, CHIP8_OK while it runs
+    uint8_t pitch[BATCH_GROUP];
+    uint16_t keypad[BATCH_GROUP];           //bit k set = key k down
+    uint32_t rng[BATCH_GROUP];              //xorshift32 state for Cxkk
+    //only ever used a lane at a time, so kept lane by lane
+    uint16_t stack[BATCH_GROUP][16];
+    uint8_t rpl[BATCH_GROUP][16];
+    uint8_t audio_pattern[BATCH_GROUP][16];
+    Chip8Row display[BATCH_GROUP][DISP_HIRES_HEIGHT]; //as Chip8.display
+} Chip8Lanes;
+
+typedef struct Chip8Batch {
+    int count;                  //instances in use
+    int groups;                 //tiles of BATCH_GROUP lanes
+    Chip8Lanes *group;
+    uint8_t *memory;            //[lane * MEM_SIZE + addr]
+    uint8_t image[MEM_SIZE];    //memory of the first lane set
+    uint8_t written[MEM_SIZE];  //addresses where some lane may differ from image
+    bool has_image;
+
+    uint64_t simd_lane_steps;   //instructions retired by the lockstep path
+    uint64_t scalar_lane_steps; //instructions retired one lane at a time
+
+    void *block;                //allocation behind group and memory
+} Chip8Batch;
+
+Chip8Batch *chip8_batch_create(int count);
+void chip8_batch_destroy(Chip8Batch *batch);
+void chip8_batch_set(Chip8Batch *batch, int lane, const Chip8 *chip8);
+void chip8_batch_get(const Chip8Batch *batch, int lane, Chip8 *chip8);
+void chip8_batch_seed(Chip8Batch *batch, int lane, uint32_t seed);
+void chip8_batch_set_keys(Chip8Batch *batch, int lane, uint16_t mask);
+int chip8_batch_run(Chip8Batch *batch, int cycles);
+int chip8_batch_error(const Chip8Batch *batch, int lane);
+void chip8_batch_timer_tick(Chip8Batch *batch);
+
+#endif
@@ -0,0 +1,400 @@
+#include "chip8_disasm.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ZERO_RUN 16 //zero bytes shown as one line from this many
+#define LISTING_WIDTH 34 //instruction text before the profile columns
+
+typedef enum {
+    INSN_PLAIN,       //falls through to pc + 2
+    INSN_JUMP,        //1nnn
+    INSN_CALL,        //2nnn
+    INSN_RET,         //00EE
+    INSN_SKIP,        //3xkk 4xkk 5xy0 9xy0 Ex9E ExA1
+    INSN_INDIRECT,    //Bnnn
+    INSN_UNKNOWN      //not an instruction chip8_step knows
+} InsnKind;
+
+typedef struct {
+    uint16_t start;
+    uint16_t end;
+    int instructions;
+    uint64_t count;
+    uint64_t time_ns;
+    bool loops;       //branches back into itself
+} BlockStats;
+
+
+static uint16_t read_opcode(const Chip8 *chip8, uint16_t addr){
+    return (uint16_t)((chip8_mem_read(chip8, addr) << 8) | chip8_mem_read(chip8, addr + 1));
+}
+
+static InsnKind classify(uint16_t opcode){
+    //control flow only, same classes as tools/chip8_aotc.c
+    switch (opcode & 0xF000){
+    case 0x0000:
+        if (opcode == 0x00E0) return INSN_PLAIN;
+        if (opcode == 0x00EE || opcode == 0x00FD) return INSN_RET; //00FD: nothing follows either
+        if ((opcode & 0xFFF0) == 0x00C0 || (opcode >= 0x00FB && opcode <= 0x00FF)) return INSN_PLAIN;
+        return INSN_UNKNOWN;
+    case 0x1000: return INSN_JUMP;
+    case 0x2000: return INSN_CALL;
+    case 0x3000:
+    case 0x4000:
+    case 0x5000:
+    case 0x9000: return INSN_SKIP;
+    case 0xB000: return INSN_INDIRECT;
+    case 0xE000:
+        if ((opcode & 0xF0FF) == 0xE09E || (opcode & 0xF0FF) == 0xE0A1) return INSN_SKIP;
+        return INSN_PLAIN;
+    default:
+        return INSN_PLAIN;
+    }
+}
+
+static bool valid_pc(uint32_t addr){
+    return addr <= MEM_SIZE - 2;
+}
+
+static void walk(Chip8Disasm *disasm, const Chip8 *chip8, uint16_t root){
+    //on the stack, tools/chip8_romindex.c analyzes ROMs on several threads
+    uint16_t worklist[MEM_SIZE * 2];
+    int top = 0;
+
+    disasm->flags[root] |= DISASM_BLOCK;
+    worklist[top++] = root;
+
+    while (top > 0){
+        uint16_t addr = worklist[--top];
+        if (!valid_pc(addr) || (disasm->flags[addr] & DISASM_CODE)){
+            continue;
+        }
+        disasm->flags[addr] |= DISASM_CODE;
+        disasm->instructions++;
+
+        uint16_t opcode = read_opcode(chip8, addr);
+        uint16_t nnn = opcode & 0x0FFF;
+        if ((opcode & 0xF000) == 0xA000){
+            disasm->flags[nnn] |= DISASM_DATA;
+        }
+
+        switch (classify(opcode)){
+        case INSN_PLAIN:
+            worklist[top++] = addr + 2;
+            break;
+
+        case INSN_JUMP:
+            disasm->flags[nnn] |= DISASM_BLOCK | DISASM_TARGET;
+            worklist[top++] = nnn;
+            break;
+
+        case INSN_CALL:
+            disasm->flags[nnn] |= DISASM_BLOCK | DISASM_CALL;
+            worklist[top++] = nnn;
+            if (valid_pc(addr + 2)){
+                disasm->flags[addr + 2] |= DISASM_BLOCK;
+                worklist[top++] = addr + 2;
+            }
+            break;
+
+        case INSN_SKIP:
+            if (valid_pc(addr + 4)){
+                disasm->flags[addr + 2] |= DISASM_BLOCK;
+                disasm->flags[addr + 4] |= DISASM_BLOCK | DISASM_TARGET;
+                worklist[top++] = addr + 2;
+                worklist[top++] = addr + 4;
+            }
+            break;
+
+        case INSN_RET:
+        case INSN_INDIRECT:
+        case INSN_UNKNOWN:
+            break;
+        }
+    }
+}
+
+void chip8_disasm_analyze(Chip8Disasm *disasm, const Chip8 *chip8, const Chip8Profile *profile){
+    /*
+    Find code, blocks and data in chip8's memory. With a profile, addresses
+    seen executing are followed too (Bnnn targets, code reached through
+    self-modification).
+    */
+    memset(disasm, 0, sizeof(*disasm));
+    walk(disasm, chip8, 0x200);
+
+    if (profile){
+        for (int addr = 0; addr < MEM_SIZE; addr++){
+            if (profile->counts[addr] && !(disasm->flags[addr] & DISASM_CODE)){
+                disasm->flags[addr] |= DISASM_DYNAMIC;
+                walk(disasm, chip8, (uint16_t)addr);
+            }
+        }
+    }
+
+    disasm->end = 0x200;
+    for (int addr = MEM_SIZE - 1; addr >= 0x200; addr--){
+        if (chip8_mem_read(chip8, (uint16_t)addr) || (disasm->flags[addr] & DISASM_CODE)){
+            disasm->end = (uint16_t)(addr + 1 + ((disasm->flags[addr] & DISASM_CODE) != 0));
+            break;
+        }
+    }
+
+    for (int addr = 0; addr < MEM_SIZE; addr++){
+        if (disasm->flags[addr] & DISASM_CODE){
+            disasm->flags[addr] &= (uint8_t)~DISASM_DATA;
+            disasm->blocks += (disasm->flags[addr] & DISASM_BLOCK) != 0;
+        }
+    }
+}
+
+void chip8_disasm_format(uint16_t opcode, char *buf, size_t size){
+    /*
+    One instruction in the usual CHIP-8 assembler mnemonics
+    */
+    unsigned nnn = opcode & 0x0FFF;
+    unsigned x = (opcode >> 8) & 0xF;
+    unsigned y = (opcode >> 4) & 0xF;
+    unsigned kk = opcode & 0xFF;
+    unsigned n = opcode & 0xF;
+
+    switch (opcode & 0xF000){
+    case 0x0000:
+        if (opcode == 0x00E0) snprintf(buf, size, "CLS");
+        else if (opcode == 0x00EE) snprintf(buf, size, "RET");
+        else if ((opcode & 0xFFF0) == 0x00C0) snprintf(buf, size, "SCD  %u", n);
+        else if (opcode == 0x00FB) snprintf(buf, size, "SCR");
+        else if (opcode == 0x00FC) snprintf(buf, size, "SCL");
+        else if (opcode == 0x00FD) snprintf(buf, size, "EXIT");
+        else if (opcode == 0x00FE) snprintf(buf, size, "LOW");
+        else if (opcode == 0x00FF) snprintf(buf, size, "HIGH");
+        else snprintf(buf, size, "SYS  0x%03X", nnn);
+        return;
+    case 0x1000: snprintf(buf, size, "JP   0x%03X", nnn); return;
+    case 0x2000: snprintf(buf, size, "CALL 0x%03X", nnn); return;
+    case 0x3000: snprintf(buf, size, "SE   V%X, 0x%02X", x, kk); return;
+    case 0x4000: snprintf(buf, size, "SNE  V%X, 0x%02X", x, kk); return;
+    case 0x5000: snprintf(buf, size, "SE   V%X, V%X", x, y); return;
+    case 0x6000: snprintf(buf, size, "LD   V%X, 0x%02X", x, kk); return;
+    case 0x7000: snprintf(buf, size, "ADD  V%X, 0x%02X", x, kk); return;
+    case 0x8000: {
+        static const char *const alu[16] = {
+            "LD", "OR", "AND", "XOR", "ADD", "SUB", "SHR", "SUBN",
+            NULL, NULL, NULL, NULL, NULL, NULL, "SHL", NULL
+        };
+        if (alu[n]) snprintf(buf, size, "%-4s V%X, V%X", alu[n], x, y);
+        else snprintf(buf, size, "DW   0x%04X", opcode);
+        return;
+    }
+    case 0x9000: snprintf(buf, size, "SNE  V%X, V%X", x, y); return;
+    case 0xA000: snprintf(buf, size, "LD   I, 0x%03X", nnn); return;
+    case 0xB000: snprintf(buf, size, "JP   V0, 0x%03X", nnn); return;
+    case 0xC000: snprintf(buf, size, "RND  V%X, 0x%02X", x, kk); return;
+    case 0xD000: snprintf(buf, size, "DRW  V%X, V%X, %u", x, y, n); return;
+    case 0xE000:
+        if (kk == 0x9E) snprintf(buf, size, "SKP  V%X", x);
+        else if (kk == 0xA1) snprintf(buf, size, "SKNP V%X", x);
+        else snprintf(buf, size, "DW   0x%04X", opcode);
+        return;
+    default:
+        switch (kk){
+        case 0x02: snprintf(buf, size, "AUDIO"); return;
+        case 0x07: snprintf(buf, size, "LD   V%X, DT", x); return;
+        case 0x0A: snprintf(buf, size, "LD   V%X, K", x); return;
+        case 0x15: snprintf(buf, size, "LD   DT, V%X", x); return;
+        case 0x18: snprintf(buf, size, "LD   ST, V%X", x); return;
+        case 0x1E: snprintf(buf, size, "ADD  I, V%X", x); return;
+        case 0x29: snprintf(buf, size, "LD   F, V%X", x); return;
+        case 0x30: snprintf(buf, size, "LD   HF, V%X", x); return;
+        case 0x3A: snprintf(buf, size, "PITCH V%X", x); return;
+        case 0x33: snprintf(buf, size, "LD   B, V%X", x); return;
+        case 0x55: snprintf(buf, size, "LD   [I], V%X", x); return;
+        case 0x65: snprintf(buf, size, "LD   V%X, [I]", x); return;
+        case 0x75: snprintf(buf, size, "LD   R, V%X", x); return;
+        case 0x85: snprintf(buf, size, "LD   V%X, R", x); return;
+        default: snprintf(buf, size, "DW   0x%04X", opcode); return;
+        }
+    }
+}
+
+static uint16_t block_end(const Chip8Disasm *disasm, const Chip8 *chip8, uint16_t start, int *instructions){
+    //one past the last instruction of the block starting at start
+    uint16_t addr = start;
+    *instructions = 0;
+    for (;;){
+        InsnKind kind = classify(read_opcode(chip8, addr));
+        addr += 2;
+        (*instructions)++;
+        if (kind != INSN_PLAIN || !valid_pc(addr) ||
+            (disasm->flags[addr] & (DISASM_CODE | DISASM_BLOCK)) != DISASM_CODE){
+            return addr;
+        }
+    }
+}
+
+static BlockStats block_stats(const Chip8Disasm *disasm, const Chip8 *chip8, const Chip8Profile *profile, uint16_t start){
+    BlockStats block = { .start = start };
+    block.end = block_end(disasm, chip8, start, &block.instructions);
+    for (uint16_t addr = start; addr < block.end; addr += 2){
+        if (profile){
+            block.count += profile->counts[addr];
+            block.time_ns += profile->time_ns[addr];
+        }
+    }
+
+    //back edge: the last instruction jumps into the block, or it is a skip
+    //guarding such a jump (the usual "wait until" loop)
+    uint16_t last = (uint16_t)(block.end - 2);
+    uint16_t branch = classify(read_opcode(chip8, last)) == INSN_SKIP && valid_pc(block.end) ? block.end : last;
+    uint16_t opcode = read_opcode(chip8, branch);
+    uint16_t target = opcode & 0x0FFF;
+    block.loops = classify(opcode) == INSN_JUMP && target >= start && target < block.end;
+    return block;
+}
+
+static double share(uint64_t part, uint64_t total){
+    return total ? 100.0 * (double)part / (double)total : 0.0;
+}
+
+static void print_data(FILE *out, const Chip8Disasm *disasm, const Chip8 *chip8, uint16_t addr, uint16_t end){
+    //non-code bytes [addr, end): sprites as pixels, zero runs folded, the rest as hex
+    int sprite_left = 0;
+    while (addr < end){
+        if (disasm->flags[addr] & DISASM_DATA){
+            sprite_left = 15; //Dxyn draws at most 15 rows from I
+        }
+
+        uint16_t zeros = addr;
+        while (zeros < end && chip8_mem_read(chip8, zeros) == 0 && !(disasm->flags[zeros] & DISASM_DATA)){
+            zeros++;
+        }
+        if (zeros - addr >= ZERO_RUN){
+            fprintf(out, "  0x%03X  00 x %d\n", addr, zeros - addr);
+            addr = zeros;
+            sprite_left = 0;
+            continue;
+        }
+
+        if (sprite_left > 0){
+            uint8_t byte = chip8_mem_read(chip8, addr);
+            char pixels[9];
+            for (int bit = 0; bit < 8; bit++){
+                pixels[bit] = (byte & (0x80 >> bit)) ? '#' : '.';
+            }
+            pixels[8] = '\0';
+            fprintf(out, "  0x%03X  %02X    %s%s\n", addr, byte, pixels,
+                    (disasm->flags[addr] & DISASM_DATA) ? "    ; sprite" : "");
+            addr++;
+            sprite_left--;
+            continue;
+        }
+
+        fprintf(out, "  0x%03X ", addr);
+        for (int i = 0; i < 8 && addr < end && !(disasm->flags[addr] & DISASM_DATA); i++, addr++){
+            fprintf(out, " %02X", chip8_mem_read(chip8, addr));
+        }
+        fprintf(out, "\n");
+    }
+}
+
+void chip8_disasm_print(FILE *out, const Chip8Disasm *disasm, const Chip8 *chip8, const Chip8Profile *profile){
+    /*
+    Listing of 0x200..end. Instruction lines show estimated executions and
+    share of host time when there is a profile; '>' marks the current PC.
+    */
+    fprintf(out, "; %d bytes, %d instructions in %d blocks", disasm->end - 0x200, disasm->instructions, disasm->blocks);
+    if (profile){
+        fprintf(out, ", %llu samples, %.3f ms sampled",
+                (unsigned long long)profile->samples, (double)profile->total_ns / 1e6);
+    }
+    fprintf(out, "\n");
+
+    uint16_t addr = 0x200;
+    while (addr < disasm->end){
+        uint8_t flags = disasm->flags[addr];
+        if (!(flags & DISASM_CODE)){
+            uint16_t data_end = addr;
+            while (data_end < disasm->end && !(disasm->flags[data_end] & DISASM_CODE)){
+                data_end++;
+            }
+            fprintf(out, "\n; data\n");
+            print_data(out, disasm, chip8, addr, data_end);
+            addr = data_end;
+            continue;
+        }
+
+        if (flags & DISASM_BLOCK){
+            BlockStats block = block_stats(disasm, chip8, profile, addr);
+            char label[64];
+            snprintf(label, sizeof(label), "0x%03X:%s%s%s%s", addr,
+                     (flags & DISASM_CALL) ? " sub" : "",
+                     (flags & DISASM_TARGET) ? " target" : "",
+                     (flags & DISASM_DYNAMIC) ? " dynamic" : "",
+                     block.loops ? " loop" : "");
+            if (profile && block.count){
+                fprintf(out, "\n%-*s %12llu  %5.1f%%\n", LISTING_WIDTH, label,
+                        (unsigned long long)block.count, share(block.time_ns, profile->total_ns));
+            } else {
+                fprintf(out, "\n%s\n", label);
+            }
+        }
+
+        uint16_t opcode = read_opcode(chip8, addr);
+        char text[32];
+        chip8_disasm_format(opcode, text, sizeof(text));
+        if (profile && profile->counts[addr]){
+            fprintf(out, "%c 0x%03X  %04X  %-*s %12llu  %5.1f%%\n", addr == chip8->pc ? '>' : ' ', addr, opcode,
+                    LISTING_WIDTH - 15, text, (unsigned long long)profile->counts[addr],
+                    share(profile->time_ns[addr], profile->total_ns));
+        } else {
+            fprintf(out, "%c 0x%03X  %04X  %s\n", addr == chip8->pc ? '>' : ' ', addr, opcode, text);
+        }
+        addr += 2;
+    }
+}
+
+static int compare_blocks(const void *a, const void *b){
+    const BlockStats *x = a;
+    const BlockStats *y = b;
+    if (x->time_ns != y->time_ns){
+        return x->time_ns < y->time_ns ? 1 : -1;
+    }
+    return (x->count < y->count) - (x->count > y->count);
+}
+
+void chip8_disasm_hot_blocks(FILE *out, const Chip8Disasm *disasm, const Chip8 *chip8, const Chip8Profile *profile, int top){
+    /*
+    The top blocks by host time, the places worth optimizing first
+    */
+    if (!profile || !profile->samples){
+        fprintf(out, "; no samples\n");
+        return;
+    }
+
+    BlockStats *blocks = malloc(sizeof(*blocks) * (size_t)(disasm->blocks ? disasm->blocks : 1));
+    if (!blocks){
+        perror("chip8_disasm_hot_blocks: malloc");
+        return;
+    }
+    int count = 0;
+    for (int addr = 0; addr < MEM_SIZE && count < disasm->blocks; addr++){
+        if ((disasm->flags[addr] & (DISASM_CODE | DISASM_BLOCK)) == (DISASM_CODE | DISASM_BLOCK)){
+            blocks[count++] = block_stats(disasm, chip8, profile, (uint16_t)addr);
+        }
+    }
+    qsort(blocks, (size_t)count, sizeof(*blocks), compare_blocks);
+
+    fprintf(out, "; hottest blocks\n;  block         insns        execs   time  first instruction\n");
+    for (int i = 0; i < count && i < top && blocks[i].count; i++){
+        char text[32];
+        chip8_disasm_format(read_opcode(chip8, blocks[i].start), text, sizeof(text));
+        fprintf(out, ";  0x%03X-0x%03X %5d %12llu %5.1f%%  %s%s\n",
+                blocks[i].start, blocks[i].end - 1, blocks[i].instructions,
+                (unsigned long long)blocks[i].count, share(blocks[i].time_ns, profile->total_ns),
+                text, blocks[i].loops ? "  (loop)" : "");
+    }
+    free(blocks);
+}
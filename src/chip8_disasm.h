@@ -0,0 +1,43 @@
+#ifndef CHIP8_DISASM_H
+#define CHIP8_DISASM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "chip8.h"
+#include "chip8_profile.h"
+
+// Control-flow disassembler.
+//
+// chip8_disasm_analyze walks every instruction reachable from 0x200 (the
+// same way the AOT compiler does) to tell code from data, and splits the
+// code into basic blocks. Bnnn targets cannot be followed statically; with
+// a profile, every address that was sampled executing is walked as well.
+// Bytes loaded with Annn that are not code are marked as data, most often
+// sprites.
+//
+// chip8_disasm_print renders the ROM as mnemonics, one line per
+// instruction, annotated with the profile's estimated executions and share
+// of host time per instruction and per block; data is shown as hex, sprite
+// data also as pixels. chip8_disasm_hot_blocks lists the costliest blocks.
+
+#define DISASM_CODE     0x01    //an instruction starts here
+#define DISASM_BLOCK    0x02    //a basic block starts here
+#define DISASM_TARGET   0x04    //jumped or skipped to
+#define DISASM_CALL     0x08    //subroutine entry
+#define DISASM_DATA     0x10    //loaded with Annn, not code
+#define DISASM_DYNAMIC  0x20    //only known from the profile
+
+typedef struct Chip8Disasm {
+    uint8_t flags[MEM_SIZE];    //DISASM_*
+    uint16_t end;               //one past the last non-zero byte of the program
+    int instructions;
+    int blocks;
+} Chip8Disasm;
+
+void chip8_disasm_analyze(Chip8Disasm *disasm, const Chip8 *chip8, const Chip8Profile *profile);
+void chip8_disasm_format(uint16_t opcode, char *buf, size_t size);
+void chip8_disasm_print(FILE *out, const Chip8Disasm *disasm, const Chip8 *chip8, const Chip8Profile *profile);
+void chip8_disasm_hot_blocks(FILE *out, const Chip8Disasm *disasm, const Chip8 *chip8, const Chip8Profile *profile, int top);
+
+#endif
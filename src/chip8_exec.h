@@ -0,0 +1,229 @@
+#ifndef CHIP8_EXEC_H
+#define CHIP8_EXEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "chip8.h"
+
+// Opcode bodies shared by chip8_opcodes.c and the lanes of chip8_batch.c,
+// so the scalar and lockstep engines cannot drift apart.
+//
+// The helpers work on values and pointers instead of a Chip8. Stack and
+// display are one instance's arrays; V takes a stride, 1 for a Chip8 and
+// BATCH_GROUP for a tile of lanes, which keeps V[r] of 32 lanes together.
+// Memory stays with the caller, each engine has its own (pages, flat, a
+// lane over a shared image); the helpers get the bytes already read.
+
+// chip8_exec_alu results
+#define CHIP8_ALU_NONE 0    //not an 8xyn chip8_step runs, nothing changes
+#define CHIP8_ALU_VX 1      //store the result in Vx
+#define CHIP8_ALU_VX_VF 2   //store the result in Vx, then the flag in VF
+
+static inline int chip8_exec_width(bool hires){
+    return hires ? DISP_HIRES_WIDTH : DISP_WIDTH;
+}
+
+static inline int chip8_exec_height(bool hires){
+    return hires ? DISP_HIRES_HEIGHT : DISP_HEIGHT;
+}
+
+static inline int chip8_exec_call(uint16_t *stack, uint8_t *sp, uint16_t *pc, uint16_t nnn){
+    /*
+    2nnn on a PC already past the instruction. With the stack full, stays
+    on the instruction and returns CHIP8_ERR_STACK
+    */
+    if (*sp >= 16){
+        *pc -= 2;
+        return CHIP8_ERR_STACK;
+    }
+    stack[*sp] = *pc;
+    (*sp)++;
+    *pc = nnn;
+    return CHIP8_OK;
+}
+
+static inline int chip8_exec_ret(const uint16_t *stack, uint8_t *sp, uint16_t *pc){
+    /*
+    00EE. With nothing to return to, stays on the instruction and returns
+    CHIP8_ERR_STACK
+    */
+    if (*sp == 0){
+        *pc -= 2;
+        return CHIP8_ERR_STACK;
+    }
+    (*sp)--;
+    *pc = stack[*sp];
+    return CHIP8_OK;
+}
+
+static inline int chip8_exec_alu(uint8_t n, uint8_t vx, uint8_t vy, uint8_t *result, uint8_t *vf){
+    /*
+    8xyn on register values, CHIP8_ALU_* says what to store. Vx is written
+    before VF, so with x = F the flag wins.
+
+    OR/AND/XOR clear VF, shifts read Vy (original CHIP-8), VF of the
+    subtractions is NOT borrow.
+    */
+    switch (n){
+    case 0x0: *result = vy; return CHIP8_ALU_VX;
+    case 0x1: *result = vx | vy; *vf = 0; return CHIP8_ALU_VX_VF;
+    case 0x2: *result = vx & vy; *vf = 0; return CHIP8_ALU_VX_VF;
+    case 0x3: *result = vx ^ vy; *vf = 0; return CHIP8_ALU_VX_VF;
+    case 0x4: *result = (uint8_t)(vx + vy); *vf = (vx + vy) > 0xFF; return CHIP8_ALU_VX_VF;
+    case 0x5: *result = (uint8_t)(vx - vy); *vf = vx >= vy; return CHIP8_ALU_VX_VF;
+    case 0x6: *result = vy >> 1; *vf = vy & 0x1; return CHIP8_ALU_VX_VF;
+    case 0x7: *result = (uint8_t)(vy - vx); *vf = vy >= vx; return CHIP8_ALU_VX_VF;
+    case 0xE: *result = (uint8_t)(vy << 1); *vf = vy >> 7; return CHIP8_ALU_VX_VF;
+    default: return CHIP8_ALU_NONE;
+    }
+}
+
+static inline bool chip8_exec_key_down(uint16_t keypad, uint8_t vx){
+    //Ex9E/ExA1: only the low nibble of Vx names a key
+    return (keypad >> (vx & 0x0F)) & 1;
+}
+
+static inline uint8_t chip8_exec_rnd(uint32_t *rng, uint8_t kk){
+    //Cxkk: per-instance xorshift32 so forks, replays and rewinds repeat exactly
+    uint32_t s = *rng;
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    *rng = s;
+    return (uint8_t)s & kk;
+}
+
+static inline uint16_t chip8_exec_font(uint8_t vx){
+    //Fx29: 5-byte digit sprites
+    return (uint16_t)(FONT_ADDRESS + (vx & 0x0F) * 5);
+}
+
+static inline uint16_t chip8_exec_big_font(uint8_t vx){
+    //Fx30: SUPER-CHIP 10-byte digit sprites
+    return (uint16_t)(BIG_FONT_ADDRESS + (vx & 0x0F) * 10);
+}
+
+static inline void chip8_exec_bcd(uint8_t v, uint8_t digits[3]){
+    //Fx33: hundreds, tens, ones
+    digits[0] = v / 100;
+    digits[1] = (v / 10) % 10;
+    digits[2] = v % 10;
+}
+
+static inline int chip8_exec_wait_key(bool *waiting, uint8_t *reg, uint8_t *value, uint16_t keypad,
+                                      uint8_t x, uint8_t *dest){
+    /*
+    Fx0A: wait for a key press, then for that key to be released.
+    Returns -1 while the instruction has to repeat, else the key to store
+    in register *dest.
+    */
+
+    // First time entering this instruction
+    if (!*waiting){
+        *waiting = true;
+        *reg = x;
+        *value = 0xFF;
+    }
+
+    // Phase 1: wait for a key to be pressed, the lowest one counts
+    if (*value == 0xFF){
+        if (keypad){
+            *value = (uint8_t)__builtin_ctz(keypad);
+        }
+        return -1;
+    }
+
+    // Phase 2: key was pressed, now wait until that same key is released
+    if (keypad & (1u << *value)){
+        return -1;
+    }
+
+    int key = *value;
+    *dest = *reg;
+    *waiting = false;
+    *reg = 0;
+    *value = 0xFF;
+    return key;
+}
+
+static inline void chip8_exec_clear(Chip8Row *display){
+    //00E0, and 00FE/00FF after the switch: every row, whatever the resolution
+    memset(display, 0, sizeof(Chip8Row) * DISP_HIRES_HEIGHT);
+}
+
+static inline void chip8_exec_scroll_down(Chip8Row *display, uint8_t n, bool hires){
+    //00Cn: n rows of the active resolution, blank rows come in at the top
+    int height = chip8_exec_height(hires);
+    if (n > height){
+        n = (uint8_t)height;
+    }
+    memmove(&display[n], &display[0], sizeof(Chip8Row) * (size_t)(height - n));
+    memset(&display[0], 0, sizeof(Chip8Row) * n);
+}
+
+static inline void chip8_exec_scroll_right(Chip8Row *display, bool hires){
+    //00FB: 4 pixels, low resolution keeps to the high 64 bits
+    Chip8Row visible = ~(Chip8Row)0 << (DISP_HIRES_WIDTH - chip8_exec_width(hires));
+    for (int y = 0; y < chip8_exec_height(hires); y++){
+        display[y] = (display[y] >> 4) & visible;
+    }
+}
+
+static inline void chip8_exec_scroll_left(Chip8Row *display, bool hires){
+    //00FC: 4 pixels
+    for (int y = 0; y < chip8_exec_height(hires); y++){
+        display[y] <<= 4;
+    }
+}
+
+static inline unsigned chip8_exec_sprite_bytes(uint8_t n){
+    //bytes Dxyn reads from I: n rows of 8, Dxy0 16 rows of 16 (SUPER-CHIP)
+    return n ? n : 32;
+}
+
+static inline void chip8_exec_draw(Chip8Row *display, uint8_t *V, size_t stride, const uint8_t *sprite,
+                                   uint8_t x, uint8_t y, uint8_t n, bool hires, uint64_t *disp_hash){
+    /*
+    Dxyn: XOR the chip8_exec_sprite_bytes(n) bytes of sprite in at (Vx, Vy),
+    VF = 1 if any row collided. VF is cleared before Vx and Vy are read.
+
+    The start coordinate wraps, the sprite clips at the right and bottom
+    edges. Each row is shifted into place as a Chip8Row mask. disp_hash,
+    if not NULL, is kept up to date like chip8_mem_write keeps mem_hash.
+    */
+    V[0xF * stride] = 0;
+
+    int width = chip8_exec_width(hires);
+    int height = chip8_exec_height(hires);
+    int x_cord = V[x * stride] & (width - 1);
+    int y_cord = V[y * stride] & (height - 1);
+    int rows = n ? n : 16;
+    int sprite_width = n ? 8 : 16;
+    //low resolution only uses the high 64 bits
+    Chip8Row visible = ~(Chip8Row)0 << (DISP_HIRES_WIDTH - width);
+    //leftmost sprite pixel lands on bit 127 - x_cord
+    int shift = DISP_HIRES_WIDTH - sprite_width - x_cord;
+    uint8_t collision = 0;
+
+    for (int row = 0; row < rows && y_cord + row < height; row++){
+        uint32_t bits = n ? sprite[row] : (uint32_t)sprite[2 * row] << 8 | sprite[2 * row + 1];
+        Chip8Row mask = shift >= 0 ? (Chip8Row)bits << shift : (Chip8Row)bits >> -shift;
+        mask &= visible;
+
+        Chip8Row *line = &display[y_cord + row];
+        collision |= (*line & mask) != 0;
+#if CHIP8_STATE_HASH
+        if (disp_hash){
+            *disp_hash ^= chip8_hash_row(y_cord + row, *line) ^ chip8_hash_row(y_cord + row, *line ^ mask);
+        }
+#else
+        (void)disp_hash;
+#endif
+        *line ^= mask;
+    }
+    V[0xF * stride] = collision;
+}
+
+#endif
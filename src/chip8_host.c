@@ -0,0 +1,438 @@
+#include "chip8_host.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#define DEQUE_MIN 64
+
+
+uint64_t chip8_host_now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+//_____Chase-Lev deque: the owner pushes/takes at the bottom, thieves steal the top_____
+
+static bool deque_reserve(HostDeque *deque, int64_t count){
+    //only between frames, no thief can be looking at buf
+    int64_t cap = deque->buf ? deque->mask + 1 : 0;
+    if (count <= cap){
+        return true;
+    }
+    int64_t grown = cap ? cap : DEQUE_MIN;
+    while (grown < count){
+        grown *= 2;
+    }
+    _Atomic(Chip8Session *) *buf = calloc((size_t)grown, sizeof(*buf));
+    if (!buf){
+        perror("chip8_host: calloc");
+        return false;
+    }
+    free(deque->buf);
+    deque->buf = buf;
+    deque->mask = grown - 1;
+    return true;
+}
+
+static void deque_push(HostDeque *deque, Chip8Session *session){
+    int64_t b = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    atomic_store_explicit(&deque->buf[b & deque->mask], session, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+}
+
+static Chip8Session *deque_take(HostDeque *deque){
+    int64_t b = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t t = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    if (t > b){
+        //empty
+        atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    Chip8Session *session = atomic_load_explicit(&deque->buf[b & deque->mask], memory_order_relaxed);
+    if (t == b){
+        //last one, race the thieves for it
+        if (!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1,
+                memory_order_seq_cst, memory_order_relaxed)){
+            session = NULL;
+        }
+        atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+    }
+    return session;
+}
+
+static Chip8Session *deque_steal(HostDeque *deque){
+    int64_t t = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t b = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+    if (t >= b){
+        return NULL;
+    }
+    Chip8Session *session = atomic_load_explicit(&deque->buf[t & deque->mask], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1,
+            memory_order_seq_cst, memory_order_relaxed)){
+        return NULL; //lost to the owner or another thief
+    }
+    return session;
+}
+
+//_____Sessions_____
+
+static bool session_due(Chip8Session *session){
+    /*
+    Decide whether the session runs this frame, waking it if its input
+    changed while parked
+    */
+    if (atomic_load_explicit(&session->closing, memory_order_relaxed)){
+        return false;
+    }
+    if (session->park == PARK_NONE){
+        return true;
+    }
+
+    uint16_t input = atomic_load_explicit(&session->input, memory_order_relaxed);
+    if (input == session->park_input){
+        session->parked_frames++;
+        session->park_skipped++;
+        return false;
+    }
+
+    //the skipped frames would only have counted the timers down
+    Chip8 *chip8 = &session->chip8;
+    uint32_t skipped = session->park_skipped;
+    chip8->delay_timer = skipped >= chip8->delay_timer ? 0 : (uint8_t)(chip8->delay_timer - skipped);
+    chip8->sound_timer = skipped >= chip8->sound_timer ? 0 : (uint8_t)(chip8->sound_timer - skipped);
+    session->park = PARK_NONE;
+    return true;
+}
+
+static inline bool key_wait_idle(const Chip8 *chip8){
+    //in Fx0A with nothing pressed, further steps change nothing
+    return chip8->waiting_for_key && chip8->wait_key_value == 0xFF && chip8->keypad == 0;
+}
+
+static inline bool halted(const Chip8 *chip8){
+    //1nnn jumping to itself, or SUPER-CHIP 00FD
+    uint16_t opcode = (uint16_t)((chip8_mem_read(chip8, chip8->pc) << 8) | chip8_mem_read(chip8, chip8->pc + 1));
+    return opcode == (0x1000 | chip8->pc) || opcode == 0x00FD;
+}
+
+static void send_frame(Chip8Session *session){
+    HostFrame frame;
+    const Chip8 *chip8 = &session->chip8;
+    frame.frame = (uint32_t)session->frames;
+    frame.missed = (uint32_t)session->missed;
+    frame.width = (uint16_t)chip8_disp_width(chip8);
+    frame.height = (uint16_t)chip8_disp_height(chip8);
+    frame.reserved = 0;
+    int words = 0;
+    for (int y = 0; y < frame.height; y++){
+        frame.rows[words++] = (uint64_t)(chip8->display[y] >> 64);
+        if (chip8->hires){
+            frame.rows[words++] = (uint64_t)chip8->display[y];
+        }
+    }
+    size_t len = offsetof(HostFrame, rows) + (size_t)words * sizeof(uint64_t);
+
+    //SOCK_SEQPACKET: all or nothing, never block a worker
+    if (send(session->fd, &frame, len, MSG_DONTWAIT | MSG_NOSIGNAL) != (ssize_t)len){
+        session->dropped++;
+    }
+}
+
+static void run_session(Chip8Session *session, uint64_t deadline_ns){
+    /*
+    One frame: the instructions owed for 1/60 s, then a timer tick
+    */
+    Chip8 *chip8 = &session->chip8;
+    chip8->keypad = atomic_load_explicit(&session->input, memory_order_relaxed);
+
+    //700 Hz does not divide into 60 Hz, spread the remainder over the frames
+    uint64_t f = session->frames;
+    int cycles = (int)((f + 1) * HOST_CPU_HZ / HOST_FRAME_HZ - f * HOST_CPU_HZ / HOST_FRAME_HZ);
+    int err = CHIP8_OK;
+    for (int i = 0; i < cycles && !key_wait_idle(chip8) && !chip8->vblank_wait && err == CHIP8_OK; i++){
+        err = chip8_step(chip8);
+    }
+    chip8_timer_tick(chip8);
+    session->frames++;
+
+    if (chip8_host_now_ns() > deadline_ns){
+        session->missed++;
+    }
+
+    if (err != CHIP8_OK){
+        session->park = PARK_FAULT;
+    } else if (key_wait_idle(chip8)){
+        session->park = PARK_KEY;
+    } else if (chip8->delay_timer == 0 && chip8->sound_timer == 0 && halted(chip8)){
+        session->park = PARK_HALT;
+    }
+    if (session->park != PARK_NONE){
+        session->park_input = chip8->keypad;
+        session->park_skipped = 0;
+    }
+
+    if (chip8->draw_flag){
+        if (session->fd >= 0){
+            send_frame(session);
+        }
+        chip8->draw_flag = false;
+    }
+}
+
+//_____Workers_____
+
+static Chip8Session *steal_any(HostWorker *worker){
+    Chip8Host *host = worker->host;
+    for (int i = 1; i < host->worker_count; i++){
+        HostWorker *victim = &host->workers[(worker->index + i) % host->worker_count];
+        Chip8Session *session = deque_steal(&victim->deque);
+        if (session){
+            worker->steals++;
+            return session;
+        }
+    }
+    return NULL;
+}
+
+static void *worker_main(void *arg){
+    HostWorker *worker = arg;
+    Chip8Host *host = worker->host;
+
+    pthread_mutex_lock(&host->lock);
+    for (;;){
+        while (!host->stop && worker->seen_frame == host->frame){
+            pthread_cond_wait(&host->frame_start, &host->lock);
+        }
+        if (host->stop){
+            break;
+        }
+        worker->seen_frame = host->frame;
+        uint64_t deadline_ns = host->deadline_ns;
+        pthread_mutex_unlock(&host->lock);
+
+        uint64_t t0 = chip8_host_now_ns();
+        for (int i = 0; i < worker->home_count; i++){
+            Chip8Session *session = worker->home[i];
+            if (session_due(session)){
+                deque_push(&worker->deque, session);
+            } else {
+                atomic_fetch_sub_explicit(&host->pending, 1, memory_order_acq_rel);
+            }
+        }
+
+        for (;;){
+            Chip8Session *session = deque_take(&worker->deque);
+            if (!session){
+                session = steal_any(worker);
+            }
+            if (session){
+                run_session(session, deadline_ns);
+                atomic_fetch_sub_explicit(&host->pending, 1, memory_order_acq_rel);
+                continue;
+            }
+            if (atomic_load_explicit(&host->pending, memory_order_acquire) == 0){
+                break;
+            }
+            sched_yield();
+        }
+        uint64_t t1 = chip8_host_now_ns();
+        worker->busy_ns += t1 - t0;
+
+        pthread_mutex_lock(&host->lock);
+        if (--host->active == 0){
+            host->done_ns = t1;
+            pthread_cond_signal(&host->frame_done);
+        }
+    }
+    pthread_mutex_unlock(&host->lock);
+    return NULL;
+}
+
+bool chip8_host_init(Chip8Host *host, int workers){
+    /*
+    Start `workers` threads (1..HOST_MAX_WORKERS). Returns false on failure.
+    */
+    if (workers < 1 || workers > HOST_MAX_WORKERS){
+        fprintf(stderr, "chip8_host_init: workers must be 1..%d\n", HOST_MAX_WORKERS);
+        return false;
+    }
+
+    memset(host, 0, sizeof(*host));
+    pthread_mutex_init(&host->lock, NULL);
+    pthread_cond_init(&host->frame_start, NULL);
+    pthread_cond_init(&host->frame_done, NULL);
+
+    for (int i = 0; i < workers; i++){
+        HostWorker *worker = &host->workers[i];
+        worker->host = host;
+        worker->index = i;
+        if (!deque_reserve(&worker->deque, DEQUE_MIN) ||
+            pthread_create(&worker->thread, NULL, worker_main, worker) != 0){
+            fprintf(stderr, "chip8_host_init: could not start worker %d\n", i);
+            chip8_host_shutdown(host);
+            return false;
+        }
+        host->worker_count++;
+    }
+    return true;
+}
+
+void chip8_host_shutdown(Chip8Host *host){
+    /*
+    Stop the workers and free every session. Call between frames.
+    */
+    pthread_mutex_lock(&host->lock);
+    host->stop = true;
+    pthread_cond_broadcast(&host->frame_start);
+    pthread_mutex_unlock(&host->lock);
+
+    for (int i = 0; i < host->worker_count; i++){
+        pthread_join(host->workers[i].thread, NULL);
+    }
+    for (int i = 0; i < HOST_MAX_WORKERS; i++){
+        HostWorker *worker = &host->workers[i];
+        while (worker->home_count){
+            chip8_host_remove(host, worker->home[worker->home_count - 1]);
+        }
+        free(worker->home);
+        free(worker->deque.buf);
+    }
+    pthread_cond_destroy(&host->frame_done);
+    pthread_cond_destroy(&host->frame_start);
+    pthread_mutex_destroy(&host->lock);
+}
+
+Chip8Session *chip8_host_add(Chip8Host *host, const uint8_t *rom, size_t rom_len, int fd){
+    /*
+    Create a session running rom, talking to client socket fd (-1 for none,
+    input then comes from writing session->input). Call between frames.
+    Returns NULL on failure; fd stays open then.
+    */
+    if (rom_len > MEM_SIZE - 0x200){
+        fprintf(stderr, "chip8_host_add: ROM too large\n");
+        return NULL;
+    }
+
+    //least loaded worker
+    HostWorker *worker = &host->workers[0];
+    for (int i = 1; i < host->worker_count; i++){
+        if (host->workers[i].home_count < worker->home_count){
+            worker = &host->workers[i];
+        }
+    }
+
+    if (worker->home_count == worker->home_cap){
+        int cap = worker->home_cap ? worker->home_cap * 2 : DEQUE_MIN;
+        Chip8Session **grown = realloc(worker->home, sizeof(*grown) * (size_t)cap);
+        if (!grown){
+            perror("chip8_host_add: realloc");
+            return NULL;
+        }
+        worker->home = grown;
+        worker->home_cap = cap;
+    }
+    if (!deque_reserve(&worker->deque, worker->home_count + 1)){
+        return NULL;
+    }
+
+    Chip8Session *session = calloc(1, sizeof(*session));
+    if (!session){
+        perror("chip8_host_add: calloc");
+        return NULL;
+    }
+    chip8_reset(&session->chip8);
+    chip8_seed(&session->chip8, (uint32_t)host->next_id * 0x9E3779B9u + (uint32_t)time(NULL));
+    chip8_load(&session->chip8, rom, rom_len);
+
+    session->id = host->next_id++;
+    session->fd = fd;
+    session->home = worker->index;
+    worker->home[worker->home_count++] = session;
+    host->session_count++;
+    return session;
+}
+
+void chip8_host_remove(Chip8Host *host, Chip8Session *session){
+    /*
+    Drop a session and close its socket. Call between frames.
+    */
+    HostWorker *worker = &host->workers[session->home];
+    for (int i = 0; i < worker->home_count; i++){
+        if (worker->home[i] == session){
+            worker->home[i] = worker->home[--worker->home_count];
+            break;
+        }
+    }
+    if (session->fd >= 0){
+        close(session->fd);
+    }
+    chip8_release(&session->chip8);
+    free(session);
+    host->session_count--;
+}
+
+void chip8_host_frame_begin(Chip8Host *host, uint64_t deadline_ns){
+    /*
+    Release the workers on the next frame, due by deadline_ns
+    */
+    pthread_mutex_lock(&host->lock);
+    host->frame++;
+    host->deadline_ns = deadline_ns;
+    atomic_store_explicit(&host->pending, host->session_count, memory_order_release);
+    host->active = host->worker_count;
+    pthread_cond_broadcast(&host->frame_start);
+    pthread_mutex_unlock(&host->lock);
+}
+
+void chip8_host_frame_wait(Chip8Host *host){
+    /*
+    Block until every worker is done with the current frame. Afterwards,
+    until the next chip8_host_frame_begin, sessions may be added, removed
+    and inspected.
+    */
+    pthread_mutex_lock(&host->lock);
+    while (host->active > 0){
+        pthread_cond_wait(&host->frame_done, &host->lock);
+    }
+    pthread_mutex_unlock(&host->lock);
+
+    if (host->done_ns > host->deadline_ns){
+        host->overruns++;
+    }
+}
+
+void chip8_host_stats(Chip8Host *host, Chip8HostStats *stats){
+    /*
+    Totals over all sessions and workers. Call between frames.
+    */
+    memset(stats, 0, sizeof(*stats));
+    stats->sessions = host->session_count;
+    for (int w = 0; w < host->worker_count; w++){
+        HostWorker *worker = &host->workers[w];
+        stats->steals += worker->steals;
+        stats->busy_ns += worker->busy_ns;
+        for (int i = 0; i < worker->home_count; i++){
+            Chip8Session *session = worker->home[i];
+            stats->parked += session->park != PARK_NONE;
+            stats->frames += session->frames;
+            stats->parked_frames += session->parked_frames;
+            stats->missed += session->missed;
+            stats->dropped += session->dropped;
+        }
+    }
+}
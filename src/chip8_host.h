@@ -0,0 +1,136 @@
+#ifndef CHIP8_HOST_H
+#define CHIP8_HOST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "chip8.h"
+
+// Multi-session host: many Chip8s in one process, each advanced one 60 Hz
+// frame (CPU_HZ / 60 instructions plus a timer tick) per quantum.
+//
+// Every session has a home worker. At the start of a frame each worker
+// pushes its runnable home sessions onto its own deque and runs them from
+// the bottom, idle workers steal from the top of other deques
+// (Chase-Lev). A session's frame is due by the start of the next frame;
+// finishing later counts as a missed deadline.
+//
+// A session waiting in Fx0A with no key down, or spinning on a
+// jump-to-self with both timers at 0, is parked: it is not queued until
+// its client's keypad changes. Parked frames do not execute, timers are
+// caught up when it wakes (nothing else can change meanwhile).
+//
+// Clients talk over a Unix domain socket, see HostHello/HostFrame.
+
+#define HOST_FRAME_HZ 60
+#define HOST_CPU_HZ 700     //same as main.c
+#define HOST_MAX_WORKERS 64
+
+// Wire protocol over SOCK_SEQPACKET, one message per packet. Client -> host:
+// a HostHello with rom_len ROM bytes appended (or rom_len 0 and the
+// uint64_t chip8_rom_hash of a ROM in the host's library), then a uint16_t
+// keypad mask whenever it changes. Host -> client: a HostFrame after every frame that
+// drew, dropped rather than queued if the client is not keeping up. Only the
+// rows of the active resolution are sent, so a 64x32 frame is 272 bytes.
+#define HOST_MAGIC "C8HS"
+
+typedef struct HostHello {
+    char magic[4];
+    uint16_t rom_len;
+    uint16_t reserved;
+} HostHello;
+
+typedef struct HostFrame {
+    uint32_t frame;             //session frame number
+    uint32_t missed;            //missed deadlines so far
+    uint16_t width;             //64 or 128 (SUPER-CHIP)
+    uint16_t height;
+    uint32_t reserved;
+    uint64_t rows[DISP_HIRES_HEIGHT * 2]; //height rows of width / 64 words, bit 63 of a row's first word = x 0
+} HostFrame;
+
+typedef enum {
+    PARK_NONE,
+    PARK_KEY,                   //Fx0A, no key down
+    PARK_HALT,                  //jump-to-self or 00FD, timers at 0
+    PARK_FAULT                  //instruction at PC cannot run (chip8_step error)
+} ParkReason;
+
+typedef struct Chip8Session {
+    Chip8 chip8;
+    int id;
+    int fd;                     //client socket, -1 for local sessions
+    int home;                   //worker index
+    _Atomic uint16_t input;     //keypad from the client
+    _Atomic bool closing;       //client gone, remove at the next frame
+
+    uint64_t frames;            //frames executed
+    uint64_t missed;            //frames finished after their deadline
+    uint64_t parked_frames;     //frames skipped while parked
+    uint64_t dropped;           //HostFrames not sent, socket full
+    uint8_t park;               //ParkReason
+    uint16_t park_input;        //input when it parked
+    uint32_t park_skipped;      //frames skipped since it parked
+} Chip8Session;
+
+typedef struct HostDeque {
+    _Atomic int64_t top;
+    _Atomic int64_t bottom;
+    _Atomic(Chip8Session *) *buf;
+    int64_t mask;
+} HostDeque;
+
+typedef struct HostWorker {
+    _Alignas(64) struct Chip8Host *host; //own cache lines, workers write their counters
+    int index;
+    pthread_t thread;
+    HostDeque deque;
+    Chip8Session **home;        //sessions this worker queues every frame
+    int home_count;
+    int home_cap;
+    uint64_t steals;
+    uint64_t busy_ns;           //time spent running sessions
+    uint64_t seen_frame;        //last frame this worker scheduled
+} HostWorker;
+
+typedef struct Chip8Host {
+    HostWorker workers[HOST_MAX_WORKERS];
+    int worker_count;
+    int session_count;
+    int next_id;
+
+    uint64_t frame;             //current frame number
+    uint64_t deadline_ns;       //end of the current frame, CLOCK_MONOTONIC
+    _Atomic int pending;        //sessions not yet done with this frame
+    int active;                 //workers not yet done with this frame
+    uint64_t done_ns;           //when the last worker finished it
+    bool stop;
+    pthread_mutex_t lock;
+    pthread_cond_t frame_start;
+    pthread_cond_t frame_done;
+
+    uint64_t overruns;          //frames that ended after their deadline
+} Chip8Host;
+
+typedef struct Chip8HostStats {
+    int sessions;
+    int parked;
+    uint64_t frames;            //session frames executed
+    uint64_t parked_frames;
+    uint64_t missed;
+    uint64_t dropped;
+    uint64_t steals;
+    uint64_t busy_ns;
+} Chip8HostStats;
+
+bool chip8_host_init(Chip8Host *host, int workers);
+void chip8_host_shutdown(Chip8Host *host);
+Chip8Session *chip8_host_add(Chip8Host *host, const uint8_t *rom, size_t rom_len, int fd);
+void chip8_host_remove(Chip8Host *host, Chip8Session *session);
+void chip8_host_frame_begin(Chip8Host *host, uint64_t deadline_ns);
+void chip8_host_frame_wait(Chip8Host *host);
+void chip8_host_stats(Chip8Host *host, Chip8HostStats *stats);
+uint64_t chip8_host_now_ns(void);
+
+#endif
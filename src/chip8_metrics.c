@@ -0,0 +1,162 @@
+#include "chip8_metrics.h"
+#include "chip8_audio.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+
+static uint64_t now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void chip8_metrics_init(Chip8Metrics *metrics, double cpu_hz, double timer_hz, const char *path, uint64_t now){
+    /*
+    now: the caller's clock in ns, the same one passed to chip8_metrics_window
+    */
+    memset(metrics, 0, sizeof(*metrics));
+    metrics->cpu_hz = cpu_hz;
+    metrics->timer_hz = timer_hz;
+    metrics->path = path;
+    metrics->window_start_ns = now;
+    metrics->started_ns = now;
+}
+
+uint64_t chip8_hist_quantile(const Chip8Histogram *hist, double q){
+    /*
+    Upper bound of the bucket holding quantile q, 0 when empty
+    */
+    uint64_t count = atomic_load_explicit(&hist->count, memory_order_relaxed);
+    if (!count){
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(q * (double)count);
+    uint64_t seen = 0;
+    for (int b = 0; b < METRICS_BUCKETS; b++){
+        seen += atomic_load_explicit(&hist->buckets[b], memory_order_relaxed);
+        if (seen > rank){
+            return (2ull << b) - 1;
+        }
+    }
+    return atomic_load_explicit(&hist->max_ns, memory_order_relaxed);
+}
+
+double chip8_hist_mean(const Chip8Histogram *hist){
+    uint64_t count = atomic_load_explicit(&hist->count, memory_order_relaxed);
+    return count ? (double)atomic_load_explicit(&hist->sum_ns, memory_order_relaxed) / (double)count : 0.0;
+}
+
+static void write_counter(FILE *fp, const char *name, const char *help, uint64_t value){
+    fprintf(fp, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", name, help, name, name, (unsigned long long)value);
+}
+
+static void write_gauge(FILE *fp, const char *name, const char *help, double value){
+    fprintf(fp, "# HELP %s %s\n# TYPE %s gauge\n%s %.6g\n", name, help, name, name, value);
+}
+
+static void write_hist(FILE *fp, const char *name, const char *help, const Chip8Histogram *hist){
+    //cumulative buckets in seconds, empty leading and trailing ones left out
+    fprintf(fp, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+    uint64_t count = atomic_load_explicit(&hist->count, memory_order_relaxed);
+    uint64_t seen = 0;
+    for (int b = 0; b < METRICS_BUCKETS && seen < count; b++){
+        uint64_t n = atomic_load_explicit(&hist->buckets[b], memory_order_relaxed);
+        seen += n;
+        if (seen){
+            fprintf(fp, "%s_bucket{le=\"%.9f\"} %llu\n", name, (double)(2ull << b) * 1e-9, (unsigned long long)seen);
+        }
+    }
+    fprintf(fp, "%s_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long)count);
+    fprintf(fp, "%s_sum %.9f\n%s_count %llu\n", name,
+            (double)atomic_load_explicit(&hist->sum_ns, memory_order_relaxed) * 1e-9,
+            name, (unsigned long long)count);
+}
+
+static void write_file(const Chip8Metrics *metrics, const Chip8Audio *audio){
+    char tmp[4096];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", metrics->path) >= (int)sizeof(tmp)){
+        return;
+    }
+    FILE *fp = fopen(tmp, "w");
+    if (!fp){
+        perror("chip8_metrics: fopen");
+        return;
+    }
+
+    write_counter(fp, "chip8_instructions_total", "Guest instructions executed", metrics->instructions);
+    write_gauge(fp, "chip8_instructions_per_second", "Instructions in the last window", metrics->ips);
+    write_gauge(fp, "chip8_cpu_hz_target", "CPU_HZ", metrics->cpu_hz);
+    write_counter(fp, "chip8_timer_ticks_total", "60 Hz timer ticks", metrics->timer_ticks);
+    write_gauge(fp, "chip8_timer_ticks_per_second", "Timer ticks in the last window", metrics->tick_hz);
+    write_gauge(fp, "chip8_timer_hz_target", "TIMER_HZ", metrics->timer_hz);
+    write_counter(fp, "chip8_frames_total", "Frames presented", metrics->frames);
+    write_gauge(fp, "chip8_frames_per_second", "Frames presented in the last window", metrics->fps);
+    write_counter(fp, "chip8_delta_clamps_total", "Main loop passes with delta_time capped at 0.1 s", metrics->clamps);
+    write_hist(fp, "chip8_present_seconds", "RenderClear, RenderCopy and RenderPresent", &metrics->present);
+    write_hist(fp, "chip8_texture_update_seconds", "Pixel conversion and SDL_UpdateTexture", &metrics->texture);
+    if (audio){
+        write_hist(fp, "chip8_audio_callback_seconds", "Audio callback duration", &audio->stats.render);
+        write_counter(fp, "chip8_audio_underruns_total", "Audio callbacks more than 1.5 buffers late",
+                      atomic_load_explicit(&audio->stats.late, memory_order_relaxed));
+    }
+    write_gauge(fp, "chip8_metrics_overhead_ratio", "Wall time spent collecting and writing metrics", metrics->overhead);
+
+    if (fclose(fp) != 0 || rename(tmp, metrics->path) != 0){
+        perror("chip8_metrics: write");
+    }
+}
+
+bool chip8_metrics_window(Chip8Metrics *metrics, uint64_t now, uint64_t cycles, const Chip8Audio *audio){
+    /*
+    Call once per main loop pass with the current time and Chip8.cycles.
+    Returns true when a window closed and the rates were updated.
+    */
+    //Chip8.cycles moves back on rewind and reset, count only progress
+    if (cycles > metrics->last_cycles){
+        metrics->instructions += cycles - metrics->last_cycles;
+    }
+    metrics->last_cycles = cycles;
+
+    uint64_t elapsed = now - metrics->window_start_ns;
+    if (elapsed < METRICS_WINDOW_NS){
+        return false;
+    }
+
+    uint64_t t0 = now_ns();
+    double seconds = (double)elapsed * 1e-9;
+    metrics->ips = (double)(metrics->instructions - metrics->window_instructions) / seconds;
+    metrics->tick_hz = (double)(metrics->timer_ticks - metrics->window_ticks) / seconds;
+    metrics->fps = (double)(metrics->frames - metrics->window_frames) / seconds;
+    metrics->window_instructions = metrics->instructions;
+    metrics->window_ticks = metrics->timer_ticks;
+    metrics->window_frames = metrics->frames;
+    metrics->window_start_ns = now;
+
+    if (metrics->path){
+        write_file(metrics, audio);
+    }
+    metrics->overhead_ns += now_ns() - t0;
+    metrics->overhead = (double)metrics->overhead_ns / (double)(now - metrics->started_ns);
+    return true;
+}
+
+int chip8_metrics_summary(const Chip8Metrics *metrics, const Chip8Audio *audio, char *buf, size_t size){
+    /*
+    The last window in a few short lines for the overlay, upper case only
+    */
+    int len = snprintf(buf, size,
+        "IPS %.0f/%.0f\nTPS %.1f/%.0f\nFPS %.1f\nPRESENT %.0fUS P99 %lluUS\nTEXTURE %.0fUS\nCLAMPS %llu\n",
+        metrics->ips, metrics->cpu_hz, metrics->tick_hz, metrics->timer_hz, metrics->fps,
+        chip8_hist_mean(&metrics->present) * 1e-3,
+        (unsigned long long)(chip8_hist_quantile(&metrics->present, 0.99) / 1000),
+        chip8_hist_mean(&metrics->texture) * 1e-3, (unsigned long long)metrics->clamps);
+    if (audio && len >= 0 && (size_t)len < size){
+        len += snprintf(buf + len, size - (size_t)len, "AUDIO %.1fUS UNDERRUNS %llu\n",
+                        chip8_hist_mean(&audio->stats.render) * 1e-3,
+                        (unsigned long long)atomic_load_explicit(&audio->stats.late, memory_order_relaxed));
+    }
+    return len;
+}
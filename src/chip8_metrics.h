@@ -0,0 +1,88 @@
+#ifndef CHIP8_METRICS_H
+#define CHIP8_METRICS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// Front-end telemetry: counters, latency histograms and per-second rates.
+//
+// Every counter and histogram has a single writer (the main loop, or the
+// audio callback for the audio ones) and is updated with a relaxed load
+// and store, which costs the same as a plain increment, so any thread
+// may read it at any time. Histograms have power-of-two buckets: bucket b
+// counts durations in [2^b, 2^(b+1)) ns, found with one count-leading-zeros.
+//
+// chip8_metrics_window closes a measurement window (once per second by
+// default). It computes the rates and, with a metrics path, rewrites the
+// file in the Prometheus text format (written to <path>.tmp and renamed, so
+// readers never see half a file). It also times itself; that and the clock
+// reads around what is measured are the only collection cost.
+
+#define METRICS_BUCKETS 32          //up to ~4.3 s
+#define METRICS_WINDOW_NS 1000000000ull
+
+typedef struct Chip8Histogram {
+    _Atomic uint64_t count;
+    _Atomic uint64_t sum_ns;
+    _Atomic uint64_t max_ns;
+    _Atomic uint64_t buckets[METRICS_BUCKETS];
+} Chip8Histogram;
+
+typedef struct Chip8Metrics {
+    double cpu_hz;                  //targets the rates are shown against
+    double timer_hz;
+    const char *path;               //metrics file, NULL for none
+
+    // Main loop counters
+    uint64_t instructions;          //guest instructions, from Chip8.cycles
+    uint64_t timer_ticks;
+    uint64_t frames;                //SDL_RenderPresent calls
+    uint64_t clamps;                //loop passes whose delta_time hit the cap
+    Chip8Histogram present;         //RenderClear + RenderCopy + RenderPresent
+    Chip8Histogram texture;         //chip8_disp_to_pixels + SDL_UpdateTexture
+
+    // Last closed window
+    double ips;                     //instructions per second
+    double tick_hz;
+    double fps;
+    double overhead;                //share of wall time spent in chip8_metrics_window
+
+    // Window bookkeeping
+    uint64_t window_start_ns;
+    uint64_t last_cycles;
+    uint64_t window_instructions;
+    uint64_t window_ticks;
+    uint64_t window_frames;
+    uint64_t started_ns;
+    uint64_t overhead_ns;
+} Chip8Metrics;
+
+static inline void chip8_counter_add(_Atomic uint64_t *counter, uint64_t n){
+    //single writer: no locked read-modify-write needed
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+static inline void chip8_hist_add(Chip8Histogram *hist, uint64_t ns){
+    int bucket = 63 - __builtin_clzll(ns | 1);
+    if (bucket >= METRICS_BUCKETS){
+        bucket = METRICS_BUCKETS - 1;
+    }
+    chip8_counter_add(&hist->buckets[bucket], 1);
+    chip8_counter_add(&hist->count, 1);
+    chip8_counter_add(&hist->sum_ns, ns);
+    if (ns > atomic_load_explicit(&hist->max_ns, memory_order_relaxed)){
+        atomic_store_explicit(&hist->max_ns, ns, memory_order_relaxed);
+    }
+}
+
+struct Chip8Audio;
+
+void chip8_metrics_init(Chip8Metrics *metrics, double cpu_hz, double timer_hz, const char *path, uint64_t now);
+bool chip8_metrics_window(Chip8Metrics *metrics, uint64_t now, uint64_t cycles, const struct Chip8Audio *audio);
+uint64_t chip8_hist_quantile(const Chip8Histogram *hist, double q);
+double chip8_hist_mean(const Chip8Histogram *hist);
+int chip8_metrics_summary(const Chip8Metrics *metrics, const struct Chip8Audio *audio, char *buf, size_t size);
+
+#endif
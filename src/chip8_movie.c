@@ -0,0 +1,263 @@
+#include "chip8_movie.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FNV_OFFSET 0xCBF29CE484222325ull
+#define FNV_PRIME 0x100000001B3ull
+#define MOVIE_LEB_MAX 10 //bytes of the longest LEB128 uint64_t
+
+struct Chip8Movie {
+    FILE *fp;
+    uint64_t last;      //cycle of the previous event
+    uint16_t keys;      //last keypad mask logged
+};
+
+
+uint64_t chip8_memory_hash(const Chip8 *chip8){
+    //FNV-1a over the 4 KB address space
+    uint64_t h = FNV_OFFSET;
+    for (uint16_t addr = 0; addr < MEM_SIZE; addr++){
+        h = (h ^ chip8_mem_read(chip8, addr)) * FNV_PRIME;
+    }
+    return h;
+}
+
+uint64_t chip8_display_hash(const Chip8 *chip8){
+    //FNV-1a over the active resolution, one byte per pixel, so CHIP-8
+    //hashes match movies recorded before SUPER-CHIP
+    uint64_t h = FNV_OFFSET;
+    int width = chip8_disp_width(chip8);
+    int height = chip8_disp_height(chip8);
+    for (int y = 0; y < height; y++){
+        for (int x = 0; x < width; x++){
+            h = (h ^ chip8_pixel(chip8, x, y)) * FNV_PRIME;
+        }
+    }
+    return h;
+}
+
+static void put_event(Chip8Movie *movie, uint64_t cycle, MovieEvent kind){
+    uint64_t v = ((cycle - movie->last) << 2) | kind;
+    movie->last = cycle;
+    while (v >= 0x80){
+        fputc((int)(v & 0x7F) | 0x80, movie->fp);
+        v >>= 7;
+    }
+    fputc((int)v, movie->fp);
+}
+
+Chip8Movie *chip8_movie_record(const char *path, const Chip8 *chip8){
+    /*
+    Start a movie from chip8's current state: call after load_rom, before
+    the first instruction. Returns NULL on failure.
+    */
+    Chip8Movie *movie = calloc(1, sizeof(*movie));
+    if (!movie){
+        perror("chip8_movie_record: calloc");
+        return NULL;
+    }
+
+    movie->fp = fopen(path, "wb");
+    if (!movie->fp){
+        perror("chip8_movie_record: fopen");
+        free(movie);
+        return NULL;
+    }
+
+    Chip8MovieHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MOVIE_MAGIC, sizeof(header.magic));
+    header.version = MOVIE_VERSION;
+    header.seed = chip8->rng;
+    header.quirks = chip8->quirks;
+    header.memory_hash = chip8_memory_hash(chip8);
+    fwrite(&header, sizeof(header), 1, movie->fp);
+
+    movie->last = chip8->cycles;
+    movie->keys = chip8->keypad;
+    return movie;
+}
+
+void chip8_movie_tick(Chip8Movie *movie, const Chip8 *chip8){
+    /*
+    Log a chip8_timer_tick about to happen, call right before it
+    */
+    put_event(movie, chip8->cycles, MOVIE_TICK);
+}
+
+void chip8_movie_keys(Chip8Movie *movie, const Chip8 *chip8){
+    /*
+    Log the keypad if it changed since the last call
+    */
+    if (chip8->keypad != movie->keys){
+        movie->keys = chip8->keypad;
+        put_event(movie, chip8->cycles, MOVIE_KEYS);
+        fputc(chip8->keypad & 0xFF, movie->fp);
+        fputc(chip8->keypad >> 8, movie->fp);
+    }
+}
+
+void chip8_movie_close(Chip8Movie *movie, const Chip8 *chip8){
+    /*
+    Write the end marker with the final display hash and close the file
+    */
+    if (!movie){
+        return;
+    }
+
+    put_event(movie, chip8->cycles, MOVIE_END);
+    uint64_t h = chip8_display_hash(chip8);
+    for (int i = 0; i < 8; i++){
+        fputc((int)(h >> (8 * i)) & 0xFF, movie->fp);
+    }
+
+    fclose(movie->fp);
+    free(movie);
+}
+
+static uint8_t *read_file(const char *path, size_t *len){
+    FILE *fp = fopen(path, "rb");
+    if (!fp){
+        perror("chip8_movie_play: fopen");
+        return NULL;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    uint8_t *data = size > 0 ? malloc((size_t)size) : NULL;
+    if (!data || fread(data, 1, (size_t)size, fp) != (size_t)size){
+        fprintf(stderr, "chip8_movie_play: could not read %s\n", path);
+        free(data);
+        fclose(fp);
+        return NULL;
+    }
+
+    fclose(fp);
+    *len = (size_t)size;
+    return data;
+}
+
+int chip8_movie_play(const char *path, Chip8 *chip8, Chip8MovieResult *result){
+    /*
+    Replay a movie as fast as possible onto chip8, which must have the same
+    ROM loaded. Returns 0 if the final display matches the recording, 1 on
+    a mismatch and -1 if the movie cannot be used.
+    */
+    return chip8_movie_play_frames(path, chip8, result, NULL, NULL);
+}
+
+int chip8_movie_play_frames(const char *path, Chip8 *chip8, Chip8MovieResult *result,
+                            void (*on_tick)(void *ctx, Chip8 *chip8), void *ctx){
+    /*
+    chip8_movie_play, calling on_tick after every timer tick (once per
+    60 Hz frame)
+    */
+    size_t len;
+    uint8_t *data = read_file(path, &len);
+    if (!data){
+        return -1;
+    }
+
+    Chip8MovieHeader header;
+    if (len < sizeof(header)){
+        fprintf(stderr, "chip8_movie_play: %s is too short\n", path);
+        free(data);
+        return -1;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, MOVIE_MAGIC, sizeof(header.magic)) != 0 || header.version != MOVIE_VERSION){
+        fprintf(stderr, "chip8_movie_play: %s is not a version %d movie\n", path, MOVIE_VERSION);
+        free(data);
+        return -1;
+    }
+    if (header.memory_hash != chip8_memory_hash(chip8)){
+        fprintf(stderr, "chip8_movie_play: %s was recorded with a different ROM\n", path);
+        free(data);
+        return -1;
+    }
+
+    memset(result, 0, sizeof(*result));
+    chip8->rng = header.seed;
+    chip8->quirks = (uint8_t)header.quirks;
+    uint64_t start = chip8->cycles;
+
+    size_t pos = sizeof(header);
+    int status = -1;
+    bool failed = false;
+    while (pos < len){
+        //anything longer than MOVIE_LEB_MAX bytes is corrupt, not a bigger number
+        uint64_t v = 0;
+        int shift = 0;
+        size_t end = len - pos > MOVIE_LEB_MAX ? pos + MOVIE_LEB_MAX : len;
+        while (pos < end && (data[pos] & 0x80)){
+            v |= (uint64_t)(data[pos++] & 0x7F) << shift;
+            shift += 7;
+        }
+        if (pos == end){
+            break;
+        }
+        v |= (uint64_t)data[pos++] << shift;
+
+        //run up to the event, nothing else can happen in between
+        uint64_t until = chip8->cycles + (v >> 2);
+        while (chip8->cycles < until){
+            if (chip8->vblank_wait){
+                //the recording ran on where display-wait stops the CPU
+                fprintf(stderr, "chip8_movie_play: %s: display-wait at 0x%03X, %llu instructions before the next event\n",
+                        path, chip8->pc, (unsigned long long)(until - chip8->cycles));
+                failed = true;
+                break;
+            }
+            int err = chip8_step(chip8);
+            if (err != CHIP8_OK){
+                fprintf(stderr, "chip8_movie_play: %s: %s at 0x%03X\n", path, chip8_strerror(err), chip8->pc);
+                failed = true;
+                break;
+            }
+        }
+        if (failed){
+            break;
+        }
+
+        MovieEvent kind = (MovieEvent)(v & 3);
+        if (kind == MOVIE_TICK){
+            chip8_timer_tick(chip8);
+            result->ticks++;
+            if (on_tick){
+                on_tick(ctx, chip8);
+            }
+        } else if (kind == MOVIE_KEYS){
+            if (len - pos < 2){
+                break;
+            }
+            chip8->keypad = (uint16_t)(data[pos] | (data[pos + 1] << 8));
+            pos += 2;
+            result->key_changes++;
+        } else if (kind == MOVIE_END){
+            if (len - pos < 8){
+                break;
+            }
+            for (int i = 0; i < 8; i++){
+                result->expected_hash |= (uint64_t)data[pos + i] << (8 * i);
+            }
+            result->display_hash = chip8_display_hash(chip8);
+            status = result->display_hash == result->expected_hash ? 0 : 1;
+            break;
+        } else {
+            break;
+        }
+    }
+
+    if (status < 0 && !failed){
+        fprintf(stderr, "chip8_movie_play: %s is truncated or corrupt\n", path);
+    }
+    result->cycles = chip8->cycles - start;
+    free(data);
+    return status;
+}
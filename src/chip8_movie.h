@@ -0,0 +1,56 @@
+#ifndef CHIP8_MOVIE_H
+#define CHIP8_MOVIE_H
+
+#include <stdint.h>
+#include "chip8.h"
+
+// Input movie: everything needed to replay a session bit for bit.
+//
+// File: Chip8MovieHeader (RNG seed, quirks and a hash of the starting
+// memory), then events, each a LEB128 of (cycles since the previous
+// event << 2 | kind):
+//   MOVIE_TICK  chip8_timer_tick before instruction `cycle`
+//   MOVIE_KEYS  followed by the new uint16_t keypad mask, little-endian
+//   MOVIE_END   followed by the uint64_t display hash at that cycle
+// Cycles are Chip8.cycles, so events land between the same two
+// instructions on replay no matter how fast it runs.
+
+#define MOVIE_MAGIC "C8MV"
+#define MOVIE_VERSION 1
+
+typedef enum {
+    MOVIE_TICK,
+    MOVIE_KEYS,
+    MOVIE_END
+} MovieEvent;
+
+typedef struct Chip8MovieHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t seed;          //Chip8.rng at cycle 0
+    uint32_t quirks;        //Chip8.quirks, 0 in movies from before it was stored
+    uint64_t memory_hash;   //chip8_memory_hash after load_rom
+} Chip8MovieHeader;
+
+typedef struct Chip8Movie Chip8Movie;
+
+typedef struct Chip8MovieResult {
+    uint64_t cycles;        //instructions replayed
+    uint64_t ticks;
+    uint64_t key_changes;
+    uint64_t expected_hash; //display hash stored in the movie
+    uint64_t display_hash;  //display hash after replay
+} Chip8MovieResult;
+
+uint64_t chip8_memory_hash(const Chip8 *chip8);
+uint64_t chip8_display_hash(const Chip8 *chip8);
+
+Chip8Movie *chip8_movie_record(const char *path, const Chip8 *chip8);
+void chip8_movie_tick(Chip8Movie *movie, const Chip8 *chip8);
+void chip8_movie_keys(Chip8Movie *movie, const Chip8 *chip8);
+void chip8_movie_close(Chip8Movie *movie, const Chip8 *chip8);
+int chip8_movie_play(const char *path, Chip8 *chip8, Chip8MovieResult *result);
+int chip8_movie_play_frames(const char *path, Chip8 *chip8, Chip8MovieResult *result,
+                            void (*on_tick)(void *ctx, Chip8 *chip8), void *ctx);
+
+#endif
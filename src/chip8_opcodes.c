@@ -1,10 +1,9 @@
 #include "chip8.h"
+#include "chip8_exec.h"
 
 #include <stdbool.h>
-#include <assert.h>
 #include <string.h>
 #include <stdlib.h>
-#include <stdio.h>
 
 
 void op_00E0 (Chip8 *chip8){
@@ -12,22 +11,91 @@ void op_00E0 (Chip8 *chip8){
     00E0: Clear screen
     Set all display pixels = 0
     */
-    memset(chip8->display, 0x0, sizeof(chip8->display));
+    chip8_exec_clear(chip8->display);
+#if CHIP8_STATE_HASH
+    chip8->disp_hash = 0;
+#endif
     chip8->draw_flag = true;
     return;
 }
 
 
-void op_00EE(Chip8 *chip8){
+int op_00EE(Chip8 *chip8){
     /*
     00EE: RET
     Return from subroutine
     Set program counter to address at top of stack
     Subtract 1 from stack pointer
+
+    With nothing to return to, stays on the instruction and returns
+    CHIP8_ERR_STACK
+    */
+    return chip8_exec_ret(chip8->stack, &chip8->sp, &chip8->pc);
+}
+
+
+#if CHIP8_STATE_HASH
+static void rehash_display(Chip8 *chip8){
+    //scrolls move every row
+    chip8->disp_hash = 0;
+    for (int y = 0; y < DISP_HIRES_HEIGHT; y++){
+        chip8->disp_hash ^= chip8_hash_row(y, chip8->display[y]);
+    }
+}
+#endif
+
+void op_00Cn(Chip8 *chip8, uint8_t n){
+    /*
+    00Cn: SCD n (SUPER-CHIP)
+    Scroll the display down n rows of the active resolution, blank rows
+    come in at the top
+    */
+    chip8_exec_scroll_down(chip8->display, n, chip8->hires);
+#if CHIP8_STATE_HASH
+    rehash_display(chip8);
+#endif
+    chip8->draw_flag = true;
+}
+
+void op_00FB(Chip8 *chip8){
+    /*
+    00FB: SCR (SUPER-CHIP)
+    Scroll the display right 4 pixels
+    */
+    chip8_exec_scroll_right(chip8->display, chip8->hires);
+#if CHIP8_STATE_HASH
+    rehash_display(chip8);
+#endif
+    chip8->draw_flag = true;
+}
+
+void op_00FC(Chip8 *chip8){
+    /*
+    00FC: SCL (SUPER-CHIP)
+    Scroll the display left 4 pixels
+    */
+    chip8_exec_scroll_left(chip8->display, chip8->hires);
+#if CHIP8_STATE_HASH
+    rehash_display(chip8);
+#endif
+    chip8->draw_flag = true;
+}
+
+void op_00FD(Chip8 *chip8){
+    /*
+    00FD: EXIT (SUPER-CHIP)
+    Stop: PC stays on this instruction, see chip8_exited
     */
-    assert(chip8->sp > 0);
-    chip8->sp --;
-    chip8->pc = chip8->stack[chip8->sp];
+    chip8->pc -= 2;
+}
+
+void op_00FE(Chip8 *chip8, bool hires){
+    /*
+    00FE: LOW, 00FF: HIGH (SUPER-CHIP)
+    Switch to 64x32 or 128x64 and clear the display
+    */
+    chip8->hires = hires;
+    op_00E0(chip8);
 }
 
 
@@ -40,7 +108,7 @@ void op_1nnn(Chip8 *chip8, uint16_t nnn){
 }
 
 
-void op_2nnn(Chip8 *chip8, uint16_t nnn){
+int op_2nnn(Chip8 *chip8, uint16_t nnn){
     /*
     2nnn: Call addr
     Call subroutine at nnn
@@ -48,10 +116,11 @@ void op_2nnn(Chip8 *chip8, uint16_t nnn){
     stack[sp] = pc
     sp = sp + 1
     pc = nnn
+
+    With the stack full, stays on the instruction and returns
+    CHIP8_ERR_STACK
     */
-    chip8->stack[chip8->sp] = chip8->pc;
-    chip8->sp ++;
-    chip8->pc = nnn;
+    return chip8_exec_call(chip8->stack, &chip8->sp, &chip8->pc, nnn);
 }
 
 
@@ -109,12 +178,25 @@ void op_7xkk(Chip8 *chip8, uint8_t x, uint8_t kk){
 }
 
 
+static void alu(Chip8 *chip8, uint8_t n, uint8_t x, uint8_t y){
+    //8xyn through chip8_exec_alu, shared with the batch lanes
+    uint8_t result = 0;
+    uint8_t vf = 0;
+    int store = chip8_exec_alu(n, chip8->V[x], chip8->V[y], &result, &vf);
+    if (store != CHIP8_ALU_NONE){
+        chip8->V[x] = result;
+    }
+    if (store == CHIP8_ALU_VX_VF){
+        chip8->V[0xF] = vf;
+    }
+}
+
 void op_8xy0(Chip8 *chip8, uint8_t x, uint8_t y){
     /*
     8xy0: Ld Vx, Vy
     Store the value of register Vy in register Vx
     */
-    chip8->V[x] = chip8->V[y];
+    alu(chip8, 0x0, x, y);
 }
 
 
@@ -124,8 +206,7 @@ void op_8xy1(Chip8 *chip8, uint8_t x, uint8_t y){
     Set Vx = Vx OR Vy
     OR is bitwise
     */
-    chip8->V[x] = chip8->V[y] | chip8->V[x];
-    chip8->V[0xF] = 0; 
+    alu(chip8, 0x1, x, y);
 }
 
 
@@ -135,8 +216,7 @@ void op_8xy2(Chip8 *chip8, uint8_t x, uint8_t y){
     Set Vx = Vx AND Vy
     AND is bitwise
     */
-    chip8->V[x] = chip8->V[y] & chip8->V[x];
-    chip8->V[0xF] = 0; 
+    alu(chip8, 0x2, x, y);
 }
 
 
@@ -146,8 +226,7 @@ void op_8xy3(Chip8 *chip8, uint8_t x, uint8_t y){
     Set Vx = Vx XOR Vy
     XOR is bitwise
     */
-    chip8->V[x] = chip8->V[y] ^ chip8->V[x];
-    chip8->V[0xF] = 0; 
+    alu(chip8, 0x3, x, y);
 }
 
 
@@ -158,9 +237,7 @@ void op_8xy4(Chip8 *chip8, uint8_t x, uint8_t y){
     If result > 255 (8 bits) VF = 1, low 8 bits are stored to Vx.
     If result <= 255 VF = 0
     */
-    uint16_t sum = (uint16_t)chip8->V[x] + (uint16_t)chip8->V[y];
-    chip8->V[x] = (uint8_t)sum;
-    chip8->V[0xF] = (sum > 0xFF);
+    alu(chip8, 0x4, x, y);
 }
 
 
@@ -171,11 +248,7 @@ void op_8xy5(Chip8 *chip8, uint8_t x, uint8_t y){
     If Vx > Vy, VF = 1
     else VF = 0
     */
-    uint8_t vx = chip8->V[x];
-    uint8_t vy = chip8->V[y];
-
-    chip8->V[x] = vx - vy;
-    chip8->V[0xF] = (vx >= vy);
+    alu(chip8, 0x5, x, y);
 }
 
 
@@ -187,10 +260,7 @@ void op_8xy6(Chip8 *chip8, uint8_t x, uint8_t y){
     VF = least significant bit of original Vy
     Vx = Vy >> 1
     */
-    uint8_t vy = chip8->V[y];
-
-    chip8->V[x] = vy >> 1;
-    chip8->V[0xF] = vy & 0x1;
+    alu(chip8, 0x6, x, y);
 }
 
 
@@ -201,11 +271,7 @@ void op_8xy7(Chip8 *chip8, uint8_t x, uint8_t y){
     IF Vy > Vx, VF = 1
     else VF = 0
     */
-    uint8_t vx = chip8->V[x];
-    uint8_t vy = chip8->V[y];
-
-    chip8->V[x] = vy - vx;
-    chip8->V[0xF] = (vy >= vx);
+    alu(chip8, 0x7, x, y);
 }
 
 
@@ -217,10 +283,7 @@ void op_8xyE(Chip8 *chip8, uint8_t x, uint8_t y){
     VF = most significant bit of original Vy
     Vx = Vy << 1
     */
-    uint8_t vy = chip8->V[y];
-
-    chip8->V[x] = vy << 1;
-    chip8->V[0xF] = vy >> 7;
+    alu(chip8, 0xE, x, y);
 }
 
 
@@ -259,9 +322,9 @@ void op_Cxkk(Chip8 *chip8, uint8_t x, uint8_t kk){
     Cxkk: RND Vx, byte
     Set Vx = random byte AND kk
     Generate a random number from 0-255 and logical AND it with kk. Store in Vx
+    Per-instance xorshift32 so forks, replays and rewinds repeat exactly
     */
-    uint8_t r = (uint8_t)(rand() & 0xFF);
-    chip8->V[x] = r & kk;
+    chip8->V[x] = chip8_exec_rnd(&chip8->rng, kk);
 }
 
 // void op_Dxyn(Chip8 *chip8, uint8_t x, uint8_t y, uint8_t n){
@@ -271,7 +334,7 @@ void op_Cxkk(Chip8 *chip8, uint8_t x, uint8_t kk){
 //     uint8_t start_y = chip8->V[y] % 32;
 
 //     for (int row = 0; row < n; row++){
-//         uint8_t sprite_data = chip8->memory[chip8->I + row];
+//         uint8_t sprite_data = chip8_mem_read(chip8, chip8->I + row);
 
 //         for (int pixel = 0; pixel < 8; pixel++){
 //             uint8_t sprite_bit = (sprite_data >> (7 - pixel)) & 1;
@@ -295,47 +358,34 @@ void op_Dxyn(Chip8 *chip8, uint8_t x, uint8_t y, uint8_t n){
     /*
     Dxyn: DRW Vx, Vy, n
     Draw n-byte sprite from memory[I] at (Vx, Vy)
+    Dxy0 (SUPER-CHIP): 16x16 sprite, 2 bytes per row
 
     Start coordinate wraps:
-        Vx % DISP_WIDTH
-        Vy % DISP_HEIGHT
-
-    Sprite drawing clips at right/bottom edges.
-    */
-    chip8->V[0xF] = 0;
-
-    int y_cord = chip8->V[y] % DISP_HEIGHT;
-
-    for (int row = 0; row < n; row++){
-        int x_cord = chip8->V[x] % DISP_WIDTH;
+        Vx % chip8_disp_width
+        Vy % chip8_disp_height
 
-        if (y_cord >= DISP_HEIGHT){
-            break;
-        }
+    Sprite drawing clips at right/bottom edges, VF = 1 if any row
+    collided. The drawing itself is chip8_exec_draw.
 
-        uint8_t sprite_data = chip8->memory[chip8->I + row];
-
-        for (int pixel = 0; pixel < 8; pixel++){
-            if (x_cord >= DISP_WIDTH){
-                break;
-            }
-
-            uint8_t sprite_bit = (sprite_data >> (7 - pixel)) & 1;
-
-            if (sprite_bit){
-                if (chip8->display[y_cord][x_cord]){
-                    chip8->V[0xF] = 1;
-                }
-
-                chip8->display[y_cord][x_cord] ^= 1;
-            }
-
-            x_cord++;
-        }
-
-        y_cord++;
+    With CHIP8_QUIRK_DISPLAY_WAIT the rest of the frame is spent waiting
+    for vblank.
+    */
+    unsigned bytes = chip8_exec_sprite_bytes(n);
+    uint8_t sprite[32];
+    chip8_watch(chip8, chip8->I, bytes, CHIP8_WATCH_READ);
+    for (unsigned i = 0; i < bytes; i++){
+        sprite[i] = chip8_mem_read(chip8, chip8->I + i);
     }
+#if CHIP8_STATE_HASH
+    uint64_t *disp_hash = &chip8->disp_hash;
+#else
+    uint64_t *disp_hash = NULL;
+#endif
+    chip8_exec_draw(chip8->display, chip8->V, 1, sprite, x, y, n, chip8->hires, disp_hash);
     chip8->draw_flag = true;
+    if (chip8->quirks & CHIP8_QUIRK_DISPLAY_WAIT){
+        chip8->vblank_wait = true;
+    }
 }
 
 
@@ -346,8 +396,7 @@ void op_Ex9E(Chip8 *chip8, uint8_t x){
     Skip next instruction if key with the value of Vx is pressed
     If the same key is pressed, PC = PC + 2
     */
-    uint8_t key = chip8->V[x] & 0x0F;
-    if (chip8->keypad[key]) {
+    if (chip8_exec_key_down(chip8->keypad, chip8->V[x])) {
         chip8->pc += 2;
     }
 }
@@ -359,13 +408,23 @@ void op_ExA1(Chip8 *chip8, uint8_t x){
     Skipp next instruction if key with the value fo Vx is not pressed
     If key is in up position, PC = PC + 2
     */
-    uint8_t key = chip8->V[x] & 0x0F;
-    if (!chip8->keypad[key]) {
+    if (!chip8_exec_key_down(chip8->keypad, chip8->V[x])) {
         chip8->pc += 2;
     }
 }
 
 
+void op_F002(Chip8 *chip8){
+    /*
+    F002: AUDIO (XO-CHIP)
+    Load the 16-byte audio pattern from memory location I
+    */
+    chip8_watch(chip8, chip8->I, sizeof(chip8->audio_pattern), CHIP8_WATCH_READ);
+    for (uint8_t i = 0; i < sizeof(chip8->audio_pattern); i++){
+        chip8->audio_pattern[i] = chip8_mem_read(chip8, chip8->I + i);
+    }
+}
+
 void op_Fx07(Chip8 *chip8, uint8_t x){
     /*
     Fx07: LD VX, DT
@@ -383,40 +442,15 @@ void op_Fx0A(Chip8 *chip8, uint8_t x){
     Store the pressed key in Vx.
     Do not continue until that key is released.
     */
-
-    // First time entering this instruction
-    if (!chip8->waiting_for_key){
-        chip8->waiting_for_key = true;
-        chip8->wait_key_reg = x;
-        chip8->wait_key_value = 0xFF;
-    }
-
-    // Phase 1: wait for a key to be pressed
-    if (chip8->wait_key_value == 0xFF){
-        for (uint8_t k = 0; k < 16; k++){
-            if (chip8->keypad[k]){
-                chip8->wait_key_value = k;
-                break;
-            }
-        }
-
-        // Still no key pressed, repeat Fx0A
-        chip8->pc -= 2;
-        return;
-    }
-
-    // Phase 2: key was pressed, now wait until that same key is released
-    if (chip8->keypad[chip8->wait_key_value]){
+    uint8_t dest = 0;
+    int key = chip8_exec_wait_key(&chip8->waiting_for_key, &chip8->wait_key_reg, &chip8->wait_key_value,
+                                  chip8->keypad, x, &dest);
+    if (key < 0){
+        // Still waiting, repeat Fx0A
         chip8->pc -= 2;
         return;
     }
-
-    // Key has been released, now store it and continue
-    chip8->V[chip8->wait_key_reg] = chip8->wait_key_value;
-
-    chip8->waiting_for_key = false;
-    chip8->wait_key_reg = 0;
-    chip8->wait_key_value = 0xFF;
+    chip8->V[dest] = (uint8_t)key;
 }
 
 
@@ -453,8 +487,23 @@ void op_Fx29(Chip8 *chip8, uint8_t x){
     Set I = location of sprite for digit Vx (0-F).
     Each sprite is 5 bytes.
     */
-    uint8_t digit = chip8->V[x] & 0x0F;
-    chip8->I = FONT_ADDRESS + (digit * 5);
+    chip8->I = chip8_exec_font(chip8->V[x]);
+}
+
+void op_Fx30(Chip8 *chip8, uint8_t x){
+    /*
+    Fx30: LD HF, Vx (SUPER-CHIP)
+    Set I = location of the 8x10 sprite for digit Vx
+    */
+    chip8->I = chip8_exec_big_font(chip8->V[x]);
+}
+
+void op_Fx3A(Chip8 *chip8, uint8_t x){
+    /*
+    Fx3A: PITCH Vx (XO-CHIP)
+    Set the audio pattern playback rate to 4000 * 2^((Vx - 64) / 48) Hz
+    */
+    chip8->pitch = chip8->V[x];
 }
 
 void op_Fx33(Chip8 *chip8, uint8_t x){
@@ -465,11 +514,13 @@ void op_Fx33(Chip8 *chip8, uint8_t x){
         -I + 1 = tens
         -I + 2 = ones
     */
-    uint8_t v = chip8->V[x];
+    uint8_t digits[3];
+    chip8_exec_bcd(chip8->V[x], digits);
+    chip8_watch(chip8, chip8->I, 3, CHIP8_WATCH_WRITE);
 
-    chip8->memory[chip8->I]     = v / 100;
-    chip8->memory[chip8->I + 1] = (v / 10) % 10;
-    chip8->memory[chip8->I + 2] = v % 10;
+    for (uint8_t i = 0; i < 3; i++){
+        chip8_mem_write(chip8, chip8->I + i, digits[i]);
+    }
 }
 
 
@@ -478,8 +529,9 @@ void op_Fx55(Chip8 *chip8, uint8_t x){
     Fx55: Ld [i], Vx
     Store registers V0-Vx in memory starting at I
     */
+    chip8_watch(chip8, chip8->I, x + 1, CHIP8_WATCH_WRITE);
     for(uint8_t i = 0; i <= x; i++){
-        chip8->memory[chip8->I + i] = chip8->V[i];
+        chip8_mem_write(chip8, chip8->I + i, chip8->V[i]);
     }
     chip8->I += x + 1;
 }
@@ -490,8 +542,25 @@ void op_Fx65(Chip8 *chip8, uint8_t x){
     Fx65: LD Vx, [I]
     Read starting at memory location I into registers V0-Vx 
     */
+    chip8_watch(chip8, chip8->I, x + 1, CHIP8_WATCH_READ);
     for(uint8_t i = 0; i <= x; i++){
-        chip8->V[i] = chip8->memory[chip8->I + i];
+        chip8->V[i] = chip8_mem_read(chip8, chip8->I + i);
     }
     chip8->I += x + 1;
-}
\ No newline at end of file
+}
+
+void op_Fx75(Chip8 *chip8, uint8_t x){
+    /*
+    Fx75: LD R, Vx (SUPER-CHIP)
+    Store V0-Vx in the RPL user flags
+    */
+    memcpy(chip8->rpl, chip8->V, (size_t)x + 1);
+}
+
+void op_Fx85(Chip8 *chip8, uint8_t x){
+    /*
+    Fx85: LD Vx, R (SUPER-CHIP)
+    Read V0-Vx from the RPL user flags
+    */
+    memcpy(chip8->V, chip8->rpl, (size_t)x + 1);
+}
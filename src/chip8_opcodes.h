@@ -1,7 +1,19 @@
+#ifndef CHIP8_OPCODES_H
+#define CHIP8_OPCODES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "chip8.h"
+
 void op_00E0 (Chip8 *chip8);
-void op_00EE(Chip8 *chip8);
+int op_00EE(Chip8 *chip8);
+void op_00Cn(Chip8 *chip8, uint8_t n);
+void op_00FB(Chip8 *chip8);
+void op_00FC(Chip8 *chip8);
+void op_00FD(Chip8 *chip8);
+void op_00FE(Chip8 *chip8, bool hires);
 void op_1nnn(Chip8 *chip8, uint16_t nnn);
-void op_2nnn(Chip8 *chip8, uint16_t nnn);
+int op_2nnn(Chip8 *chip8, uint16_t nnn);
 void op_3xkk(Chip8 *chip8, uint8_t x, uint8_t kk);
 void op_4xkk(Chip8 *chip8, uint8_t x, uint8_t kk);
 void op_5xy0(Chip8 *chip8, uint8_t x, uint8_t y);
@@ -23,12 +35,19 @@ void op_Cxkk(Chip8 *chip8, uint8_t x, uint8_t kk);
 void op_Dxyn(Chip8 *chip8, uint8_t x, uint8_t y, uint8_t n);
 void op_Ex9E(Chip8 *chip8, uint8_t x);
 void op_ExA1(Chip8 *chip8, uint8_t x);
+void op_F002(Chip8 *chip8);
 void op_Fx07(Chip8 *chip8, uint8_t x);
 void op_Fx0A(Chip8 *chip8, uint8_t x);
 void op_Fx15(Chip8 *chip8, uint8_t x);
 void op_Fx18(Chip8 *chip8, uint8_t x);
 void op_Fx1E(Chip8 *chip8, uint8_t x);
 void op_Fx29(Chip8 *chip8, uint8_t x);
+void op_Fx30(Chip8 *chip8, uint8_t x);
+void op_Fx3A(Chip8 *chip8, uint8_t x);
 void op_Fx33(Chip8 *chip8, uint8_t x);
 void op_Fx55(Chip8 *chip8, uint8_t x);
-void op_Fx65(Chip8 *chip8, uint8_t x);
\ No newline at end of file
+void op_Fx65(Chip8 *chip8, uint8_t x);
+void op_Fx75(Chip8 *chip8, uint8_t x);
+void op_Fx85(Chip8 *chip8, uint8_t x);
+
+#endif
\ No newline at end of file
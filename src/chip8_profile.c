@@ -0,0 +1,62 @@
+#include "chip8_profile.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+
+static uint64_t now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t next_period(Chip8Profile *profile){
+    //uniform in [mean / 2, mean * 3 / 2)
+    uint32_t x = profile->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    profile->rng = x;
+    return profile->mean_period / 2 + (x & (profile->mean_period - 1));
+}
+
+void chip8_profile_init(Chip8Profile *profile, uint32_t mean_period){
+    /*
+    mean_period: instructions between samples on average, a power of 2 >= 2
+    (e.g. PROFILE_PERIOD)
+    */
+    memset(profile, 0, sizeof(*profile));
+    profile->mean_period = mean_period;
+    profile->rng = 0x9E3779B9u;
+    profile->period = next_period(profile);
+    profile->countdown = profile->period;
+    profile->last_ns = now_ns();
+}
+
+void chip8_profile_resume(Chip8Profile *profile){
+    /*
+    Start of a run batch: whatever happened since the last instruction was
+    not emulation
+    */
+    profile->last_ns = now_ns();
+}
+
+void chip8_profile_sample(Chip8Profile *profile, const Chip8 *chip8){
+    /*
+    Credit the PC about to run with the instructions and host time since the
+    previous sample, then pick the next sample point
+    */
+    uint64_t now = now_ns();
+    uint16_t pc = chip8->pc & (MEM_SIZE - 1);
+
+    profile->counts[pc] += profile->period;
+    profile->time_ns[pc] += now - profile->last_ns;
+    profile->total_count += profile->period;
+    profile->total_ns += now - profile->last_ns;
+    profile->samples++;
+    profile->last_ns = now;
+
+    profile->period = next_period(profile);
+    profile->countdown = profile->period;
+}
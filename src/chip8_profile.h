@@ -0,0 +1,49 @@
+#ifndef CHIP8_PROFILE_H
+#define CHIP8_PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "chip8.h"
+
+// Sampling execution profile.
+//
+// chip8_profile_step goes in the run loop before each chip8_step. It only
+// counts down; every `period` instructions on average (jittered so loops
+// cannot alias with the period) chip8_profile_sample records the PC
+// about to execute, crediting it with the instructions since the last
+// sample and the host time since the last sample. Call
+// chip8_profile_resume at the start of each run batch so time spent
+// outside the interpreter (rendering, sleeping) is not charged.
+//
+// counts[] estimates executions per address, time_ns[] host time per
+// address. chip8_disasm_print shows both next to the disassembly.
+
+// Mean instructions between samples, a power of 2. Each sample reads the
+// clock (~40 ns), so 128 costs a few percent running unthrottled; at
+// 700 Hz a shorter period gives a livelier picture for free.
+#define PROFILE_PERIOD 128
+
+typedef struct Chip8Profile {
+    uint32_t countdown;         //instructions until the next sample
+    uint32_t period;            //instructions the next sample stands for
+    uint32_t mean_period;
+    uint32_t rng;
+    uint64_t last_ns;
+    uint64_t samples;
+    uint64_t total_count;       //sum of counts[]
+    uint64_t total_ns;          //sum of time_ns[]
+    uint64_t counts[MEM_SIZE];
+    uint64_t time_ns[MEM_SIZE];
+} Chip8Profile;
+
+void chip8_profile_init(Chip8Profile *profile, uint32_t mean_period);
+void chip8_profile_resume(Chip8Profile *profile);
+void chip8_profile_sample(Chip8Profile *profile, const Chip8 *chip8);
+
+static inline void chip8_profile_step(Chip8Profile *profile, const Chip8 *chip8){
+    if (--profile->countdown == 0){
+        chip8_profile_sample(profile, chip8);
+    }
+}
+
+#endif
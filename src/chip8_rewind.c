@@ -0,0 +1,290 @@
+#include "chip8_rewind.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    EVENT_KEYS,     //keypad mask changed to value
+    EVENT_TICK      //chip8_timer_tick
+} EventKind;
+
+typedef struct {
+    uint64_t at;    //applied just before instruction `at`
+    uint16_t value;
+    uint8_t kind;
+} RewindEvent;
+
+typedef struct {
+    uint64_t at;    //state just before instruction `at`
+    size_t events;  //events already reflected in state
+    Chip8 state;
+} Checkpoint;
+
+struct Chip8Rewind {
+    uint64_t count;         //instructions executed so far
+    uint16_t keys;          //last keypad mask logged
+
+    Checkpoint *checkpoints;
+    int checkpoint_count;
+    int checkpoint_cap;
+
+    RewindEvent *events;
+    size_t event_count;
+    size_t event_cap;
+};
+
+
+static bool push_checkpoint(Chip8Rewind *rewind, const Chip8 *chip8){
+    if (rewind->checkpoint_count == rewind->checkpoint_cap){
+        int cap = rewind->checkpoint_cap ? rewind->checkpoint_cap * 2 : 64;
+        Checkpoint *grown = realloc(rewind->checkpoints, sizeof(*grown) * (size_t)cap);
+        if (!grown){
+            perror("chip8_rewind: realloc");
+            return false;
+        }
+        rewind->checkpoints = grown;
+        rewind->checkpoint_cap = cap;
+    }
+
+    Checkpoint *cp = &rewind->checkpoints[rewind->checkpoint_count++];
+    cp->at = rewind->count;
+    cp->events = rewind->event_count;
+    chip8_fork(&cp->state, chip8);
+    cp->state.mem_flags = NULL; //debugger table belongs to the live Chip8
+    return true;
+}
+
+static void push_event(Chip8Rewind *rewind, EventKind kind, uint16_t value){
+    if (rewind->event_count == rewind->event_cap){
+        size_t cap = rewind->event_cap ? rewind->event_cap * 2 : 1024;
+        RewindEvent *grown = realloc(rewind->events, sizeof(*grown) * cap);
+        if (!grown){
+            perror("chip8_rewind: realloc");
+            return;
+        }
+        rewind->events = grown;
+        rewind->event_cap = cap;
+    }
+
+    RewindEvent *e = &rewind->events[rewind->event_count++];
+    e->at = rewind->count;
+    e->value = value;
+    e->kind = (uint8_t)kind;
+}
+
+Chip8Rewind *chip8_rewind_create(const Chip8 *chip8){
+    /*
+    Start recording from chip8's current state. Returns NULL on failure.
+    */
+    Chip8Rewind *rewind = calloc(1, sizeof(*rewind));
+    if (!rewind){
+        perror("chip8_rewind_create: calloc");
+        return NULL;
+    }
+
+    rewind->keys = chip8->keypad;
+    if (!push_checkpoint(rewind, chip8)){
+        free(rewind);
+        return NULL;
+    }
+    return rewind;
+}
+
+void chip8_rewind_destroy(Chip8Rewind *rewind){
+    if (!rewind){
+        return;
+    }
+    for (int i = 0; i < rewind->checkpoint_count; i++){
+        chip8_release(&rewind->checkpoints[i].state);
+    }
+    free(rewind->checkpoints);
+    free(rewind->events);
+    free(rewind);
+}
+
+void chip8_rewind_record(Chip8Rewind *rewind, const Chip8 *chip8){
+    /*
+    Call right before every chip8_step
+    */
+    chip8_rewind_checkpoint(rewind, chip8);
+    rewind->count++;
+}
+
+unsigned chip8_rewind_checkpoint(Chip8Rewind *rewind, const Chip8 *chip8){
+    /*
+    Batched chip8_rewind_record: call before a run of chip8_step, then
+    chip8_rewind_advance with how many ran. Returns how many may run
+    before the next checkpoint is due.
+    */
+    if (rewind->count % REWIND_INTERVAL == 0 &&
+        rewind->checkpoints[rewind->checkpoint_count - 1].at != rewind->count){
+        push_checkpoint(rewind, chip8);
+    }
+    return REWIND_INTERVAL - (unsigned)(rewind->count % REWIND_INTERVAL);
+}
+
+void chip8_rewind_advance(Chip8Rewind *rewind, unsigned steps){
+    rewind->count += steps;
+}
+
+void chip8_rewind_keys(Chip8Rewind *rewind, const Chip8 *chip8){
+    /*
+    Log the keypad if it changed since the last call
+    */
+    if (chip8->keypad != rewind->keys){
+        rewind->keys = chip8->keypad;
+        push_event(rewind, EVENT_KEYS, chip8->keypad);
+    }
+}
+
+void chip8_rewind_timer_tick(Chip8Rewind *rewind, Chip8 *chip8){
+    push_event(rewind, EVENT_TICK, 0);
+    chip8_timer_tick(chip8);
+}
+
+uint64_t chip8_rewind_position(const Chip8Rewind *rewind){
+    return rewind->count;
+}
+
+static int checkpoint_before(const Chip8Rewind *rewind, uint64_t target){
+    //last checkpoint with at <= target, checkpoints are in order
+    int lo = 0;
+    int hi = rewind->checkpoint_count - 1;
+    while (lo < hi){
+        int mid = (lo + hi + 1) / 2;
+        if (rewind->checkpoints[mid].at <= target){
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+static size_t first_event_after(const Chip8Rewind *rewind, uint64_t at){
+    //first event with event.at > at
+    size_t lo = 0;
+    size_t hi = rewind->event_count;
+    while (lo < hi){
+        size_t mid = (lo + hi) / 2;
+        if (rewind->events[mid].at <= at){
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static void restore(Chip8 *chip8, const Checkpoint *cp){
+    //keep the live debugger table across the restore
+    uint8_t *mem_flags = chip8->mem_flags;
+    chip8_release(chip8);
+    chip8_fork(chip8, &cp->state);
+    chip8->mem_flags = mem_flags;
+    chip8->watch_hit = 0;
+}
+
+static void replay(const Chip8Rewind *rewind, Chip8 *chip8, int index, uint64_t target, uint8_t flags, uint64_t *hit){
+    /*
+    Restore checkpoint `index` and run forward to just before instruction
+    target, applying logged events. With flags set, the last instruction
+    in that range that started on a flagged PC or touched a watched byte
+    is stored in *hit.
+    */
+    const Checkpoint *cp = &rewind->checkpoints[index];
+    restore(chip8, cp);
+
+    size_t e = cp->events;
+
+    for (uint64_t n = cp->at; ; n++){
+        while (e < rewind->event_count && rewind->events[e].at == n){
+            if (rewind->events[e].kind == EVENT_KEYS){
+                chip8->keypad = rewind->events[e].value;
+            } else {
+                chip8_timer_tick(chip8);
+            }
+            e++;
+        }
+
+        if (n == target){
+            break;
+        }
+
+        if ((flags & CHIP8_BREAK) && chip8->mem_flags && (chip8->mem_flags[chip8->pc & (MEM_SIZE - 1)] & CHIP8_BREAK)){
+            *hit = n;
+        }
+
+        chip8_step(chip8);
+
+        if (chip8->watch_hit){
+            if (flags & chip8->watch_hit){
+                *hit = n;
+            }
+            chip8->watch_hit = 0;
+        }
+    }
+}
+
+static void truncate_after(Chip8Rewind *rewind, const Chip8 *chip8, uint64_t target){
+    //the recorded future no longer happens
+    while (rewind->checkpoint_count > 1 && rewind->checkpoints[rewind->checkpoint_count - 1].at > target){
+        chip8_release(&rewind->checkpoints[--rewind->checkpoint_count].state);
+    }
+    rewind->event_count = first_event_after(rewind, target);
+    rewind->count = target;
+    rewind->keys = chip8->keypad;
+}
+
+bool chip8_rewind_seek(Chip8Rewind *rewind, Chip8 *chip8, uint64_t target){
+    /*
+    Move chip8 back to the state just before instruction `target`.
+    Returns false if target is in the future.
+    */
+    if (target > rewind->count){
+        return false;
+    }
+
+    replay(rewind, chip8, checkpoint_before(rewind, target), target, 0, NULL);
+    truncate_after(rewind, chip8, target);
+    return true;
+}
+
+bool chip8_rewind_find_back(Chip8Rewind *rewind, Chip8 *chip8, uint8_t flags){
+    /*
+    Reverse continue: go back to just before the most recent instruction
+    that started on a CHIP8_BREAK PC or hit a CHIP8_WATCH_* byte, per
+    flags and chip8->mem_flags. Searches one checkpoint interval at a time,
+    newest first. Returns false, leaving chip8 as it was, if there is none.
+    */
+    if (!chip8->mem_flags || rewind->count == 0){
+        return false;
+    }
+
+    //the instruction about to run does not count
+    uint64_t end = rewind->count;
+    int index = checkpoint_before(rewind, end - 1);
+
+    for (;;){
+        uint64_t hit = UINT64_MAX;
+        replay(rewind, chip8, index, end, flags, &hit);
+
+        if (hit != UINT64_MAX){
+            replay(rewind, chip8, index, hit, 0, NULL);
+            truncate_after(rewind, chip8, hit);
+            return true;
+        }
+
+        if (index == 0){
+            break;
+        }
+        end = rewind->checkpoints[index].at;
+        index--;
+    }
+
+    //nothing found, put chip8 back where it was
+    replay(rewind, chip8, checkpoint_before(rewind, rewind->count), rewind->count, 0, NULL);
+    return false;
+}
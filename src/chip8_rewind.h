@@ -0,0 +1,40 @@
+#ifndef CHIP8_REWIND_H
+#define CHIP8_REWIND_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "chip8.h"
+
+// Execution history for reverse stepping.
+//
+// Every REWIND_INTERVAL instructions a full copy of the Chip8 is kept
+// (chip8_fork, so pages are shared with CHIP8_PAGED_MEMORY). Keypad changes
+// and timer ticks are logged against the instruction count. Going back to
+// instruction n restores the last checkpoint at or before n and re-executes
+// forward, replaying the log. Cxkk uses the per-instance RNG, which is part
+// of the checkpoint, so the re-execution is exact.
+//
+// Going back drops the history after the new position; running forward
+// again records a new future.
+//
+// Only the count and the checkpoints are needed while running, so a loop
+// with nothing to check between instructions calls chip8_rewind_checkpoint
+// and chip8_rewind_advance once per batch instead of chip8_rewind_record
+// before every step.
+
+#define REWIND_INTERVAL 1000 //instructions between checkpoints
+
+typedef struct Chip8Rewind Chip8Rewind;
+
+Chip8Rewind *chip8_rewind_create(const Chip8 *chip8);
+void chip8_rewind_destroy(Chip8Rewind *rewind);
+void chip8_rewind_record(Chip8Rewind *rewind, const Chip8 *chip8);
+unsigned chip8_rewind_checkpoint(Chip8Rewind *rewind, const Chip8 *chip8);
+void chip8_rewind_advance(Chip8Rewind *rewind, unsigned steps);
+void chip8_rewind_keys(Chip8Rewind *rewind, const Chip8 *chip8);
+void chip8_rewind_timer_tick(Chip8Rewind *rewind, Chip8 *chip8);
+uint64_t chip8_rewind_position(const Chip8Rewind *rewind);
+bool chip8_rewind_seek(Chip8Rewind *rewind, Chip8 *chip8, uint64_t target);
+bool chip8_rewind_find_back(Chip8Rewind *rewind, Chip8 *chip8, uint8_t flags);
+
+#endif
@@ -0,0 +1,236 @@
+#include "chip8_rollback.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+
+static uint64_t now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static const uint8_t *page_data(const Chip8 *chip8, int page){
+#if CHIP8_PAGED_MEMORY
+    return chip8->pages[page]->data;
+#else
+    return chip8->memory + page * MEM_PAGE_SIZE;
+#endif
+}
+
+static void page_restore(Chip8 *chip8, int page, const uint8_t *src){
+    //leave identical pages alone, with CHIP8_PAGED_MEMORY that keeps them shared
+    if (memcmp(page_data(chip8, page), src, MEM_PAGE_SIZE) == 0){
+        return;
+    }
+#if CHIP8_PAGED_MEMORY
+    if (__atomic_load_n(&chip8->pages[page]->refs, __ATOMIC_ACQUIRE) > 1 &&
+        !chip8_page_unshare(chip8, page)){
+        return;
+    }
+    memcpy(chip8->pages[page]->data, src, MEM_PAGE_SIZE);
+#else
+    memcpy(chip8->memory + page * MEM_PAGE_SIZE, src, MEM_PAGE_SIZE);
+#endif
+}
+
+size_t chip8_snapshot_save(Chip8Snapshot *snapshot, const Chip8 *chip8, const uint8_t *base){
+    /*
+    Save chip8 into snapshot, storing only memory pages that differ from
+    base (MEM_SIZE bytes). Returns the bytes written.
+    */
+    memcpy(snapshot->hot, chip8->hot, sizeof(snapshot->hot));
+    memcpy(snapshot->stack, chip8->stack, sizeof(snapshot->stack));
+
+    memcpy(snapshot->rpl, chip8->rpl, sizeof(snapshot->rpl));
+    memcpy(snapshot->audio_pattern, chip8->audio_pattern, sizeof(snapshot->audio_pattern));
+    snapshot->pitch = chip8->pitch;
+    if (chip8->hires){
+        for (int y = 0; y < DISP_HIRES_HEIGHT; y++){
+            snapshot->rows[2 * y] = (uint64_t)(chip8->display[y] >> 64);
+            snapshot->rows[2 * y + 1] = (uint64_t)chip8->display[y];
+        }
+    } else {
+        for (int y = 0; y < DISP_HEIGHT; y++){
+            snapshot->rows[y] = (uint64_t)(chip8->display[y] >> 64);
+        }
+    }
+
+    uint16_t dirty = 0;
+    int stored = 0;
+    for (int p = 0; p < MEM_PAGES; p++){
+        const uint8_t *data = page_data(chip8, p);
+        if (memcmp(data, base + p * MEM_PAGE_SIZE, MEM_PAGE_SIZE) != 0){
+            memcpy(snapshot->pages[stored++], data, MEM_PAGE_SIZE);
+            dirty |= (uint16_t)(1u << p);
+        }
+    }
+    snapshot->dirty = dirty;
+
+    size_t row_bytes = (chip8->hires ? DISP_HIRES_HEIGHT * 2 : DISP_HEIGHT) * sizeof(uint64_t);
+    return offsetof(Chip8Snapshot, rows) + row_bytes + sizeof(snapshot->dirty) + (size_t)stored * MEM_PAGE_SIZE;
+}
+
+void chip8_snapshot_load(Chip8 *chip8, const Chip8Snapshot *snapshot, const uint8_t *base){
+    /*
+    Restore a snapshot saved against the same base. Debugger state
+    (mem_flags, watchpoint hits) is left as it is.
+    */
+    memcpy(chip8->hot, snapshot->hot, sizeof(chip8->hot));
+    memcpy(chip8->stack, snapshot->stack, sizeof(chip8->stack));
+
+    memcpy(chip8->rpl, snapshot->rpl, sizeof(chip8->rpl));
+    memcpy(chip8->audio_pattern, snapshot->audio_pattern, sizeof(chip8->audio_pattern));
+    chip8->pitch = snapshot->pitch;
+    memset(chip8->display, 0, sizeof(chip8->display));
+    if (chip8->hires){
+        for (int y = 0; y < DISP_HIRES_HEIGHT; y++){
+            chip8->display[y] = (Chip8Row)snapshot->rows[2 * y] << 64 | snapshot->rows[2 * y + 1];
+        }
+    } else {
+        for (int y = 0; y < DISP_HEIGHT; y++){
+            chip8->display[y] = (Chip8Row)snapshot->rows[y] << 64;
+        }
+    }
+
+    int stored = 0;
+    for (int p = 0; p < MEM_PAGES; p++){
+        if (snapshot->dirty & (1u << p)){
+            page_restore(chip8, p, snapshot->pages[stored++]);
+        } else {
+            page_restore(chip8, p, base + p * MEM_PAGE_SIZE);
+        }
+    }
+}
+
+static RollbackInput *input_slot(Chip8Rollback *rollback, uint64_t frame){
+    RollbackInput *input = &rollback->inputs[frame % ROLLBACK_INPUTS];
+    if (input->frame != frame){
+        //slot last held frame - ROLLBACK_INPUTS, long out of the window
+        memset(input, 0, sizeof(*input));
+        input->frame = frame;
+    }
+    return input;
+}
+
+static uint16_t predict(Chip8Rollback *rollback, uint64_t frame){
+    //the remote player keeps holding what they held the frame before
+    return frame ? input_slot(rollback, frame - 1)->remote : 0;
+}
+
+static void save(Chip8Rollback *rollback, uint64_t frame){
+    Chip8Snapshot *snapshot = &rollback->snapshots[frame % ROLLBACK_FRAMES];
+    rollback->stats.snapshot_bytes += chip8_snapshot_save(snapshot, rollback->chip8, rollback->base);
+    rollback->stats.snapshots++;
+}
+
+static void run_frame(Chip8Rollback *rollback, uint64_t frame, const RollbackInput *input){
+    Chip8 *chip8 = rollback->chip8;
+    uint64_t cycles = (uint64_t)((double)(frame + 1) * rollback->cpu_hz / 60.0) -
+                      (uint64_t)((double)frame * rollback->cpu_hz / 60.0);
+
+    chip8->keypad = input->local | input->remote;
+    for (uint64_t i = 0; i < cycles && !chip8->vblank_wait; i++){
+        chip8_step(chip8);
+    }
+    chip8_timer_tick(chip8);
+}
+
+void chip8_rollback_init(Chip8Rollback *rollback, Chip8 *chip8, double cpu_hz){
+    /*
+    Start rolling back chip8 (ROM already loaded) from frame 0, running
+    cpu_hz / 60 instructions plus one timer tick per frame
+    */
+    memset(rollback, 0, sizeof(*rollback));
+    rollback->chip8 = chip8;
+    rollback->cpu_hz = cpu_hz;
+    for (int p = 0; p < MEM_PAGES; p++){
+        memcpy(rollback->base + p * MEM_PAGE_SIZE, page_data(chip8, p), MEM_PAGE_SIZE);
+    }
+    for (int i = 0; i < ROLLBACK_INPUTS; i++){
+        rollback->inputs[i].frame = UINT64_MAX;
+    }
+}
+
+bool chip8_rollback_remote(Chip8Rollback *rollback, uint64_t frame, uint16_t keys){
+    /*
+    Authoritative remote keys for a frame, past or future. A past frame that
+    was mispredicted is re-simulated by the next chip8_rollback_advance (or
+    chip8_rollback_sync). Returns false if the frame is more than
+    ROLLBACK_FRAMES away.
+    */
+    if (frame + ROLLBACK_FRAMES < rollback->frame || frame >= rollback->frame + ROLLBACK_FRAMES){
+        rollback->stats.rejected++;
+        return false;
+    }
+
+    RollbackInput *input = input_slot(rollback, frame);
+    if (frame < rollback->frame && input->remote != keys && frame < rollback->rollback_to){
+        rollback->rollback_to = frame;
+    }
+    input->remote = keys;
+    input->confirmed = true;
+    return true;
+}
+
+void chip8_rollback_sync(Chip8Rollback *rollback){
+    /*
+    Re-simulate from the earliest mispredicted frame up to the present, if
+    there is one
+    */
+    if (rollback->rollback_to >= rollback->frame){
+        return;
+    }
+
+    uint64_t t0 = now_ns();
+    uint64_t from = rollback->rollback_to;
+    chip8_snapshot_load(rollback->chip8, &rollback->snapshots[from % ROLLBACK_FRAMES], rollback->base);
+
+    for (uint64_t f = from; f < rollback->frame; f++){
+        RollbackInput *input = input_slot(rollback, f);
+        if (!input->confirmed){
+            input->remote = predict(rollback, f);
+        }
+        if (f != from){
+            save(rollback, f);
+        }
+        run_frame(rollback, f, input);
+    }
+    rollback->rollback_to = rollback->frame;
+
+    uint64_t depth = rollback->frame - from;
+    uint64_t elapsed = now_ns() - t0;
+    rollback->stats.rollbacks++;
+    rollback->stats.resimulated += depth;
+    if (depth > rollback->stats.max_depth){
+        rollback->stats.max_depth = (uint32_t)depth;
+    }
+    if (elapsed > rollback->stats.max_resim_ns){
+        rollback->stats.max_resim_ns = elapsed;
+    }
+}
+
+void chip8_rollback_advance(Chip8Rollback *rollback, uint16_t local_keys){
+    /*
+    One host frame: correct any misprediction, then run the next frame with
+    the local keys and the remote keys (confirmed if they already arrived,
+    predicted otherwise)
+    */
+    chip8_rollback_sync(rollback);
+
+    uint64_t frame = rollback->frame;
+    RollbackInput *input = input_slot(rollback, frame);
+    input->local = local_keys;
+    if (!input->confirmed){
+        input->remote = predict(rollback, frame);
+    }
+
+    save(rollback, frame);
+    run_frame(rollback, frame, input);
+
+    rollback->frame = frame + 1;
+    rollback->rollback_to = rollback->frame;
+    rollback->stats.frames++;
+}
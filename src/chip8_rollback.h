@@ -0,0 +1,75 @@
+#ifndef CHIP8_ROLLBACK_H
+#define CHIP8_ROLLBACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "chip8.h"
+
+// Rollback for a remote player's input.
+//
+// The keypad each frame is the local keys OR the remote keys. Local keys are
+// known when the frame runs; remote keys usually arrive a few frames late,
+// so until then the remote player is predicted to hold whatever they held
+// the frame before. Every frame starts with a snapshot. When authoritative
+// remote input for a past frame turns out to differ from the prediction,
+// the next chip8_rollback_advance restores that frame's snapshot and
+// re-simulates up to the present (with the stored local keys and fresh
+// predictions) before running the new frame, all in the same host frame.
+//
+// Snapshots are compact: the hot cache line, the stack, the rows of the
+// active resolution and only the 256-byte memory pages that differ from
+// the ROM image, typically ~600 bytes for a CHIP-8 ROM instead of a 5 KB
+// Chip8.
+
+#define ROLLBACK_FRAMES 16              //deepest rollback, in frames
+#define ROLLBACK_INPUTS (2 * ROLLBACK_FRAMES) //remote input window, past and future
+
+typedef struct Chip8Snapshot {
+    uint8_t hot[CHIP8_HOT_SIZE];
+    uint16_t stack[16];
+    uint8_t rpl[16];
+    uint8_t audio_pattern[16];
+    uint8_t pitch;
+    uint64_t rows[DISP_HIRES_HEIGHT * 2]; //low resolution: the high halves of 32 rows
+    uint16_t dirty;                     //bit p: page p differs from the base image
+    uint8_t pages[MEM_PAGES][MEM_PAGE_SIZE]; //dirty pages in order, first popcount(dirty) used
+} Chip8Snapshot;
+
+typedef struct RollbackInput {
+    uint64_t frame;                     //which frame this slot holds, slots are reused
+    uint16_t local;
+    uint16_t remote;                    //confirmed, or what was predicted
+    bool confirmed;
+} RollbackInput;
+
+typedef struct Chip8RollbackStats {
+    uint64_t frames;                    //frames advanced
+    uint64_t rollbacks;                 //mispredictions corrected
+    uint64_t resimulated;               //frames re-run by those
+    uint64_t rejected;                  //remote inputs outside the window
+    uint32_t max_depth;                 //deepest rollback
+    uint64_t max_resim_ns;              //slowest re-simulation
+    uint64_t snapshot_bytes;            //bytes saved over all snapshots
+    uint64_t snapshots;
+} Chip8RollbackStats;
+
+typedef struct Chip8Rollback {
+    Chip8 *chip8;
+    uint8_t base[MEM_SIZE];             //memory when the rollback started
+    double cpu_hz;
+    uint64_t frame;                     //next frame to run
+    uint64_t rollback_to;               //earliest mispredicted frame, frame if none
+    Chip8Snapshot snapshots[ROLLBACK_FRAMES]; //state at the start of frame f in [f % ROLLBACK_FRAMES]
+    RollbackInput inputs[ROLLBACK_INPUTS];
+    Chip8RollbackStats stats;
+} Chip8Rollback;
+
+void chip8_rollback_init(Chip8Rollback *rollback, Chip8 *chip8, double cpu_hz);
+bool chip8_rollback_remote(Chip8Rollback *rollback, uint64_t frame, uint16_t keys);
+void chip8_rollback_sync(Chip8Rollback *rollback);
+void chip8_rollback_advance(Chip8Rollback *rollback, uint16_t local_keys);
+size_t chip8_snapshot_save(Chip8Snapshot *snapshot, const Chip8 *chip8, const uint8_t *base);
+void chip8_snapshot_load(Chip8 *chip8, const Chip8Snapshot *snapshot, const uint8_t *base);
+
+#endif
@@ -0,0 +1,259 @@
+#include "chip8_romindex.h"
+#include "chip8_romlib.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char *const chip8_romindex_op_names[ROM_OP_COUNT] = {
+    "00E0", "00EE", "0nnn", "1nnn", "2nnn", "3xkk", "4xkk", "5xy0",
+    "6xkk", "7xkk", "8xy0", "8xy1", "8xy2", "8xy3", "8xy4", "8xy5",
+    "8xy6", "8xy7", "8xyE", "9xy0", "Annn", "Bnnn", "Cxkk", "Dxyn",
+    "Ex9E", "ExA1", "Fx07", "Fx0A", "Fx15", "Fx18", "Fx1E", "Fx29",
+    "Fx33", "Fx55", "Fx65",
+    "00Cn", "00FB", "00FC", "00FD", "00FE", "00FF", "Dxy0", "Fx30",
+    "Fx75", "Fx85",
+    "F002", "Fx3A",
+    "skipped",
+};
+
+
+int chip8_romindex_op(uint16_t opcode){
+    /*
+    ROM_OP_* for an opcode, decoded the way chip8_step decodes it
+    */
+    switch (opcode & 0xF000){
+    case 0x0000:
+        if (opcode == 0x00E0) return ROM_OP_00E0;
+        if (opcode == 0x00EE) return ROM_OP_00EE;
+        if ((opcode & 0xFFF0) == 0x00C0) return ROM_OP_00Cn;
+        if (opcode >= 0x00FB && opcode <= 0x00FF) return ROM_OP_00FB + (opcode - 0x00FB);
+        return ROM_OP_0nnn;
+    case 0x1000: return ROM_OP_1nnn;
+    case 0x2000: return ROM_OP_2nnn;
+    case 0x3000: return ROM_OP_3xkk;
+    case 0x4000: return ROM_OP_4xkk;
+    case 0x5000: return ROM_OP_5xy0;
+    case 0x6000: return ROM_OP_6xkk;
+    case 0x7000: return ROM_OP_7xkk;
+    case 0x8000:
+        if ((opcode & 0xF) <= 0x7) return ROM_OP_8xy0 + (opcode & 0xF);
+        if ((opcode & 0xF) == 0xE) return ROM_OP_8xyE;
+        return ROM_OP_SKIPPED;
+    case 0x9000: return ROM_OP_9xy0;
+    case 0xA000: return ROM_OP_Annn;
+    case 0xB000: return ROM_OP_Bnnn;
+    case 0xC000: return ROM_OP_Cxkk;
+    case 0xD000: return (opcode & 0xF) ? ROM_OP_Dxyn : ROM_OP_Dxy0;
+    case 0xE000:
+        if ((opcode & 0xFF) == 0x9E) return ROM_OP_Ex9E;
+        if ((opcode & 0xFF) == 0xA1) return ROM_OP_ExA1;
+        return ROM_OP_SKIPPED;
+    default:
+        switch (opcode & 0xF0FF){
+        case 0xF002: return ROM_OP_F002;
+        case 0xF007: return ROM_OP_Fx07;
+        case 0xF00A: return ROM_OP_Fx0A;
+        case 0xF015: return ROM_OP_Fx15;
+        case 0xF018: return ROM_OP_Fx18;
+        case 0xF01E: return ROM_OP_Fx1E;
+        case 0xF029: return ROM_OP_Fx29;
+        case 0xF030: return ROM_OP_Fx30;
+        case 0xF033: return ROM_OP_Fx33;
+        case 0xF03A: return ROM_OP_Fx3A;
+        case 0xF055: return ROM_OP_Fx55;
+        case 0xF065: return ROM_OP_Fx65;
+        case 0xF075: return ROM_OP_Fx75;
+        case 0xF085: return ROM_OP_Fx85;
+        default: return ROM_OP_SKIPPED;
+        }
+    }
+}
+
+uint32_t chip8_romindex_quirks(uint64_t opcodes){
+    /*
+    Likely ROM_QUIRK_* profile: that of the platform the instructions point
+    to (XO-CHIP, SUPER-CHIP 1.1, else the COSMAC VIP), keeping only quirks
+    of instructions the ROM uses
+    */
+    uint32_t quirks;
+    if (opcodes & ROM_OPS_XOCHIP){
+        quirks = ROM_QUIRK_MEMORY;
+    } else if (opcodes & ROM_OPS_SCHIP){
+        quirks = ROM_QUIRK_SHIFT | ROM_QUIRK_JUMP | ROM_QUIRK_CLIP;
+    } else {
+        quirks = ROM_QUIRK_VF_RESET | ROM_QUIRK_MEMORY | ROM_QUIRK_DISPLAY_WAIT | ROM_QUIRK_CLIP;
+    }
+
+    uint32_t used = 0;
+    if (opcodes & (ROM_OP_BIT(ROM_OP_8xy1) | ROM_OP_BIT(ROM_OP_8xy2) | ROM_OP_BIT(ROM_OP_8xy3))){
+        used |= ROM_QUIRK_VF_RESET;
+    }
+    if (opcodes & (ROM_OP_BIT(ROM_OP_Fx55) | ROM_OP_BIT(ROM_OP_Fx65))){
+        used |= ROM_QUIRK_MEMORY;
+    }
+    if (opcodes & (ROM_OP_BIT(ROM_OP_8xy6) | ROM_OP_BIT(ROM_OP_8xyE))){
+        used |= ROM_QUIRK_SHIFT;
+    }
+    if (opcodes & ROM_OP_BIT(ROM_OP_Bnnn)){
+        used |= ROM_QUIRK_JUMP;
+    }
+    if (opcodes & (ROM_OP_BIT(ROM_OP_Dxyn) | ROM_OP_BIT(ROM_OP_Dxy0))){
+        used |= ROM_QUIRK_DISPLAY_WAIT | ROM_QUIRK_CLIP;
+    }
+    return quirks & used;
+}
+
+static int check_index(const Chip8RomIndex *index){
+    //exact size and sorted, everything find relies on
+    RomIndexHeader header;
+    if (index->size < sizeof(header)){
+        return CHIP8_ERR_FORMAT;
+    }
+    memcpy(&header, index->base, sizeof(header));
+    if (memcmp(header.magic, ROMINDEX_MAGIC, sizeof(header.magic)) != 0 || header.version != ROMINDEX_VERSION ||
+        header.count != (index->size - sizeof(header)) / sizeof(Chip8RomAnalysis) ||
+        (index->size - sizeof(header)) % sizeof(Chip8RomAnalysis) != 0){
+        return CHIP8_ERR_FORMAT;
+    }
+
+    const Chip8RomAnalysis *entries = (const Chip8RomAnalysis *)(index->base + sizeof(header));
+    for (uint32_t i = 0; i < header.count; i++){
+        if ((i && entries[i - 1].hash >= entries[i].hash) ||
+            entries[i].code_count > ROMINDEX_RANGES || entries[i].sprite_count > ROMINDEX_RANGES){
+            return CHIP8_ERR_FORMAT;
+        }
+    }
+    return CHIP8_OK;
+}
+
+int chip8_romindex_open(Chip8RomIndex *index, const char *path){
+    /*
+    Map an index file read-only. Returns CHIP8_OK or a Chip8Error; index is
+    only valid on CHIP8_OK.
+    */
+    memset(index, 0, sizeof(*index));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0){
+        perror("chip8_romindex_open: open");
+        return CHIP8_ERR_IO;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(RomIndexHeader)){
+        close(fd);
+        fprintf(stderr, "chip8_romindex_open: %s is not a ROM index\n", path);
+        return CHIP8_ERR_FORMAT;
+    }
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED){
+        perror("chip8_romindex_open: mmap");
+        return CHIP8_ERR_IO;
+    }
+
+    index->base = p;
+    index->size = (size_t)st.st_size;
+    int err = check_index(index);
+    if (err != CHIP8_OK){
+        fprintf(stderr, "chip8_romindex_open: %s is not a version %d ROM index\n", path, ROMINDEX_VERSION);
+        chip8_romindex_close(index);
+        return err;
+    }
+    index->count = ((const RomIndexHeader *)index->base)->count;
+    index->entries = (const Chip8RomAnalysis *)(index->base + sizeof(RomIndexHeader));
+    return CHIP8_OK;
+}
+
+void chip8_romindex_close(Chip8RomIndex *index){
+    if (index->base){
+        munmap(index->base, index->size);
+    }
+    memset(index, 0, sizeof(*index));
+}
+
+int chip8_romindex_write(const char *path, const Chip8RomAnalysis *entries, uint32_t count){
+    /*
+    Save `count` records, sorted by hash without duplicates (the order of
+    a Chip8RomLib index), to <path>.tmp and rename it
+    */
+    char tmp[4096];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)){
+        return CHIP8_ERR_IO;
+    }
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp){
+        perror("chip8_romindex_write: fopen");
+        return CHIP8_ERR_IO;
+    }
+    RomIndexHeader header = { .version = ROMINDEX_VERSION, .count = count };
+    memcpy(header.magic, ROMINDEX_MAGIC, sizeof(header.magic));
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    ok = ok && fwrite(entries, sizeof(*entries), count, fp) == count;
+    ok = fclose(fp) == 0 && ok;
+    if (!ok || rename(tmp, path) != 0){
+        perror("chip8_romindex_write");
+        unlink(tmp);
+        return CHIP8_ERR_IO;
+    }
+    return CHIP8_OK;
+}
+
+const Chip8RomAnalysis *chip8_romindex_find(const Chip8RomIndex *index, uint64_t hash){
+    //binary search of the sorted records
+    uint32_t lo = 0;
+    uint32_t hi = index->count;
+    while (lo < hi){
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (index->entries[mid].hash < hash){
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < index->count && index->entries[lo].hash == hash ? &index->entries[lo] : NULL;
+}
+
+void chip8_romindex_describe(const Chip8RomAnalysis *rom, char *buf, size_t size){
+    /*
+    One line for people: code, sprites, platform, hazards and quirks
+    */
+    int sprite_bytes = 0;
+    for (int i = 0; i < rom->sprite_count; i++){
+        sprite_bytes += rom->sprites[i].end - rom->sprites[i].start;
+    }
+    char quirks[128];
+    chip8_romlib_quirk_names(rom->quirks, quirks, sizeof(quirks));
+
+    size_t used = (size_t)snprintf(buf, size, "%u instructions, code 0x%03X-0x%03X in %u range%s, %d sprite bytes, %s",
+                                   rom->instructions, rom->code_count ? rom->code[0].start : 0,
+                                   rom->code_count ? rom->code[rom->code_count - 1].end - 1 : 0,
+                                   rom->code_count, rom->code_count == 1 ? "" : "s", sprite_bytes,
+                                   rom->features & ROM_FEAT_XOCHIP ? "XO-CHIP" :
+                                   rom->features & ROM_FEAT_SCHIP ? "SUPER-CHIP" : "CHIP-8");
+    static const struct {
+        uint32_t bit;
+        const char *text;
+    } notes[] = {
+        { ROM_FEAT_UNKNOWN, "unknown opcodes" },
+        { ROM_FEAT_INDIRECT, "Bnnn" },
+        { ROM_FEAT_SMC, "writes code" },
+        { ROM_FEAT_SMC_POSSIBLE, "may write code" },
+    };
+    for (size_t i = 0; i < sizeof(notes) / sizeof(notes[0]); i++){
+        //"writes code" implies the weaker note, show only the first
+        bool shown = (rom->features & notes[i].bit) &&
+                     !(notes[i].bit == ROM_FEAT_SMC_POSSIBLE && (rom->features & ROM_FEAT_SMC));
+        if (shown && used < size){
+            used += (size_t)snprintf(buf + used, size - used, ", %s", notes[i].text);
+        }
+    }
+    if (used < size){
+        snprintf(buf + used, size - used, ", quirks %s", quirks[0] ? quirks : "none");
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef CHIP8_ROMINDEX_H
+#define CHIP8_ROMINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "chip8.h"
+
+// ROM index: what static analysis knows about each ROM, looked up by hash.
+//
+// tools/chip8_romindex.c walks every ROM of a library (a directory or a
+// pack, see chip8_romlib.h) with chip8_disasm_analyze, on all cores, and
+// writes one Chip8RomAnalysis per ROM. An index file is a RomIndexHeader
+// then `count` 128-byte records sorted by chip8_rom_hash, so readers map it
+// and binary search it without parsing anything.
+//
+// A record holds the reachable code ranges, the instruction forms used, the
+// likely sprite data (Annn targets that are not code, as far as the tallest
+// Dxyn reachable), whether stores (Fx33/Fx55) can reach code and the quirk
+// profile of the platform the instructions point to. Anything past a Bnnn
+// is beyond the static walk, ROM_FEAT_INDIRECT says when that matters.
+
+#define ROMINDEX_MAGIC "C8IX"
+#define ROMINDEX_VERSION 1
+#define ROMINDEX_RANGES 12
+
+// Instruction forms, bit n of Chip8RomAnalysis.opcodes
+enum {
+    ROM_OP_00E0, ROM_OP_00EE, ROM_OP_0nnn, ROM_OP_1nnn, ROM_OP_2nnn, ROM_OP_3xkk, ROM_OP_4xkk, ROM_OP_5xy0,
+    ROM_OP_6xkk, ROM_OP_7xkk, ROM_OP_8xy0, ROM_OP_8xy1, ROM_OP_8xy2, ROM_OP_8xy3, ROM_OP_8xy4, ROM_OP_8xy5,
+    ROM_OP_8xy6, ROM_OP_8xy7, ROM_OP_8xyE, ROM_OP_9xy0, ROM_OP_Annn, ROM_OP_Bnnn, ROM_OP_Cxkk, ROM_OP_Dxyn,
+    ROM_OP_Ex9E, ROM_OP_ExA1, ROM_OP_Fx07, ROM_OP_Fx0A, ROM_OP_Fx15, ROM_OP_Fx18, ROM_OP_Fx1E, ROM_OP_Fx29,
+    ROM_OP_Fx33, ROM_OP_Fx55, ROM_OP_Fx65,
+    // SUPER-CHIP
+    ROM_OP_00Cn, ROM_OP_00FB, ROM_OP_00FC, ROM_OP_00FD, ROM_OP_00FE, ROM_OP_00FF, ROM_OP_Dxy0, ROM_OP_Fx30,
+    ROM_OP_Fx75, ROM_OP_Fx85,
+    // XO-CHIP
+    ROM_OP_F002, ROM_OP_Fx3A,
+    // Sub-opcodes chip8_step skips
+    ROM_OP_SKIPPED,
+    ROM_OP_COUNT
+};
+
+#define ROM_OP_BIT(op) (1ull << (op))
+#define ROM_OPS_SCHIP (((ROM_OP_BIT(ROM_OP_Fx85) << 1) - 1) & ~(ROM_OP_BIT(ROM_OP_00Cn) - 1))
+#define ROM_OPS_XOCHIP (ROM_OP_BIT(ROM_OP_F002) | ROM_OP_BIT(ROM_OP_Fx3A))
+#define ROM_OPS_UNKNOWN (ROM_OP_BIT(ROM_OP_0nnn) | ROM_OP_BIT(ROM_OP_SKIPPED))
+
+// Chip8RomAnalysis.features
+#define ROM_FEAT_SCHIP        0x01  //SUPER-CHIP instructions reachable
+#define ROM_FEAT_XOCHIP       0x02
+#define ROM_FEAT_UNKNOWN      0x04  //0nnn (chip8_step faults) or sub-opcodes chip8_step skips
+#define ROM_FEAT_INDIRECT     0x08  //Bnnn: code past the static walk is possible
+#define ROM_FEAT_WRITES       0x10  //Fx33/Fx55 reachable
+#define ROM_FEAT_SMC          0x20  //a store reaches code through an Annn target (from its block, else any)
+#define ROM_FEAT_SMC_POSSIBLE 0x40  //ROM_FEAT_SMC, or stores through an I the walk cannot follow (Fx1E, Bnnn)
+#define ROM_FEAT_MERGED       0x80  //more ranges than ROMINDEX_RANGES, the last one covers the rest
+
+typedef struct RomIndexHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+} RomIndexHeader;
+
+typedef struct Chip8RomRange {
+    uint16_t start;
+    uint16_t end;                   //one past the last byte
+} Chip8RomRange;
+
+typedef struct Chip8RomAnalysis {
+    uint64_t hash;                  //chip8_rom_hash of the ROM bytes
+    uint64_t opcodes;               //ROM_OP_BIT of every reachable form
+    uint32_t features;              //ROM_FEAT_*
+    uint32_t quirks;                //likely ROM_QUIRK_* profile
+    uint16_t length;
+    uint16_t code_bytes;
+    uint16_t instructions;
+    uint8_t code_count;
+    uint8_t sprite_count;
+    Chip8RomRange code[ROMINDEX_RANGES];
+    Chip8RomRange sprites[ROMINDEX_RANGES];
+} Chip8RomAnalysis;
+
+_Static_assert(sizeof(Chip8RomAnalysis) == 128, "Chip8RomAnalysis is two cache lines");
+
+typedef struct Chip8RomIndex {
+    uint8_t *base;                  //mapped index file
+    size_t size;
+    uint32_t count;
+    const Chip8RomAnalysis *entries; //sorted by hash
+} Chip8RomIndex;
+
+extern const char *const chip8_romindex_op_names[ROM_OP_COUNT];
+
+int chip8_romindex_op(uint16_t opcode);
+uint32_t chip8_romindex_quirks(uint64_t opcodes);
+int chip8_romindex_open(Chip8RomIndex *index, const char *path);
+void chip8_romindex_close(Chip8RomIndex *index);
+int chip8_romindex_write(const char *path, const Chip8RomAnalysis *entries, uint32_t count);
+const Chip8RomAnalysis *chip8_romindex_find(const Chip8RomIndex *index, uint64_t hash);
+void chip8_romindex_describe(const Chip8RomAnalysis *rom, char *buf, size_t size);
+
+#endif
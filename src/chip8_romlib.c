@@ -0,0 +1,414 @@
+#include "chip8_romlib.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FNV_OFFSET 0xCBF29CE484222325ull
+#define FNV_PRIME 0x100000001B3ull
+#define ROM_MAX (MEM_SIZE - 0x200)
+
+typedef struct {
+    Chip8RomInfo info;
+    uint8_t *data;
+} RomEntry;
+
+static const struct {
+    const char *name;
+    uint32_t bit;
+} quirk_names[] = {
+    { "vf-reset", ROM_QUIRK_VF_RESET },
+    { "memory", ROM_QUIRK_MEMORY },
+    { "shift", ROM_QUIRK_SHIFT },
+    { "jump", ROM_QUIRK_JUMP },
+    { "display-wait", ROM_QUIRK_DISPLAY_WAIT },
+    { "clip", ROM_QUIRK_CLIP },
+};
+
+
+uint64_t chip8_rom_hash(const uint8_t *rom, size_t len){
+    //FNV-1a, same as the movie hashes
+    uint64_t h = FNV_OFFSET;
+    for (size_t i = 0; i < len; i++){
+        h = (h ^ rom[i]) * FNV_PRIME;
+    }
+    return h;
+}
+
+int chip8_rom_hash_file(const char *path, uint64_t *hash){
+    //chip8_rom_hash of a ROM file, for lookups by callers that loaded it with load_rom
+    uint8_t data[ROM_MAX];
+    FILE *fp = fopen(path, "rb");
+    if (!fp){
+        perror("chip8_rom_hash_file: fopen");
+        return CHIP8_ERR_IO;
+    }
+    size_t len = fread(data, 1, sizeof(data), fp);
+    bool failed = ferror(fp);
+    fclose(fp);
+    if (failed){
+        perror("chip8_rom_hash_file: fread");
+        return CHIP8_ERR_IO;
+    }
+    *hash = chip8_rom_hash(data, len);
+    return CHIP8_OK;
+}
+
+uint32_t chip8_romlib_parse_quirks(const char *list){
+    //comma separated quirk names, unknown ones are reported and ignored
+    uint32_t quirks = 0;
+    while (*list){
+        size_t len = strcspn(list, ",");
+        bool known = false;
+        for (size_t i = 0; i < sizeof(quirk_names) / sizeof(quirk_names[0]); i++){
+            if (strlen(quirk_names[i].name) == len && strncmp(list, quirk_names[i].name, len) == 0){
+                quirks |= quirk_names[i].bit;
+                known = true;
+            }
+        }
+        if (!known && len){
+            fprintf(stderr, "chip8_romlib: unknown quirk '%.*s'\n", (int)len, list);
+        }
+        list += len + (list[len] == ',');
+    }
+    return quirks;
+}
+
+void chip8_romlib_quirk_names(uint32_t quirks, char *buf, size_t size){
+    size_t used = 0;
+    buf[0] = '\0';
+    for (size_t i = 0; i < sizeof(quirk_names) / sizeof(quirk_names[0]); i++){
+        if ((quirks & quirk_names[i].bit) && used < size){
+            used += (size_t)snprintf(buf + used, size - used, "%s%s", used ? "," : "", quirk_names[i].name);
+        }
+    }
+}
+
+static int compare_entries(const void *a, const void *b){
+    const Chip8RomInfo *x = &((const RomEntry *)a)->info;
+    const Chip8RomInfo *y = &((const RomEntry *)b)->info;
+    if (x->hash != y->hash){
+        return x->hash < y->hash ? -1 : 1;
+    }
+    return strcmp(x->name, y->name);
+}
+
+static void read_meta(const char *dir, RomEntry *entries, int count){
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", dir, ROMLIB_META);
+    FILE *fp = fopen(path, "r");
+    if (!fp){
+        return; //optional
+    }
+
+    char line[512];
+    int line_no = 0;
+    while (fgets(line, sizeof(line), fp)){
+        line_no++;
+        char *save;
+        char *name = strtok_r(line, " \t\r\n", &save);
+        if (!name || name[0] == '#'){
+            continue;
+        }
+        RomEntry *entry = NULL;
+        for (int i = 0; i < count; i++){
+            if (strcmp(entries[i].info.name, name) == 0){
+                entry = &entries[i];
+            }
+        }
+        if (!entry){
+            fprintf(stderr, "chip8_romlib: %s:%d: no ROM named %s\n", path, line_no, name);
+            continue;
+        }
+        for (char *field; (field = strtok_r(NULL, " \t\r\n", &save)); ){
+            if (strncmp(field, "cpu=", 4) == 0){
+                entry->info.cpu_hz = (uint16_t)atoi(field + 4);
+            } else if (strncmp(field, "quirks=", 7) == 0){
+                entry->info.quirks = chip8_romlib_parse_quirks(field + 7);
+            } else {
+                fprintf(stderr, "chip8_romlib: %s:%d: unknown setting %s\n", path, line_no, field);
+            }
+        }
+    }
+    fclose(fp);
+}
+
+static int scan_dir(const char *dir, RomEntry **out, int *out_count){
+    DIR *d = opendir(dir);
+    if (!d){
+        perror("chip8_romlib: opendir");
+        return CHIP8_ERR_IO;
+    }
+
+    RomEntry *entries = NULL;
+    int count = 0;
+    int cap = 0;
+    int err = CHIP8_OK;
+    struct dirent *de;
+    while ((de = readdir(d))){
+        if (de->d_name[0] == '.' || strcmp(de->d_name, ROMLIB_META) == 0){
+            continue;
+        }
+        if (strlen(de->d_name) >= ROMLIB_NAME_LEN){
+            fprintf(stderr, "chip8_romlib: skipping %s, name too long\n", de->d_name);
+            continue;
+        }
+
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+        struct stat st;
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)){
+            continue;
+        }
+        if (st.st_size > ROM_MAX){
+            fprintf(stderr, "chip8_romlib: skipping %s, too large for a ROM\n", de->d_name);
+            continue;
+        }
+
+        if (count == cap){
+            cap = cap ? cap * 2 : 64;
+            RomEntry *grown = realloc(entries, sizeof(*grown) * (size_t)cap);
+            if (!grown){
+                err = CHIP8_ERR_NOMEM;
+                break;
+            }
+            entries = grown;
+        }
+        RomEntry *entry = &entries[count];
+        memset(entry, 0, sizeof(*entry));
+        entry->data = malloc(ROM_MAX);
+        if (!entry->data){
+            err = CHIP8_ERR_NOMEM;
+            break;
+        }
+        FILE *fp = fopen(path, "rb");
+        size_t len = fp ? fread(entry->data, 1, ROM_MAX, fp) : 0;
+        if (!fp || ferror(fp)){
+            perror("chip8_romlib: read");
+            if (fp){
+                fclose(fp);
+            }
+            free(entry->data);
+            continue;
+        }
+        fclose(fp);
+
+        entry->info.length = (uint16_t)len;
+        entry->info.hash = chip8_rom_hash(entry->data, len);
+        memcpy(entry->info.name, de->d_name, strlen(de->d_name) + 1); //length checked above
+        count++;
+    }
+    closedir(d);
+
+    if (err != CHIP8_OK){
+        for (int i = 0; i < count; i++){
+            free(entries[i].data);
+        }
+        free(entries);
+        return err;
+    }
+
+    read_meta(dir, entries, count);
+    *out = entries;
+    *out_count = count;
+    return CHIP8_OK;
+}
+
+static int build_from_dir(Chip8RomLib *lib, const char *dir){
+    RomEntry *entries;
+    int count;
+    int err = scan_dir(dir, &entries, &count);
+    if (err != CHIP8_OK){
+        return err;
+    }
+
+    //sorted by hash, duplicates keep the alphabetically first name
+    qsort(entries, (size_t)count, sizeof(*entries), compare_entries);
+    int unique = 0;
+    size_t data_size = 0;
+    for (int i = 0; i < count; i++){
+        if (unique && entries[unique - 1].info.hash == entries[i].info.hash){
+            fprintf(stderr, "chip8_romlib: %s is the same ROM as %s\n", entries[i].info.name, entries[unique - 1].info.name);
+            free(entries[i].data);
+            continue;
+        }
+        data_size += entries[i].info.length;
+        entries[unique++] = entries[i];
+    }
+
+    size_t index_end = sizeof(RomLibHeader) + sizeof(Chip8RomInfo) * (size_t)unique;
+    uint8_t *base = malloc(index_end + data_size);
+    if (!base){
+        for (int i = 0; i < unique; i++){
+            free(entries[i].data);
+        }
+        free(entries);
+        return CHIP8_ERR_NOMEM;
+    }
+
+    RomLibHeader header = { .version = ROMLIB_VERSION, .count = (uint32_t)unique };
+    memcpy(header.magic, ROMLIB_MAGIC, sizeof(header.magic));
+    memcpy(base, &header, sizeof(header));
+
+    Chip8RomInfo *index = (Chip8RomInfo *)(base + sizeof(RomLibHeader));
+    size_t offset = index_end;
+    for (int i = 0; i < unique; i++){
+        index[i] = entries[i].info;
+        index[i].offset = (uint32_t)offset;
+        memcpy(base + offset, entries[i].data, entries[i].info.length);
+        offset += entries[i].info.length;
+        free(entries[i].data);
+    }
+    free(entries);
+
+    lib->base = base;
+    lib->size = offset;
+    lib->mapped = false;
+    lib->count = (uint32_t)unique;
+    lib->index = index;
+    return CHIP8_OK;
+}
+
+static int check_pack(const Chip8RomLib *lib){
+    //everything find/load rely on: sizes, offsets in range, index sorted
+    RomLibHeader header;
+    if (lib->size < sizeof(header)){
+        return CHIP8_ERR_FORMAT;
+    }
+    memcpy(&header, lib->base, sizeof(header));
+    if (memcmp(header.magic, ROMLIB_MAGIC, sizeof(header.magic)) != 0 || header.version != ROMLIB_VERSION ||
+        header.count > (lib->size - sizeof(header)) / sizeof(Chip8RomInfo)){
+        return CHIP8_ERR_FORMAT;
+    }
+
+    const Chip8RomInfo *index = (const Chip8RomInfo *)(lib->base + sizeof(header));
+    for (uint32_t i = 0; i < header.count; i++){
+        if (index[i].length > ROM_MAX || (size_t)index[i].offset + index[i].length > lib->size ||
+            (i && index[i - 1].hash >= index[i].hash) || memchr(index[i].name, '\0', ROMLIB_NAME_LEN) == NULL){
+            return CHIP8_ERR_FORMAT;
+        }
+    }
+    return CHIP8_OK;
+}
+
+int chip8_romlib_open(Chip8RomLib *lib, const char *path){
+    /*
+    Open a pack file (mapped read-only) or a directory of ROMs (read into
+    memory). Returns CHIP8_OK or a Chip8Error; lib is only valid on
+    CHIP8_OK.
+    */
+    memset(lib, 0, sizeof(*lib));
+
+    struct stat st;
+    if (stat(path, &st) != 0){
+        perror("chip8_romlib_open: stat");
+        return CHIP8_ERR_IO;
+    }
+    if (S_ISDIR(st.st_mode)){
+        return build_from_dir(lib, path);
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0){
+        perror("chip8_romlib_open: open");
+        return CHIP8_ERR_IO;
+    }
+    if (st.st_size < (off_t)sizeof(RomLibHeader)){
+        close(fd);
+        fprintf(stderr, "chip8_romlib_open: %s is not a ROM pack\n", path);
+        return CHIP8_ERR_FORMAT;
+    }
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED){
+        perror("chip8_romlib_open: mmap");
+        return CHIP8_ERR_IO;
+    }
+    //small and read soon after, fault it in now rather than per ROM
+    madvise(p, (size_t)st.st_size, MADV_WILLNEED);
+
+    lib->base = p;
+    lib->size = (size_t)st.st_size;
+    lib->mapped = true;
+    int err = check_pack(lib);
+    if (err != CHIP8_OK){
+        fprintf(stderr, "chip8_romlib_open: %s is not a version %d ROM pack\n", path, ROMLIB_VERSION);
+        chip8_romlib_close(lib);
+        return err;
+    }
+    lib->count = ((const RomLibHeader *)lib->base)->count;
+    lib->index = (const Chip8RomInfo *)(lib->base + sizeof(RomLibHeader));
+    return CHIP8_OK;
+}
+
+void chip8_romlib_close(Chip8RomLib *lib){
+    if (lib->mapped){
+        munmap(lib->base, lib->size);
+    } else {
+        free(lib->base);
+    }
+    memset(lib, 0, sizeof(*lib));
+}
+
+int chip8_romlib_write(const Chip8RomLib *lib, const char *path){
+    /*
+    Save a library as a pack file, written to a temporary name and renamed
+    so readers never map a half-written pack
+    */
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp){
+        perror("chip8_romlib_write: fopen");
+        return CHIP8_ERR_IO;
+    }
+    bool ok = fwrite(lib->base, 1, lib->size, fp) == lib->size;
+    ok = fclose(fp) == 0 && ok;
+    if (!ok || rename(tmp, path) != 0){
+        perror("chip8_romlib_write");
+        unlink(tmp);
+        return CHIP8_ERR_IO;
+    }
+    return CHIP8_OK;
+}
+
+const Chip8RomInfo *chip8_romlib_find(const Chip8RomLib *lib, uint64_t hash){
+    //binary search of the sorted index
+    uint32_t lo = 0;
+    uint32_t hi = lib->count;
+    while (lo < hi){
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (lib->index[mid].hash < hash){
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < lib->count && lib->index[lo].hash == hash ? &lib->index[lo] : NULL;
+}
+
+const Chip8RomInfo *chip8_romlib_find_name(const Chip8RomLib *lib, const char *name){
+    for (uint32_t i = 0; i < lib->count; i++){
+        if (strcmp(lib->index[i].name, name) == 0){
+            return &lib->index[i];
+        }
+    }
+    return NULL;
+}
+
+int chip8_romlib_load(const Chip8RomLib *lib, const Chip8RomInfo *rom, Chip8 *chip8){
+    /*
+    Copy a library ROM to 0x200 of a reset Chip8
+    */
+    if (!rom){
+        return CHIP8_ERR_NOT_FOUND;
+    }
+    return chip8_load(chip8, chip8_romlib_data(lib, rom), rom->length);
+}
@@ -0,0 +1,79 @@
+#ifndef CHIP8_ROMLIB_H
+#define CHIP8_ROMLIB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "chip8.h"
+
+// ROM library: many ROMs in one read-only mapping, indexed by content hash.
+//
+// A pack file is a RomLibHeader, then `count` Chip8RomInfo entries sorted by
+// hash, then the ROM bytes. chip8_romlib_open maps a pack, or reads a
+// directory of ROMs into the same layout in memory (chip8_romlib_write then
+// saves it as a pack). Loading a ROM into a Chip8 is one chip8_load from
+// the mapping, so starting thousands of instances does no file I/O.
+//
+// In a directory, an optional library.txt gives per-ROM metadata, one ROM
+// per line:
+//
+//     # name        settings
+//     PONG          cpu=500 quirks=vf-reset,shift
+//
+// Identical ROMs under several names are indexed once, under the first name.
+
+#define ROMLIB_MAGIC "C8RL"
+#define ROMLIB_VERSION 1
+#define ROMLIB_META "library.txt"
+#define ROMLIB_NAME_LEN 44
+
+// Recommended quirk profile, Chip8RomInfo.quirks
+#define ROM_QUIRK_VF_RESET     0x01 //8xy1/8xy2/8xy3 clear VF
+#define ROM_QUIRK_MEMORY       0x02 //Fx55/Fx65 advance I
+#define ROM_QUIRK_SHIFT        0x04 //8xy6/8xyE shift Vx in place
+#define ROM_QUIRK_JUMP         0x08 //Bnnn jumps to xnn + Vx
+#define ROM_QUIRK_DISPLAY_WAIT CHIP8_QUIRK_DISPLAY_WAIT //Dxyn waits for the next frame
+#define ROM_QUIRK_CLIP         0x20 //sprites clip at the screen edge
+
+typedef struct RomLibHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+} RomLibHeader;
+
+typedef struct Chip8RomInfo {
+    uint64_t hash;                  //chip8_rom_hash of the ROM bytes
+    uint32_t offset;                //of the ROM bytes from the start of the pack
+    uint16_t length;
+    uint16_t cpu_hz;                //recommended instructions per second, 0 = front end default
+    uint32_t quirks;                //ROM_QUIRK_*
+    char name[ROMLIB_NAME_LEN];     //file name, NUL terminated
+} Chip8RomInfo;
+
+_Static_assert(sizeof(Chip8RomInfo) == 64, "Chip8RomInfo is one 64-byte index entry");
+
+typedef struct Chip8RomLib {
+    uint8_t *base;                  //the pack: mapped file, or malloc'd for a directory
+    size_t size;
+    bool mapped;
+    uint32_t count;
+    const Chip8RomInfo *index;      //sorted by hash
+} Chip8RomLib;
+
+uint64_t chip8_rom_hash(const uint8_t *rom, size_t len);
+int chip8_rom_hash_file(const char *path, uint64_t *hash);
+int chip8_romlib_open(Chip8RomLib *lib, const char *path);
+void chip8_romlib_close(Chip8RomLib *lib);
+int chip8_romlib_write(const Chip8RomLib *lib, const char *path);
+const Chip8RomInfo *chip8_romlib_find(const Chip8RomLib *lib, uint64_t hash);
+const Chip8RomInfo *chip8_romlib_find_name(const Chip8RomLib *lib, const char *name);
+int chip8_romlib_load(const Chip8RomLib *lib, const Chip8RomInfo *rom, Chip8 *chip8);
+uint32_t chip8_romlib_parse_quirks(const char *list);
+void chip8_romlib_quirk_names(uint32_t quirks, char *buf, size_t size);
+
+static inline const uint8_t *chip8_romlib_data(const Chip8RomLib *lib, const Chip8RomInfo *rom){
+    return lib->base + rom->offset;
+}
+
+#endif
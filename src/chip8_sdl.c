@@ -36,4 +36,78 @@ int sdl_scancode_to_chip8(SDL_Scancode sc){
 
         default: return -1;
     }
-}
\ No newline at end of file
+}
+
+//3x5 glyphs for the metrics overlay, one row per entry, bit 2 = left column
+typedef struct OverlayGlyph {
+    char c;
+    uint8_t rows[5];
+} OverlayGlyph;
+
+static const OverlayGlyph overlay_font[] = {
+    {'0', {7, 5, 5, 5, 7}}, {'1', {2, 6, 2, 2, 7}}, {'2', {7, 1, 7, 4, 7}}, {'3', {7, 1, 7, 1, 7}},
+    {'4', {5, 5, 7, 1, 1}}, {'5', {7, 4, 7, 1, 7}}, {'6', {7, 4, 7, 5, 7}}, {'7', {7, 1, 1, 2, 2}},
+    {'8', {7, 5, 7, 5, 7}}, {'9', {7, 5, 7, 1, 7}}, {'.', {0, 0, 0, 0, 2}}, {'/', {1, 1, 2, 4, 4}},
+    {'-', {0, 0, 7, 0, 0}}, {'A', {2, 5, 7, 5, 5}}, {'C', {3, 4, 4, 4, 3}}, {'D', {6, 5, 5, 5, 6}},
+    {'E', {7, 4, 6, 4, 7}}, {'F', {7, 4, 6, 4, 4}}, {'I', {7, 2, 2, 2, 7}}, {'L', {4, 4, 4, 4, 7}},
+    {'M', {5, 7, 7, 5, 5}}, {'N', {6, 5, 5, 5, 5}}, {'O', {2, 5, 5, 5, 2}}, {'P', {6, 5, 6, 4, 4}},
+    {'R', {6, 5, 6, 5, 5}}, {'S', {3, 4, 2, 1, 6}}, {'T', {7, 2, 2, 2, 2}}, {'U', {5, 5, 5, 5, 7}},
+    {'X', {5, 5, 2, 5, 5}},
+};
+
+static const uint8_t *overlay_glyph(char c){
+    for (size_t i = 0; i < sizeof(overlay_font) / sizeof(overlay_font[0]); i++){
+        if (overlay_font[i].c == c){
+            return overlay_font[i].rows;
+        }
+    }
+    return NULL; //space and anything missing
+}
+
+void sdl_draw_overlay(SDL_Renderer *renderer, const char *text, int scale){
+    /*
+    Draw newline-separated text (upper case, digits, . / -) in the top-left
+    corner over a translucent box, scale window pixels per font pixel
+    */
+    int lines = 0;
+    int columns = 0;
+    int width = 0;
+    for (const char *p = text; *p; p++){
+        if (*p == '\n'){
+            lines++;
+            width = 0;
+        } else if (++width > columns){
+            columns = width;
+        }
+    }
+    if (width){
+        lines++;
+    }
+
+    SDL_Rect box = { 0, 0, (columns * 4 + 2) * scale, (lines * 6 + 2) * scale };
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 192);
+    SDL_RenderFillRect(renderer, &box);
+    SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255);
+
+    int x = 1;
+    int y = 1;
+    for (const char *p = text; *p; p++){
+        if (*p == '\n'){
+            x = 1;
+            y += 6;
+            continue;
+        }
+        const uint8_t *rows = overlay_glyph(*p);
+        for (int r = 0; rows && r < 5; r++){
+            for (int c = 0; c < 3; c++){
+                if (rows[r] & (4 >> c)){
+                    SDL_Rect dot = { (x + c) * scale, (y + r) * scale, scale, scale };
+                    SDL_RenderFillRect(renderer, &dot);
+                }
+            }
+        }
+        x += 4;
+    }
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+}
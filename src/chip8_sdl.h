@@ -1 +1,9 @@
-int sdl_scancode_to_chip8(SDL_Scancode sc);
\ No newline at end of file
+#ifndef CHIP8_SDL_H
+#define CHIP8_SDL_H
+
+#include <SDL.h>
+
+int sdl_scancode_to_chip8(SDL_Scancode sc);
+void sdl_draw_overlay(SDL_Renderer *renderer, const char *text, int scale);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include "chip8_shm.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+static Chip8Shm *shm_map(const char *name, bool create){
+    Chip8Shm *shm = calloc(1, sizeof(*shm));
+    if (!shm){
+        perror("chip8_shm: calloc");
+        return NULL;
+    }
+
+    int fd = shm_open(name, create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0600);
+    if (fd < 0){
+        perror("chip8_shm: shm_open");
+        free(shm);
+        return NULL;
+    }
+    if (create && ftruncate(fd, sizeof(Chip8ShmBlock)) != 0){
+        perror("chip8_shm: ftruncate");
+        close(fd);
+        shm_unlink(name);
+        free(shm);
+        return NULL;
+    }
+
+    void *p = mmap(NULL, sizeof(Chip8ShmBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED){
+        perror("chip8_shm: mmap");
+        if (create){
+            shm_unlink(name);
+        }
+        free(shm);
+        return NULL;
+    }
+
+    shm->block = p;
+    shm->owner = create;
+    snprintf(shm->name, sizeof(shm->name), "%s", name);
+    return shm;
+}
+
+Chip8Shm *chip8_shm_create(const char *name){
+    /*
+    Emulator side: create (or replace) the shared-memory object. Returns
+    NULL on failure.
+    */
+    Chip8Shm *shm = shm_map(name, true);
+    if (!shm){
+        return NULL;
+    }
+
+    Chip8ShmBlock *block = shm->block;
+    block->version = SHM_VERSION;
+    block->size = sizeof(Chip8ShmBlock);
+    block->pid = (uint32_t)getpid();
+    //magic last, readers check it to know the block is set up
+    atomic_thread_fence(memory_order_release);
+    memcpy(block->magic, SHM_MAGIC, sizeof(block->magic));
+    return shm;
+}
+
+Chip8Shm *chip8_shm_attach(const char *name){
+    /*
+    Reader side: map an emulator's shared-memory object. Returns NULL if it
+    does not exist or is not a compatible block.
+    */
+    Chip8Shm *shm = shm_map(name, false);
+    if (!shm){
+        return NULL;
+    }
+
+    Chip8ShmBlock *block = shm->block;
+    if (memcmp(block->magic, SHM_MAGIC, sizeof(block->magic)) != 0 ||
+        block->version != SHM_VERSION || block->size != sizeof(Chip8ShmBlock)){
+        fprintf(stderr, "chip8_shm_attach: %s is not a version %d block\n", name, SHM_VERSION);
+        chip8_shm_close(shm);
+        return NULL;
+    }
+    return shm;
+}
+
+void chip8_shm_close(Chip8Shm *shm){
+    if (!shm){
+        return;
+    }
+    munmap(shm->block, sizeof(Chip8ShmBlock));
+    if (shm->owner){
+        shm_unlink(shm->name);
+    }
+    free(shm);
+}
+
+void chip8_shm_publish(Chip8Shm *shm, const Chip8 *chip8){
+    /*
+    Copy the registers, timers and (if it was drawn to) the display out.
+    Call once per frame; costs about 100 bytes of stores plus 1 KB when
+    draw_flag is set.
+    */
+    Chip8ShmBlock *block = shm->block;
+    uint32_t seq = atomic_load_explicit(&block->seq, memory_order_relaxed);
+
+    atomic_store_explicit(&block->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    block->frame++;
+    block->cycles = chip8->cycles;
+    memcpy(block->V, chip8->V, sizeof(block->V));
+    block->pc = chip8->pc;
+    block->I = chip8->I;
+    memcpy(block->stack, chip8->stack, sizeof(block->stack));
+    block->sp = chip8->sp;
+    block->delay_timer = chip8->delay_timer;
+    block->sound_timer = chip8->sound_timer;
+    block->waiting_for_key = chip8->waiting_for_key;
+    block->keypad = chip8->keypad;
+    //display only changes in frames that drew
+    if (chip8->draw_flag || block->frame == 1){
+        block->hires = chip8->hires;
+        for (int y = 0; y < DISP_HIRES_HEIGHT; y++){
+            block->display[y][0] = (uint64_t)(chip8->display[y] >> 64);
+            block->display[y][1] = (uint64_t)chip8->display[y];
+        }
+    }
+
+    atomic_store_explicit(&block->seq, seq + 2, memory_order_release);
+}
+
+void chip8_shm_input(Chip8Shm *shm, Chip8 *chip8){
+    /*
+    Apply keys readers pressed or released since the last call. Keys the
+    readers left alone keep whatever the keyboard set.
+    */
+    uint16_t input = atomic_load_explicit(&shm->block->input, memory_order_acquire);
+    uint16_t changed = input ^ shm->input_seen;
+    if (changed){
+        chip8->keypad = (uint16_t)((chip8->keypad & ~changed) | (input & changed));
+        shm->input_seen = input;
+    }
+}
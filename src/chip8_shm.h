@@ -0,0 +1,82 @@
+#ifndef CHIP8_SHM_H
+#define CHIP8_SHM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "chip8.h"
+
+// Shared-memory view of a running emulator for external tools.
+//
+// The emulator creates a POSIX shared-memory object (chip8.exe <rom> --shm
+// <name>, name like "/chip8") and publishes the registers, timers and
+// display into it once per main loop pass. Readers map the same object and
+// read the fields in place, bracketed by chip8_shm_read_begin and
+// chip8_shm_read_retry (a seqlock: seq is odd while the emulator writes).
+// The emulator never waits for readers.
+//
+// Input goes the other way: a reader stores a keypad mask with
+// chip8_shm_set_keys and the emulator applies keys pressed or released
+// since its last look, on top of its own keyboard.
+
+#define SHM_MAGIC "C8SM"
+#define SHM_VERSION 2
+
+typedef struct Chip8ShmBlock {
+    char magic[4];
+    uint32_t version;
+    uint32_t size;              //sizeof(Chip8ShmBlock)
+    uint32_t pid;               //emulator process
+
+    _Atomic uint32_t seq;       //odd while the fields below are written
+    uint32_t reserved;
+    uint64_t frame;             //publish count
+    uint64_t cycles;            //Chip8.cycles
+    uint8_t V[16];
+    uint16_t pc;
+    uint16_t I;
+    uint16_t stack[16];
+    uint8_t sp;
+    uint8_t delay_timer;
+    uint8_t sound_timer;
+    uint8_t waiting_for_key;
+    uint16_t keypad;            //keys the emulator saw
+    uint8_t hires;              //display is 128x64, else 64x32
+    uint64_t display[DISP_HIRES_HEIGHT][2]; //row y: [0] x 0-63, [1] x 64-127, bit 63 first
+
+    // Written by readers, on its own cache line
+    _Alignas(64) _Atomic uint16_t input;
+} Chip8ShmBlock;
+
+typedef struct Chip8Shm {
+    Chip8ShmBlock *block;
+    bool owner;                 //created it, unlinks it on close
+    uint16_t input_seen;        //emulator: input mask at the last chip8_shm_input
+    char name[64];
+} Chip8Shm;
+
+Chip8Shm *chip8_shm_create(const char *name);
+Chip8Shm *chip8_shm_attach(const char *name);
+void chip8_shm_close(Chip8Shm *shm);
+void chip8_shm_publish(Chip8Shm *shm, const Chip8 *chip8);
+void chip8_shm_input(Chip8Shm *shm, Chip8 *chip8);
+
+static inline uint32_t chip8_shm_read_begin(const Chip8ShmBlock *block){
+    //wait out a publish in progress
+    uint32_t seq;
+    while ((seq = atomic_load_explicit(&block->seq, memory_order_acquire)) & 1){
+    }
+    return seq;
+}
+
+static inline bool chip8_shm_read_retry(const Chip8ShmBlock *block, uint32_t seq){
+    //true if a publish overlapped the read and it has to be repeated
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&block->seq, memory_order_relaxed) != seq;
+}
+
+static inline void chip8_shm_set_keys(Chip8ShmBlock *block, uint16_t keypad){
+    atomic_store_explicit(&block->input, keypad, memory_order_release);
+}
+
+#endif
@@ -0,0 +1,263 @@
+//src/chip8_term.c
+#include "chip8_term.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define CSI "\x1b["
+#define KEY_QUIT 0x03 //Ctrl-C, ISIG is off in raw mode
+
+static struct termios saved_termios;
+
+
+int term_char_to_chip8(int c){
+// Same layout as sdl_scancode_to_chip8
+// Keypad       Keyboard
+// +-+-+-+-+    +-+-+-+-+
+// |1|2|3|C|    |1|2|3|4|
+// +-+-+-+-+    +-+-+-+-+
+// |4|5|6|D|    |Q|W|E|R|
+// +-+-+-+-+ => +-+-+-+-+
+// |7|8|9|E|    |A|S|D|F|
+// +-+-+-+-+    +-+-+-+-+
+// |A|0|B|F|    |Z|X|C|V|
+// +-+-+-+-+    +-+-+-+-+
+    if (c >= 'A' && c <= 'Z'){
+        c += 'a' - 'A';
+    }
+    switch (c) {
+        case '1': return 0x1;
+        case '2': return 0x2;
+        case '3': return 0x3;
+        case '4': return 0xC;
+
+        case 'q': return 0x4;
+        case 'w': return 0x5;
+        case 'e': return 0x6;
+        case 'r': return 0xD;
+
+        case 'a': return 0x7;
+        case 's': return 0x8;
+        case 'd': return 0x9;
+        case 'f': return 0xE;
+
+        case 'z': return 0xA;
+        case 'x': return 0x0;
+        case 'c': return 0xB;
+        case 'v': return 0xF;
+
+        default: return -1;
+    }
+}
+
+static bool write_all(const char *buf, size_t len){
+    while (len > 0){
+        ssize_t n = write(STDOUT_FILENO, buf, len);
+        if (n < 0){
+            if (errno == EINTR){
+                continue;
+            }
+            return false;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+bool term_open(Chip8Term *term, int mode){
+    /*
+    Put the terminal in raw mode, switch to the alternate screen and clear
+    it. Returns false if stdin is not a terminal.
+    */
+    memset(term, 0, sizeof(*term));
+    term->mode = mode;
+    term->cols = mode == TERM_BRAILLE ? DISP_WIDTH / 2 : DISP_WIDTH;
+    term->rows = mode == TERM_BRAILLE ? DISP_HEIGHT / 4 : DISP_HEIGHT / 2;
+
+    if (!isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, &saved_termios) != 0){
+        fprintf(stderr, "term_open: stdin is not a terminal\n");
+        return false;
+    }
+
+    struct termios raw = saved_termios;
+    raw.c_iflag &= (tcflag_t)~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+    raw.c_oflag &= (tcflag_t)~OPOST;
+    raw.c_cflag |= CS8;
+    raw.c_lflag &= (tcflag_t)~(ECHO | ICANON | IEXTEN | ISIG);
+    raw.c_cc[VMIN] = 0;  //read() returns at once, with or without input
+    raw.c_cc[VTIME] = 0;
+    if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) != 0){
+        perror("term_open: tcsetattr");
+        return false;
+    }
+
+    //alternate screen, hide cursor, clear: every cell starts blank
+    static const char setup[] = CSI "?1049h" CSI "?25l" CSI "2J";
+    write_all(setup, sizeof(setup) - 1);
+    return true;
+}
+
+void term_close(Chip8Term *term){
+    (void)term;
+    static const char restore[] = CSI "0m" CSI "?25h" CSI "?1049l";
+    write_all(restore, sizeof(restore) - 1);
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &saved_termios);
+}
+
+bool term_poll_keys(Chip8Term *term, Chip8 *chip8){
+    /*
+    Read pending key presses and age held keys by one frame, then rebuild
+    chip8->keypad. Call once per frame. Returns false on Ctrl-C.
+    */
+    for (int k = 0; k < 16; k++){
+        if (term->key_hold[k]){
+            term->key_hold[k]--;
+        }
+    }
+
+    char buf[64];
+    ssize_t n;
+    while ((n = read(STDIN_FILENO, buf, sizeof(buf))) > 0){
+        for (ssize_t i = 0; i < n; i++){
+            if (buf[i] == KEY_QUIT){
+                return false;
+            }
+            int k = term_char_to_chip8((unsigned char)buf[i]);
+            if (k != -1){
+                term->key_hold[k] = TERM_KEY_HOLD;
+            }
+        }
+    }
+
+    uint16_t keypad = 0;
+    for (int k = 0; k < 16; k++){
+        if (term->key_hold[k]){
+            keypad |= (uint16_t)(1u << k);
+        }
+    }
+    chip8->keypad = keypad;
+    return true;
+}
+
+static inline int lit(const uint64_t *rows, int x, int y){
+    return (int)(rows[y] >> (63 - x)) & 1;
+}
+
+static uint8_t cell_bits(const Chip8Term *term, const uint64_t *rows, int row, int col){
+    if (term->mode == TERM_HALF_BLOCK){
+        //bit 0 upper pixel, bit 1 lower
+        return (uint8_t)(lit(rows, col, row * 2) | (lit(rows, col, row * 2 + 1) << 1));
+    }
+
+    //Braille dots 1-8 for the 2x4 block
+    static const uint8_t dot[4][2] = {
+        { 0x01, 0x08 },
+        { 0x02, 0x10 },
+        { 0x04, 0x20 },
+        { 0x40, 0x80 },
+    };
+    uint8_t bits = 0;
+    for (int dy = 0; dy < 4; dy++){
+        for (int dx = 0; dx < 2; dx++){
+            if (lit(rows, col * 2 + dx, row * 4 + dy)){
+                bits |= dot[dy][dx];
+            }
+        }
+    }
+    return bits;
+}
+
+static int glyph(const Chip8Term *term, uint8_t bits, char *out){
+    //UTF-8 for the cell, returns its length
+    if (bits == 0){
+        out[0] = ' ';
+        return 1;
+    }
+    if (term->mode == TERM_HALF_BLOCK){
+        //U+2580 upper half, U+2584 lower half, U+2588 full block
+        static const uint8_t last[4] = { 0, 0x80, 0x84, 0x88 };
+        out[0] = (char)0xE2;
+        out[1] = (char)0x96;
+        out[2] = (char)last[bits];
+        return 3;
+    }
+    //U+2800 + dot bits
+    out[0] = (char)0xE2;
+    out[1] = (char)(0xA0 | (bits >> 6));
+    out[2] = (char)(0x80 | (bits & 0x3F));
+    return 3;
+}
+
+int term_render(Chip8Term *term, Chip8 *chip8){
+    /*
+    Bring the terminal up to date with chip8->display in one write().
+    SUPER-CHIP 128x64 is shown at 64x32, see chip8_disp_lores_row.
+    Returns the number of bytes sent.
+    */
+    char *out = term->out;
+    int len = 0;
+    uint8_t now[TERM_MAX_ROWS][TERM_MAX_COLS];
+    uint64_t rows[DISP_HEIGHT];
+
+    for (int y = 0; y < DISP_HEIGHT; y++){
+        rows[y] = chip8_disp_lores_row(chip8, y);
+    }
+    for (int row = 0; row < term->rows; row++){
+        for (int col = 0; col < term->cols; col++){
+            now[row][col] = cell_bits(term, rows, row, col);
+        }
+    }
+
+    for (int row = 0; row < term->rows; row++){
+        int cursor = -1; //column the cursor is at on this row, -1 if elsewhere
+        for (int col = 0; col < term->cols; col++){
+            if (now[row][col] == term->shown[row][col]){
+                continue;
+            }
+
+            //reach col by reprinting the unchanged cells in between, or
+            //by a cursor jump, whichever is fewer bytes
+            char jump[16];
+            int jump_len = snprintf(jump, sizeof(jump), CSI "%d;%dH", row + 1, col + 1);
+            int walk_len = -1;
+            if (cursor >= 0){
+                char tmp[4];
+                walk_len = 0;
+                for (int c = cursor; c < col; c++){
+                    walk_len += glyph(term, now[row][c], tmp);
+                }
+            }
+
+            if (walk_len >= 0 && walk_len <= jump_len){
+                for (int c = cursor; c < col; c++){
+                    len += glyph(term, now[row][c], &out[len]);
+                }
+            } else {
+                memcpy(&out[len], jump, (size_t)jump_len);
+                len += jump_len;
+            }
+
+            len += glyph(term, now[row][col], &out[len]);
+            term->shown[row][col] = now[row][col];
+            cursor = col + 1;
+        }
+    }
+
+    //terminal bell when the sound timer starts
+    bool sound = chip8->sound_timer > 0;
+    if (sound && !term->sound){
+        out[len++] = '\a';
+    }
+    term->sound = sound;
+
+    if (len > 0){
+        write_all(out, (size_t)len);
+    }
+    term->frames++;
+    term->bytes += (uint64_t)len;
+    return len;
+}
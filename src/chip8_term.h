@@ -0,0 +1,47 @@
+#ifndef CHIP8_TERM_H
+#define CHIP8_TERM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "chip8.h"
+
+// Terminal front end for SSH sessions, see main_term.c.
+//
+// Half-block mode packs two pixel rows per character cell (64x16 cells),
+// Braille mode a 2x4 block per cell (32x8 cells). term_render compares each
+// cell against what the terminal already shows and only sends the changed
+// ones, jumping with cursor-addressing sequences where that is shorter than
+// reprinting the cells in between. A frame goes out in a single write().
+//
+// Terminals only report key presses, not releases, so a key stays down for
+// TERM_KEY_HOLD frames after its last press or auto-repeat.
+
+#define TERM_HALF_BLOCK 0
+#define TERM_BRAILLE 1
+
+#define TERM_KEY_HOLD 12 //frames, 200 ms at 60 Hz
+
+#define TERM_MAX_COLS DISP_WIDTH
+#define TERM_MAX_ROWS (DISP_HEIGHT / 2)
+#define TERM_OUT_SIZE (TERM_MAX_ROWS * TERM_MAX_COLS * 12 + 64) //worst case frame
+
+typedef struct Chip8Term {
+    int mode;           //TERM_HALF_BLOCK or TERM_BRAILLE
+    int cols;
+    int rows;
+    uint8_t shown[TERM_MAX_ROWS][TERM_MAX_COLS]; //cell bits on screen
+    uint8_t key_hold[16]; //frames left for each key
+    bool sound;         //sound_timer was running last frame
+
+    uint64_t frames;
+    uint64_t bytes;
+    char out[TERM_OUT_SIZE];
+} Chip8Term;
+
+int term_char_to_chip8(int c);
+bool term_open(Chip8Term *term, int mode);
+void term_close(Chip8Term *term);
+bool term_poll_keys(Chip8Term *term, Chip8 *chip8);
+int term_render(Chip8Term *term, Chip8 *chip8);
+
+#endif
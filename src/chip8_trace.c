@@ -0,0 +1,344 @@
+#include "chip8_trace.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define TRACE_RING_BITS 16
+#define TRACE_RING_SIZE (1u << TRACE_RING_BITS) //records, 1 MB
+#define TRACE_RING_MASK (TRACE_RING_SIZE - 1)
+#define TRACE_IDLE_NS 1000000 //writer sleep when the ring is empty
+#define TRACE_OUT_SIZE (1 << 16)  //encoded bytes batched per fwrite
+
+struct Chip8Trace {
+    Chip8TraceRecord *ring;
+    uint32_t head_local;        //producer's copy of head
+    uint32_t tail_cache;        //producer's last view of tail
+    uint8_t V[16];              //producer's copy of V0-VE as last recorded
+    _Atomic uint32_t head;      //next slot the producer fills
+    _Atomic uint32_t tail;      //next slot the writer drains
+    _Atomic int stop;
+    pthread_mutex_t lock;       //only for sleeping and waking the writer
+    pthread_cond_t wake;        //producer found the ring full, or stop
+
+    FILE *fp;
+    Chip8TraceRecord prev;      //writer's last encoded record
+    int out_len;
+    uint8_t out[TRACE_OUT_SIZE];
+    pthread_t writer;
+};
+
+
+static inline unsigned byte_mask(uint64_t x){
+    /*
+    Bit i set for every non-zero byte i of x (little-endian)
+    */
+    x |= x >> 4;
+    x |= x >> 2;
+    x |= x >> 1;
+    x &= 0x0101010101010101ull;
+    return (unsigned)((x * 0x0102040810204080ull) >> 56);
+}
+
+
+static void trace_encode(Chip8Trace *trace, const Chip8TraceRecord *record){
+    /*
+    Append the bytes of record that differ from the prediction, behind a
+    LEB128 mask saying which ones
+    */
+    Chip8TraceRecord predicted;
+    chip8_trace_predict(&predicted, &trace->prev);
+    trace->prev = *record;
+
+    uint64_t now[2];
+    uint64_t guess[2];
+    memcpy(now, record, sizeof(now));
+    memcpy(guess, &predicted, sizeof(guess));
+    unsigned mask = byte_mask(now[0] ^ guess[0]) | (byte_mask(now[1] ^ guess[1]) << 8);
+
+    if (trace->out_len > TRACE_OUT_SIZE - (3 + (int)sizeof(*record))){
+        fwrite(trace->out, 1, (size_t)trace->out_len, trace->fp);
+        trace->out_len = 0;
+    }
+
+    uint8_t *out = &trace->out[trace->out_len];
+    int n = 0;
+    unsigned m = mask;
+    while (m >= 0x80){
+        out[n++] = (uint8_t)(m | 0x80);
+        m >>= 7;
+    }
+    out[n++] = (uint8_t)m;
+
+    const uint8_t *bytes = (const uint8_t *)record;
+    while (mask){
+        out[n++] = bytes[__builtin_ctz(mask)];
+        mask &= mask - 1;
+    }
+    trace->out_len += n;
+}
+
+static void *trace_writer(void *arg){
+    /*
+    Background thread: drain the ring into the file until stopped and empty
+    */
+    Chip8Trace *trace = arg;
+    uint32_t tail = atomic_load_explicit(&trace->tail, memory_order_relaxed);
+
+    for (;;){
+        uint32_t head = atomic_load_explicit(&trace->head, memory_order_acquire);
+
+        if (head == tail){
+            if (atomic_load_explicit(&trace->stop, memory_order_acquire)){
+                //producer is done, take anything pushed before stop
+                if (atomic_load_explicit(&trace->head, memory_order_acquire) == tail){
+                    break;
+                }
+                continue;
+            }
+            if (trace->out_len){
+                fwrite(trace->out, 1, (size_t)trace->out_len, trace->fp);
+                trace->out_len = 0;
+            }
+            //sleep until the ring fills, or TRACE_IDLE_NS to flush a
+            //slow producer's records
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += TRACE_IDLE_NS;
+            if (until.tv_nsec >= 1000000000L){
+                until.tv_sec++;
+                until.tv_nsec -= 1000000000L;
+            }
+            pthread_mutex_lock(&trace->lock);
+            if (atomic_load_explicit(&trace->head, memory_order_acquire) == tail &&
+                !atomic_load_explicit(&trace->stop, memory_order_acquire)){
+                pthread_cond_timedwait(&trace->wake, &trace->lock, &until);
+            }
+            pthread_mutex_unlock(&trace->lock);
+            continue;
+        }
+
+        while (tail != head){
+            trace_encode(trace, &trace->ring[tail & TRACE_RING_MASK]);
+            tail++;
+        }
+        atomic_store_explicit(&trace->tail, tail, memory_order_release);
+    }
+    fwrite(trace->out, 1, (size_t)trace->out_len, trace->fp);
+    return NULL;
+}
+
+Chip8Trace *chip8_trace_open(const char *path, const Chip8 *chip8){
+    /*
+    Create the trace file, write the starting state and start the writer
+    thread. Returns NULL on failure.
+    */
+    Chip8Trace *trace = calloc(1, sizeof(*trace));
+    if (!trace){
+        perror("chip8_trace_open: calloc");
+        return NULL;
+    }
+
+    trace->ring = malloc(sizeof(Chip8TraceRecord) * TRACE_RING_SIZE);
+    if (!trace->ring){
+        perror("chip8_trace_open: malloc");
+        free(trace);
+        return NULL;
+    }
+
+    trace->fp = fopen(path, "wb");
+    if (!trace->fp){
+        perror("chip8_trace_open: fopen");
+        free(trace->ring);
+        free(trace);
+        return NULL;
+    }
+
+    Chip8TraceHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.sp = chip8->sp;
+    header.delay_timer = chip8->delay_timer;
+    header.sound_timer = chip8->sound_timer;
+    header.pc = chip8->pc;
+    header.I = chip8->I;
+    memcpy(header.V, chip8->V, sizeof(header.V));
+    fwrite(&header, sizeof(header), 1, trace->fp);
+
+    memcpy(trace->V, chip8->V, sizeof(trace->V));
+    memset(&trace->prev, 0, sizeof(trace->prev));
+    trace->prev.next_pc = chip8->pc;
+
+    pthread_mutex_init(&trace->lock, NULL);
+    pthread_cond_init(&trace->wake, NULL);
+    if (pthread_create(&trace->writer, NULL, trace_writer, trace) != 0){
+        fprintf(stderr, "chip8_trace_open: pthread_create failed\n");
+        pthread_cond_destroy(&trace->wake);
+        pthread_mutex_destroy(&trace->lock);
+        fclose(trace->fp);
+        free(trace->ring);
+        free(trace);
+        return NULL;
+    }
+
+    return trace;
+}
+
+static void trace_wake(Chip8Trace *trace){
+    //under the lock, so a writer about to sleep sees the new head or the signal
+    pthread_mutex_lock(&trace->lock);
+    pthread_cond_signal(&trace->wake);
+    pthread_mutex_unlock(&trace->lock);
+}
+
+static void trace_wait(Chip8Trace *trace){
+    /*
+    The ring is full: wait for the writer rather than drop records
+    */
+    trace->tail_cache = atomic_load_explicit(&trace->tail, memory_order_acquire);
+    while (trace->head_local - trace->tail_cache == TRACE_RING_SIZE){
+        //the writer may be asleep, and with one core nothing else runs it
+        trace_wake(trace);
+        sched_yield();
+        trace->tail_cache = atomic_load_explicit(&trace->tail, memory_order_acquire);
+    }
+}
+
+static inline Chip8TraceRecord *trace_slot(Chip8Trace *trace){
+    /*
+    The next free ring slot, for the producer to fill and publish with
+    trace_publish
+    */
+    uint32_t head = trace->head_local;
+    if (head - trace->tail_cache == TRACE_RING_SIZE){
+        trace_wait(trace);
+    }
+    return &trace->ring[head & TRACE_RING_MASK];
+}
+
+static void trace_publish(Chip8Trace *trace){
+    trace->head_local++;
+    atomic_store_explicit(&trace->head, trace->head_local, memory_order_release);
+}
+
+static inline void trace_push(Chip8Trace *trace, uint64_t lo, uint64_t hi){
+    //the record is built in registers and written with one 16-byte store
+    Chip8TraceRecord *slot = trace_slot(trace);
+#ifdef __SSE2__
+    _mm_storeu_si128((__m128i *)slot, _mm_set_epi64x((long long)hi, (long long)lo));
+#else
+    uint64_t words[2] = {lo, hi};
+    memcpy(slot, words, sizeof(words));
+#endif
+    trace_publish(trace);
+}
+
+static inline uint64_t record_lo(uint16_t opcode, unsigned reg, unsigned value, uint16_t pc, uint16_t next_pc){
+    //first 8 bytes of a Chip8TraceRecord, little-endian like trace_encode
+    return opcode | (uint64_t)reg << 16 | (uint64_t)value << 24 | (uint64_t)pc << 32 | (uint64_t)next_pc << 48;
+}
+
+static inline uint64_t record_hi(const Chip8 *chip8, uint16_t mem_addr, uint8_t delay_timer, uint8_t sound_timer){
+    return chip8->I | (uint64_t)mem_addr << 16 | (uint64_t)chip8->V[0xF] << 32 | (uint64_t)chip8->sp << 40 |
+           (uint64_t)delay_timer << 48 | (uint64_t)sound_timer << 56;
+}
+
+static void trace_multi(Chip8Trace *trace, const Chip8 *chip8, uint16_t pc, uint64_t hi){
+    /*
+    Fx65 and Fx85 can change more than one of V0-VE: the first change
+    goes in the instruction's record, one TRACE_CONT record each after
+    */
+    uint16_t opcode = chip8->opcode;
+    unsigned reg = TRACE_NO_REG;
+    unsigned value = 0;
+    for (int r = 0; r < 0xF; r++){
+        if (chip8->V[r] == trace->V[r]){
+            continue;
+        }
+        trace->V[r] = chip8->V[r];
+        if (reg != TRACE_NO_REG){
+            trace_push(trace, record_lo(opcode, reg, value, pc, chip8->pc), hi);
+            pc = TRACE_CONT;
+        }
+        reg = (unsigned)r;
+        value = chip8->V[r];
+    }
+    trace_push(trace, record_lo(opcode, reg, value, pc, chip8->pc), hi);
+}
+
+int chip8_trace_step(Chip8Trace *trace, Chip8 *chip8){
+    /*
+    Execute one instruction with chip8_step and record it. Returns
+    chip8_step's result, a fault is not recorded.
+    */
+    if (chip8->vblank_wait){
+        //display-wait: chip8_step runs nothing, there is nothing to record
+        return chip8_step(chip8);
+    }
+
+    //the rest of the record is read after, opcode included
+    uint16_t pc = chip8->pc;
+    uint16_t I = chip8->I;
+    uint8_t delay_timer = chip8->delay_timer;
+    uint8_t sound_timer = chip8->sound_timer;
+
+    int err = chip8_step(chip8);
+    if (err != CHIP8_OK){
+        return err;
+    }
+
+    uint16_t opcode = chip8->opcode;
+    //Fx33 and Fx55 are the only memory writers, both start at I
+    uint16_t op = opcode & 0xF0FF;
+    uint16_t mem_addr = (op == 0xF033 || op == 0xF055) ? I : TRACE_NONE;
+    uint64_t hi = record_hi(chip8, mem_addr, delay_timer, sound_timer);
+
+    if (op == 0xF065 || op == 0xF085){
+        trace_multi(trace, chip8, pc, hi);
+        return CHIP8_OK;
+    }
+
+    //everything else writes at most Vx and VF, which has its own field.
+    //Compared byte by byte against the producer's copy: reloading V whole
+    //right after chip8_step's byte stores would stall on store forwarding
+    unsigned x = (opcode >> 8) & 0x0F;
+    unsigned reg = TRACE_NO_REG;
+    unsigned value = 0;
+    if (x != 0xF && chip8->V[x] != trace->V[x]){
+        reg = x;
+        value = chip8->V[x];
+        trace->V[x] = (uint8_t)value;
+    }
+    trace_push(trace, record_lo(opcode, reg, value, pc, chip8->pc), hi);
+    return CHIP8_OK;
+}
+
+void chip8_trace_close(Chip8Trace *trace){
+    /*
+    Flush everything recorded so far and close the file
+    */
+    if (!trace){
+        return;
+    }
+
+    atomic_store_explicit(&trace->stop, 1, memory_order_release);
+    trace_wake(trace);
+    pthread_join(trace->writer, NULL);
+    pthread_cond_destroy(&trace->wake);
+    pthread_mutex_destroy(&trace->lock);
+
+    fclose(trace->fp);
+    free(trace->ring);
+    free(trace);
+}
@@ -0,0 +1,158 @@
+#include "chip8_tune.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static int clamp(const Chip8Tune *tune, int cycles){
+    return cycles < tune->min ? tune->min : cycles > tune->max ? tune->max : cycles;
+}
+
+void chip8_tune_init(Chip8Tune *tune, int min, int max, int start){
+    /*
+    start: cycles per frame to begin with, e.g. a stored chip8_tune_load
+    value or CPU_HZ / TIMER_HZ, clamped to [min, max]
+    */
+    memset(tune, 0, sizeof(*tune));
+    tune->min = min;
+    tune->max = max;
+    tune->start = clamp(tune, start);
+    tune->cycles = tune->start;
+    tune->quiet = true;
+}
+
+static int cmp_u32(const void *a, const void *b){
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int decide(Chip8Tune *tune){
+    //new cycles per frame from a full window
+    if (!tune->count && !tune->late){
+        if (tune->free * 2 > tune->frames){
+            tune->frozen = true;
+            return tune->start;
+        }
+        return tune->cycles;
+    }
+    if (tune->late * 20 > tune->count + tune->late){
+        if (tune->cycles > tune->late_at){
+            tune->late_at = tune->cycles;
+        }
+        int step = tune->cycles / 4;
+        return clamp(tune, tune->cycles + (step ? step : 1));
+    }
+    qsort(tune->samples, tune->count, sizeof(tune->samples[0]), cmp_u32);
+    int target = (int)(tune->samples[tune->count * 95 / 100] * TUNE_HEADROOM) + 1;
+    if (target >= tune->cycles){
+        return tune->cycles;
+    }
+    //down in steps, a window that was easy is not proof the next one is
+    int step = tune->cycles / 8;
+    int next = tune->cycles - (step ? step : 1);
+    if (next < target){
+        next = target;
+    }
+    if (next <= tune->late_at){
+        next = tune->late_at + 1;
+    }
+    return next < tune->cycles ? clamp(tune, next) : tune->cycles;
+}
+
+bool chip8_tune_frame(Chip8Tune *tune, const Chip8 *chip8){
+    /*
+    Call at each timer tick, before chip8_timer_tick.
+    Returns true when Chip8Tune.cycles changed.
+    */
+    if (tune->frozen || tune->executed == tune->frame_start){
+        //done, or paused: nothing learned
+        return false;
+    }
+    if (chip8->vblank_wait){
+        chip8_tune_sample(tune, tune->executed - tune->frame_start);
+        tune->quiet = false;
+    }
+    if (tune->quiet && !chip8->waiting_for_key){
+        tune->free++;
+    }
+    tune->frame_start = tune->executed;
+    tune->quiet = true;
+    if (++tune->frames < TUNE_WINDOW){
+        return false;
+    }
+
+    bool informed = tune->count || tune->late;
+    int cycles = decide(tune);
+    bool changed = cycles != tune->cycles;
+    tune->cycles = cycles;
+    if (informed){
+        tune->stable = changed ? 0 : tune->stable + 1;
+        tune->settled = tune->stable >= TUNE_SETTLE;
+    }
+    tune->frames = 0;
+    tune->free = 0;
+    tune->late = 0;
+    tune->count = 0;
+    return changed;
+}
+
+int chip8_tune_load(const char *path, uint64_t hash){
+    /*
+    Stored cycles per frame for the ROM, 0 if none (or no file yet)
+    */
+    FILE *fp = fopen(path, "r");
+    if (!fp){
+        return 0;
+    }
+    char line[128];
+    int cycles = 0;
+    while (fgets(line, sizeof(line), fp)){
+        unsigned long long h;
+        int c;
+        if (line[0] != '#' && sscanf(line, "%llx %d", &h, &c) == 2 && h == hash){
+            cycles = c;
+        }
+    }
+    fclose(fp);
+    return cycles;
+}
+
+int chip8_tune_save(const char *path, uint64_t hash, int cycles){
+    /*
+    Replace or add the ROM's line, other ROMs are kept.
+    Written to <path>.tmp and renamed.
+    */
+    char tmp[4096];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)){
+        return CHIP8_ERR_IO;
+    }
+    FILE *out = fopen(tmp, "w");
+    if (!out){
+        perror("chip8_tune_save: fopen");
+        return CHIP8_ERR_IO;
+    }
+    fprintf(out, "# chip8 tuned cycles per frame: rom hash, cycles\n");
+
+    FILE *in = fopen(path, "r");
+    if (in){
+        char line[128];
+        while (fgets(line, sizeof(line), in)){
+            unsigned long long h;
+            int c;
+            if (line[0] != '#' && sscanf(line, "%llx %d", &h, &c) == 2 && h != hash){
+                fprintf(out, "%016llx %d\n", h, c);
+            }
+        }
+        fclose(in);
+    }
+    fprintf(out, "%016llx %d\n", (unsigned long long)hash, cycles);
+
+    if (fclose(out) != 0 || rename(tmp, path) != 0){
+        perror("chip8_tune_save: write");
+        return CHIP8_ERR_IO;
+    }
+    return CHIP8_OK;
+}
@@ -0,0 +1,111 @@
+#ifndef CHIP8_TUNE_H
+#define CHIP8_TUNE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "chip8.h"
+
+// Adaptive cycles-per-frame: run each ROM at the lowest speed it needs.
+//
+// A game paced by the delay timer sets it (Fx15 with n > 0), does its work
+// and then polls it (Fx07) until it runs out. chip8_tune_step watches for
+// that pair: if the first poll after the set still reads a running timer,
+// the work fit and took (instructions since the start of the host frame
+// of the set, which is when the previous poll let go) / n cycles per frame;
+// if the timer already ran out, the game was late. With the display-wait
+// quirk each frame up to the Dxyn is a sample as well.
+//
+// Every TUNE_WINDOW frames chip8_tune_frame decides: more than 1 late game
+// frame in 20 speeds up by a quarter; otherwise the speed steps down (at
+// most an eighth per window, and never back to a speed that was late)
+// towards the 95th percentile of the samples plus TUNE_HEADROOM. A window
+// with no timer activity at all that is not waiting for a key is a ROM
+// timed by CPU speed alone (PONG's rallies, for one), and tuning stops for
+// good at the starting speed. After TUNE_SETTLE windows of samples without
+// a change the value is settled, and chip8_tune_save stores it under the
+// ROM's chip8_rom_hash.
+//
+// The tuning file is text, one ROM per line: "<hash> <cycles per frame>".
+
+#define TUNE_WINDOW 60          //frames per decision, 1 s at 60 Hz
+#define TUNE_SAMPLES 256        //per window, more are dropped
+#define TUNE_SETTLE 3           //unchanged windows before the value is settled
+#define TUNE_HEADROOM 1.25      //over the 95th percentile of the samples
+#define TUNE_MIN 4              //default bounds, cycles per frame
+#define TUNE_MAX 50
+
+typedef struct Chip8Tune {
+    int min, max;
+    int start;
+    int cycles;                 //current cycles per frame
+    int late_at;                //highest speed that was late, 0 for none
+    bool frozen;                //timed by CPU speed, left at start
+    bool settled;
+
+    uint32_t executed;          //instructions seen, wraps
+    bool armed;                 //delay timer set, not polled yet
+    uint8_t budget;             //frames it was set to
+    uint32_t mark;              //executed at the start of the frame of the set
+
+    // Current frame
+    uint32_t frame_start;
+    bool quiet;                 //no timer or key activity
+
+    // Current window
+    uint32_t frames;
+    uint32_t free;              //quiet frames
+    uint32_t late;
+    uint32_t count;
+    uint32_t samples[TUNE_SAMPLES];
+    int stable;
+} Chip8Tune;
+
+void chip8_tune_init(Chip8Tune *tune, int min, int max, int start);
+bool chip8_tune_frame(Chip8Tune *tune, const Chip8 *chip8);
+int chip8_tune_load(const char *path, uint64_t hash);
+int chip8_tune_save(const char *path, uint64_t hash, int cycles);
+
+static inline void chip8_tune_sample(Chip8Tune *tune, uint32_t cycles){
+    if (tune->count < TUNE_SAMPLES){
+        tune->samples[tune->count++] = cycles;
+    }
+}
+
+static inline void chip8_tune_step(Chip8Tune *tune, const Chip8 *chip8){
+    /*
+    Call before each chip8_step
+    */
+    tune->executed++;
+    uint16_t pc = chip8->pc;
+    uint16_t opcode = (uint16_t)(chip8_mem_read(chip8, pc) << 8 | chip8_mem_read(chip8, pc + 1));
+    switch (opcode & 0xF0FF){
+        case 0xF015: {
+            uint8_t n = chip8->V[(opcode >> 8) & 0xF];
+            if (n){
+                tune->armed = true;
+                tune->budget = n;
+                tune->mark = tune->frame_start;
+            }
+            tune->quiet = false;
+            break;
+        }
+        case 0xF007:
+            if (tune->armed){
+                tune->armed = false;
+                if (chip8->delay_timer){
+                    chip8_tune_sample(tune, (tune->executed - tune->mark + tune->budget - 1) / tune->budget);
+                } else {
+                    tune->late++;
+                }
+            }
+            tune->quiet = false;
+            break;
+        case 0xF00A:
+            tune->quiet = false;
+            break;
+        default:
+            break;
+    }
+}
+
+#endif
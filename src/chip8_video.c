@@ -0,0 +1,296 @@
+#include "chip8_video.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+// YUV4MPEG2, luma is BT.601 studio range, chroma is left neutral
+#define Y4M_HEADER "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n"
+#define Y4M_FRAME "FRAME\n"
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    uint64_t pending;   //times the writer still has to write data
+    bool writing;       //writer is using data outside the lock
+    bool closed;        //a newer frame is in the other slot, no more repeats
+} VideoSlot;
+
+struct Chip8Video {
+    FILE *fp;
+    VideoFormat format;
+    int scale;
+    int width;
+    int height;
+    bool failed;        //a write failed, set by the writer
+
+    VideoSlot slots[2];
+    int current;        //slot holding the newest frame
+    bool stop;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t writer;
+
+    bool have_last;
+    bool last_hires;
+    Chip8Row last[DISP_HIRES_HEIGHT];   //display of the newest frame
+    uint32_t pixels[DISP_HIRES_WIDTH * DISP_HIRES_HEIGHT];
+    int src_width;                      //resolution of pixels
+    int src_height;
+    Chip8VideoStats stats;
+};
+
+
+static void *video_writer(void *arg){
+    /*
+    Background thread: write slots in order, each as many times as it was
+    submitted, until stopped and drained
+    */
+    Chip8Video *video = arg;
+    int w = 0;
+
+    pthread_mutex_lock(&video->lock);
+    for (;;){
+        VideoSlot *slot = &video->slots[w];
+        if (slot->pending == 0){
+            if (slot->closed){
+                //producer moved on, the other slot is next
+                slot->closed = false;
+                pthread_cond_broadcast(&video->cond);
+                w ^= 1;
+                continue;
+            }
+            if (video->stop){
+                break;
+            }
+            pthread_cond_wait(&video->cond, &video->lock);
+            continue;
+        }
+
+        uint64_t n = slot->pending;
+        slot->pending = 0;
+        slot->writing = true;
+        pthread_mutex_unlock(&video->lock);
+
+        for (uint64_t i = 0; i < n && !video->failed; i++){
+            if (fwrite(slot->data, 1, slot->len, video->fp) != slot->len){
+                perror("chip8_video: fwrite");
+                video->failed = true;
+            }
+        }
+
+        pthread_mutex_lock(&video->lock);
+        slot->writing = false;
+        pthread_cond_broadcast(&video->cond);
+    }
+    pthread_mutex_unlock(&video->lock);
+    return NULL;
+}
+
+Chip8Video *chip8_video_open(const char *path, VideoFormat format, int scale){
+    /*
+    Open path ("-" for stdout) and start the writer thread. Returns NULL
+    on failure.
+    */
+    if (scale < 1){
+        fprintf(stderr, "chip8_video_open: scale must be >= 1\n");
+        return NULL;
+    }
+
+    Chip8Video *video = calloc(1, sizeof(*video));
+    if (!video){
+        perror("chip8_video_open: calloc");
+        return NULL;
+    }
+
+    video->format = format;
+    video->scale = scale;
+    video->width = DISP_WIDTH * scale;
+    video->height = DISP_HEIGHT * scale;
+
+    size_t plane = (size_t)video->width * (size_t)video->height;
+    size_t len = format == VIDEO_Y4M
+        ? strlen(Y4M_FRAME) + plane + 2 * (plane / 4)
+        : plane * 3;
+    for (int i = 0; i < 2; i++){
+        video->slots[i].data = malloc(len);
+        video->slots[i].len = len;
+        if (!video->slots[i].data){
+            perror("chip8_video_open: malloc");
+            free(video->slots[0].data);
+            free(video);
+            return NULL;
+        }
+    }
+
+    video->fp = strcmp(path, "-") == 0 ? stdout : fopen(path, "wb");
+    if (!video->fp){
+        perror("chip8_video_open: fopen");
+        free(video->slots[0].data);
+        free(video->slots[1].data);
+        free(video);
+        return NULL;
+    }
+
+    if (format == VIDEO_Y4M){
+        fprintf(video->fp, Y4M_HEADER, video->width, video->height, VIDEO_FPS);
+    }
+
+    pthread_mutex_init(&video->lock, NULL);
+    pthread_cond_init(&video->cond, NULL);
+    if (pthread_create(&video->writer, NULL, video_writer, video) != 0){
+        fprintf(stderr, "chip8_video_open: pthread_create failed\n");
+        if (video->fp != stdout){
+            fclose(video->fp);
+        }
+        free(video->slots[0].data);
+        free(video->slots[1].data);
+        free(video);
+        return NULL;
+    }
+
+    return video;
+}
+
+static void encode_y4m(Chip8Video *video, uint8_t *out){
+    memcpy(out, Y4M_FRAME, strlen(Y4M_FRAME));
+    uint8_t *y_plane = out + strlen(Y4M_FRAME);
+    int w = video->width;
+    int sw = video->src_width;
+    int sh = video->src_height;
+
+    //source pixel x covers output columns [x * w / sw, (x + 1) * w / sw),
+    //the scale at 64x32, half of it at 128x64
+    for (int y = 0; y < sh; y++){
+        int y0 = y * video->height / sh;
+        int y1 = (y + 1) * video->height / sh;
+        uint8_t *row = &y_plane[(size_t)y0 * w];
+        for (int x = 0; x < sw; x++){
+            uint32_t p = video->pixels[y * sw + x];
+            int r = (p >> 16) & 0xFF;
+            int g = (p >> 8) & 0xFF;
+            int b = p & 0xFF;
+            uint8_t luma = (uint8_t)(16 + ((66 * r + 129 * g + 25 * b + 128) >> 8));
+            int x0 = x * w / sw;
+            memset(&row[x0], luma, (size_t)((x + 1) * w / sw - x0));
+        }
+        //the other lines are copies
+        for (int i = 1; i < y1 - y0; i++){
+            memcpy(&row[(size_t)i * w], row, (size_t)w);
+        }
+    }
+
+    //the display is grey, chroma is neutral
+    size_t plane = (size_t)w * (size_t)video->height;
+    memset(y_plane + plane, 128, 2 * (plane / 4));
+}
+
+static void encode_rgb(Chip8Video *video, uint8_t *out){
+    int w = video->width;
+    int sw = video->src_width;
+    int sh = video->src_height;
+    size_t stride = (size_t)w * 3;
+
+    for (int y = 0; y < sh; y++){
+        int y0 = y * video->height / sh;
+        int y1 = (y + 1) * video->height / sh;
+        uint8_t *row = &out[(size_t)y0 * stride];
+        uint8_t *o = row;
+        for (int x = 0; x < sw; x++){
+            uint32_t p = video->pixels[y * sw + x];
+            for (int i = x * w / sw; i < (x + 1) * w / sw; i++){
+                *o++ = (uint8_t)(p >> 16);
+                *o++ = (uint8_t)(p >> 8);
+                *o++ = (uint8_t)p;
+            }
+        }
+        for (int i = 1; i < y1 - y0; i++){
+            memcpy(&row[(size_t)i * stride], row, stride);
+        }
+    }
+}
+
+void chip8_video_frame(Chip8Video *video, Chip8 *chip8){
+    /*
+    Queue the current display as the next frame
+    */
+    video->stats.frames++;
+    video->stats.bytes += video->slots[0].len;
+
+    if (video->have_last && video->last_hires == chip8->hires &&
+        memcmp(video->last, chip8->display, sizeof(video->last)) == 0){
+        //unchanged, write the newest buffer once more
+        pthread_mutex_lock(&video->lock);
+        video->slots[video->current].pending++;
+        pthread_cond_broadcast(&video->cond);
+        pthread_mutex_unlock(&video->lock);
+        return;
+    }
+
+    memcpy(video->last, chip8->display, sizeof(video->last));
+    video->last_hires = chip8->hires;
+    video->have_last = true;
+    video->stats.encoded++;
+
+    //first frame goes in slot 1, closing the empty slot 0 the writer waits on
+    int next = video->current ^ 1;
+    VideoSlot *slot = &video->slots[next];
+
+    //wait for the writer to be done with it and move past it
+    pthread_mutex_lock(&video->lock);
+    while (slot->pending || slot->writing || slot->closed){
+        pthread_cond_wait(&video->cond, &video->lock);
+    }
+    pthread_mutex_unlock(&video->lock);
+
+    chip8_disp_to_pixels(chip8, video->pixels);
+    video->src_width = chip8_disp_width(chip8);
+    video->src_height = chip8_disp_height(chip8);
+    if (video->format == VIDEO_Y4M){
+        encode_y4m(video, slot->data);
+    } else {
+        encode_rgb(video, slot->data);
+    }
+
+    pthread_mutex_lock(&video->lock);
+    slot->pending = 1;
+    video->slots[video->current].closed = true;
+    video->current = next;
+    pthread_cond_broadcast(&video->cond);
+    pthread_mutex_unlock(&video->lock);
+}
+
+int chip8_video_close(Chip8Video *video, Chip8VideoStats *stats){
+    /*
+    Write out everything queued and close. Returns 0, or -1 if a write
+    failed.
+    */
+    if (!video){
+        return -1;
+    }
+
+    pthread_mutex_lock(&video->lock);
+    video->stop = true;
+    pthread_cond_broadcast(&video->cond);
+    pthread_mutex_unlock(&video->lock);
+    pthread_join(video->writer, NULL);
+
+    bool failed = video->failed;
+    if (video->fp == stdout){
+        failed |= fflush(stdout) != 0;
+    } else {
+        failed |= fclose(video->fp) != 0;
+    }
+
+    if (stats){
+        *stats = video->stats;
+    }
+    pthread_mutex_destroy(&video->lock);
+    pthread_cond_destroy(&video->cond);
+    free(video->slots[0].data);
+    free(video->slots[1].data);
+    free(video);
+    return failed ? -1 : 0;
+}
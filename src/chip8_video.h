@@ -0,0 +1,39 @@
+#ifndef CHIP8_VIDEO_H
+#define CHIP8_VIDEO_H
+
+#include <stdint.h>
+#include "chip8.h"
+
+// Headless frame export.
+//
+// chip8_video_frame takes one presented frame (call it once per 60 Hz timer
+// tick), converts chip8_disp_to_pixels output to the output format scaled
+// up by an integer factor (half of it for SUPER-CHIP 128x64, so the frame
+// size never changes) and hands it to a writer thread. There are two
+// frame buffers: one being written out while the next is encoded. A frame
+// whose Chip8.display equals the previous one is not encoded again, the
+// writer just repeats the last buffer.
+//
+// VIDEO_Y4M is YUV4MPEG2 4:2:0 at 60 fps (ffmpeg/mpv read it directly),
+// VIDEO_RGB is headerless rgb24 (ffmpeg -f rawvideo -pix_fmt rgb24).
+
+#define VIDEO_FPS 60
+
+typedef enum {
+    VIDEO_Y4M,
+    VIDEO_RGB
+} VideoFormat;
+
+typedef struct Chip8Video Chip8Video;
+
+typedef struct Chip8VideoStats {
+    uint64_t frames;    //frames written
+    uint64_t encoded;   //frames that had to be converted
+    uint64_t bytes;
+} Chip8VideoStats;
+
+Chip8Video *chip8_video_open(const char *path, VideoFormat format, int scale);
+void chip8_video_frame(Chip8Video *video, Chip8 *chip8);
+int chip8_video_close(Chip8Video *video, Chip8VideoStats *stats);
+
+#endif
@@ -1,10 +1,20 @@
 #include "debug.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_RESUME 0xFFFF
+
+//PC of the breakpoint we last stopped at, so resuming runs past it
+static uint16_t debug_resume_pc = NO_RESUME;
+
+//execution history for reverse stepping, NULL when not recording
+static Chip8Rewind *debug_rewind;
 
 static uint16_t debug_peek_opcode(const Chip8 *chip8){
-    uint16_t high_byte = chip8->memory[chip8->pc];
-    uint16_t low_byte  = chip8->memory[chip8->pc + 1];
+    uint16_t high_byte = chip8_mem_read(chip8, chip8->pc);
+    uint16_t low_byte  = chip8_mem_read(chip8, chip8->pc + 1);
 
     return (high_byte << 8) | low_byte;
 }
@@ -44,7 +54,7 @@ void debug_dump_memory(const Chip8 *chip8, uint16_t start, int count){
             printf("\n0x%03X: ", addr);
         }
 
-        printf("%02X ", chip8->memory[addr]);
+        printf("%02X ", chip8_mem_read(chip8, addr));
     }
 
     printf("\n");
@@ -57,10 +67,184 @@ void debug_step_instruction(Chip8 *chip8){
     printf("Before:");
     debug_print_state(chip8);
 
-    chip8_step(chip8);
+    if (debug_rewind){
+        chip8_rewind_record(debug_rewind, chip8);
+    }
+    int err = chip8_step(chip8);
+    if (err != CHIP8_OK){
+        printf("\nFault: %s at PC=0x%03X\n", chip8_strerror(err), chip8->pc);
+    }
 
     printf("After:");
     debug_print_state(chip8);
     
     fflush(stdout);
-}
\ No newline at end of file
+}
+
+
+static void debug_flags_changed(Chip8 *chip8){
+    /*
+    Drop the table once nothing is flagged, so the run loop goes back to
+    the unchecked path
+    */
+    for (int addr = 0; addr < MEM_SIZE; addr++){
+        if (chip8->mem_flags[addr]){
+            return;
+        }
+    }
+    free(chip8->mem_flags);
+    chip8->mem_flags = NULL;
+}
+
+static bool debug_flags_alloc(Chip8 *chip8){
+    if (!chip8->mem_flags){
+        chip8->mem_flags = calloc(MEM_SIZE, 1);
+        if (!chip8->mem_flags){
+            perror("debug: calloc");
+            return false;
+        }
+    }
+    return true;
+}
+
+void debug_toggle_breakpoint(Chip8 *chip8, uint16_t addr){
+    if (addr >= MEM_SIZE || !debug_flags_alloc(chip8)){
+        return;
+    }
+
+    chip8->mem_flags[addr] ^= CHIP8_BREAK;
+    printf("\nBreakpoint at 0x%03X %s\n", addr, (chip8->mem_flags[addr] & CHIP8_BREAK) ? "set" : "cleared");
+    debug_flags_changed(chip8);
+    fflush(stdout);
+}
+
+void debug_toggle_watchpoint(Chip8 *chip8, uint16_t start, int count, uint8_t kind){
+    /*
+    Toggle a CHIP8_WATCH_READ or CHIP8_WATCH_WRITE watchpoint on
+    [start, start + count). Set if the first byte was not watched.
+    */
+    if (start >= MEM_SIZE || !debug_flags_alloc(chip8)){
+        return;
+    }
+
+    bool set = !(chip8->mem_flags[start] & kind);
+    for (int i = 0; i < count && start + i < MEM_SIZE; i++){
+        if (set){
+            chip8->mem_flags[start + i] |= kind;
+        } else {
+            chip8->mem_flags[start + i] &= (uint8_t)~kind;
+        }
+    }
+    printf("\n%s watchpoint 0x%03X-0x%03X %s\n",
+           kind == CHIP8_WATCH_READ ? "Read" : "Write",
+           start, start + count - 1, set ? "set" : "cleared");
+    debug_flags_changed(chip8);
+    fflush(stdout);
+}
+
+void debug_clear_points(Chip8 *chip8){
+    free(chip8->mem_flags);
+    chip8->mem_flags = NULL;
+    chip8->watch_hit = 0;
+    printf("\nAll breakpoints and watchpoints cleared\n");
+    fflush(stdout);
+}
+
+bool debug_break_hit(Chip8 *chip8){
+    /*
+    True when a breakpoint sits on PC: stop before running it. The next
+    call at the same PC lets it run, so continuing moves past it.
+    */
+    uint16_t pc = chip8->pc;
+
+    if ((chip8->mem_flags[pc & (MEM_SIZE - 1)] & CHIP8_BREAK) && pc != debug_resume_pc){
+        debug_resume_pc = pc;
+        printf("\nBreakpoint hit at 0x%03X\n", pc);
+        debug_print_state(chip8);
+        return true;
+    }
+    debug_resume_pc = NO_RESUME;
+    return false;
+}
+
+bool debug_watch_hit(Chip8 *chip8, uint16_t pc){
+    //after the instruction at pc ran: true if it touched a watched byte
+    if (chip8->watch_hit){
+        printf("\n%s watchpoint hit at 0x%03X by PC=0x%03X\n",
+               chip8->watch_hit == CHIP8_WATCH_READ ? "Read" : "Write",
+               chip8->watch_addr, pc);
+        chip8->watch_hit = 0;
+        debug_print_state(chip8);
+        return true;
+    }
+    return false;
+}
+
+bool debug_step_checked(Chip8 *chip8){
+    /*
+    Run one instruction unless a breakpoint sits on PC. Returns true when
+    execution should stop: at a breakpoint or a fault (instruction not
+    run) or after an instruction that touched a watched byte.
+    Only useful while chip8->mem_flags is set. main.c's run_cpu calls
+    debug_break_hit and debug_watch_hit around its own step instead, to
+    keep the profile, tune and trace hooks.
+    */
+    uint16_t pc = chip8->pc;
+
+    if (debug_break_hit(chip8)){
+        return true;
+    }
+
+    if (debug_rewind){
+        chip8_rewind_record(debug_rewind, chip8);
+    }
+    int err = chip8_step(chip8);
+    if (err != CHIP8_OK){
+        printf("\nFault: %s at PC=0x%03X\n", chip8_strerror(err), pc);
+        debug_print_state(chip8);
+        return true;
+    }
+
+    return debug_watch_hit(chip8, pc);
+}
+
+void debug_set_rewind(Chip8Rewind *rewind){
+    /*
+    Record every instruction the debugger runs into rewind
+    */
+    debug_rewind = rewind;
+}
+
+void debug_reverse_step(Chip8 *chip8){
+    /*
+    Undo the last instruction
+    */
+    if (!debug_rewind || chip8_rewind_position(debug_rewind) == 0){
+        printf("\nNothing to step back over\n");
+        fflush(stdout);
+        return;
+    }
+
+    chip8_rewind_seek(debug_rewind, chip8, chip8_rewind_position(debug_rewind) - 1);
+    debug_resume_pc = chip8->pc;
+
+    printf("\n--- BACK ---\n");
+    printf("Now:");
+    debug_print_state(chip8);
+}
+
+void debug_reverse_continue(Chip8 *chip8){
+    /*
+    Run backwards to the last breakpoint or watchpoint hit
+    */
+    if (!debug_rewind ||
+        !chip8_rewind_find_back(debug_rewind, chip8, CHIP8_BREAK | CHIP8_WATCH_READ | CHIP8_WATCH_WRITE)){
+        printf("\nNo earlier breakpoint or watchpoint hit\n");
+        fflush(stdout);
+        return;
+    }
+    debug_resume_pc = chip8->pc;
+
+    printf("\nReversed to instruction %llu\n", (unsigned long long)chip8_rewind_position(debug_rewind));
+    debug_print_state(chip8);
+}
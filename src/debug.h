@@ -2,10 +2,21 @@
 #define CHIP8_DEBUG_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "chip8.h"
+#include "chip8_rewind.h"
 
 void debug_print_state(const Chip8 *chip8);
 void debug_dump_memory(const Chip8 *chip8, uint16_t start, int count);
 void debug_step_instruction(Chip8 *chip8);
+void debug_toggle_breakpoint(Chip8 *chip8, uint16_t addr);
+void debug_toggle_watchpoint(Chip8 *chip8, uint16_t start, int count, uint8_t kind);
+void debug_clear_points(Chip8 *chip8);
+bool debug_break_hit(Chip8 *chip8);
+bool debug_watch_hit(Chip8 *chip8, uint16_t pc);
+bool debug_step_checked(Chip8 *chip8);
+void debug_set_rewind(Chip8Rewind *rewind);
+void debug_reverse_step(Chip8 *chip8);
+void debug_reverse_continue(Chip8 *chip8);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include "chip8.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+// Instance handling for libchip8.h callers that only see an opaque Chip8.
+// The core itself is chip8.c and chip8_opcodes.c.
+
+static Chip8 *alloc_chip8(void){
+    //cache-line aligned so the hot state is one line, size rounded for aligned_alloc
+    size_t size = (sizeof(Chip8) + CHIP8_HOT_SIZE - 1) & ~(size_t)(CHIP8_HOT_SIZE - 1);
+    return aligned_alloc(CHIP8_HOT_SIZE, size);
+}
+
+Chip8 *chip8_new(void){
+    /*
+    A reset Chip8 with its own RNG stream, NULL when out of memory.
+    Release with chip8_free.
+    */
+    Chip8 *chip8 = alloc_chip8();
+    if (chip8){
+        chip8_reset(chip8);
+    }
+    return chip8;
+}
+
+Chip8 *chip8_clone(const Chip8 *src){
+    /*
+    An independent copy of src, RNG state included, NULL when out of
+    memory. With CHIP8_PAGED_MEMORY the memory pages are shared until
+    written. Hooks and their addresses are copied.
+    */
+    Chip8 *chip8 = alloc_chip8();
+    if (chip8){
+        chip8_fork(chip8, src);
+        //hooks get a table of their own, not src's
+        chip8->hooks = NULL;
+        chip8->mem_flags = NULL;
+        if (src->hooks){
+            if (chip8_set_hooks(chip8, &src->hooks->hooks) != CHIP8_OK){
+                chip8_free(chip8);
+                return NULL;
+            }
+            memcpy(chip8->hooks->flags, src->hooks->flags, sizeof(chip8->hooks->flags));
+        }
+    }
+    return chip8;
+}
+
+void chip8_free(Chip8 *chip8){
+    if (chip8){
+        chip8_set_hooks(chip8, NULL);
+        chip8_release(chip8);
+        free(chip8);
+    }
+}
+
+void chip8_set_quirks(Chip8 *chip8, unsigned quirks){
+    chip8->quirks = (uint8_t)quirks;
+}
+
+void chip8_set_keypad(Chip8 *chip8, uint16_t keys){
+    //bit k set = key k down
+    chip8->keypad = keys;
+}
+
+int chip8_set_hooks(Chip8 *chip8, const Chip8Hooks *hooks){
+    if (!hooks){
+        if (chip8->hooks){
+            free(chip8->hooks);
+            chip8->hooks = NULL;
+            chip8->mem_flags = NULL;
+            chip8->watch_hit = 0;
+        }
+        return CHIP8_OK;
+    }
+    if (!chip8->hooks){
+        chip8->hooks = calloc(1, sizeof(*chip8->hooks));
+        if (!chip8->hooks){
+            return CHIP8_ERR_NOMEM;
+        }
+        chip8->mem_flags = chip8->hooks->flags;
+    }
+    chip8->hooks->hooks = *hooks;
+    return CHIP8_OK;
+}
+
+static void hook_flags(Chip8 *chip8, uint16_t start, unsigned len, uint8_t flag, bool on){
+    if (!chip8->hooks){
+        return;
+    }
+    for (unsigned i = 0; i < len; i++){
+        uint8_t *f = &chip8->hooks->flags[(start + i) & (MEM_SIZE - 1)];
+        *f = on ? (uint8_t)(*f | flag) : (uint8_t)(*f & ~flag);
+    }
+}
+
+void chip8_hook_pc(Chip8 *chip8, uint16_t addr, bool on){
+    hook_flags(chip8, addr, 1, CHIP8_BREAK, on);
+}
+
+void chip8_hook_mem_write(Chip8 *chip8, uint16_t start, unsigned len, bool on){
+    hook_flags(chip8, start, len, CHIP8_WATCH_WRITE, on);
+}
+
+static long run_hooked(Chip8 *chip8, long cycles){
+    /*
+    chip8_run with the instruction hooks. Only taken while hooks are set,
+    the plain loop stays as it was.
+    */
+    const Chip8HookTable *table = chip8->hooks;
+    const Chip8Hooks *hooks = &table->hooks;
+    long done = 0;
+    while (done < cycles && !chip8->vblank_wait){
+        uint16_t pc = chip8->pc;
+        if (hooks->on_pc && (table->flags[pc & (MEM_SIZE - 1)] & CHIP8_BREAK)){
+            hooks->on_pc(chip8, hooks->ctx, pc);
+            pc = chip8->pc;
+        }
+        uint8_t sound = chip8->sound_timer;
+        bool waiting = chip8->waiting_for_key;
+
+        int err = chip8_step(chip8);
+        if (err != CHIP8_OK){
+            return err;
+        }
+        done++;
+
+        if (chip8->watch_hit){
+            chip8->watch_hit = 0;
+            if (hooks->on_mem_write){
+                hooks->on_mem_write(chip8, hooks->ctx, chip8->watch_addr, pc);
+            }
+        }
+        if (!sound && chip8->sound_timer && hooks->on_sound_start){
+            hooks->on_sound_start(chip8, hooks->ctx);
+        }
+        if (!waiting && chip8->waiting_for_key && hooks->on_key_wait){
+            hooks->on_key_wait(chip8, hooks->ctx, chip8->wait_key_reg);
+        }
+    }
+    return done;
+}
+
+long chip8_run(Chip8 *chip8, long cycles){
+    /*
+    Up to `cycles` instructions, fewer if a display-wait starts. Returns
+    the number run, or a Chip8Error if an instruction faulted (the ones
+    before it have run).
+    */
+    if (chip8->hooks){
+        return run_hooked(chip8, cycles);
+    }
+    long done = 0;
+    while (done < cycles && !chip8->vblank_wait){
+        int err = chip8_step(chip8);
+        if (err != CHIP8_OK){
+            return err;
+        }
+        done++;
+    }
+    return done;
+}
+
+void chip8_display_size(const Chip8 *chip8, int *width, int *height){
+    *width = chip8_disp_width(chip8);
+    *height = chip8_disp_height(chip8);
+}
+
+bool chip8_frame_ready(Chip8 *chip8){
+    bool ready = chip8->draw_flag;
+    chip8->draw_flag = false;
+    return ready;
+}
+
+bool chip8_sound_on(const Chip8 *chip8){
+    return chip8->sound_timer > 0;
+}
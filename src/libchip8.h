@@ -0,0 +1,113 @@
+#ifndef LIBCHIP8_H
+#define LIBCHIP8_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Public interface of libchip8 (make lib: libchip8.a, libchip8.so).
+//
+// The core without SDL, files or global state: a Chip8 is an opaque
+// instance from chip8_new, and everything it needs (RNG included) lives in
+// it. Functions are reentrant; one instance must only be used by one thread
+// at a time, different instances can run on any number of threads. Nothing
+// here prints or aborts: faults come back as Chip8Error codes. A faulting
+// instruction is not executed and the PC stays on it, so the instance can be
+// inspected and the same fault repeats if it is stepped again.
+//
+// In-tree code includes chip8.h instead, which adds the struct layout and
+// the internal helpers on top of this header.
+//
+// Only CHIP8_API functions are exported. The library is built with
+// -fvisibility=hidden, and make lib localizes the hidden symbols in
+// libchip8.a too, so internal names such as load_rom or op_00E0 cannot
+// clash with the embedding program.
+
+#if defined(__GNUC__)
+#define CHIP8_API __attribute__((visibility("default")))
+#else
+#define CHIP8_API
+#endif
+
+typedef struct Chip8 Chip8;
+
+// Status codes, 0 or negative
+typedef enum {
+    CHIP8_OK = 0,
+    CHIP8_ERR_IO = -1,          //open/read/map failed, errno is set
+    CHIP8_ERR_TOO_LARGE = -2,   //ROM does not fit above 0x200
+    CHIP8_ERR_FORMAT = -3,      //not a valid file of the expected kind
+    CHIP8_ERR_NOT_FOUND = -4,
+    CHIP8_ERR_NOMEM = -5,
+    CHIP8_ERR_OPCODE = -6,      //undefined instruction at PC
+    CHIP8_ERR_STACK = -7,       //2nnn with 16 calls nested, or 00EE with none
+    CHIP8_ERR_PC = -8           //PC ran off the end of memory
+} Chip8Error;
+
+// Quirks for chip8_set_quirks, same bits as ROM_QUIRK_* in chip8_romlib.h.
+// Only the ones defined here are implemented.
+//
+// Display wait: like the COSMAC VIP, Dxyn waits for the vertical blank, so
+// a ROM draws at most once per 60 Hz frame. After a Dxyn chip8_step does
+// nothing until chip8_timer_tick and chip8_run returns early; in-tree run
+// loops check Chip8.vblank_wait and give up the rest of the frame.
+#define CHIP8_QUIRK_DISPLAY_WAIT 0x10
+
+// Hooks for bots and scripted players, installed with chip8_set_hooks.
+// Every callback gets the instance and ctx; NULL callbacks are skipped.
+// Instruction hooks are dispatched by chip8_run (chip8_step alone never
+// calls them) and on_frame by chip8_timer_tick. Without hooks chip8_run
+// runs its plain loop, so an instance without hooks pays nothing.
+//
+// Between frames, on_frame may read the display and set the keypad for the
+// next frame with chip8_set_keypad, no front end needed. Callbacks may
+// change the instance but must not call chip8_set_hooks or chip8_free on it.
+typedef struct Chip8Hooks {
+    void *ctx;
+    void (*on_frame)(Chip8 *chip8, void *ctx);              //after each chip8_timer_tick
+    void (*on_pc)(Chip8 *chip8, void *ctx, uint16_t pc);    //before an instruction at a chip8_hook_pc address
+    void (*on_mem_write)(Chip8 *chip8, void *ctx, uint16_t addr, uint16_t pc);
+                                                            //after the instruction at pc wrote to a chip8_hook_mem_write
+                                                            //range, addr is the first hooked byte it wrote
+    void (*on_sound_start)(Chip8 *chip8, void *ctx);        //sound timer went from 0 to running
+    void (*on_key_wait)(Chip8 *chip8, void *ctx, uint8_t x);//Fx0A started waiting, the key will go to Vx
+} Chip8Hooks;
+
+// Lifetime. chip8_new returns a reset instance seeded from the clock and
+// its own address, or NULL when out of memory.
+CHIP8_API Chip8 *chip8_new(void);
+CHIP8_API Chip8 *chip8_clone(const Chip8 *src);
+CHIP8_API void chip8_free(Chip8 *chip8);
+
+// Setup
+CHIP8_API int chip8_load(Chip8 *chip8, const uint8_t *rom, size_t len);
+CHIP8_API void chip8_seed(Chip8 *chip8, uint32_t seed);
+CHIP8_API void chip8_set_quirks(Chip8 *chip8, unsigned quirks);
+CHIP8_API void chip8_set_keypad(Chip8 *chip8, uint16_t keys);
+
+// Hooks. chip8_set_hooks copies the callbacks (NULL removes them and every
+// registered address) and returns CHIP8_OK or CHIP8_ERR_NOMEM. Addresses
+// are registered once hooks are set; chip8_clone copies hooks and addresses.
+CHIP8_API int chip8_set_hooks(Chip8 *chip8, const Chip8Hooks *hooks);
+CHIP8_API void chip8_hook_pc(Chip8 *chip8, uint16_t addr, bool on);
+CHIP8_API void chip8_hook_mem_write(Chip8 *chip8, uint16_t start, unsigned len, bool on);
+
+// Execution. chip8_step runs one instruction; chip8_run up to `cycles`,
+// stopping early at a display-wait or a fault, and returns the number run
+// or the fault's Chip8Error. Call chip8_timer_tick at 60 Hz.
+CHIP8_API int chip8_step(Chip8 *chip8);
+CHIP8_API long chip8_run(Chip8 *chip8, long cycles);
+CHIP8_API void chip8_timer_tick(Chip8 *chip8);
+
+// Output. chip8_disp_to_pixels writes the active resolution as ARGB,
+// width pixels per row, at most 128 x 64. chip8_frame_ready reports
+// whether the display changed since the last call.
+CHIP8_API void chip8_display_size(const Chip8 *chip8, int *width, int *height);
+CHIP8_API void chip8_disp_to_pixels(const Chip8 *chip8, uint32_t *pixels);
+CHIP8_API bool chip8_frame_ready(Chip8 *chip8);
+CHIP8_API bool chip8_sound_on(const Chip8 *chip8);
+CHIP8_API uint64_t chip8_state_hash(const Chip8 *chip8);
+
+CHIP8_API const char *chip8_strerror(int err);
+
+#endif
@@ -1,6 +1,7 @@
 //main.c
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <SDL.h>
 #include <stdint.h>
 #include <stdbool.h>
@@ -8,61 +9,362 @@
 #include "chip8.h"
 #include "chip8_sdl.h"
 #include "debug.h"
+#include "chip8_movie.h"
+#include "chip8_shm.h"
+#include "chip8_profile.h"
+#include "chip8_disasm.h"
+#include "chip8_romlib.h"
+#include "chip8_romindex.h"
+#include "chip8_audio.h"
+#include "chip8_metrics.h"
+#include "chip8_tune.h"
+
+#ifndef CHIP8_AOT
+#define CHIP8_AOT 0 //set by `make aot`, ROM is compiled in
+#endif
+
+#if CHIP8_AOT
+#include "chip8_aot.h"
+#endif
+
+#ifndef CHIP8_TRACE
+#define CHIP8_TRACE 0 //set by `make trace`, records every instruction to TRACE_FILE
+#endif
+
+#if CHIP8_TRACE
+#if CHIP8_AOT
+#error "CHIP8_TRACE records chip8_step, it cannot be combined with CHIP8_AOT"
+#endif
+#include "chip8_trace.h"
+#define TRACE_FILE "chip8.trace" //expand with chip8_trace_dump
+static Chip8Trace *trace;
+#endif
 
 #define SCALE 12
 #define CPU_HZ 700.0
 #define TIMER_HZ 60.0
 #define DEBUG_STEP_MODE 1
+#define DEBUG_REWIND (DEBUG_STEP_MODE && !CHIP8_AOT) //reverse stepping, needs per-instruction stepping
 
-#define AUDIO_HZ 44100
-#define BEEP_HZ 440
-#define BEEP_VOLUME 3000
+#if DEBUG_REWIND
+#include "chip8_rewind.h"
+static Chip8Rewind *history;
+#endif
 
-typedef struct {
-    bool enabled; //true when sound_timer > 0
-    int phase;    //tracks position in beep wave
-} BeepState;
+static Chip8Movie *movie; //--record <file>, replay with chip8_replay
+static Chip8Shm *shm;     //--shm <name>, see chip8_shm.h
 
-void audio_callback(void *userdata, Uint8 *stream, int len){
-    BeepState *beep = (BeepState *)userdata;
+#define PROFILE_LIVE_PERIOD 16 //plenty of samples at 700 Hz, costs nothing at that rate
+static Chip8Profile *profile;       //--profile <file>, see chip8_profile.h
+static const char *profile_path;    //annotated listing, written on exit and on L
+static Chip8Metrics metrics;        //see chip8_metrics.h, F3 shows them, --metrics <file> exports them
+static Chip8Tune *tune;             //--tune <file>, adaptive cycles per frame, see chip8_tune.h
 
-    int16_t *samples = (int16_t *)stream;
-    int sample_count = len / sizeof(int16_t);
+#define AUDIO_HZ 44100
+#define AUDIO_SAMPLES 128   //~2.9 ms per callback, see chip8_audio.h
 
-    int period = AUDIO_HZ / BEEP_HZ;
-    int half_period = period / 2;
+void audio_callback(void *userdata, Uint8 *stream, int len){
+    chip8_audio_render((Chip8Audio *)userdata, (int16_t *)stream, len / (int)sizeof(int16_t));
+}
 
-    for (int i = 0; i < sample_count; i++){
-        if (beep->enabled){
-            if (beep->phase < half_period){
-                samples[i] = BEEP_VOLUME;
-            } else {
-                samples[i] = -BEEP_VOLUME;
-            }
+static int cpu_fault;       //Chip8Error that stopped the CPU, CHIP8_OK while it runs
 
-            beep->phase++;
+static void report_fault(const Chip8 *chip8, int err){
+    cpu_fault = err;
+    fprintf(stderr, "CPU stopped: %s at PC 0x%03X\n", chip8_strerror(err), chip8->pc);
+}
 
-            if (beep->phase >= period){
-                beep->phase = 0;
+static bool run_cpu(Chip8 *chip8, double *cpu_accum, double cpu_step){
+    /*
+    Run every whole instruction owed by the accumulator.
+    Returns true if a breakpoint, watchpoint or fault stopped it.
+    */
+#if DEBUG_STEP_MODE
+    //breakpoints or watchpoints set, check around every instruction
+    bool checked = chip8->mem_flags != NULL;
+#else
+    bool checked = false;
+#endif
+#if CHIP8_AOT
+    if (!checked){
+        //recompiled blocks run to completion, overshoot comes off the accumulator
+        int cycles = (int)(*cpu_accum / cpu_step);
+        int ran;
+        int err = chip8_aot_run(chip8, cycles, &ran);
+        *cpu_accum -= ran * cpu_step;
+        if (err != CHIP8_OK){
+            report_fault(chip8, err);
+            *cpu_accum = 0.0;
+            return true;
+        }
+        if (chip8->vblank_wait){
+            //display-wait: the CPU idles until the next timer tick
+            *cpu_accum = 0.0;
+        }
+        return false;
+    }
+    //blocks cannot stop between instructions, step them one at a time
+#endif
+    if (!checked && !profile && !tune){
+        //nothing to look at between instructions, rewind only counts batches
+        while (*cpu_accum >= cpu_step && !chip8->vblank_wait){
+            unsigned owed = (unsigned)(*cpu_accum / cpu_step);
+#if DEBUG_REWIND
+            unsigned room = chip8_rewind_checkpoint(history, chip8);
+            if (owed > room){
+                owed = room;
             }
-        } else {
-            samples[i] = 0;
+#endif
+            unsigned ran = 0;
+            int err = CHIP8_OK;
+            while (ran < owed && !chip8->vblank_wait){
+                ran++;
+#if CHIP8_TRACE
+                err = chip8_trace_step(trace, chip8);
+#else
+                err = chip8_step(chip8);
+#endif
+                if (err != CHIP8_OK){
+                    break;
+                }
+            }
+#if DEBUG_REWIND
+            chip8_rewind_advance(history, ran);
+#endif
+            if (err != CHIP8_OK){
+                report_fault(chip8, err);
+                *cpu_accum = 0.0;
+                return true;
+            }
+            *cpu_accum -= ran * cpu_step;
         }
+        if (chip8->vblank_wait){
+            //display-wait: the CPU idles until the next timer tick
+            *cpu_accum = 0.0;
+        }
+        return false;
+    }
+    if (profile){
+        chip8_profile_resume(profile);
     }
+    while (*cpu_accum >= cpu_step){
+        if (chip8->vblank_wait){
+            //display-wait: the CPU idles until the next timer tick
+            *cpu_accum = 0.0;
+            break;
+        }
+        uint16_t pc = chip8->pc;
+        if (checked && debug_break_hit(chip8)){
+            *cpu_accum = 0.0;
+            return true;
+        }
+        if (profile){
+            chip8_profile_step(profile, chip8);
+        }
+        if (tune){
+            chip8_tune_step(tune, chip8);
+        }
+#if DEBUG_REWIND
+        chip8_rewind_record(history, chip8);
+#endif
+#if CHIP8_TRACE
+        int err = chip8_trace_step(trace, chip8);
+#else
+        int err = chip8_step(chip8);
+#endif
+        if (err != CHIP8_OK){
+            report_fault(chip8, err);
+            *cpu_accum = 0.0;
+            return true;
+        }
+        if (checked && debug_watch_hit(chip8, pc)){
+            *cpu_accum = 0.0;
+            return true;
+        }
+        *cpu_accum -= cpu_step;
+    }
+    return false;
+}
+
+static void write_profile(const Chip8 *chip8){
+    //annotated listing to profile_path, hottest blocks to stdout
+    static Chip8Disasm disasm;
+    chip8_disasm_analyze(&disasm, chip8, profile);
+    FILE *fp = fopen(profile_path, "w");
+    if (!fp){
+        perror("write_profile: fopen");
+        return;
+    }
+    chip8_disasm_print(fp, &disasm, chip8, profile);
+    fprintf(fp, "\n");
+    chip8_disasm_hot_blocks(fp, &disasm, chip8, profile, 20);
+    fclose(fp);
+    printf("\n");
+    chip8_disasm_hot_blocks(stdout, &disasm, chip8, profile, 10);
+    printf("Listing written to %s\n", profile_path);
+}
+
+static uint64_t perf_to_ns(uint64_t counter, uint64_t freq){
+    //split so counter * 1e9 cannot overflow
+    return counter / freq * 1000000000ull + counter % freq * 1000000000ull / freq;
+}
+
+static void timer_tick(Chip8 *chip8){
+    metrics.timer_ticks++;
+    if (tune){
+        chip8_tune_frame(tune, chip8);
+    }
+    if (movie){
+        chip8_movie_tick(movie, chip8);
+    }
+#if DEBUG_REWIND
+    chip8_rewind_timer_tick(history, chip8);
+#else
+    chip8_timer_tick(chip8);
+#endif
 }
 
 int main(int argc, char *argv[]){
     setvbuf(stdout, NULL, _IONBF, 0);
 
+    Chip8 chip8;
+    chip8_reset(&chip8);
+
+#if CHIP8_AOT
+    chip8_aot_load(&chip8);
+    int arg = 1;
+#else
     if(argc < 2){
         fprintf(stderr, "Expected at least 2 args. %d provided. Expected ROM filepath.", argc);
         return 1;
     }
 
-    Chip8 chip8;
-    chip8_reset(&chip8);
     char *filename = argv[1];
-    load_rom(filename, &chip8);
+    if (load_rom(filename, &chip8) != CHIP8_OK){
+        return 1;
+    }
+    int arg = 2;
+#endif
+
+    const char *metrics_path = NULL;
+    const char *record_path = NULL;
+#if !CHIP8_AOT
+    bool quirks_set = false;
+    const char *index_path = NULL;
+    const char *tune_path = NULL;
+    int tune_min = TUNE_MIN;
+    int tune_max = TUNE_MAX;
+#endif
+    for (; arg + 1 < argc; arg += 2){
+        if (strcmp(argv[arg], "--record") == 0){
+            //opened once the quirks are final, they go in the header
+            record_path = argv[arg + 1];
+        } else if (strcmp(argv[arg], "--quirks") == 0){
+            //e.g. --quirks display-wait, names as in roms/library.txt
+            chip8.quirks = (uint8_t)chip8_romlib_parse_quirks(argv[arg + 1]);
+#if !CHIP8_AOT
+            quirks_set = true;
+#endif
+        } else if (strcmp(argv[arg], "--metrics") == 0){
+            //Prometheus text format, rewritten every second
+            metrics_path = argv[arg + 1];
+#if !CHIP8_AOT
+        } else if (strcmp(argv[arg], "--index") == 0){
+            //from tools/chip8_romindex.c: quirks (unless --quirks) and warnings
+            index_path = argv[arg + 1];
+        } else if (strcmp(argv[arg], "--tune") == 0){
+            //per-ROM speeds, read at start and updated on exit
+            tune_path = argv[arg + 1];
+        } else if (strcmp(argv[arg], "--tune-min") == 0){
+            tune_min = atoi(argv[arg + 1]);
+        } else if (strcmp(argv[arg], "--tune-max") == 0){
+            tune_max = atoi(argv[arg + 1]);
+#endif
+        } else if (strcmp(argv[arg], "--profile") == 0){
+#if CHIP8_AOT
+            //recompiled blocks do not go through chip8_profile_step
+            fprintf(stderr, "--profile needs the interpreter, it is not available in the recompiled build\n");
+            return 1;
+#else
+            static Chip8Profile live_profile;
+            chip8_profile_init(&live_profile, PROFILE_LIVE_PERIOD);
+            profile = &live_profile;
+            profile_path = argv[arg + 1];
+#endif
+        } else if (strcmp(argv[arg], "--shm") == 0){
+            shm = chip8_shm_create(argv[arg + 1]);
+            if (!shm){
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "Unknown argument %s\n", argv[arg]);
+            return 1;
+        }
+    }
+
+#if !CHIP8_AOT
+    uint64_t rom_hash = 0;
+    if ((tune_path || index_path) && chip8_rom_hash_file(filename, &rom_hash) != CHIP8_OK){
+        return 1;
+    }
+    if (index_path){
+        Chip8RomIndex index;
+        if (chip8_romindex_open(&index, index_path) != CHIP8_OK){
+            return 1;
+        }
+        const Chip8RomAnalysis *rom = chip8_romindex_find(&index, rom_hash);
+        if (rom){
+            char text[256];
+            chip8_romindex_describe(rom, text, sizeof(text));
+            printf("Index: %s\n", text);
+            if (!quirks_set){
+                chip8.quirks = (uint8_t)rom->quirks;
+            }
+            if (rom->opcodes & ROM_OP_BIT(ROM_OP_0nnn)){
+                printf("Index: 0nnn is reachable, the CPU stops if it gets there\n");
+            }
+            if (rom->opcodes & ROM_OP_BIT(ROM_OP_SKIPPED)){
+                printf("Index: undefined opcodes are reachable, they run as no-ops\n");
+            }
+        } else {
+            printf("Index: %s is not indexed\n", filename);
+        }
+        chip8_romindex_close(&index);
+    }
+    if (tune_path){
+        if (tune_min < 1 || tune_max < tune_min){
+            fprintf(stderr, "--tune-min and --tune-max need 1 <= min <= max\n");
+            return 1;
+        }
+        static Chip8Tune rom_tune;
+        int stored = chip8_tune_load(tune_path, rom_hash);
+        chip8_tune_init(&rom_tune, tune_min, tune_max, stored ? stored : (int)(CPU_HZ / TIMER_HZ + 0.5));
+        tune = &rom_tune;
+        printf("Tuning: starting at %d cycles per frame%s\n", tune->cycles, stored ? " (stored)" : "");
+    }
+#endif
+
+    if (record_path){
+        movie = chip8_movie_record(record_path, &chip8);
+        if (!movie){
+            return 1;
+        }
+    }
+
+#if CHIP8_TRACE
+    trace = chip8_trace_open(TRACE_FILE, &chip8);
+    if (!trace){
+        return 1;
+    }
+#endif
+
+#if DEBUG_REWIND
+    history = chip8_rewind_create(&chip8);
+    if (!history){
+        return 1;
+    }
+    debug_set_rewind(history);
+#endif
 
     //_____SDL Initialization_____
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_AUDIO) != 0){
@@ -89,12 +391,13 @@ int main(int argc, char *argv[]){
         return 1;
     }
 
+    //sized for 128x64, 64x32 uses the top-left corner (see screen below)
     SDL_Texture *texture = SDL_CreateTexture(
         renderer,
         SDL_PIXELFORMAT_ARGB8888,
         SDL_TEXTUREACCESS_STREAMING,
-        DISP_WIDTH,
-        DISP_HEIGHT
+        DISP_HIRES_WIDTH,
+        DISP_HIRES_HEIGHT
     );
     if (!texture) {
         fprintf(stderr, "sdl_setup: SDL_CreateTexture failed: %s\n", SDL_GetError());
@@ -104,7 +407,8 @@ int main(int argc, char *argv[]){
         return 1;
     }
     //______ Audio Setup ______
-    BeepState beep = { false, 0 };
+    Chip8Audio audio;
+    chip8_audio_init(&audio, AUDIO_HZ);
 
     SDL_AudioSpec want;
     SDL_AudioSpec have;
@@ -113,9 +417,9 @@ int main(int argc, char *argv[]){
     want.freq = AUDIO_HZ;
     want.format = AUDIO_S16SYS;
     want.channels = 1;
-    want.samples = 512;
+    want.samples = AUDIO_SAMPLES;
     want.callback = audio_callback;
-    want.userdata = &beep;
+    want.userdata = &audio;
 
     SDL_AudioDeviceID audio_device = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
 
@@ -138,9 +442,15 @@ int main(int argc, char *argv[]){
     double cpu_accum = 0.0;
     double timer_accum = 0.0;
 
-    const double cpu_step = 1.0 / CPU_HZ;
+    double cpu_hz = tune ? tune->cycles * TIMER_HZ : CPU_HZ;
+    double cpu_step = 1.0 / cpu_hz;
     const double timer_step = 1.0 / TIMER_HZ;
 
+    chip8_metrics_init(&metrics, cpu_hz, TIMER_HZ, metrics_path, perf_to_ns(last_timer, perf_freq));
+    metrics.last_cycles = chip8.cycles;
+    bool show_overlay = false;
+    char overlay[256] = "";
+
 #if DEBUG_STEP_MODE
     //_____Debugging_______
     bool debug_paused = true;
@@ -151,10 +461,20 @@ int main(int argc, char *argv[]){
     printf("P     = pause/unpause\n");
     printf("M     = dump memory around PC\n");
     printf("I     = dump memory around I\n");
+    printf("B     = toggle breakpoint at PC\n");
+    printf("N     = toggle write watchpoint on I..I+15\n");
+    printf("K     = toggle read watchpoint on I..I+15\n");
+    printf("G     = clear breakpoints and watchpoints\n");
+    printf("L     = disassemble (with --profile: hottest blocks, listing to the profile file)\n");
+#if DEBUG_REWIND
+    printf("BKSP  = step back one instruction\n");
+    printf("H     = run back to the last breakpoint/watchpoint hit\n");
 #endif
+#endif
+    printf("F3    = toggle the performance overlay\n");
 
     //______ Main Loop ________
-    uint32_t pixels[DISP_WIDTH * DISP_HEIGHT];
+    uint32_t pixels[DISP_HIRES_WIDTH * DISP_HIRES_HEIGHT];
     bool running = true;
 
     while (running){
@@ -164,11 +484,13 @@ int main(int argc, char *argv[]){
         last_timer = now_timer;
 
         //stop large delta
-        if (delta_time > 0.1) delta_time = 0.1;
+        if (delta_time > 0.1){
+            delta_time = 0.1;
+            metrics.clamps++;
+        }
+        bool redraw = false;       //overlay changed
 
-        SDL_LockAudioDevice(audio_device);
-        beep.enabled = chip8.sound_timer > 0;
-        SDL_UnlockAudioDevice(audio_device);
+        chip8_audio_update(&audio, &chip8);
 
         //SDL Events Processing
         SDL_Event event;
@@ -177,6 +499,13 @@ int main(int argc, char *argv[]){
                 running = false;
             }
 
+            if (event.type == SDL_KEYDOWN && event.key.repeat == 0 &&
+                event.key.keysym.scancode == SDL_SCANCODE_F3){
+                show_overlay = !show_overlay;
+                chip8_metrics_summary(&metrics, &audio, overlay, sizeof(overlay));
+                redraw = true;
+            }
+
             if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) {
 #if DEBUG_STEP_MODE
                 if (event.type == SDL_KEYDOWN && event.key.repeat == 0) {
@@ -200,6 +529,52 @@ int main(int argc, char *argv[]){
                             debug_dump_memory(&chip8, chip8.I, 64);
                             break;
 
+                        case SDL_SCANCODE_B:
+                            debug_toggle_breakpoint(&chip8, chip8.pc);
+                            break;
+
+                        case SDL_SCANCODE_N:
+                            debug_toggle_watchpoint(&chip8, chip8.I, 16, CHIP8_WATCH_WRITE);
+                            break;
+
+                        case SDL_SCANCODE_K:
+                            debug_toggle_watchpoint(&chip8, chip8.I, 16, CHIP8_WATCH_READ);
+                            break;
+
+                        case SDL_SCANCODE_G:
+                            debug_clear_points(&chip8);
+                            break;
+
+                        case SDL_SCANCODE_L:
+                            if (profile){
+                                write_profile(&chip8);
+                            } else {
+                                static Chip8Disasm disasm;
+                                chip8_disasm_analyze(&disasm, &chip8, NULL);
+                                chip8_disasm_print(stdout, &disasm, &chip8, NULL);
+                            }
+                            break;
+
+#if DEBUG_REWIND
+                        case SDL_SCANCODE_BACKSPACE:
+                            if (movie){
+                                printf("\nNo reverse stepping while recording a movie\n");
+                                break;
+                            }
+                            debug_paused = true;
+                            debug_reverse_step(&chip8);
+                            break;
+
+                        case SDL_SCANCODE_H:
+                            if (movie){
+                                printf("\nNo reverse stepping while recording a movie\n");
+                                break;
+                            }
+                            debug_paused = true;
+                            debug_reverse_continue(&chip8);
+                            break;
+#endif
+
                         default:
                             break;
                     }
@@ -209,13 +584,22 @@ int main(int argc, char *argv[]){
                 int k = sdl_scancode_to_chip8(event.key.keysym.scancode);
                 if (k != -1) {
                     if (event.type == SDL_KEYDOWN && event.key.repeat == 0) {
-                        chip8.keypad[k] = 1;
+                        chip8.keypad |= (uint16_t)(1u << k);
                     } else if (event.type == SDL_KEYUP) {
-                        chip8.keypad[k] = 0;
+                        chip8.keypad &= (uint16_t)~(1u << k);
                     }
                 }
             }
         }
+        if (shm){
+            chip8_shm_input(shm, &chip8);
+        }
+#if DEBUG_REWIND
+        chip8_rewind_keys(history, &chip8);
+#endif
+        if (movie){
+            chip8_movie_keys(movie, &chip8);
+        }
 
         //CPU cycle
 #if DEBUG_STEP_MODE
@@ -226,52 +610,102 @@ int main(int argc, char *argv[]){
             }
         } else {
             cpu_accum += delta_time;
-
-            while (cpu_accum >= cpu_step){
-                chip8_step(&chip8);
-                cpu_accum -= cpu_step;
+            if (run_cpu(&chip8, &cpu_accum, cpu_step)){
+                debug_paused = true;
+                printf("\nDebug paused = true\n");
             }
 
             timer_accum += delta_time;
 
             while (timer_accum >= timer_step){
-                chip8_timer_tick(&chip8);
+                timer_tick(&chip8);
                 timer_accum -= timer_step;
             }
         }
 #else
         cpu_accum += delta_time;
-
-        while (cpu_accum >= cpu_step){
-            chip8_step(&chip8);
-            cpu_accum -= cpu_step;
+        if (run_cpu(&chip8, &cpu_accum, cpu_step)){
+            running = false;
         }
 
         timer_accum += delta_time;
 
         while (timer_accum >= timer_step){
-            chip8_timer_tick(&chip8);
+            timer_tick(&chip8);
             timer_accum -= timer_step;
         }
 #endif
+        if (tune){
+            //chip8_tune_frame may have moved it at a timer tick
+            metrics.cpu_hz = tune->cycles * TIMER_HZ;
+            cpu_step = 1.0 / metrics.cpu_hz;
+        }
+
+        if (shm){
+            chip8_shm_publish(shm, &chip8);
+        }
+
+        if (chip8_exited(&chip8)){
+            //SUPER-CHIP 00FD
+            running = false;
+        }
+
+        if (chip8_metrics_window(&metrics, perf_to_ns(now_timer, perf_freq), chip8.cycles, &audio) && show_overlay){
+            chip8_metrics_summary(&metrics, &audio, overlay, sizeof(overlay));
+            redraw = true;
+        }
 
         //Update display window if draw flag changed
-        if (chip8.draw_flag){
+        if (redraw || chip8.draw_flag){
+            //active resolution, stretched to the window
+            SDL_Rect screen = { 0, 0, chip8_disp_width(&chip8), chip8_disp_height(&chip8) };
+            uint64_t t0 = SDL_GetPerformanceCounter();
             chip8_disp_to_pixels(&chip8, pixels);
-            SDL_UpdateTexture(texture, NULL, pixels, DISP_WIDTH * (int)sizeof(uint32_t));
+            SDL_UpdateTexture(texture, &screen, pixels, screen.w * (int)sizeof(uint32_t));
+            uint64_t t1 = SDL_GetPerformanceCounter();
             SDL_RenderClear(renderer);
-            SDL_RenderCopy(renderer, texture, NULL, NULL);
+            SDL_RenderCopy(renderer, texture, &screen, NULL);
+            if (show_overlay){
+                sdl_draw_overlay(renderer, overlay, 2);
+            }
             SDL_RenderPresent(renderer);
+            uint64_t t2 = SDL_GetPerformanceCounter();
             chip8.draw_flag = false;
+
+            chip8_hist_add(&metrics.texture, perf_to_ns(t1 - t0, perf_freq));
+            chip8_hist_add(&metrics.present, perf_to_ns(t2 - t1, perf_freq));
+            metrics.frames++;
         }
     }
 
     //Clean up sdl objects
     SDL_CloseAudioDevice(audio_device);
+    chip8_audio_report(stdout, &audio);
     SDL_DestroyTexture(texture);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
 
-    return 0;
+#if CHIP8_TRACE
+    chip8_trace_close(trace);
+#endif
+    chip8_movie_close(movie, &chip8);
+    chip8_shm_close(shm);
+    if (profile){
+        write_profile(&chip8);
+    }
+#if !CHIP8_AOT
+    if (tune){
+        printf("Tuning: %d cycles per frame (%.0f Hz), %s\n", tune->cycles, tune->cycles * TIMER_HZ,
+               tune->settled ? "saved" : tune->frozen ? "timed by CPU speed, left as is" : "not settled yet");
+        if (tune->settled){
+            chip8_tune_save(tune_path, rom_hash, tune->cycles);
+        }
+    }
+#endif
+#if DEBUG_REWIND
+    chip8_rewind_destroy(history);
+#endif
+
+    return cpu_fault == CHIP8_OK ? 0 : 1;
 }
\ No newline at end of file
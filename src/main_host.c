@@ -0,0 +1,362 @@
+//main_host.c
+// Multi-session host, see chip8_host.h.
+//
+//   chip8_host.exe <socket path> [workers] [--lib <pack|dir>]
+//       serve clients (tools/chip8_host_client.c) over a Unix socket,
+//       clients may start library ROMs by hash
+//   chip8_host.exe --bench <rom> <sessions> [seconds] [workers]
+//       run local sessions with scripted input and report deadlines
+#define _GNU_SOURCE //accept4
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "chip8.h"
+#include "chip8_host.h"
+#include "chip8_romlib.h"
+
+#define FRAME_NS (1000000000ull / HOST_FRAME_HZ)
+#define RESYNC_FRAMES 5     //further behind than this, stop trying to catch up
+#define INPUT_PERIOD 20     //bench: frames between keypad changes per session
+#define MAX_CLIENTS 65536
+
+typedef struct {
+    int fd;
+    Chip8Session *session; //NULL until its hello arrived
+    uint8_t *hello;        //HostHello + ROM waiting for the next frame boundary
+    size_t hello_len;
+} Client;
+
+static volatile sig_atomic_t stop;
+static Chip8RomLib *library; //--lib, NULL if none
+
+static void on_signal(int sig){
+    (void)sig;
+    stop = 1;
+}
+
+static void sleep_until(uint64_t t_ns){
+    struct timespec ts = { (time_t)(t_ns / 1000000000ull), (long)(t_ns % 1000000000ull) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && !stop){
+    }
+}
+
+static void report(Chip8Host *host, Chip8HostStats *last){
+    //once a second
+    Chip8HostStats now;
+    chip8_host_stats(host, &now);
+    double fps = now.sessions ? (double)(now.frames - last->frames) / now.sessions : 0.0;
+    printf("sessions %5d  parked %5d  frames/s/session %5.1f  missed %llu  dropped %llu  steals %llu  busy %5.1f%%  overruns %llu\n",
+           now.sessions, now.parked, fps,
+           (unsigned long long)now.missed, (unsigned long long)now.dropped,
+           (unsigned long long)now.steals,
+           (double)(now.busy_ns - last->busy_ns) / (1e9 * host->worker_count) * 100.0,
+           (unsigned long long)host->overruns);
+    *last = now;
+}
+
+static int bench(const char *rom_path, int sessions, double seconds, int workers){
+    FILE *fp = fopen(rom_path, "rb");
+    if (!fp){
+        perror("bench: fopen");
+        return 1;
+    }
+    uint8_t rom[MEM_SIZE - 0x200];
+    size_t rom_len = fread(rom, 1, sizeof(rom), fp);
+    fclose(fp);
+
+    static Chip8Host host;
+    if (!chip8_host_init(&host, workers)){
+        return 1;
+    }
+
+    Chip8Session **list = malloc(sizeof(*list) * (size_t)sessions);
+    if (!list){
+        perror("bench: malloc");
+        chip8_host_shutdown(&host);
+        return 1;
+    }
+    for (int i = 0; i < sessions; i++){
+        list[i] = chip8_host_add(&host, rom, rom_len, -1);
+        if (!list[i]){
+            sessions = i;
+            break;
+        }
+    }
+
+    printf("%d sessions of %s on %d workers for %.0f s\n", sessions, rom_path, workers, seconds);
+
+    Chip8HostStats last;
+    memset(&last, 0, sizeof(last));
+    uint64_t frames = (uint64_t)(seconds * HOST_FRAME_HZ);
+    uint64_t next = chip8_host_now_ns();
+    uint32_t rng = 12345;
+
+    for (uint64_t f = 0; f < frames && !stop; f++){
+        chip8_host_frame_begin(&host, next + FRAME_NS);
+
+        //scripted players, each changing keys every INPUT_PERIOD frames
+        for (int i = (int)(f % INPUT_PERIOD); i < sessions; i += INPUT_PERIOD){
+            rng = rng * 1103515245u + 12345u;
+            uint16_t keys = (rng >> 16) & 1 ? (uint16_t)(1u << ((rng >> 17) & 0xF)) : 0;
+            atomic_store_explicit(&list[i]->input, keys, memory_order_relaxed);
+        }
+
+        chip8_host_frame_wait(&host);
+        next += FRAME_NS;
+        if ((f + 1) % HOST_FRAME_HZ == 0){
+            report(&host, &last);
+        }
+        sleep_until(next);
+    }
+
+    free(list);
+    chip8_host_shutdown(&host);
+    return 0;
+}
+
+static void client_io(Client *c){
+    /*
+    Drain a client's packets: keypad updates go straight to the session,
+    a hello is kept until the frame boundary
+    */
+    uint8_t packet[sizeof(HostHello) + MEM_SIZE];
+    ssize_t n;
+    while ((n = recv(c->fd, packet, sizeof(packet), 0)) > 0){
+        if (c->session && n == sizeof(uint16_t)){
+            uint16_t keys;
+            memcpy(&keys, packet, sizeof(keys));
+            atomic_store_explicit(&c->session->input, keys, memory_order_relaxed);
+        } else if (!c->session && !c->hello && n >= (ssize_t)sizeof(HostHello)){
+            c->hello = malloc((size_t)n);
+            if (c->hello){
+                memcpy(c->hello, packet, (size_t)n);
+                c->hello_len = (size_t)n;
+            }
+        }
+    }
+
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)){
+        if (c->session){
+            //workers may be running it, the host removes it after the frame
+            atomic_store(&c->session->closing, true);
+        } else {
+            close(c->fd);
+            c->fd = -1;
+        }
+    }
+}
+
+static void start_sessions(Chip8Host *host, Client *clients, int client_count){
+    //between frames: turn pending hellos into sessions
+    for (int i = 0; i < client_count; i++){
+        Client *c = &clients[i];
+        if (!c->hello){
+            continue;
+        }
+        HostHello hello;
+        memcpy(&hello, c->hello, sizeof(hello));
+        const uint8_t *rom = c->hello + sizeof(hello);
+        size_t rom_len = hello.rom_len;
+        const Chip8RomInfo *info = NULL;
+        if (rom_len == 0 && library && c->hello_len == sizeof(hello) + sizeof(uint64_t)){
+            //by hash: the ROM comes straight from the mapped library
+            uint64_t hash;
+            memcpy(&hash, rom, sizeof(hash));
+            info = chip8_romlib_find(library, hash);
+            rom = info ? chip8_romlib_data(library, info) : NULL;
+            rom_len = info ? info->length : 0;
+        } else if (c->hello_len != sizeof(hello) + rom_len){
+            rom = NULL;
+        }
+        if (c->fd < 0 || memcmp(hello.magic, HOST_MAGIC, sizeof(hello.magic)) != 0 || !rom ||
+            !(c->session = chip8_host_add(host, rom, rom_len, c->fd))){
+            if (c->fd >= 0){
+                close(c->fd);
+                c->fd = -1;
+            }
+        } else if (info){
+            //the library's recommended quirks, display-wait ends the session's frame early
+            c->session->chip8.quirks = (uint8_t)info->quirks;
+        }
+        free(c->hello);
+        c->hello = NULL;
+    }
+}
+
+static int drop_closed(Chip8Host *host, Client *clients, int client_count){
+    //between frames: remove sessions whose client left, returns the new count
+    for (int i = 0; i < client_count; ){
+        Client *c = &clients[i];
+        if (c->session && atomic_load(&c->session->closing)){
+            chip8_host_remove(host, c->session); //closes fd
+            c->fd = -1;
+        }
+        if (c->fd < 0){
+            free(c->hello);
+            clients[i] = clients[--client_count];
+            continue;
+        }
+        i++;
+    }
+    return client_count;
+}
+
+static int serve(const char *path, int workers){
+    int listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK, 0);
+    if (listen_fd < 0){
+        perror("serve: socket");
+        return 1;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    unlink(path);
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_fd, 1024) != 0){
+        perror("serve: bind/listen");
+        close(listen_fd);
+        return 1;
+    }
+
+    Client *clients = calloc(MAX_CLIENTS, sizeof(*clients));
+    struct pollfd *fds = calloc(MAX_CLIENTS + 1, sizeof(*fds));
+    if (!clients || !fds){
+        perror("serve: calloc");
+        free(clients);
+        close(listen_fd);
+        return 1;
+    }
+
+    static Chip8Host host;
+    if (!chip8_host_init(&host, workers)){
+        free(clients);
+        free(fds);
+        close(listen_fd);
+        return 1;
+    }
+
+    printf("serving on %s with %d workers\n", path, workers);
+
+    int client_count = 0;
+    Chip8HostStats last;
+    memset(&last, 0, sizeof(last));
+    uint64_t next = chip8_host_now_ns();
+    uint64_t frame = 0;
+
+    while (!stop){
+        client_count = drop_closed(&host, clients, client_count);
+        chip8_host_frame_begin(&host, next + FRAME_NS);
+
+        //client I/O until the frame is over, workers run meanwhile
+        for (;;){
+            uint64_t now = chip8_host_now_ns();
+            if (now >= next + FRAME_NS || stop){
+                break;
+            }
+
+            int polled = client_count;
+            fds[0].fd = listen_fd;
+            fds[0].events = POLLIN;
+            for (int i = 0; i < polled; i++){
+                fds[i + 1].fd = clients[i].fd;
+                fds[i + 1].events = POLLIN;
+            }
+            int timeout_ms = (int)((next + FRAME_NS - now + 999999) / 1000000ull);
+            if (poll(fds, (nfds_t)polled + 1, timeout_ms) <= 0){
+                continue;
+            }
+
+            for (int i = 0; i < polled; i++){
+                if (fds[i + 1].revents && clients[i].fd >= 0){
+                    client_io(&clients[i]);
+                }
+            }
+
+            if (fds[0].revents & POLLIN){
+                int fd;
+                while (client_count < MAX_CLIENTS && (fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK)) >= 0){
+                    memset(&clients[client_count], 0, sizeof(Client));
+                    clients[client_count].fd = fd;
+                    client_count++;
+                }
+            }
+        }
+
+        chip8_host_frame_wait(&host);
+        start_sessions(&host, clients, client_count);
+
+        frame++;
+        next += FRAME_NS;
+        uint64_t now = chip8_host_now_ns();
+        if (now > next + RESYNC_FRAMES * FRAME_NS){
+            next = now;
+        }
+        if (frame % HOST_FRAME_HZ == 0){
+            report(&host, &last);
+        }
+    }
+
+    chip8_host_shutdown(&host); //closes the session sockets
+    for (int i = 0; i < client_count; i++){
+        if (!clients[i].session && clients[i].fd >= 0){
+            close(clients[i].fd);
+        }
+        free(clients[i].hello);
+    }
+    free(clients);
+    free(fds);
+    close(listen_fd);
+    unlink(path);
+    return 0;
+}
+
+int main(int argc, char *argv[]){
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    int cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (argc >= 4 && strcmp(argv[1], "--bench") == 0){
+        int sessions = atoi(argv[3]);
+        double seconds = argc > 4 ? atof(argv[4]) : 10.0;
+        int workers = argc > 5 ? atoi(argv[5]) : cpus;
+        return bench(argv[2], sessions, seconds, workers);
+    }
+    if (argc >= 2 && argv[1][0] != '-'){
+        int workers = cpus;
+        static Chip8RomLib lib;
+        for (int arg = 2; arg < argc; arg++){
+            if (strcmp(argv[arg], "--lib") == 0 && arg + 1 < argc){
+                int err = chip8_romlib_open(&lib, argv[++arg]);
+                if (err != CHIP8_OK){
+                    fprintf(stderr, "%s: %s\n", argv[arg], chip8_strerror(err));
+                    return 1;
+                }
+                library = &lib;
+            } else {
+                workers = atoi(argv[arg]);
+            }
+        }
+        int status = serve(argv[1], workers);
+        if (library){
+            chip8_romlib_close(library);
+        }
+        return status;
+    }
+
+    fprintf(stderr, "Usage: %s <socket path> [workers] [--lib <pack|dir>]\n"
+                    "       %s --bench <rom> <sessions> [seconds] [workers]\n", argv[0], argv[0]);
+    return 1;
+}
@@ -0,0 +1,91 @@
+//main_term.c
+// Terminal front end: chip8_term.exe <rom> [--braille]
+// Keys as in the SDL build (1234/QWER/ASDF/ZXCV), Ctrl-C quits.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "chip8.h"
+#include "chip8_term.h"
+
+#define CPU_HZ 700.0 //same as main.c
+#define TIMER_HZ 60.0
+
+static double now_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[]){
+    if (argc < 2){
+        fprintf(stderr, "Usage: %s <rom> [--braille]\n", argv[0]);
+        return 1;
+    }
+    int mode = argc > 2 && strcmp(argv[2], "--braille") == 0 ? TERM_BRAILLE : TERM_HALF_BLOCK;
+
+    Chip8 chip8;
+    chip8_reset(&chip8);
+    if (load_rom(argv[1], &chip8) != CHIP8_OK){
+        return 1;
+    }
+
+    static Chip8Term term;
+    if (!term_open(&term, mode)){
+        return 1;
+    }
+
+    const double cpu_step = 1.0 / CPU_HZ;
+    const double frame_step = 1.0 / TIMER_HZ;
+    double cpu_accum = 0.0;
+    double render_time = 0.0;
+    double next_frame = now_seconds();
+
+    //one pass per 60 Hz frame: input, CPU, timers, then the screen
+    int fault = CHIP8_OK;
+    while (fault == CHIP8_OK && term_poll_keys(&term, &chip8)){
+        cpu_accum += frame_step;
+        while (cpu_accum >= cpu_step && !chip8.vblank_wait){
+            fault = chip8_step(&chip8);
+            if (fault != CHIP8_OK){
+                break;
+            }
+            cpu_accum -= cpu_step;
+        }
+        if (chip8.vblank_wait){
+            cpu_accum = 0.0;
+        }
+        chip8_timer_tick(&chip8);
+
+        double t0 = now_seconds();
+        term_render(&term, &chip8);
+        render_time += now_seconds() - t0;
+        chip8.draw_flag = false;
+
+        next_frame += frame_step;
+        double wait = next_frame - now_seconds();
+        if (wait > 0.0){
+            struct timespec ts = { (time_t)wait, (long)((wait - (double)(time_t)wait) * 1e9) };
+            nanosleep(&ts, NULL);
+        } else if (wait < -0.1){
+            //fell behind (suspended, slow link), do not try to catch up
+            next_frame = now_seconds();
+        }
+    }
+
+    term_close(&term);
+
+    if (fault != CHIP8_OK){
+        fprintf(stderr, "CPU stopped: %s at PC 0x%03X\n", chip8_strerror(fault), chip8.pc);
+    }
+
+    if (term.frames){
+        printf("%llu frames, %.1f bytes/frame, %.1f us/frame rendering\n",
+               (unsigned long long)term.frames, (double)term.bytes / (double)term.frames,
+               render_time / (double)term.frames * 1e6);
+    }
+    return fault == CHIP8_OK ? 0 : 1;
+}
@@ -0,0 +1,592 @@
+//tools/chip8_aotc.c
+// Static ROM-to-C recompiler.
+//
+// Usage: chip8_aotc <rom> <out.c> [rom index]
+//
+// Walks the ROM's control flow from 0x200 and writes a C file with one label
+// per basic block. Each block calls the op_* handlers directly, so there is no
+// fetch/decode at run time. Anything that cannot be resolved statically falls
+// back to chip8_step:
+//   - Bnnn targets and 00EE returns go through a switch on PC, and unknown
+//     addresses are interpreted until PC lands on a known block again
+//   - Fx33/Fx55 writes that change a code byte invalidate the blocks that
+//     contain it, those blocks are interpreted from then on
+//
+// With a ROM index (tools/chip8_romindex.c) whose record says no store can
+// reach code, the write checks and the per-block validity tests are left
+// out.
+//
+// roms/smc-*.ch8 patch their own code in ways the checks have missed before.
+// Built with make aot, each has to end on the same PC and V2/V3 as the
+// interpreter: jump-to-self at 0x218 with V2 = 0 and V3 = 7.
+#include "chip8.h"
+#include "chip8_romindex.h"
+#include "chip8_romlib.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+
+typedef enum {
+    INSN_PLAIN,       //falls through to pc + 2
+    INSN_JUMP,        //1nnn
+    INSN_CALL,        //2nnn
+    INSN_RET,         //00EE
+    INSN_SKIP,        //3xkk 4xkk 5xy0 9xy0 Ex9E ExA1
+    INSN_INDIRECT,    //Bnnn
+    INSN_WAIT_KEY,    //Fx0A and 00FD, may rewind pc
+    INSN_MEM_WRITE,   //Fx33 Fx55
+    INSN_DRAW,        //Dxyn, may start a display-wait
+    INSN_UNKNOWN      //asserts in chip8_step
+} InsnKind;
+
+typedef struct {
+    uint16_t start;
+    int count; //instructions in block
+} Block;
+
+static Chip8 image; //ROM as load_rom leaves it in memory
+
+static bool insn_start[MEM_SIZE];
+static bool leader[MEM_SIZE];
+static int block_at[MEM_SIZE]; //block index + 1, 0 = none
+static uint16_t block_of[MEM_SIZE]; //block index + 1 owning each code byte
+static Block blocks[MEM_SIZE];
+static int block_count;
+static bool has_mem_write;
+static bool check_writes = true; //false when the ROM index rules out self-modification
+
+
+static uint16_t read_opcode(uint16_t addr){
+    return (uint16_t)((chip8_mem_read(&image, addr) << 8) | chip8_mem_read(&image, addr + 1));
+}
+
+static InsnKind classify(uint16_t opcode){
+    /*
+    Mirror of the decode in chip8_step.
+    Sub-opcodes that chip8_step silently ignores are INSN_PLAIN no-ops.
+    */
+    switch (opcode & 0xF000){
+    case 0x0000:
+        if (opcode == 0x00E0) return INSN_PLAIN;
+        if (opcode == 0x00EE) return INSN_RET;
+        if (opcode == 0x00FD) return INSN_WAIT_KEY;
+        if ((opcode & 0xFFF0) == 0x00C0 || (opcode >= 0x00FB && opcode <= 0x00FF)) return INSN_PLAIN;
+        return INSN_UNKNOWN;
+    case 0x1000: return INSN_JUMP;
+    case 0x2000: return INSN_CALL;
+    case 0x3000:
+    case 0x4000:
+    case 0x5000:
+    case 0x9000: return INSN_SKIP;
+    case 0xB000: return INSN_INDIRECT;
+    case 0xD000: return INSN_DRAW;
+    case 0xE000:
+        if ((opcode & 0xF0FF) == 0xE09E || (opcode & 0xF0FF) == 0xE0A1) return INSN_SKIP;
+        return INSN_PLAIN;
+    case 0xF000:
+        switch (opcode & 0xF0FF){
+        case 0xF00A: return INSN_WAIT_KEY;
+        case 0xF033:
+        case 0xF055: return INSN_MEM_WRITE;
+        default: return INSN_PLAIN;
+        }
+    default:
+        return INSN_PLAIN;
+    }
+}
+
+static bool is_terminator(InsnKind kind){
+    return kind != INSN_PLAIN;
+}
+
+static bool valid_pc(uint32_t addr){
+    return addr <= MEM_SIZE - 2;
+}
+
+
+static void discover(void){
+    /*
+    Worklist pass over every reachable instruction from 0x200.
+    Marks instruction starts and block leaders.
+    */
+    static uint16_t worklist[MEM_SIZE * 2];
+    int top = 0;
+
+    worklist[top++] = 0x200;
+    leader[0x200] = true;
+
+    while (top > 0){
+        uint16_t addr = worklist[--top];
+
+        if (!valid_pc(addr) || insn_start[addr]){
+            continue;
+        }
+        insn_start[addr] = true;
+
+        uint16_t opcode = read_opcode(addr);
+        uint16_t nnn = opcode & 0x0FFF;
+
+        switch (classify(opcode)){
+        case INSN_PLAIN:
+            worklist[top++] = addr + 2;
+            break;
+
+        case INSN_JUMP:
+            leader[nnn] = true;
+            worklist[top++] = nnn;
+            break;
+
+        case INSN_CALL:
+            leader[nnn] = true;
+            worklist[top++] = nnn;
+            //return point is reached through the 00EE dispatch
+            if (valid_pc(addr + 2)){
+                leader[addr + 2] = true;
+                worklist[top++] = addr + 2;
+            }
+            break;
+
+        case INSN_SKIP:
+            if (valid_pc(addr + 2)){
+                leader[addr + 2] = true;
+                worklist[top++] = addr + 2;
+            }
+            if (valid_pc(addr + 4)){
+                leader[addr + 4] = true;
+                worklist[top++] = addr + 4;
+            }
+            break;
+
+        case INSN_WAIT_KEY:
+            //Fx0A rewinds pc to itself while waiting
+            leader[addr] = true;
+            /* fall through */
+        case INSN_MEM_WRITE:
+        case INSN_DRAW:
+            if (valid_pc(addr + 2)){
+                leader[addr + 2] = true;
+                worklist[top++] = addr + 2;
+            }
+            break;
+
+        case INSN_RET:
+        case INSN_INDIRECT:
+        case INSN_UNKNOWN:
+            break;
+        }
+    }
+}
+
+static void form_blocks(void){
+    for (uint32_t addr = 0; addr < MEM_SIZE; addr++){
+        if (!leader[addr] || !insn_start[addr]){
+            continue;
+        }
+
+        Block *b = &blocks[block_count];
+        b->start = (uint16_t)addr;
+        b->count = 0;
+        block_count++;
+        block_at[addr] = block_count;
+
+        uint32_t pc = addr;
+        while (true){
+            b->count++;
+
+            for (uint32_t i = pc; i < pc + 2; i++){
+                //bytes shared by two blocks (jump into the middle of an
+                //instruction) invalidate everything when written
+                block_of[i] = (block_of[i] == 0) ? (uint16_t)block_count : 0xFFFF;
+            }
+
+            InsnKind kind = classify(read_opcode((uint16_t)pc));
+            if (kind == INSN_MEM_WRITE){
+                has_mem_write = true;
+            }
+            if (is_terminator(kind)){
+                break;
+            }
+
+            pc += 2;
+            if (!valid_pc(pc) || !insn_start[pc] || leader[pc]){
+                break;
+            }
+        }
+    }
+}
+
+
+static void emit_op(FILE *out, uint16_t opcode){
+    /*
+    Emit the op_* call chip8_step would make for this opcode.
+    */
+    unsigned nnn = opcode & 0x0FFF;
+    unsigned n = opcode & 0x000F;
+    unsigned x = (opcode & 0x0F00) >> 8;
+    unsigned y = (opcode & 0x00F0) >> 4;
+    unsigned kk = opcode & 0x00FF;
+
+    switch (opcode & 0xF000){
+    case 0x0000:
+        if (opcode == 0x00E0) fprintf(out, "    op_00E0(chip8);\n");
+        else if (opcode == 0x00FB) fprintf(out, "    op_00FB(chip8);\n");
+        else if (opcode == 0x00FC) fprintf(out, "    op_00FC(chip8);\n");
+        else if (opcode == 0x00FD) fprintf(out, "    op_00FD(chip8);\n");
+        else if (opcode == 0x00FE || opcode == 0x00FF) fprintf(out, "    op_00FE(chip8, %s);\n", opcode == 0x00FF ? "true" : "false");
+        else if ((opcode & 0xFFF0) == 0x00C0) fprintf(out, "    op_00Cn(chip8, 0x%X);\n", n);
+        break;
+    case 0x3000: fprintf(out, "    op_3xkk(chip8, 0x%X, 0x%02X);\n", x, kk); break;
+    case 0x4000: fprintf(out, "    op_4xkk(chip8, 0x%X, 0x%02X);\n", x, kk); break;
+    case 0x5000: fprintf(out, "    op_5xy0(chip8, 0x%X, 0x%X);\n", x, y); break;
+    case 0x6000: fprintf(out, "    op_6xkk(chip8, 0x%X, 0x%02X);\n", x, kk); break;
+    case 0x7000: fprintf(out, "    op_7xkk(chip8, 0x%X, 0x%02X);\n", x, kk); break;
+    case 0x8000:
+        switch (n){
+        case 0x0: fprintf(out, "    op_8xy0(chip8, 0x%X, 0x%X);\n", x, y); break;
+        case 0x1: fprintf(out, "    op_8xy1(chip8, 0x%X, 0x%X);\n", x, y); break;
+        case 0x2: fprintf(out, "    op_8xy2(chip8, 0x%X, 0x%X);\n", x, y); break;
+        case 0x3: fprintf(out, "    op_8xy3(chip8, 0x%X, 0x%X);\n", x, y); break;
+        case 0x4: fprintf(out, "    op_8xy4(chip8, 0x%X, 0x%X);\n", x, y); break;
+        case 0x5: fprintf(out, "    op_8xy5(chip8, 0x%X, 0x%X);\n", x, y); break;
+        case 0x6: fprintf(out, "    op_8xy6(chip8, 0x%X, 0x%X);\n", x, y); break;
+        case 0x7: fprintf(out, "    op_8xy7(chip8, 0x%X, 0x%X);\n", x, y); break;
+        case 0xE: fprintf(out, "    op_8xyE(chip8, 0x%X, 0x%X);\n", x, y); break;
+        default: fprintf(out, "    //0x%04X: no-op\n", opcode); break;
+        }
+        break;
+    case 0x9000: fprintf(out, "    op_9xy0(chip8, 0x%X, 0x%X);\n", x, y); break;
+    case 0xA000: fprintf(out, "    op_Annn(chip8, 0x%03X);\n", nnn); break;
+    case 0xC000: fprintf(out, "    op_Cxkk(chip8, 0x%X, 0x%02X);\n", x, kk); break;
+    case 0xD000: fprintf(out, "    op_Dxyn(chip8, 0x%X, 0x%X, 0x%X);\n", x, y, n); break;
+    case 0xE000:
+        switch (opcode & 0xF0FF){
+        case 0xE09E: fprintf(out, "    op_Ex9E(chip8, 0x%X);\n", x); break;
+        case 0xE0A1: fprintf(out, "    op_ExA1(chip8, 0x%X);\n", x); break;
+        default: fprintf(out, "    //0x%04X: no-op\n", opcode); break;
+        }
+        break;
+    case 0xF000:
+        switch (opcode & 0xF0FF){
+        case 0xF002: fprintf(out, "    op_F002(chip8);\n"); break;
+        case 0xF007: fprintf(out, "    op_Fx07(chip8, 0x%X);\n", x); break;
+        case 0xF00A: fprintf(out, "    op_Fx0A(chip8, 0x%X);\n", x); break;
+        case 0xF015: fprintf(out, "    op_Fx15(chip8, 0x%X);\n", x); break;
+        case 0xF018: fprintf(out, "    op_Fx18(chip8, 0x%X);\n", x); break;
+        case 0xF01E: fprintf(out, "    op_Fx1E(chip8, 0x%X);\n", x); break;
+        case 0xF029: fprintf(out, "    op_Fx29(chip8, 0x%X);\n", x); break;
+        case 0xF030: fprintf(out, "    op_Fx30(chip8, 0x%X);\n", x); break;
+        case 0xF03A: fprintf(out, "    op_Fx3A(chip8, 0x%X);\n", x); break;
+        case 0xF033: fprintf(out, "    op_Fx33(chip8, 0x%X);\n", x); break;
+        case 0xF055: fprintf(out, "    op_Fx55(chip8, 0x%X);\n", x); break;
+        case 0xF065: fprintf(out, "    op_Fx65(chip8, 0x%X);\n", x); break;
+        case 0xF075: fprintf(out, "    op_Fx75(chip8, 0x%X);\n", x); break;
+        case 0xF085: fprintf(out, "    op_Fx85(chip8, 0x%X);\n", x); break;
+        default: fprintf(out, "    //0x%04X: no-op\n", opcode); break;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void emit_chain(FILE *out, int count, uint16_t target){
+    /*
+    Charge the block's cycles, return if the budget ran out,
+    otherwise jump straight to the next block.
+    */
+    fprintf(out, "    cycles -= %d;\n", count);
+    fprintf(out, "    if (cycles <= 0) return cycles;\n");
+    if (valid_pc(target) && block_at[target]){
+        fprintf(out, "    goto b_%03X;\n", target);
+    } else {
+        fprintf(out, "    goto dispatch;\n");
+    }
+}
+
+static void emit_fault_check(FILE *out, const char *call, uint16_t pc, int count){
+    /*
+    A 2nnn/00EE that fails ends the block: the PC goes back on it and only
+    the instructions before it count
+    */
+    fprintf(out, "    if ((*err = %s) != CHIP8_OK){\n", call);
+    fprintf(out, "        chip8->pc = 0x%03X;\n", pc);
+    fprintf(out, "        return cycles - %d;\n", count - 1);
+    fprintf(out, "    }\n");
+}
+
+static void emit_block(FILE *out, const Block *b){
+    uint16_t pc = b->start;
+
+    fprintf(out, "b_%03X:\n", b->start);
+    if (check_writes){
+        fprintf(out, "    if (!aot_valid[%d]) goto interp;\n", block_at[b->start] - 1);
+    }
+
+    for (int i = 0; i < b->count - 1; i++){
+        emit_op(out, read_opcode(pc));
+        pc += 2;
+    }
+
+    uint16_t opcode = read_opcode(pc);
+    uint16_t next = pc + 2;
+    uint16_t nnn = opcode & 0x0FFF;
+    unsigned x = (opcode & 0x0F00) >> 8;
+
+    switch (classify(opcode)){
+    case INSN_PLAIN:
+        //block split by a leader, fall through to it
+        emit_op(out, opcode);
+        fprintf(out, "    chip8->pc = 0x%03X;\n", next);
+        emit_chain(out, b->count, next);
+        break;
+
+    case INSN_JUMP:
+        fprintf(out, "    chip8->pc = 0x%03X;\n", nnn);
+        emit_chain(out, b->count, nnn);
+        break;
+
+    case INSN_CALL: {
+        char call[32];
+        snprintf(call, sizeof(call), "op_2nnn(chip8, 0x%03X)", nnn);
+        fprintf(out, "    chip8->pc = 0x%03X;\n", next);
+        emit_fault_check(out, call, pc, b->count);
+        emit_chain(out, b->count, nnn);
+        break;
+    }
+
+    case INSN_RET:
+        emit_fault_check(out, "op_00EE(chip8)", pc, b->count);
+        fprintf(out, "    cycles -= %d;\n", b->count);
+        fprintf(out, "    if (cycles <= 0) return cycles;\n");
+        fprintf(out, "    goto dispatch;\n");
+        break;
+
+    case INSN_SKIP:
+        fprintf(out, "    chip8->pc = 0x%03X;\n", next);
+        emit_op(out, opcode);
+        fprintf(out, "    cycles -= %d;\n", b->count);
+        fprintf(out, "    if (cycles <= 0) return cycles;\n");
+        if (valid_pc(next + 2) && block_at[next + 2]){
+            fprintf(out, "    if (chip8->pc == 0x%03X) goto b_%03X;\n", next + 2, next + 2);
+        }
+        if (valid_pc(next) && block_at[next]){
+            fprintf(out, "    if (chip8->pc == 0x%03X) goto b_%03X;\n", next, next);
+        }
+        fprintf(out, "    goto dispatch;\n");
+        break;
+
+    case INSN_INDIRECT:
+        fprintf(out, "    op_Bnnn(chip8, 0x%03X);\n", nnn);
+        fprintf(out, "    cycles -= %d;\n", b->count);
+        fprintf(out, "    if (cycles <= 0) return cycles;\n");
+        fprintf(out, "    goto dispatch;\n");
+        break;
+
+    case INSN_WAIT_KEY:
+        fprintf(out, "    chip8->pc = 0x%03X;\n", next);
+        emit_op(out, opcode);
+        fprintf(out, "    cycles -= %d;\n", b->count);
+        fprintf(out, "    if (cycles <= 0) return cycles;\n");
+        fprintf(out, "    goto dispatch;\n");
+        break;
+
+    case INSN_MEM_WRITE: {
+        unsigned len = ((opcode & 0xF0FF) == 0xF033) ? 3 : x + 1;
+        if (check_writes){
+            fprintf(out, "    {\n");
+            fprintf(out, "        uint16_t w = chip8->I;\n");
+            emit_op(out, opcode);
+            fprintf(out, "        aot_check_write(chip8, w, %u);\n", len);
+            fprintf(out, "    }\n");
+        } else {
+            emit_op(out, opcode);
+        }
+        fprintf(out, "    chip8->pc = 0x%03X;\n", next);
+        emit_chain(out, b->count, next);
+        break;
+    }
+
+    case INSN_DRAW:
+        //with CHIP8_QUIRK_DISPLAY_WAIT the frame ends here
+        emit_op(out, opcode);
+        fprintf(out, "    chip8->pc = 0x%03X;\n", next);
+        fprintf(out, "    cycles -= %d;\n", b->count);
+        fprintf(out, "    if (cycles <= 0 || chip8->vblank_wait) return cycles;\n");
+        if (valid_pc(next) && block_at[next]){
+            fprintf(out, "    goto b_%03X;\n", next);
+        } else {
+            fprintf(out, "    goto dispatch;\n");
+        }
+        break;
+
+    case INSN_UNKNOWN:
+        //let the interpreter report it
+        fprintf(out, "    chip8->pc = 0x%03X;\n", pc);
+        fprintf(out, "    cycles -= %d;\n", b->count - 1);
+        fprintf(out, "    goto interp;\n");
+        break;
+    }
+
+    fprintf(out, "\n");
+}
+
+static void emit_file(FILE *out, const char *rom_path, size_t rom_len){
+    fprintf(out, "// Generated by chip8_aotc from %s. Do not edit.\n", rom_path);
+    fprintf(out, "#include \"chip8.h\"\n");
+    fprintf(out, "#include \"chip8_opcodes.h\"\n");
+    fprintf(out, "#include \"chip8_aot.h\"\n\n");
+    fprintf(out, "#include <stdint.h>\n");
+    fprintf(out, "#include <string.h>\n\n");
+
+    fprintf(out, "#define AOT_BLOCKS %d\n\n", block_count);
+
+    //original ROM bytes, also used to tell real code changes from rewrites
+    fprintf(out, "static const uint8_t aot_rom[%zu] = {", rom_len ? rom_len : 1);
+    for (size_t i = 0; i < rom_len; i++){
+        fprintf(out, "%s0x%02X,", (i % 16 == 0) ? "\n    " : " ", chip8_mem_read(&image, 0x200 + i));
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "static uint8_t aot_valid[AOT_BLOCKS + 1];\n\n");
+
+    if (has_mem_write && check_writes){
+        //only aot_check_write looks blocks up by address
+        fprintf(out, "//block index + 1 owning each code byte, 0xFFFF = shared\n");
+        fprintf(out, "static const uint16_t aot_block_of[MEM_SIZE] = {\n");
+        for (int addr = 0; addr < MEM_SIZE; addr++){
+            if (block_of[addr]){
+                fprintf(out, "    [0x%03X] = %u,\n", addr, block_of[addr]);
+            }
+        }
+        fprintf(out, "};\n\n");
+
+        fprintf(out,
+            "static void aot_check_write(const Chip8 *chip8, uint16_t start, unsigned len){\n"
+            "    for (unsigned i = 0; i < len; i++){\n"
+            "        //chip8_mem_write wraps I past 0xFFF, so the check has to too\n"
+            "        uint16_t addr = chip8_mem_addr((uint32_t)start + i);\n"
+            "        if (!aot_block_of[addr]){\n"
+            "            continue;\n"
+            "        }\n"
+            "        if (addr >= 0x200 && addr - 0x200u < sizeof(aot_rom) &&\n"
+            "            chip8_mem_read(chip8, addr) == aot_rom[addr - 0x200]){\n"
+            "            continue;\n"
+            "        }\n"
+            "        if (aot_block_of[addr] == 0xFFFF){\n"
+            "            memset(aot_valid, 0, sizeof(aot_valid));\n"
+            "        } else {\n"
+            "            aot_valid[aot_block_of[addr] - 1] = 0;\n"
+            "        }\n"
+            "    }\n"
+            "}\n\n");
+    }
+
+    fprintf(out,
+        "void chip8_aot_load(Chip8 *chip8){\n"
+        "    for (unsigned i = 0; i < %zu; i++){\n"
+        "        chip8_mem_write(chip8, (uint16_t)(0x200 + i), aot_rom[i]);\n"
+        "    }\n"
+        "    memset(aot_valid, 1, sizeof(aot_valid));\n"
+        "}\n\n", rom_len);
+
+    fprintf(out,
+        "static int aot_run(Chip8 *chip8, int cycles, int *err){\n"
+        "    if (cycles <= 0 || chip8->vblank_wait) return cycles;\n\n"
+        "dispatch:\n"
+        "    switch (chip8->pc){\n");
+    for (int i = 0; i < block_count; i++){
+        fprintf(out, "    case 0x%03X: goto b_%03X;\n", blocks[i].start, blocks[i].start);
+    }
+    fprintf(out,
+        "    default: break;\n"
+        "    }\n\n"
+        "interp: __attribute__((unused)); //unreferenced when no block can fall back\n"
+        "    if ((*err = chip8_step(chip8)) != CHIP8_OK) return cycles;\n"
+        "    cycles--;\n"
+        "    if (cycles <= 0 || chip8->vblank_wait) return cycles;\n"
+        "    goto dispatch;\n\n");
+
+    for (int i = 0; i < block_count; i++){
+        emit_block(out, &blocks[i]);
+    }
+
+    fprintf(out, "}\n\n");
+
+    fprintf(out,
+        "int chip8_aot_run(Chip8 *chip8, int cycles, int *ran){\n"
+        "    /*\n"
+        "    Run at least `cycles` instructions, stopping at the first block\n"
+        "    boundary past the budget, at a display-wait or at a fault (the\n"
+        "    PC stays on the faulting instruction). Returns CHIP8_OK or the\n"
+        "    Chip8Error of the fault; *ran is the instructions that ran.\n"
+        "    */\n"
+        "    uint64_t start = chip8->cycles;\n"
+        "    int err = CHIP8_OK;\n"
+        "    int left = aot_run(chip8, cycles, &err);\n"
+        "    //blocks do not count instructions one by one, the interp path does\n"
+        "    *ran = cycles - left;\n"
+        "    chip8->cycles = start + (uint64_t)*ran;\n"
+        "    return err;\n"
+        "}\n");
+}
+
+int main(int argc, char *argv[]){
+    if (argc < 3){
+        fprintf(stderr, "Usage: %s <rom> <out.c> [rom index]\n", argv[0]);
+        return 1;
+    }
+
+    chip8_reset(&image);
+    if (load_rom(argv[1], &image) != CHIP8_OK){
+        return 1;
+    }
+
+    //load_rom does not report the length, find it from the file itself
+    FILE *fp = fopen(argv[1], "rb");
+    if (!fp){
+        perror("chip8_aotc: fopen");
+        return 1;
+    }
+    fseek(fp, 0, SEEK_END);
+    long rom_len = ftell(fp);
+    fclose(fp);
+
+    if (rom_len < 0 || rom_len > MEM_SIZE - 0x200){
+        fprintf(stderr, "chip8_aotc: bad ROM length %ld\n", rom_len);
+        return 1;
+    }
+
+    discover();
+    form_blocks();
+
+    if (argc > 3){
+        Chip8RomIndex index;
+        uint64_t hash;
+        if (chip8_romindex_open(&index, argv[3]) == CHIP8_OK && chip8_rom_hash_file(argv[1], &hash) == CHIP8_OK){
+            const Chip8RomAnalysis *rom = chip8_romindex_find(&index, hash);
+            check_writes = !rom || (rom->features & ROM_FEAT_SMC_POSSIBLE);
+            printf("chip8_aotc: %s\n", !rom ? "ROM not in the index, write checks kept" :
+                   check_writes ? "index: stores may reach code, write checks kept" :
+                                  "index: no store reaches code, write checks left out");
+        }
+        chip8_romindex_close(&index);
+    }
+
+    FILE *out = fopen(argv[2], "w");
+    if (!out){
+        perror("chip8_aotc: fopen(out)");
+        return 1;
+    }
+    emit_file(out, argv[1], (size_t)rom_len);
+    fclose(out);
+
+    int insns = 0;
+    for (int i = 0; i < block_count; i++){
+        insns += blocks[i].count;
+    }
+    printf("chip8_aotc: %d blocks, %d instructions -> %s\n", block_count, insns, argv[2]);
+    return 0;
+}
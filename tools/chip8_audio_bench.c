@@ -0,0 +1,157 @@
+//tools/chip8_audio_bench.c
+// XO-CHIP mixer benchmark and self-check.
+//
+// Usage: chip8_audio_bench [seconds] [samples per buffer]
+//
+// Renders `seconds` (default 600) of 44.1 kHz audio unthrottled, in buffers
+// of 128 samples by default, while a second thread plays the emulator: it
+// changes the pattern, pitch and sound timer of a Chip8 at random and calls
+// chip8_audio_update every ~100 us, far more often than the 60 Hz main loop.
+// Every buffer is checked against a plain per-sample, per-byte reference
+// from the same phase and state, and the render cost is reported per
+// buffer and as a share of real time.
+#include "chip8.h"
+#include "chip8_audio.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define OUT_HZ 44100
+#define MAX_SAMPLES 4096
+
+static Chip8Audio audio;
+static atomic_bool done;
+
+static uint64_t now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b){
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void *emulator(void *arg){
+    (void)arg;
+    static Chip8 chip8;
+    uint32_t rng = 0xC8C8C8C8u;
+    struct timespec pause = { 0, 100000 };
+
+    while (!atomic_load_explicit(&done, memory_order_relaxed)){
+        rng = rng * 1103515245u + 12345u;
+        switch ((rng >> 16) & 3){
+        case 0:
+            for (int i = 0; i < 16; i++){
+                rng = rng * 1103515245u + 12345u;
+                chip8.audio_pattern[i] = (uint8_t)(rng >> 24);
+            }
+            break;
+        case 1:
+            chip8.pitch = (uint8_t)(rng >> 24);
+            break;
+        default:
+            chip8.sound_timer = (rng >> 24) & 1 ? 0 : 8;
+            break;
+        }
+        chip8_audio_update(&audio, &chip8);
+        nanosleep(&pause, NULL);
+    }
+    return NULL;
+}
+
+static int reference(const Chip8Audio *a, uint32_t phase, int16_t *out, int count){
+    //the obvious version: one branch per sample, pattern read a byte at a time
+    uint8_t bytes[16];
+    for (int i = 0; i < 8; i++){
+        bytes[i] = (uint8_t)(a->words[0] >> (56 - 8 * i));
+        bytes[8 + i] = (uint8_t)(a->words[1] >> (56 - 8 * i));
+    }
+    for (int i = 0; i < count; i++){
+        if (!a->playing){
+            out[i] = 0;
+            continue;
+        }
+        unsigned bit_index = phase >> AUDIO_PHASE_SHIFT;
+        if (bytes[bit_index / 8] & (0x80 >> (bit_index % 8))){
+            out[i] = AUDIO_VOLUME;
+        } else {
+            out[i] = -AUDIO_VOLUME;
+        }
+        phase += a->play_step;
+    }
+    return count;
+}
+
+int main(int argc, char *argv[]){
+    double seconds = argc > 1 ? atof(argv[1]) : 600.0;
+    int samples = argc > 2 ? atoi(argv[2]) : 128;
+    if (samples < 1 || samples > MAX_SAMPLES){
+        fprintf(stderr, "samples per buffer must be 1-%d\n", MAX_SAMPLES);
+        return 1;
+    }
+    uint64_t buffers = (uint64_t)(seconds * OUT_HZ / samples);
+    uint64_t *cost = malloc(sizeof(*cost) * (buffers ? buffers : 1));
+    if (!cost){
+        perror("malloc");
+        return 1;
+    }
+
+    chip8_audio_init(&audio, OUT_HZ);
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, emulator, NULL) != 0){
+        perror("pthread_create");
+        free(cost);
+        return 1;
+    }
+
+    static int16_t out[MAX_SAMPLES];
+    static int16_t expect[MAX_SAMPLES];
+    uint64_t mismatches = 0;
+    uint64_t playing = 0;
+    for (uint64_t b = 0; b < buffers; b++){
+        uint32_t phase = audio.phase;
+        uint64_t t0 = now_ns();
+        chip8_audio_render(&audio, out, samples);
+        cost[b] = now_ns() - t0;
+
+        //words/play_step/playing now hold what this buffer was rendered from
+        playing += audio.playing;
+        reference(&audio, phase, expect, samples);
+        if (memcmp(out, expect, sizeof(*out) * (size_t)samples) != 0){
+            mismatches++;
+        }
+    }
+    atomic_store(&done, true);
+    pthread_join(thread, NULL);
+
+    if (!buffers){
+        free(cost);
+        return 0;
+    }
+    qsort(cost, buffers, sizeof(*cost), compare_u64);
+    uint64_t total = 0;
+    for (uint64_t b = 0; b < buffers; b++){
+        total += cost[b];
+    }
+    double period_ns = 1e9 * samples / OUT_HZ;
+    printf("%llu buffers of %d samples (%.1f s of audio, %.0f%% with sound on)\n",
+           (unsigned long long)buffers, samples, (double)buffers * samples / OUT_HZ,
+           100.0 * (double)playing / (double)buffers);
+    printf("render: %.0f ns mean, %llu ns p99.9, %llu ns max per buffer, budget %.0f ns\n",
+           (double)total / (double)buffers,
+           (unsigned long long)cost[buffers - 1 - buffers / 1000],
+           (unsigned long long)cost[buffers - 1], period_ns);
+    printf("audio thread CPU: %.4f%% of real time\n", (double)total / ((double)buffers * period_ns) * 100.0);
+    printf("%llu state updates skipped mid-write, %llu buffers differ from the reference\n",
+           (unsigned long long)audio.stats.torn, (unsigned long long)mismatches);
+    free(cost);
+    return mismatches ? 1 : 0;
+}
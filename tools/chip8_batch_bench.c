@@ -0,0 +1,159 @@
+//tools/chip8_batch_bench.c
+// Multi-instance throughput benchmark.
+//
+// Usage: chip8_batch_bench <rom> [instances] [frames]
+//
+// Runs `instances` copies of the ROM for `frames` 60 Hz frames with
+// per-instance keypad input and RNG seeds, once through chip8_batch and
+// once as an array of Chip8 structs through chip8_step, and reports
+// instances x cycles per second for both. Both sides get the same seeds and
+// input, so every lane has to end in the state of its Chip8: the state
+// hashes and errors are compared and any difference fails the run.
+#include "chip8.h"
+#include "chip8_batch.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CPU_HZ 700.0  //same as main.c
+#define TIMER_HZ 60.0
+#define INPUT_PERIOD 30 //frames between keypad changes
+
+static double now_seconds(void){
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static uint16_t next_keys(uint32_t *state){
+    //xorshift32, mostly no key down, otherwise one key
+    uint32_t s = *state;
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    *state = s;
+    return (s & 0x300) ? 0 : (uint16_t)(1u << (s & 0xF));
+}
+
+static void reset_input(uint32_t *input_rng, int instances){
+    //the same key sequence for both runs
+    for (int i = 0; i < instances; i++){
+        input_rng[i] = 0x1234567u + (uint32_t)i * 7919u;
+    }
+}
+
+static void report(const char *name, int instances, int frames, int cycles_per_frame, double elapsed){
+    double lane_cycles = (double)instances * (double)frames * cycles_per_frame;
+    printf("%s: %d instances x %d frames x %d cycles in %.3f s\n",
+           name, instances, frames, cycles_per_frame, elapsed);
+    printf("%.2f M instance-cycles/s\n", lane_cycles / elapsed / 1e6);
+}
+
+int main(int argc, char *argv[]){
+    if (argc < 2){
+        fprintf(stderr, "Usage: %s <rom> [instances] [frames]\n", argv[0]);
+        return 1;
+    }
+
+    int instances = argc > 2 ? atoi(argv[2]) : 1024;
+    int frames = argc > 3 ? atoi(argv[3]) : 600;
+
+    if (instances <= 0 || frames <= 0){
+        fprintf(stderr, "instances and frames must be > 0\n");
+        return 1;
+    }
+
+    int cycles_per_frame = (int)(CPU_HZ / TIMER_HZ);
+
+    Chip8 image;
+    chip8_reset(&image);
+    int err = load_rom(argv[1], &image);
+    if (err != CHIP8_OK){
+        fprintf(stderr, "%s: %s\n", argv[1], chip8_strerror(err));
+        return 1;
+    }
+
+    uint32_t *input_rng = malloc(sizeof(uint32_t) * (size_t)instances);
+    Chip8 *chips = malloc(sizeof(Chip8) * (size_t)instances);
+    int *errors = calloc((size_t)instances, sizeof(int));
+    Chip8Batch *batch = chip8_batch_create(instances);
+    if (!input_rng || !chips || !errors || !batch){
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    //one seed per instance, each lane starts as a copy of its Chip8
+    for (int i = 0; i < instances; i++){
+        chip8_fork(&chips[i], &image);
+        chip8_seed(&chips[i], 0xC0FFEEu + (uint32_t)i);
+        chip8_batch_set(batch, i, &chips[i]);
+    }
+
+    reset_input(input_rng, instances);
+    double start = now_seconds();
+    for (int f = 0; f < frames; f++){
+        if (f % INPUT_PERIOD == 0){
+            for (int i = 0; i < instances; i++){
+                chip8_batch_set_keys(batch, i, next_keys(&input_rng[i]));
+            }
+        }
+        chip8_batch_run(batch, cycles_per_frame);
+        chip8_batch_timer_tick(batch);
+    }
+    double batch_elapsed = now_seconds() - start;
+
+    reset_input(input_rng, instances);
+    start = now_seconds();
+    for (int f = 0; f < frames; f++){
+        for (int i = 0; i < instances; i++){
+            if (f % INPUT_PERIOD == 0){
+                chips[i].keypad = next_keys(&input_rng[i]);
+            }
+            for (int c = 0; c < cycles_per_frame; c++){
+                //a failed instruction fails again on every step, the last result is the one to compare
+                errors[i] = chip8_step(&chips[i]);
+            }
+            chip8_timer_tick(&chips[i]);
+        }
+    }
+    double scalar_elapsed = now_seconds() - start;
+
+    Chip8 lane;
+    chip8_reset(&lane);
+    int differ = 0;
+    int stopped = 0;
+    for (int i = 0; i < instances; i++){
+        chip8_batch_get(batch, i, &lane);
+        int lane_err = chip8_batch_error(batch, i);
+        stopped += lane_err != CHIP8_OK;
+        if (chip8_state_hash(&lane) != chip8_state_hash(&chips[i]) || lane_err != errors[i]){
+            if (!differ){
+                fprintf(stderr, "instance %d: batch pc 0x%03X %s, chip8_step pc 0x%03X %s\n", i,
+                        lane.pc, chip8_strerror(lane_err), chips[i].pc, chip8_strerror(errors[i]));
+            }
+            differ++;
+        }
+    }
+
+    uint64_t total = batch->simd_lane_steps + batch->scalar_lane_steps;
+    printf("lockstep lanes: %.1f%%\n", total ? 100.0 * (double)batch->simd_lane_steps / (double)total : 0.0);
+    report("batch", instances, frames, cycles_per_frame, batch_elapsed);
+    report("scalar", instances, frames, cycles_per_frame, scalar_elapsed);
+    printf("speedup: %.2fx\n", scalar_elapsed / batch_elapsed);
+    printf("state hashes: %s (%d of %d differ, %d stopped on an error)\n",
+           differ ? "MISMATCH" : "match", differ, instances, stopped);
+
+    chip8_release(&lane);
+    for (int i = 0; i < instances; i++){
+        chip8_release(&chips[i]);
+    }
+    chip8_release(&image);
+    chip8_batch_destroy(batch);
+    free(errors);
+    free(chips);
+    free(input_rng);
+    return differ ? 1 : 0;
+}
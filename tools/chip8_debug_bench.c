@@ -0,0 +1,199 @@
+//tools/chip8_debug_bench.c
+// Cost of breakpoint and watchpoint support.
+//
+// Usage: chip8_debug_bench <rom> [cycles]
+//
+// Runs the ROM unthrottled through the plain chip8_step loop with nothing
+// flagged, best of RUNS. `make debugbench` builds this with and without
+// CHIP8_WATCHPOINTS so the two plain numbers can be compared. The
+// watchpoint build also times the checked loop with a breakpoint and a
+// watchpoint set on addresses the ROM never reaches.
+//
+// It also times main.c's run_cpu with nothing set and rewind recording on,
+// frame by frame: the per-instruction loop, which tests for breakpoints,
+// profile and tune and calls chip8_rewind_record before every step, against
+// the bare chip8_step loop that counts for rewind once per batch.
+#include "chip8.h"
+#include "debug.h"
+#include "chip8_rewind.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CPU_HZ 700.0  //same as main.c
+#define TIMER_HZ 60.0
+#define RUNS 5
+#define BIG_FRAME 1000.0 //instructions per frame, a --tune run can get there
+
+static double now_seconds(void){
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static double run(const char *rom, long cycles, int checked){
+    int cycles_per_frame = (int)(CPU_HZ / TIMER_HZ);
+    double best = 0.0;
+
+    for (int r = 0; r < RUNS; r++){
+        Chip8 chip8;
+        chip8_reset(&chip8);
+        load_rom((char *)rom, &chip8);
+        if (checked){
+            debug_toggle_breakpoint(&chip8, MEM_SIZE - 2);
+            debug_toggle_watchpoint(&chip8, MEM_SIZE - 16, 8, CHIP8_WATCH_WRITE);
+        }
+
+        double start = now_seconds();
+        for (long c = 0; c < cycles; c++){
+            if (checked){
+                debug_step_checked(&chip8);
+            } else {
+                chip8_step(&chip8);
+            }
+            if (c % cycles_per_frame == cycles_per_frame - 1){
+                chip8_timer_tick(&chip8);
+            }
+        }
+        double rate = cycles / (now_seconds() - start) / 1e6;
+        if (rate > best){
+            best = rate;
+        }
+
+        free(chip8.mem_flags);
+        chip8_release(&chip8);
+    }
+    return best;
+}
+
+//stand-ins for main.c's --profile/--tune state, never set here
+static void *profile;
+static void *tune;
+static void stand_in_step(void *state, Chip8 *chip8){
+    (void)state;
+    (void)chip8;
+}
+
+static bool run_cpu_step(Chip8 *chip8, Chip8Rewind *history, double *cpu_accum, double cpu_step){
+    //run_cpu before the split, every instruction goes through the checks
+    bool checked = chip8->mem_flags != NULL;
+    while (*cpu_accum >= cpu_step){
+        if (chip8->vblank_wait){
+            *cpu_accum = 0.0;
+            break;
+        }
+        uint16_t pc = chip8->pc;
+        if (checked && debug_break_hit(chip8)){
+            return true;
+        }
+        if (profile){
+            stand_in_step(profile, chip8);
+        }
+        if (tune){
+            stand_in_step(tune, chip8);
+        }
+        chip8_rewind_record(history, chip8);
+        if (chip8_step(chip8) != CHIP8_OK){
+            return true;
+        }
+        if (checked && debug_watch_hit(chip8, pc)){
+            return true;
+        }
+        *cpu_accum -= cpu_step;
+    }
+    return false;
+}
+
+static bool run_cpu_batch(Chip8 *chip8, Chip8Rewind *history, double *cpu_accum, double cpu_step){
+    //run_cpu's path with nothing checked, same as main.c
+    while (*cpu_accum >= cpu_step && !chip8->vblank_wait){
+        unsigned owed = (unsigned)(*cpu_accum / cpu_step);
+        unsigned room = chip8_rewind_checkpoint(history, chip8);
+        if (owed > room){
+            owed = room;
+        }
+        unsigned ran = 0;
+        int err = CHIP8_OK;
+        while (ran < owed && !chip8->vblank_wait){
+            ran++;
+            err = chip8_step(chip8);
+            if (err != CHIP8_OK){
+                break;
+            }
+        }
+        chip8_rewind_advance(history, ran);
+        if (err != CHIP8_OK){
+            return true;
+        }
+        *cpu_accum -= ran * cpu_step;
+    }
+    if (chip8->vblank_wait){
+        *cpu_accum = 0.0;
+    }
+    return false;
+}
+
+static double run_frames(const char *rom, long cycles, double per_frame, bool batch){
+    /*
+    main.c's frame loop without SDL: per_frame instructions owed per tick,
+    then a rewind timer tick. Rate counts what rewind counted.
+    */
+    double cpu_step = 1.0 / CPU_HZ;
+    double frame = per_frame * cpu_step;
+    long frames = (long)(cycles / per_frame);
+    double best = 0.0;
+
+    for (int r = 0; r < RUNS; r++){
+        Chip8 chip8;
+        chip8_reset(&chip8);
+        load_rom((char *)rom, &chip8);
+        Chip8Rewind *history = chip8_rewind_create(&chip8);
+        if (!history){
+            exit(1);
+        }
+
+        double cpu_accum = 0.0;
+        double start = now_seconds();
+        for (long f = 0; f < frames; f++){
+            cpu_accum += frame;
+            bool stopped = batch ? run_cpu_batch(&chip8, history, &cpu_accum, cpu_step)
+                                 : run_cpu_step(&chip8, history, &cpu_accum, cpu_step);
+            if (stopped){
+                fprintf(stderr, "CPU stopped at PC 0x%03X\n", chip8.pc);
+                break;
+            }
+            chip8_rewind_timer_tick(history, &chip8);
+        }
+        double rate = (double)chip8_rewind_position(history) / (now_seconds() - start) / 1e6;
+        if (rate > best){
+            best = rate;
+        }
+
+        chip8_rewind_destroy(history);
+        chip8_release(&chip8);
+    }
+    return best;
+}
+
+int main(int argc, char *argv[]){
+    if (argc < 2){
+        fprintf(stderr, "Usage: %s <rom> [cycles]\n", argv[0]);
+        return 1;
+    }
+    long cycles = argc > 2 ? atol(argv[2]) : 10000000;
+
+    printf("CHIP8_WATCHPOINTS=%d\n", CHIP8_WATCHPOINTS);
+    printf("nothing set:             %.2f M instructions/s\n", run(argv[1], cycles, 0));
+#if CHIP8_WATCHPOINTS
+    printf("breakpoint + watchpoint: %.2f M instructions/s\n", run(argv[1], cycles, 1));
+#endif
+    //main.c's rate, then a frame long enough that the loop itself shows
+    double rates[] = {CPU_HZ / TIMER_HZ, BIG_FRAME};
+    for (int i = 0; i < 2; i++){
+        printf("run_cpu, %4.0f per frame, per step: %.2f M instructions/s\n", rates[i], run_frames(argv[1], cycles, rates[i], false));
+        printf("run_cpu, %4.0f per frame, batched:  %.2f M instructions/s\n", rates[i], run_frames(argv[1], cycles, rates[i], true));
+    }
+    return 0;
+}
@@ -0,0 +1,111 @@
+//tools/chip8_disasm.c
+// Annotated disassembly and execution heatmap.
+//
+// Usage: chip8_disasm <rom> [seconds] [--top <n>]
+//
+// Without seconds, prints the static disassembly. With seconds, first runs
+// the ROM headless for that much game time (main.c's 700 Hz CPU and 60 Hz
+// timers, keypad changing every INPUT_PERIOD frames) under the sampling
+// profiler, then prints the listing annotated with executions and host time
+// per instruction and block, the `top` (default 10) hottest blocks, and
+// the cost of the sampling hook measured against an unprofiled run.
+#include "chip8.h"
+#include "chip8_disasm.h"
+#include "chip8_profile.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CPU_HZ 700.0  //same as main.c
+#define TIMER_HZ 60.0
+#define INPUT_PERIOD 20 //frames between keypad changes
+#define SEED 0xC8C8C8C8u
+
+static double now_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static double run(const char *rom, double seconds, Chip8Profile *profile, Chip8 *chip8){
+    //returns host seconds spent
+    chip8_reset(chip8);
+    chip8_seed(chip8, SEED);
+    if (load_rom(rom, chip8) != CHIP8_OK){
+        exit(1);
+    }
+
+    uint64_t frames = (uint64_t)(seconds * TIMER_HZ);
+    uint32_t rng = 1;
+    double start = now_seconds();
+    if (profile){
+        //headless, so no time outside emulation to leave out between frames
+        chip8_profile_resume(profile);
+    }
+    for (uint64_t f = 0; f < frames; f++){
+        if (f % INPUT_PERIOD == 0){
+            rng = rng * 1103515245u + 12345u;
+            chip8->keypad = (rng >> 16) & 1 ? (uint16_t)(1u << ((rng >> 17) & 0xF)) : 0;
+        }
+        uint64_t cycles = (uint64_t)((double)(f + 1) * CPU_HZ / TIMER_HZ) - (uint64_t)((double)f * CPU_HZ / TIMER_HZ);
+        if (profile){
+            for (uint64_t i = 0; i < cycles; i++){
+                chip8_profile_step(profile, chip8);
+                chip8_step(chip8);
+            }
+        } else {
+            for (uint64_t i = 0; i < cycles; i++){
+                chip8_step(chip8);
+            }
+        }
+        chip8_timer_tick(chip8);
+    }
+    return now_seconds() - start;
+}
+
+int main(int argc, char *argv[]){
+    if (argc < 2){
+        fprintf(stderr, "Usage: %s <rom> [seconds] [--top <n>]\n", argv[0]);
+        return 1;
+    }
+    double seconds = 0.0;
+    int top = 10;
+    for (int arg = 2; arg < argc; arg++){
+        if (strcmp(argv[arg], "--top") == 0 && arg + 1 < argc){
+            top = atoi(argv[++arg]);
+        } else {
+            seconds = atof(argv[arg]);
+        }
+    }
+
+    static Chip8 chip8;
+    static Chip8Disasm disasm;
+
+    if (seconds <= 0.0){
+        chip8_reset(&chip8);
+        if (load_rom(argv[1], &chip8) != CHIP8_OK){
+            return 1;
+        }
+        chip8_disasm_analyze(&disasm, &chip8, NULL);
+        chip8_disasm_print(stdout, &disasm, &chip8, NULL);
+        return 0;
+    }
+
+    static Chip8Profile profile;
+    double plain = run(argv[1], seconds, NULL, &chip8);
+    double again = run(argv[1], seconds, NULL, &chip8); //first run also warms caches
+    plain = again < plain ? again : plain;
+    chip8_profile_init(&profile, PROFILE_PERIOD);
+    double profiled = run(argv[1], seconds, &profile, &chip8);
+
+    chip8_disasm_analyze(&disasm, &chip8, &profile);
+    chip8_disasm_print(stdout, &disasm, &chip8, &profile);
+    printf("\n");
+    chip8_disasm_hot_blocks(stdout, &disasm, &chip8, &profile, top);
+    printf("; %.0f s of game time: %.2f ms unprofiled, %.2f ms profiled (%+.1f%%)\n",
+           seconds, plain * 1e3, profiled * 1e3, plain > 0 ? (profiled / plain - 1.0) * 100.0 : 0.0);
+    return 0;
+}
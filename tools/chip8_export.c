@@ -0,0 +1,111 @@
+//tools/chip8_export.c
+// Headless video capture.
+//
+// Usage: chip8_export <rom> <out|-> [--movie <file>] [--seconds <n>] [--scale <n>] [--rgb]
+//
+// Runs the ROM unthrottled and writes one frame per 60 Hz timer tick with
+// chip8_video. With --movie the input comes from a recorded movie and the
+// capture covers all of it; otherwise the ROM runs without input for
+// --seconds (default 600). Output is Y4M unless --rgb, scale 4 by default:
+//
+//   chip8_export roms/UFO ufo.y4m --movie ufo.c8mv
+//   chip8_export roms/UFO - --rgb | ffmpeg -f rawvideo -pix_fmt rgb24 -s 256x128 -r 60 -i - ufo.mp4
+#include "chip8.h"
+#include "chip8_movie.h"
+#include "chip8_video.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CPU_HZ 700.0  //same as main.c
+#define TIMER_HZ 60.0
+
+static double now_seconds(void){
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void on_tick(void *ctx, Chip8 *chip8){
+    chip8_video_frame(ctx, chip8);
+}
+
+int main(int argc, char *argv[]){
+    if (argc < 3){
+        fprintf(stderr, "Usage: %s <rom> <out|-> [--movie <file>] [--seconds <n>] [--scale <n>] [--rgb]\n", argv[0]);
+        return 1;
+    }
+
+    const char *movie_path = NULL;
+    double seconds = 600.0;
+    int scale = 4;
+    VideoFormat format = VIDEO_Y4M;
+
+    for (int i = 3; i < argc; i++){
+        if (strcmp(argv[i], "--movie") == 0 && i + 1 < argc){
+            movie_path = argv[++i];
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc){
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc){
+            scale = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rgb") == 0){
+            format = VIDEO_RGB;
+        } else {
+            fprintf(stderr, "Unknown argument %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    Chip8 chip8;
+    chip8_reset(&chip8);
+    if (load_rom(argv[1], &chip8) != CHIP8_OK){
+        return 1;
+    }
+
+    Chip8Video *video = chip8_video_open(argv[2], format, scale);
+    if (!video){
+        return 1;
+    }
+
+    double t0 = now_seconds();
+    int status = 0;
+
+    if (movie_path){
+        Chip8MovieResult result;
+        status = chip8_movie_play_frames(movie_path, &chip8, &result, on_tick, video);
+        if (status > 0){
+            fprintf(stderr, "warning: replay diverged from the recording\n");
+            status = 0;
+        }
+    } else {
+        //same accumulator scheme as main.c
+        const double cpu_step = 1.0 / CPU_HZ;
+        double cpu_accum = 0.0;
+        long frames = (long)(seconds * TIMER_HZ);
+
+        for (long f = 0; f < frames; f++){
+            cpu_accum += 1.0 / TIMER_HZ;
+            while (cpu_accum >= cpu_step){
+                chip8_step(&chip8);
+                cpu_accum -= cpu_step;
+            }
+            chip8_timer_tick(&chip8);
+            chip8_video_frame(video, &chip8);
+        }
+    }
+
+    Chip8VideoStats stats;
+    if (chip8_video_close(video, &stats) != 0){
+        status = -1;
+    }
+    double elapsed = now_seconds() - t0;
+
+    //stdout may be the video
+    fprintf(stderr, "%llu frames (%.1f s of video), %llu encoded, %.1f MB in %.3f s\n",
+            (unsigned long long)stats.frames, (double)stats.frames / TIMER_HZ,
+            (unsigned long long)stats.encoded, (double)stats.bytes / 1e6, elapsed);
+    return status == 0 ? 0 : 1;
+}
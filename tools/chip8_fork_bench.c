@@ -0,0 +1,109 @@
+//tools/chip8_fork_bench.c
+// Fork cost and memory per clone.
+//
+// Usage: chip8_fork_bench <rom> [clones] [frames]
+//
+// Warms one Chip8 up, forks it `clones` times, then runs every clone for
+// `frames` 60 Hz frames with its own keypad input. Reports the time per
+// chip8_fork and the bytes each clone costs right after the fork and after
+// running. Build with -DCHIP8_PAGED_MEMORY=1 for copy-on-write pages, or
+// without for the flat 4 KB memory as a baseline.
+#include "chip8.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CPU_HZ 700.0  //same as main.c
+#define TIMER_HZ 60.0
+#define WARMUP_FRAMES 120
+#define INPUT_PERIOD 30 //frames between keypad changes
+
+static double now_seconds(void){
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void run_frame(Chip8 *chip8, int cycles_per_frame){
+    for (int c = 0; c < cycles_per_frame; c++){
+        chip8_step(chip8);
+    }
+    chip8_timer_tick(chip8);
+}
+
+static void report(const char *when, Chip8 *clones, int count){
+    double resident = 0.0;
+    for (int i = 0; i < count; i++){
+        resident += chip8_mem_resident(&clones[i]);
+    }
+    resident /= count;
+
+    printf("%-12s RAM %7.1f B/clone, Chip8 struct %zu B, total %7.1f B/clone, pages live %ld\n",
+           when, resident, sizeof(Chip8), resident + (double)sizeof(Chip8), chip8_pages_live());
+}
+
+int main(int argc, char *argv[]){
+    if (argc < 2){
+        fprintf(stderr, "Usage: %s <rom> [clones] [frames]\n", argv[0]);
+        return 1;
+    }
+
+    int count = argc > 2 ? atoi(argv[2]) : 10000;
+    int frames = argc > 3 ? atoi(argv[3]) : 60;
+    if (count <= 0 || frames < 0){
+        fprintf(stderr, "clones must be > 0 and frames >= 0\n");
+        return 1;
+    }
+
+    int cycles_per_frame = (int)(CPU_HZ / TIMER_HZ);
+
+    Chip8 parent;
+    chip8_reset(&parent);
+    load_rom(argv[1], &parent);
+    for (int f = 0; f < WARMUP_FRAMES; f++){
+        run_frame(&parent, cycles_per_frame);
+    }
+
+    Chip8 *clones = malloc(sizeof(Chip8) * (size_t)count);
+    if (!clones){
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    memset(clones, 0, sizeof(Chip8) * (size_t)count); //fault the array in outside the timing
+
+    printf("memory: %s\n", CHIP8_PAGED_MEMORY ? "copy-on-write pages" : "flat");
+
+    double start = now_seconds();
+    for (int i = 0; i < count; i++){
+        chip8_fork(&clones[i], &parent);
+    }
+    double elapsed = now_seconds() - start;
+    printf("fork: %d clones in %.3f ms, %.1f ns/fork\n", count, elapsed * 1e3, elapsed / count * 1e9);
+    report("after fork", clones, count);
+
+    for (int i = 0; i < count; i++){
+        uint32_t rng = 0x1234567u + (uint32_t)i * 7919u;
+        for (int f = 0; f < frames; f++){
+            if (f % INPUT_PERIOD == 0){
+                //xorshift32, mostly no key down, otherwise one key
+                rng ^= rng << 13;
+                rng ^= rng >> 17;
+                rng ^= rng << 5;
+                clones[i].keypad = (rng & 0x300) ? 0 : (uint16_t)(1u << (rng & 0xF));
+            }
+            run_frame(&clones[i], cycles_per_frame);
+        }
+    }
+    report("after run", clones, count);
+
+    for (int i = 0; i < count; i++){
+        chip8_release(&clones[i]);
+    }
+    chip8_release(&parent);
+    free(clones);
+    return 0;
+}
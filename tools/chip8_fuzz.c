@@ -0,0 +1,375 @@
+//tools/chip8_fuzz.c
+// Coverage-guided keypad fuzzer: explores a ROM by trying keypad input.
+//
+// Usage: chip8_fuzz <rom> [seconds] [threads] [crash dir]
+//
+// An input is one keypad mask per 60 Hz frame. Every corpus entry keeps the
+// Chip8 state its input ends in, so a new input is a fork of an entry plus
+// up to SUFFIX_MAX random frames, and nothing is replayed from reset (built
+// with CHIP8_PAGED_MEMORY, the fork shares the memory pages). Feedback is PC
+// and branch-edge (previous PC -> PC) coverage, recorded around each
+// chip8_step of the run loop here; an input that reaches a new PC or edge
+// joins the corpus.
+//
+// Crashes are instructions chip8_step refuses (unknown 0nnn, 2nnn/00EE
+// stack over- or underflow, PC off the end), undefined opcodes it runs as
+// no-ops (the ones chip8_disasm_format shows as DW), and Dxyn/Fx33/Fx55/
+// Fx65 whose I + length runs past 4 KB; the last two are checked before
+// the instruction runs. The first input to hit
+// each (kind, PC) is written to the crash dir (default .) as a movie from
+// reset: make replay ROM=... MOVIE=crash-000.c8mv shows it again.
+//
+// Threads share the corpus and the coverage maps, default one per core.
+// Once a second: executions/s, PCs and edges covered, edges new in that
+// second, corpus size and crashes.
+#include "chip8.h"
+#include "chip8_movie.h"
+#include "chip8_disasm.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CYCLES_PER_FRAME 12     //~700 Hz, main.c's CPU_HZ
+#define SUFFIX_MAX 64           //frames added per input
+#define CORPUS_MAX 16384
+#define EDGE_BITS 16
+#define MAX_THREADS 256
+#define MAX_CRASHES 256
+#define FUZZ_SEED 1             //Chip8.rng at reset, so crashes replay
+#define CRASH_I_RANGE 1         //not Chip8Errors: I + length past the end of memory,
+#define CRASH_SKIPPED 2         //undefined opcode that chip8_step skips
+
+typedef struct Entry {
+    int parent;                 //corpus index, -1 for the reset state
+    int frames;
+    uint16_t keys[SUFFIX_MAX];  //keypad mask per frame
+    Chip8 state;                //after the last frame
+} Entry;
+
+typedef struct Worker {
+    _Alignas(64) _Atomic uint64_t execs;
+    pthread_t tid;
+    uint32_t seed;
+} Worker;
+
+static Entry *corpus[CORPUS_MAX];
+static _Atomic int corpus_count;
+static pthread_mutex_t corpus_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static _Atomic uint8_t pc_map[MEM_SIZE];
+static _Atomic uint8_t edge_map[1 << EDGE_BITS];
+static _Atomic int pcs_found;
+static _Atomic int edges_found;
+
+static struct { int err; uint16_t pc; } crashes[MAX_CRASHES];
+static int crash_count;
+static pthread_mutex_t crash_lock = PTHREAD_MUTEX_INITIALIZER;
+static const char *crash_dir = ".";
+
+static bool skipped[0x10000];   //opcodes chip8_disasm_format has no mnemonic for
+static atomic_bool stop;
+
+static double now_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static uint32_t next_random(uint32_t *state){
+    //xorshift32, same as Cxkk
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static const char *crash_name(int err){
+    return err == CRASH_I_RANGE ? "I out of range" :
+           err == CRASH_SKIPPED ? "undefined opcode (skipped)" : chip8_strerror(err);
+}
+
+static int check(const Chip8 *chip8){
+    //what chip8_step would let pass: undefined opcodes, and I + length past the end of memory
+    uint16_t pc = chip8->pc;
+    uint16_t opcode = (uint16_t)(chip8_mem_read(chip8, pc & (MEM_SIZE - 1)) << 8 |
+                                 chip8_mem_read(chip8, (pc + 1) & (MEM_SIZE - 1)));
+    if (skipped[opcode]){
+        return CRASH_SKIPPED;
+    }
+    unsigned len = 0;
+    if ((opcode & 0xF000) == 0xD000){
+        len = (opcode & 0xF) ? (opcode & 0xF) : 32;
+    } else if ((opcode & 0xF0FF) == 0xF033){
+        len = 3;
+    } else if ((opcode & 0xF0FF) == 0xF055 || (opcode & 0xF0FF) == 0xF065){
+        len = ((opcode >> 8) & 0xF) + 1u;
+    }
+    return len && chip8->I + len > MEM_SIZE ? CRASH_I_RANGE : CHIP8_OK;
+}
+
+static bool mark(_Atomic uint8_t *map, uint32_t index, _Atomic int *found){
+    //first thread to set the byte owns the discovery
+    if (atomic_load_explicit(&map[index], memory_order_relaxed) ||
+        atomic_exchange_explicit(&map[index], 1, memory_order_relaxed)){
+        return false;
+    }
+    atomic_fetch_add_explicit(found, 1, memory_order_relaxed);
+    return true;
+}
+
+static int run(Chip8 *chip8, const uint16_t *keys, int frames, Chip8Movie *movie, bool *covered){
+    /*
+    Play `frames` frames of input. Returns CHIP8_OK, or the crash that
+    stopped it with the PC on the instruction.
+    */
+    for (int f = 0; f < frames; f++){
+        chip8->keypad = keys[f];
+        if (movie){
+            chip8_movie_keys(movie, chip8);
+        }
+        for (int c = 0; c < CYCLES_PER_FRAME; c++){
+            int err = check(chip8);
+            if (err != CHIP8_OK){
+                return err;
+            }
+            uint16_t from = chip8->pc;
+            err = chip8_step(chip8);
+            if (err != CHIP8_OK){
+                return err;
+            }
+            uint32_t edge = ((uint32_t)from << 12 | chip8->pc) * 2654435761u >> (32 - EDGE_BITS);
+            *covered |= mark(pc_map, from, &pcs_found);
+            *covered |= mark(edge_map, edge, &edges_found);
+        }
+        if (movie){
+            chip8_movie_tick(movie, chip8);
+        }
+        chip8_timer_tick(chip8);
+    }
+    return CHIP8_OK;
+}
+
+static void mutate(Entry *entry, int parent, uint32_t *rng){
+    //runs of 1-16 frames with no key, one key or two keys held
+    entry->parent = parent;
+    entry->frames = 1 + (int)(next_random(rng) % SUFFIX_MAX);
+    int f = 0;
+    while (f < entry->frames){
+        uint32_t r = next_random(rng);
+        int hold = 1 + (int)(r & 15);
+        uint16_t keys = 0;
+        switch ((r >> 4) & 3){
+            case 0:
+                break;
+            case 3:
+                keys = (uint16_t)(1u << ((r >> 12) & 15));
+                //fall through
+            default:
+                keys |= (uint16_t)(1u << ((r >> 8) & 15));
+                break;
+        }
+        for (; hold > 0 && f < entry->frames; hold--, f++){
+            entry->keys[f] = keys;
+        }
+    }
+}
+
+static int pick(uint32_t *rng){
+    //half the time one of the 64 newest entries, they are where the frontier is
+    int count = atomic_load_explicit(&corpus_count, memory_order_acquire);
+    uint32_t r = next_random(rng);
+    if (r & 1){
+        int newest = count < 64 ? count : 64;
+        return count - 1 - (int)((r >> 1) % (uint32_t)newest);
+    }
+    return (int)((r >> 1) % (uint32_t)count);
+}
+
+static void save_crash(const Entry *entry, int err, uint16_t pc){
+    /*
+    Rebuild the input from reset and record it as a movie, once per (kind, PC)
+    */
+    pthread_mutex_lock(&crash_lock);
+    for (int i = 0; i < crash_count; i++){
+        if (crashes[i].err == err && crashes[i].pc == pc){
+            pthread_mutex_unlock(&crash_lock);
+            return;
+        }
+    }
+    int id = crash_count;
+    if (crash_count < MAX_CRASHES){
+        crashes[crash_count].err = err;
+        crashes[crash_count].pc = pc;
+        crash_count++;
+    }
+    pthread_mutex_unlock(&crash_lock);
+    if (id == MAX_CRASHES){
+        return;
+    }
+
+    int frames = entry->frames;
+    for (int p = entry->parent; p > 0; p = corpus[p]->parent){
+        frames += corpus[p]->frames;
+    }
+    uint16_t *keys = malloc(sizeof(*keys) * (size_t)frames);
+    if (!keys){
+        perror("save_crash: malloc");
+        return;
+    }
+    int end = frames - entry->frames;
+    memcpy(keys + end, entry->keys, sizeof(*keys) * (size_t)entry->frames);
+    for (int p = entry->parent; p > 0; p = corpus[p]->parent){
+        end -= corpus[p]->frames;
+        memcpy(keys + end, corpus[p]->keys, sizeof(*keys) * (size_t)corpus[p]->frames);
+    }
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/crash-%03d.c8mv", crash_dir, id);
+    Chip8 chip8;
+    chip8_fork(&chip8, &corpus[0]->state);
+    Chip8Movie *movie = chip8_movie_record(path, &chip8);
+    if (movie){
+        bool covered = false;
+        int replayed = run(&chip8, keys, frames, movie, &covered);
+        chip8_movie_close(movie, &chip8);
+        printf("crash: %s at PC 0x%03X after %d frames, %s%s\n", crash_name(err), pc, frames, path,
+               replayed == err && chip8.pc == pc ? "" : " (did not reproduce from reset)");
+    }
+    chip8_release(&chip8);
+    free(keys);
+}
+
+static bool add_entry(Entry *entry){
+    pthread_mutex_lock(&corpus_lock);
+    int count = atomic_load_explicit(&corpus_count, memory_order_relaxed);
+    bool added = count < CORPUS_MAX;
+    if (added){
+        corpus[count] = entry;
+        atomic_store_explicit(&corpus_count, count + 1, memory_order_release);
+    }
+    pthread_mutex_unlock(&corpus_lock);
+    return added;
+}
+
+static void *fuzz(void *arg){
+    Worker *worker = arg;
+    uint32_t rng = worker->seed;
+    Entry *child = malloc(sizeof(*child));
+    Chip8 chip8;
+    while (child && !atomic_load_explicit(&stop, memory_order_relaxed)){
+        int parent = pick(&rng);
+        mutate(child, parent, &rng);
+        chip8_fork(&chip8, &corpus[parent]->state);
+
+        bool covered = false;
+        int err = run(&chip8, child->keys, child->frames, NULL, &covered);
+        if (err != CHIP8_OK){
+            save_crash(child, err, chip8.pc);
+        } else if (covered){
+            chip8_fork(&child->state, &chip8);
+            if (add_entry(child)){
+                child = malloc(sizeof(*child));
+            } else {
+                chip8_release(&child->state);
+            }
+        }
+        chip8_release(&chip8);
+        atomic_store_explicit(&worker->execs, atomic_load_explicit(&worker->execs, memory_order_relaxed) + 1,
+                              memory_order_relaxed);
+    }
+    if (!child){
+        perror("fuzz: malloc");
+    }
+    free(child);
+    return NULL;
+}
+
+int main(int argc, char *argv[]){
+    if (argc < 2){
+        fprintf(stderr, "Usage: %s <rom> [seconds] [threads] [crash dir]\n", argv[0]);
+        return 1;
+    }
+    double seconds = argc > 2 ? atof(argv[2]) : 60.0;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = argc > 3 ? atoi(argv[3]) : (int)(cores > 0 ? cores : 1);
+    if (argc > 4){
+        crash_dir = argv[4];
+    }
+    if (threads < 1 || threads > MAX_THREADS){
+        fprintf(stderr, "threads must be 1-%d\n", MAX_THREADS);
+        return 1;
+    }
+
+    for (uint32_t op = 0; op < 0x10000; op++){
+        char text[32];
+        chip8_disasm_format((uint16_t)op, text, sizeof(text));
+        skipped[op] = strncmp(text, "DW", 2) == 0;
+    }
+
+    Entry *root = calloc(1, sizeof(*root));
+    if (!root){
+        perror("calloc");
+        return 1;
+    }
+    chip8_reset(&root->state);
+    if (load_rom(argv[1], &root->state) != CHIP8_OK){
+        return 1;
+    }
+    chip8_seed(&root->state, FUZZ_SEED);
+    root->parent = -1;
+    add_entry(root);
+
+    static Worker workers[MAX_THREADS];
+    for (int t = 0; t < threads; t++){
+        workers[t].seed = 2654435761u * (uint32_t)(t + 1);
+        if (pthread_create(&workers[t].tid, NULL, fuzz, &workers[t]) != 0){
+            perror("pthread_create");
+            return 1;
+        }
+    }
+
+    double t0 = now_seconds();
+    double last = t0;
+    uint64_t last_execs = 0;
+    int last_edges = 0;
+    while (now_seconds() - t0 < seconds){
+        struct timespec pause = { 0, 100000000 };
+        nanosleep(&pause, NULL);
+        double now = now_seconds();
+        if (now - last < 1.0){
+            continue;
+        }
+        uint64_t execs = 0;
+        for (int t = 0; t < threads; t++){
+            execs += atomic_load_explicit(&workers[t].execs, memory_order_relaxed);
+        }
+        int edges = atomic_load(&edges_found);
+        pthread_mutex_lock(&crash_lock);
+        int crashed = crash_count;
+        pthread_mutex_unlock(&crash_lock);
+        printf("%5.0f s  %9.0f execs/s  %4d PCs  %5d edges  +%4.0f edges/s  corpus %5d  crashes %d\n",
+               now - t0, (double)(execs - last_execs) / (now - last), atomic_load(&pcs_found), edges,
+               (double)(edges - last_edges) / (now - last), atomic_load(&corpus_count), crashed);
+        last = now;
+        last_execs = execs;
+        last_edges = edges;
+    }
+
+    atomic_store(&stop, true);
+    uint64_t execs = 0;
+    for (int t = 0; t < threads; t++){
+        pthread_join(workers[t].tid, NULL);
+        execs += workers[t].execs;
+    }
+    printf("%d threads, %.0f s: %llu executions, %d PCs, %d edges, corpus %d, %d distinct crashes\n",
+           threads, now_seconds() - t0, (unsigned long long)execs, atomic_load(&pcs_found),
+           atomic_load(&edges_found), atomic_load(&corpus_count), crash_count);
+    return 0;
+}
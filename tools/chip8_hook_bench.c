@@ -0,0 +1,158 @@
+//tools/chip8_hook_bench.c
+// What hooks cost, through libchip8.h only.
+//
+// Usage: chip8_hook_bench <rom> [seconds]
+//
+// Plays `seconds` (default 600) of game time three ways with the same seed
+// and keys: a chip8_step loop, chip8_run without hooks, and chip8_run with
+// every hook set (on_pc at 0x200, on_mem_write on all of memory, and
+// on_frame injecting the keys). All three must end on the same state hash;
+// without hooks chip8_run is the plain loop around chip8_step, so the first
+// two differ only by that loop.
+#include "libchip8.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MAX_ROM (4096 - 0x200)
+#define CYCLES_PER_FRAME 12   //~700 Hz
+#define REPEATS 3             //best of
+
+typedef enum { MODE_STEP, MODE_RUN, MODE_HOOKS } Mode;
+
+typedef struct Counts {
+    long frames;              //to play
+    long on_frame, on_pc, on_mem_write, on_sound_start, on_key_wait;
+} Counts;
+
+static uint8_t rom[MAX_ROM];
+static size_t rom_len;
+
+static double now_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static uint16_t keys_for(long frame){
+    //a key (or none) held for 16 frames at a time
+    uint32_t h = (uint32_t)(frame >> 4) * 2654435761u;
+    return (h >> 28) & 1 ? (uint16_t)(1u << ((h >> 24) & 0xF)) : 0;
+}
+
+static void on_frame(Chip8 *chip8, void *ctx){
+    Counts *counts = ctx;
+    //keys for the frame about to start, same schedule as the other modes
+    chip8_set_keypad(chip8, keys_for(++counts->on_frame));
+}
+
+static void on_pc(Chip8 *chip8, void *ctx, uint16_t pc){
+    (void)chip8;
+    (void)pc;
+    ((Counts *)ctx)->on_pc++;
+}
+
+static void on_mem_write(Chip8 *chip8, void *ctx, uint16_t addr, uint16_t pc){
+    (void)chip8;
+    (void)addr;
+    (void)pc;
+    ((Counts *)ctx)->on_mem_write++;
+}
+
+static void on_sound_start(Chip8 *chip8, void *ctx){
+    (void)chip8;
+    ((Counts *)ctx)->on_sound_start++;
+}
+
+static void on_key_wait(Chip8 *chip8, void *ctx, uint8_t x){
+    (void)chip8;
+    (void)x;
+    ((Counts *)ctx)->on_key_wait++;
+}
+
+static int play(Mode mode, Counts *counts, uint64_t *hash, long *instructions){
+    Chip8 *chip8 = chip8_new();
+    if (!chip8){
+        return CHIP8_ERR_NOMEM;
+    }
+    int err = chip8_load(chip8, rom, rom_len);
+    chip8_seed(chip8, 1);
+    if (mode == MODE_HOOKS && err == CHIP8_OK){
+        Chip8Hooks hooks = { counts, on_frame, on_pc, on_mem_write, on_sound_start, on_key_wait };
+        err = chip8_set_hooks(chip8, &hooks);
+        chip8_hook_pc(chip8, 0x200, true);
+        chip8_hook_mem_write(chip8, 0, 4096, true);
+    }
+    chip8_set_keypad(chip8, keys_for(0));
+
+    *instructions = 0;
+    for (long f = 0; f < counts->frames && err == CHIP8_OK; f++){
+        if (mode == MODE_STEP){
+            for (int c = 0; c < CYCLES_PER_FRAME && err == CHIP8_OK; c++){
+                err = chip8_step(chip8);
+                *instructions += err == CHIP8_OK;
+            }
+        } else {
+            long ran = chip8_run(chip8, CYCLES_PER_FRAME);
+            if (ran < 0){
+                err = (int)ran;
+                break;
+            }
+            *instructions += ran;
+        }
+        chip8_timer_tick(chip8);
+        if (mode != MODE_HOOKS){
+            chip8_set_keypad(chip8, keys_for(f + 1));
+        }
+    }
+    *hash = chip8_state_hash(chip8);
+    chip8_free(chip8);
+    return err;
+}
+
+int main(int argc, char *argv[]){
+    if (argc < 2){
+        fprintf(stderr, "Usage: %s <rom> [seconds]\n", argv[0]);
+        return 1;
+    }
+    double seconds = argc > 2 ? atof(argv[2]) : 600.0;
+
+    FILE *fp = fopen(argv[1], "rb");
+    if (!fp){
+        perror("fopen");
+        return 1;
+    }
+    rom_len = fread(rom, 1, sizeof(rom), fp);
+    fclose(fp);
+
+    static const char *names[] = { "chip8_step loop", "chip8_run, no hooks", "chip8_run, all hooks" };
+    double best[3];
+    uint64_t hashes[3];
+    Counts counts = { 0 };
+    for (int m = MODE_STEP; m <= MODE_HOOKS; m++){
+        best[m] = 1e30;
+        for (int r = 0; r < REPEATS; r++){
+            counts = (Counts){ .frames = (long)(seconds * 60.0) };
+            long instructions = 0;
+            double t0 = now_seconds();
+            int err = play((Mode)m, &counts, &hashes[m], &instructions);
+            double ns = (now_seconds() - t0) * 1e9 / (double)(instructions ? instructions : 1);
+            if (err != CHIP8_OK){
+                printf("%s: %s\n", names[m], chip8_strerror(err));
+            }
+            if (ns < best[m]){
+                best[m] = ns;
+            }
+        }
+        printf("%-22s %6.2f ns/instruction  %+6.1f%%\n", names[m], best[m],
+               (best[m] / best[MODE_STEP] - 1.0) * 100.0);
+    }
+    printf("hooks called: %ld on_frame, %ld on_pc, %ld on_mem_write, %ld on_sound_start, %ld on_key_wait\n",
+           counts.on_frame, counts.on_pc, counts.on_mem_write, counts.on_sound_start, counts.on_key_wait);
+
+    bool match = hashes[MODE_STEP] == hashes[MODE_RUN] && hashes[MODE_STEP] == hashes[MODE_HOOKS];
+    printf("state hashes %s\n", match ? "match" : "differ");
+    return match ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+//tools/chip8_host_client.c
+// Stand-in client for chip8_host.exe.
+//
+// Usage: chip8_host_client <socket> <rom> [clients] [seconds] [--by-hash]
+//
+// Opens `clients` (default 1) connections, starts the ROM on each, presses
+// a random key (or none) on each connection about every 1/3 s and counts the
+// HostFrames coming back. Prints frames/s per client and the highest
+// missed-deadline count once a second. --by-hash sends only the ROM's
+// hash; the host must have been started with a --lib containing it.
+#include "chip8_host.h"
+#include "chip8_romlib.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define KEY_PERIOD 0.33 //seconds between keypad changes per client
+
+static double now_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int connect_host(const char *path, const uint8_t *hello, size_t hello_len){
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (fd < 0){
+        perror("client: socket");
+        return -1;
+    }
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        send(fd, hello, hello_len, MSG_NOSIGNAL) != (ssize_t)hello_len){
+        perror("client: connect");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char *argv[]){
+    if (argc < 3){
+        fprintf(stderr, "Usage: %s <socket> <rom> [clients] [seconds] [--by-hash]\n", argv[0]);
+        return 1;
+    }
+    int clients = 1;
+    double seconds = 5.0;
+    bool by_hash = false;
+    for (int arg = 3, positional = 0; arg < argc; arg++){
+        if (strcmp(argv[arg], "--by-hash") == 0){
+            by_hash = true;
+        } else if (positional++ == 0){
+            clients = atoi(argv[arg]);
+        } else {
+            seconds = atof(argv[arg]);
+        }
+    }
+
+    FILE *fp = fopen(argv[2], "rb");
+    if (!fp){
+        perror("client: fopen");
+        return 1;
+    }
+    uint8_t hello[sizeof(HostHello) + MEM_SIZE - 0x200];
+    size_t rom_len = fread(hello + sizeof(HostHello), 1, MEM_SIZE - 0x200, fp);
+    fclose(fp);
+    HostHello header = { .rom_len = (uint16_t)rom_len };
+    if (by_hash){
+        uint64_t hash = chip8_rom_hash(hello + sizeof(HostHello), rom_len);
+        memcpy(hello + sizeof(HostHello), &hash, sizeof(hash));
+        header.rom_len = 0;
+        rom_len = sizeof(hash);
+    }
+    memcpy(header.magic, HOST_MAGIC, sizeof(header.magic));
+    memcpy(hello, &header, sizeof(header));
+
+    struct pollfd *fds = calloc((size_t)clients, sizeof(*fds));
+    double *next_key = calloc((size_t)clients, sizeof(*next_key));
+    if (!fds || !next_key){
+        perror("client: calloc");
+        return 1;
+    }
+
+    double start = now_seconds();
+    for (int i = 0; i < clients; i++){
+        fds[i].fd = connect_host(argv[1], hello, sizeof(HostHello) + rom_len);
+        if (fds[i].fd < 0){
+            clients = i;
+            break;
+        }
+        fds[i].events = POLLIN;
+        next_key[i] = start + KEY_PERIOD * i / (clients ? clients : 1);
+    }
+    printf("%d clients connected\n", clients);
+
+    uint64_t frames = 0;
+    uint64_t frames_last = 0;
+    uint32_t missed = 0;
+    int closed = 0;
+    uint32_t rng = 1;
+    double next_report = start + 1.0;
+    HostFrame frame;
+
+    while (clients > closed){
+        double now = now_seconds();
+        if (now - start >= seconds){
+            break;
+        }
+
+        if (poll(fds, (nfds_t)clients, 10) > 0){
+            for (int i = 0; i < clients; i++){
+                if (!fds[i].revents){
+                    continue;
+                }
+                ssize_t n;
+                while ((n = recv(fds[i].fd, &frame, sizeof(frame), MSG_DONTWAIT)) >= (ssize_t)offsetof(HostFrame, rows)){
+                    frames++;
+                    if (frame.missed > missed){
+                        missed = frame.missed;
+                    }
+                }
+                if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)){
+                    fds[i].fd = -fds[i].fd - 1; //poll ignores negative fds
+                    closed++;
+                }
+            }
+        }
+
+        for (int i = 0; i < clients; i++){
+            if (fds[i].fd >= 0 && now >= next_key[i]){
+                rng = rng * 1103515245u + 12345u;
+                uint16_t keys = (rng >> 16) & 1 ? (uint16_t)(1u << ((rng >> 17) & 0xF)) : 0;
+                send(fds[i].fd, &keys, sizeof(keys), MSG_DONTWAIT | MSG_NOSIGNAL);
+                next_key[i] += KEY_PERIOD;
+            }
+        }
+
+        if (now >= next_report){
+            printf("frames/s/client %5.1f  max missed %u  closed %d\n",
+                   clients ? (double)(frames - frames_last) / clients : 0.0, missed, closed);
+            frames_last = frames;
+            next_report += 1.0;
+        }
+    }
+
+    for (int i = 0; i < clients; i++){
+        close(fds[i].fd >= 0 ? fds[i].fd : -fds[i].fd - 1);
+    }
+    free(fds);
+    free(next_key);
+    return 0;
+}
@@ -0,0 +1,118 @@
+//tools/chip8_replay.c
+// Headless movie replay.
+//
+// Usage: chip8_replay <rom> <movie>
+//        chip8_replay <rom> <movie> --record-synthetic <minutes>
+//
+// Replays a movie recorded with `chip8.exe <rom> --record <movie>` as fast
+// as the interpreter goes and checks the final display against the hash
+// stored in the movie. Exit status is 0 on a match, 1 on a mismatch.
+//
+// --record-synthetic first writes a movie of <minutes> of play without a
+// window: main.c's 700 Hz CPU and 60 Hz timers with the keypad changing
+// every INPUT_PERIOD frames. Handy for timing long replays.
+#include "chip8.h"
+#include "chip8_movie.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CPU_HZ 700.0  //same as main.c
+#define TIMER_HZ 60.0
+#define INPUT_PERIOD 20 //frames between keypad changes
+
+static double now_seconds(void){
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int record_synthetic(char *rom, const char *path, double minutes){
+    Chip8 chip8;
+    chip8_reset(&chip8);
+    if (load_rom(rom, &chip8) != CHIP8_OK){
+        return -1;
+    }
+
+    Chip8Movie *movie = chip8_movie_record(path, &chip8);
+    if (!movie){
+        return -1;
+    }
+
+    //same accumulator scheme as main.c, so frames are 11 or 12 instructions
+    const double cpu_step = 1.0 / CPU_HZ;
+    double cpu_accum = 0.0;
+    long frames = (long)(minutes * 60.0 * TIMER_HZ);
+    uint32_t input = 12345;
+
+    for (long f = 0; f < frames; f++){
+        if (f % INPUT_PERIOD == 0){
+            input = input * 1103515245u + 12345u;
+            chip8.keypad = (uint16_t)(1u << ((input >> 16) & 0xF));
+            if ((input >> 8) & 1){
+                chip8.keypad = 0;
+            }
+            chip8_movie_keys(movie, &chip8);
+        }
+
+        cpu_accum += 1.0 / TIMER_HZ;
+        while (cpu_accum >= cpu_step){
+            chip8_step(&chip8);
+            cpu_accum -= cpu_step;
+        }
+
+        chip8_movie_tick(movie, &chip8);
+        chip8_timer_tick(&chip8);
+    }
+
+    printf("recorded %.1f min: %llu instructions, %ld frames\n",
+           minutes, (unsigned long long)chip8.cycles, frames);
+    chip8_movie_close(movie, &chip8);
+    return 0;
+}
+
+int main(int argc, char *argv[]){
+    if (argc < 3){
+        fprintf(stderr, "Usage: %s <rom> <movie> [--record-synthetic <minutes>]\n", argv[0]);
+        return 1;
+    }
+
+    if (argc > 4 && strcmp(argv[3], "--record-synthetic") == 0){
+        double minutes = atof(argv[4]);
+        if (minutes <= 0.0){
+            fprintf(stderr, "minutes must be > 0\n");
+            return 1;
+        }
+        if (record_synthetic(argv[1], argv[2], minutes) != 0){
+            return 1;
+        }
+    }
+
+    Chip8 chip8;
+    chip8_reset(&chip8);
+    if (load_rom(argv[1], &chip8) != CHIP8_OK){
+        return 1;
+    }
+
+    Chip8MovieResult result;
+    double t0 = now_seconds();
+    int status = chip8_movie_play(argv[2], &chip8, &result);
+    double elapsed = now_seconds() - t0;
+
+    if (status < 0){
+        return 1;
+    }
+
+    double played = (double)result.ticks / TIMER_HZ;
+    printf("replayed %llu instructions, %llu timer ticks (%.1f s of play), %llu key changes\n",
+           (unsigned long long)result.cycles, (unsigned long long)result.ticks,
+           played, (unsigned long long)result.key_changes);
+    printf("%.3f s, %.0fx real time\n", elapsed, elapsed > 0.0 ? played / elapsed : 0.0);
+    printf("display hash %016llx, recorded %016llx: %s\n",
+           (unsigned long long)result.display_hash, (unsigned long long)result.expected_hash,
+           status == 0 ? "MATCH" : "MISMATCH");
+    return status;
+}
@@ -0,0 +1,151 @@
+//tools/chip8_rollback_bench.c
+// Rollback benchmark with a loopback stand-in for the remote player.
+//
+// Usage: chip8_rollback_bench <rom> [delay frames] [seconds]
+//
+// Two scripted players press and release keys at random. The local
+// player's keys go straight into chip8_rollback_advance; the remote
+// player's reach chip8_rollback_remote `delay` frames late (default 6,
+// ~100 ms) plus up to JITTER frames of jitter, so they arrive out of order.
+// Runs `seconds` (default 60) of game time unthrottled, then checks the
+// final state hash against a run that saw every input on time, and prints
+// the cost per host frame (re-simulation included) against the 1 ms budget.
+#include "chip8.h"
+#include "chip8_rollback.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CPU_HZ 700.0  //same as main.c
+#define JITTER 3
+#define BUDGET_NS 1000000ull
+#define SEED 0xC8C8C8C8u
+
+static uint64_t now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b){
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void script(uint16_t *keys, uint64_t frames, uint32_t *rng){
+    //hold a random key (or none) for a while, change about every 15 frames
+    uint16_t held = 0;
+    for (uint64_t f = 0; f < frames; f++){
+        *rng = *rng * 1103515245u + 12345u;
+        if (((*rng >> 16) % 15) == 0){
+            held = (*rng >> 20) & 1 ? (uint16_t)(1u << ((*rng >> 24) & 0xF)) : 0;
+        }
+        keys[f] = held;
+    }
+}
+
+int main(int argc, char *argv[]){
+    if (argc < 2){
+        fprintf(stderr, "Usage: %s <rom> [delay frames] [seconds]\n", argv[0]);
+        return 1;
+    }
+    uint64_t delay = argc > 2 ? strtoull(argv[2], NULL, 10) : 6;
+    double seconds = argc > 3 ? atof(argv[3]) : 60.0;
+    uint64_t frames = (uint64_t)(seconds * 60.0);
+    if (delay + JITTER >= ROLLBACK_FRAMES){
+        fprintf(stderr, "delay + jitter must stay under %d frames\n", ROLLBACK_FRAMES);
+        return 1;
+    }
+
+    uint16_t *local = malloc(sizeof(*local) * frames);
+    uint16_t *remote = malloc(sizeof(*remote) * frames);
+    uint64_t *arrival = malloc(sizeof(*arrival) * frames);
+    uint64_t *cost = malloc(sizeof(*cost) * frames);
+    if (!local || !remote || !arrival || !cost){
+        perror("malloc");
+        return 1;
+    }
+    uint32_t rng = 1;
+    script(local, frames, &rng);
+    script(remote, frames, &rng);
+    for (uint64_t f = 0; f < frames; f++){
+        rng = rng * 1103515245u + 12345u;
+        arrival[f] = f + delay + (rng >> 16) % (JITTER + 1);
+    }
+
+    //reference: every input on time
+    static Chip8 reference;
+    chip8_reset(&reference);
+    chip8_seed(&reference, SEED);
+    load_rom(argv[1], &reference);
+    uint64_t t0 = now_ns();
+    for (uint64_t f = 0; f < frames; f++){
+        uint64_t cycles = (uint64_t)((double)(f + 1) * CPU_HZ / 60.0) - (uint64_t)((double)f * CPU_HZ / 60.0);
+        reference.keypad = local[f] | remote[f];
+        for (uint64_t i = 0; i < cycles; i++){
+            chip8_step(&reference);
+        }
+        chip8_timer_tick(&reference);
+    }
+    double plain_ns = (double)(now_ns() - t0) / (double)frames;
+
+    //rollback: remote input over the loopback, late and out of order
+    static Chip8 live;
+    static Chip8Rollback rollback;
+    chip8_reset(&live);
+    chip8_seed(&live, SEED);
+    load_rom(argv[1], &live);
+    chip8_rollback_init(&rollback, &live, CPU_HZ);
+
+    uint64_t total = 0;
+    for (uint64_t h = 0; h < frames; h++){
+        uint64_t start = now_ns();
+        uint64_t first = h > delay + JITTER ? h - delay - JITTER : 0;
+        for (uint64_t f = first; f <= h; f++){
+            if (arrival[f] == h){
+                chip8_rollback_remote(&rollback, f, remote[f]);
+            }
+        }
+        chip8_rollback_advance(&rollback, local[h]);
+        cost[h] = now_ns() - start;
+        total += cost[h];
+    }
+    //whatever was still in flight
+    for (uint64_t f = frames > delay + JITTER ? frames - delay - JITTER : 0; f < frames; f++){
+        if (arrival[f] >= frames){
+            chip8_rollback_remote(&rollback, f, remote[f]);
+        }
+    }
+    chip8_rollback_sync(&rollback);
+
+    uint64_t expect = chip8_state_hash(&reference);
+    uint64_t got = chip8_state_hash(&live);
+
+    qsort(cost, frames, sizeof(*cost), compare_u64);
+    Chip8RollbackStats *stats = &rollback.stats;
+    printf("%s: %llu frames, remote input %llu-%llu frames late\n", argv[1],
+           (unsigned long long)frames, (unsigned long long)delay, (unsigned long long)(delay + JITTER));
+    printf("plain frame        %8.2f us\n", plain_ns / 1000.0);
+    printf("host frame mean    %8.2f us\n", (double)total / (double)frames / 1000.0);
+    printf("host frame p99     %8.2f us\n", (double)cost[frames * 99 / 100] / 1000.0);
+    printf("host frame max     %8.2f us  (budget %.0f us)\n", (double)cost[frames - 1] / 1000.0, BUDGET_NS / 1000.0);
+    printf("rollbacks          %8llu  (%.1f frames each, deepest %u, slowest %.2f us)\n",
+           (unsigned long long)stats->rollbacks,
+           stats->rollbacks ? (double)stats->resimulated / (double)stats->rollbacks : 0.0,
+           stats->max_depth, (double)stats->max_resim_ns / 1000.0);
+    printf("snapshot           %8.0f bytes avg (Chip8 is %zu)\n",
+           stats->snapshots ? (double)stats->snapshot_bytes / (double)stats->snapshots : 0.0, sizeof(Chip8));
+    printf("final state        %016llx %s\n", (unsigned long long)got, got == expect ? "matches" : "MISMATCH");
+
+    bool ok = got == expect && cost[frames - 1] <= BUDGET_NS;
+    free(local);
+    free(remote);
+    free(arrival);
+    free(cost);
+    return ok ? 0 : 1;
+}
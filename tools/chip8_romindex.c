@@ -0,0 +1,310 @@
+//tools/chip8_romindex.c
+// Offline ROM analysis, so the front end knows a ROM before it runs it.
+//
+// Usage: chip8_romindex build <roms dir|pack> <index> [threads]
+//        chip8_romindex list <index>
+//
+// build opens the ROMs as a library (chip8_romlib.h), so identical ROMs are
+// analyzed once and the records come out in hash order. Each ROM is loaded
+// into its own Chip8 and walked with chip8_disasm_analyze; the threads
+// (default one per core) take ROMs off a shared counter and write disjoint
+// records, so nothing else is shared. The index is then written in one go
+// (see chip8_romindex.h for what a record holds). list prints an index.
+//
+// The front end reads the index with --index, the recompiler with its third
+// argument: make romindex, then make aot ROM=... uses chip8_roms.c8ix.
+#include "chip8.h"
+#include "chip8_disasm.h"
+#include "chip8_romindex.h"
+#include "chip8_romlib.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_THREADS 256
+#define SPRITE_SCHIP 32     //bytes drawn by Dxy0, a 16x16 sprite
+
+typedef struct Job {
+    const Chip8RomLib *lib;
+    Chip8RomAnalysis *records;
+    atomic_uint next;
+} Job;
+
+static double now_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void add_range(Chip8RomRange *ranges, uint8_t *count, uint32_t *features, uint16_t start, uint16_t end){
+    //in address order; overlapping or touching ranges join, past the last slot the last one grows
+    if (*count && ranges[*count - 1].end >= start){
+        if (end > ranges[*count - 1].end){
+            ranges[*count - 1].end = end;
+        }
+        return;
+    }
+    if (*count == ROMINDEX_RANGES){
+        ranges[*count - 1].end = end;
+        *features |= ROM_FEAT_MERGED;
+        return;
+    }
+    ranges[(*count)++] = (Chip8RomRange){ start, end };
+}
+
+static uint16_t opcode_at(const Chip8 *chip8, int addr){
+    return (uint16_t)(chip8_mem_read(chip8, (uint16_t)addr) << 8 |
+                      chip8_mem_read(chip8, (uint16_t)((addr + 1) & (MEM_SIZE - 1))));
+}
+
+static int store_target(const Chip8Disasm *disasm, const Chip8 *chip8, int addr){
+    /*
+    I at the store at addr, from the instructions before it in its basic
+    block: an Annn target plus the x + 1 that every Fx55/Fx65 since then
+    added, -2 for the font (Fx29/Fx30) if nothing moved it since, -1 when
+    it comes from elsewhere or Fx1E changed it
+    */
+    int advance = 0;
+    while (!(disasm->flags[addr] & DISASM_BLOCK) && addr >= 2 && (disasm->flags[addr - 2] & DISASM_CODE)){
+        addr -= 2;
+        uint16_t opcode = opcode_at(chip8, addr);
+        int op = chip8_romindex_op(opcode);
+        if (op == ROM_OP_Annn){
+            return ((opcode & 0x0FFF) + advance) & (MEM_SIZE - 1);
+        }
+        if (op == ROM_OP_Fx55 || op == ROM_OP_Fx65){
+            advance += ((opcode >> 8) & 0xF) + 1;
+        }
+        if (op == ROM_OP_Fx29 || op == ROM_OP_Fx30){
+            return advance ? -1 : -2;
+        }
+        if (op == ROM_OP_Fx1E){
+            return -1;
+        }
+    }
+    return -1;
+}
+
+static bool reaches_code(const bool *code, int target, int len){
+    //I wraps at 4 KB like chip8_mem_write
+    for (int i = 0; i < len; i++){
+        if (code[(target + i) & (MEM_SIZE - 1)]){
+            return true;
+        }
+    }
+    return false;
+}
+
+static void analyze(const Chip8RomLib *lib, const Chip8RomInfo *info, Chip8RomAnalysis *rom){
+    Chip8 chip8;
+    chip8_reset(&chip8);
+    chip8_romlib_load(lib, info, &chip8);
+    Chip8Disasm disasm;
+    chip8_disasm_analyze(&disasm, &chip8, NULL);
+
+    memset(rom, 0, sizeof(*rom));
+    rom->hash = info->hash;
+    rom->length = info->length;
+    rom->instructions = (uint16_t)disasm.instructions;
+
+    bool code[MEM_SIZE] = { false };
+    bool loaded[MEM_SIZE] = { false };  //Annn targets
+    int tallest = 0;                    //sprite bytes of the largest Dxyn
+    for (int addr = 0; addr < MEM_SIZE; addr++){
+        if (!(disasm.flags[addr] & DISASM_CODE)){
+            continue;
+        }
+        code[addr] = true;
+        code[(addr + 1) & (MEM_SIZE - 1)] = true;
+        uint16_t opcode = opcode_at(&chip8, addr);
+        int op = chip8_romindex_op(opcode);
+        rom->opcodes |= ROM_OP_BIT(op);
+        if (op == ROM_OP_Annn){
+            loaded[opcode & 0x0FFF] = true;
+        } else if (op == ROM_OP_Dxyn && (opcode & 0xF) > tallest){
+            tallest = opcode & 0xF;
+        } else if (op == ROM_OP_Dxy0){
+            tallest = SPRITE_SCHIP;
+        }
+    }
+
+    for (int addr = 0; addr < MEM_SIZE; addr++){
+        if (!code[addr]){
+            continue;
+        }
+        int end = addr;
+        while (end < MEM_SIZE && code[end]){
+            end++;
+        }
+        rom->code_bytes += (uint16_t)(end - addr);
+        add_range(rom->code, &rom->code_count, &rom->features, (uint16_t)addr, (uint16_t)end);
+        addr = end;
+    }
+
+    if (rom->opcodes & ROM_OPS_SCHIP) rom->features |= ROM_FEAT_SCHIP;
+    if (rom->opcodes & ROM_OPS_XOCHIP) rom->features |= ROM_FEAT_XOCHIP;
+    if (rom->opcodes & ROM_OPS_UNKNOWN) rom->features |= ROM_FEAT_UNKNOWN;
+    if (rom->opcodes & ROM_OP_BIT(ROM_OP_Bnnn)) rom->features |= ROM_FEAT_INDIRECT;
+
+    //stores: through the I set earlier in the block, else through any Annn target
+    int unresolved = 0;                 //bytes of the largest store with I from elsewhere
+    for (int addr = 0; addr < MEM_SIZE; addr++){
+        if (!(disasm.flags[addr] & DISASM_CODE)){
+            continue;
+        }
+        uint16_t opcode = opcode_at(&chip8, addr);
+        int op = chip8_romindex_op(opcode);
+        if (op != ROM_OP_Fx33 && op != ROM_OP_Fx55){
+            continue;
+        }
+        rom->features |= ROM_FEAT_WRITES;
+        int len = op == ROM_OP_Fx33 ? 3 : ((opcode >> 8) & 0xF) + 1;
+        int target = store_target(&disasm, &chip8, addr);
+        if (target >= 0 && reaches_code(code, target, len)){
+            rom->features |= ROM_FEAT_SMC;
+        } else if (target == -1 && len > unresolved){
+            unresolved = len;
+        }
+    }
+
+    for (int target = 0; target < MEM_SIZE; target++){
+        if (!loaded[target]){
+            continue;
+        }
+        if (reaches_code(code, target, unresolved)){
+            rom->features |= ROM_FEAT_SMC;
+        }
+        //drawn from here: up to the tallest sprite, or the next code byte
+        int end = target;
+        while (end < MEM_SIZE && end < target + tallest && !code[end]){
+            end++;
+        }
+        if (end > target){
+            add_range(rom->sprites, &rom->sprite_count, &rom->features, (uint16_t)target, (uint16_t)end);
+        }
+    }
+    //Fx1E moves I anywhere, and code past a Bnnn may load any I. Fx55/Fx65
+    //move it by x + 1 each time: a store whose I comes from another block
+    //(a loop, say) may be any number of those past its Annn target
+    if ((rom->features & ROM_FEAT_SMC) || ((rom->features & ROM_FEAT_WRITES) &&
+        (rom->opcodes & (ROM_OP_BIT(ROM_OP_Fx1E) | ROM_OP_BIT(ROM_OP_Bnnn)))) ||
+        (unresolved && (rom->opcodes & (ROM_OP_BIT(ROM_OP_Fx55) | ROM_OP_BIT(ROM_OP_Fx65))))){
+        rom->features |= ROM_FEAT_SMC_POSSIBLE;
+    }
+    rom->quirks = chip8_romindex_quirks(rom->opcodes);
+}
+
+static void *worker(void *arg){
+    Job *job = arg;
+    for (;;){
+        unsigned i = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed);
+        if (i >= job->lib->count){
+            return NULL;
+        }
+        analyze(job->lib, &job->lib->index[i], &job->records[i]);
+    }
+}
+
+static int build(const char *roms, const char *path, int threads){
+    Chip8RomLib lib;
+    int err = chip8_romlib_open(&lib, roms);
+    if (err != CHIP8_OK){
+        fprintf(stderr, "%s: %s\n", roms, chip8_strerror(err));
+        return 1;
+    }
+    Job job = { .lib = &lib, .records = calloc(lib.count ? lib.count : 1, sizeof(Chip8RomAnalysis)) };
+    if (!job.records){
+        perror("calloc");
+        chip8_romlib_close(&lib);
+        return 1;
+    }
+
+    double t0 = now_seconds();
+    static pthread_t tids[MAX_THREADS];
+    int started = 0;
+    for (; started < threads; started++){
+        if (pthread_create(&tids[started], NULL, worker, &job) != 0){
+            perror("pthread_create");
+            break;
+        }
+    }
+    if (!started){
+        //no threads at all, do it here
+        worker(&job);
+    }
+    for (int t = 0; t < started; t++){
+        pthread_join(tids[t], NULL);
+    }
+    double elapsed = now_seconds() - t0;
+
+    for (uint32_t i = 0; i < lib.count; i++){
+        char text[256];
+        chip8_romindex_describe(&job.records[i], text, sizeof(text));
+        printf("%016llx %-20s %s\n", (unsigned long long)job.records[i].hash, lib.index[i].name, text);
+    }
+    err = chip8_romindex_write(path, job.records, lib.count);
+    if (err == CHIP8_OK){
+        printf("%s: %u ROMs analyzed in %.1f ms on %d threads, %zu bytes\n", path, lib.count, elapsed * 1e3,
+               started ? started : 1, sizeof(RomIndexHeader) + sizeof(Chip8RomAnalysis) * lib.count);
+    }
+    free(job.records);
+    chip8_romlib_close(&lib);
+    return err == CHIP8_OK ? 0 : 1;
+}
+
+static int list(const char *path){
+    Chip8RomIndex index;
+    if (chip8_romindex_open(&index, path) != CHIP8_OK){
+        return 1;
+    }
+    for (uint32_t i = 0; i < index.count; i++){
+        const Chip8RomAnalysis *rom = &index.entries[i];
+        char text[256];
+        chip8_romindex_describe(rom, text, sizeof(text));
+        printf("%016llx %s\n", (unsigned long long)rom->hash, text);
+
+        //the instruction forms, and the ranges behind the summary
+        printf("    opcodes:");
+        for (int op = 0; op < ROM_OP_COUNT; op++){
+            if (rom->opcodes & ROM_OP_BIT(op)){
+                printf(" %s", chip8_romindex_op_names[op]);
+            }
+        }
+        printf("\n    code:");
+        for (int r = 0; r < rom->code_count; r++){
+            printf(" %03X-%03X", rom->code[r].start, rom->code[r].end - 1);
+        }
+        printf("\n    sprites:");
+        for (int r = 0; r < rom->sprite_count; r++){
+            printf(" %03X-%03X", rom->sprites[r].start, rom->sprites[r].end - 1);
+        }
+        printf("\n");
+    }
+    printf("%u ROMs\n", index.count);
+    chip8_romindex_close(&index);
+    return 0;
+}
+
+int main(int argc, char *argv[]){
+    if (argc >= 4 && strcmp(argv[1], "build") == 0){
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        int threads = argc > 4 ? atoi(argv[4]) : (int)(cores > 0 ? cores : 1);
+        if (threads < 1 || threads > MAX_THREADS){
+            fprintf(stderr, "threads must be 1-%d\n", MAX_THREADS);
+            return 1;
+        }
+        return build(argv[2], argv[3], threads);
+    }
+    if (argc >= 3 && strcmp(argv[1], "list") == 0){
+        return list(argv[2]);
+    }
+    fprintf(stderr, "Usage: %s build <roms dir|pack> <index> [threads]\n"
+                    "       %s list <index>\n", argv[0], argv[0]);
+    return 1;
+}
@@ -0,0 +1,145 @@
+//tools/chip8_romlib.c
+// ROM library maintenance and startup benchmark.
+//
+// Usage: chip8_romlib build <dir> <pack>
+//        chip8_romlib list <pack|dir>
+//        chip8_romlib bench <dir> <rom name> [instances]
+//
+// build packs a ROM directory (plus its library.txt) into one file, list
+// prints the index. bench starts `instances` (default 10000) Chip8s from
+// one ROM twice, once with load_rom per instance and once from the library
+// with chip8_romlib_load, and prints the time per instance.
+#include "chip8.h"
+#include "chip8_romlib.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int open_lib(Chip8RomLib *lib, const char *path){
+    int err = chip8_romlib_open(lib, path);
+    if (err != CHIP8_OK){
+        fprintf(stderr, "%s: %s\n", path, chip8_strerror(err));
+    }
+    return err;
+}
+
+static int list(const char *path){
+    Chip8RomLib lib;
+    if (open_lib(&lib, path) != CHIP8_OK){
+        return 1;
+    }
+    printf("%-16s %6s %6s  %-24s %s\n", "hash", "bytes", "cpu", "quirks", "name");
+    for (uint32_t i = 0; i < lib.count; i++){
+        const Chip8RomInfo *rom = &lib.index[i];
+        char quirks[128];
+        chip8_romlib_quirk_names(rom->quirks, quirks, sizeof(quirks));
+        printf("%016llx %6u %6u  %-24s %s\n", (unsigned long long)rom->hash, rom->length, rom->cpu_hz,
+               quirks[0] ? quirks : "-", rom->name);
+    }
+    printf("%u ROMs, %zu bytes\n", lib.count, lib.size);
+    chip8_romlib_close(&lib);
+    return 0;
+}
+
+static int build(const char *dir, const char *pack){
+    Chip8RomLib lib;
+    if (open_lib(&lib, dir) != CHIP8_OK){
+        return 1;
+    }
+    int err = chip8_romlib_write(&lib, pack);
+    if (err == CHIP8_OK){
+        printf("%s: %u ROMs, %zu bytes\n", pack, lib.count, lib.size);
+    }
+    chip8_romlib_close(&lib);
+    return err == CHIP8_OK ? 0 : 1;
+}
+
+static int bench(const char *dir, const char *name, int instances){
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+    Chip8 *chip8s = malloc(sizeof(*chip8s) * (size_t)instances);
+    if (!chip8s){
+        perror("bench: malloc");
+        return 1;
+    }
+
+    double t0 = now_seconds();
+    for (int i = 0; i < instances; i++){
+        chip8_reset(&chip8s[i]);
+        if (load_rom(path, &chip8s[i]) != CHIP8_OK){
+            free(chip8s);
+            return 1;
+        }
+    }
+    double per_file = (now_seconds() - t0) / instances;
+    for (int i = 0; i < instances; i++){
+        chip8_release(&chip8s[i]);
+    }
+
+    t0 = now_seconds();
+    Chip8RomLib lib;
+    if (open_lib(&lib, dir) != CHIP8_OK){
+        free(chip8s);
+        return 1;
+    }
+    double open_time = now_seconds() - t0;
+    const Chip8RomInfo *rom = chip8_romlib_find_name(&lib, name);
+    if (!rom){
+        fprintf(stderr, "%s: no ROM named %s\n", dir, name);
+        chip8_romlib_close(&lib);
+        free(chip8s);
+        return 1;
+    }
+    t0 = now_seconds();
+    for (int i = 0; i < instances; i++){
+        chip8_reset(&chip8s[i]);
+        chip8_romlib_load(&lib, chip8_romlib_find(&lib, rom->hash), &chip8s[i]);
+    }
+    double per_lib = (now_seconds() - t0) / instances;
+
+    //both must have produced the same memory
+    Chip8 check;
+    chip8_reset(&check);
+    load_rom(path, &check);
+    int same = chip8_state_hash(&check) == chip8_state_hash(&chip8s[instances - 1]);
+
+    printf("%d instances of %s\n", instances, name);
+    printf("reset + load_rom           %8.3f us/instance\n", per_file * 1e6);
+    printf("reset + chip8_romlib_load  %8.3f us/instance (library opened once in %.3f ms)\n",
+           per_lib * 1e6, open_time * 1e3);
+    printf("memory %s\n", same ? "identical" : "DIFFERS");
+
+    for (int i = 0; i < instances; i++){
+        chip8_release(&chip8s[i]);
+    }
+    chip8_release(&check);
+    chip8_romlib_close(&lib);
+    free(chip8s);
+    return same ? 0 : 1;
+}
+
+int main(int argc, char *argv[]){
+    if (argc >= 4 && strcmp(argv[1], "build") == 0){
+        return build(argv[2], argv[3]);
+    }
+    if (argc >= 3 && strcmp(argv[1], "list") == 0){
+        return list(argv[2]);
+    }
+    if (argc >= 4 && strcmp(argv[1], "bench") == 0){
+        return bench(argv[2], argv[3], argc > 4 ? atoi(argv[4]) : 10000);
+    }
+    fprintf(stderr, "Usage: %s build <dir> <pack>\n"
+                    "       %s list <pack|dir>\n"
+                    "       %s bench <dir> <rom name> [instances]\n", argv[0], argv[0], argv[0]);
+    return 1;
+}
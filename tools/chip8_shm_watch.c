@@ -0,0 +1,125 @@
+//tools/chip8_shm_watch.c
+// Example shared-memory reader.
+//
+// Usage: chip8_shm_watch <name> [seconds] [--keys <hex mask>]
+//
+// Attaches to an emulator started with `chip8.exe <rom> --shm <name>`,
+// follows its frames for `seconds` (default 5) reading the block in place,
+// and prints frames seen, torn reads retried and the PC once a second,
+// then the last display. --keys holds the given keypad mask down while it
+// runs (e.g. --keys 0x20 holds key 5).
+#include "chip8_shm.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[]){
+    if (argc < 2){
+        fprintf(stderr, "Usage: %s <name> [seconds] [--keys <hex mask>]\n", argv[0]);
+        return 1;
+    }
+
+    double seconds = 5.0;
+    long keys = -1;
+    for (int i = 2; i < argc; i++){
+        if (strcmp(argv[i], "--keys") == 0 && i + 1 < argc){
+            keys = strtol(argv[++i], NULL, 16);
+        } else {
+            seconds = atof(argv[i]);
+        }
+    }
+
+    Chip8Shm *shm = chip8_shm_attach(argv[1]);
+    if (!shm){
+        return 1;
+    }
+    Chip8ShmBlock *block = shm->block;
+
+    if (keys >= 0){
+        chip8_shm_set_keys(block, (uint16_t)keys);
+    }
+
+    uint64_t last_frame = 0;
+    uint64_t frames = 0;
+    uint64_t retries = 0;
+    uint16_t pc = 0;
+    uint16_t keypad = 0;
+    int lit = 0;
+    double start = now_seconds();
+    double next_report = start + 1.0;
+
+    for (;;){
+        double now = now_seconds();
+        if (now - start >= seconds){
+            break;
+        }
+
+        //read in place, retry if the emulator published meanwhile
+        uint64_t frame;
+        for (;;){
+            uint32_t seq = chip8_shm_read_begin(block);
+            frame = block->frame;
+            pc = block->pc;
+            keypad = block->keypad;
+            if (frame != last_frame){
+                lit = 0;
+                for (int y = 0; y < DISP_HIRES_HEIGHT; y++){
+                    lit += __builtin_popcountll(block->display[y][0]) + __builtin_popcountll(block->display[y][1]);
+                }
+            }
+            if (!chip8_shm_read_retry(block, seq)){
+                break;
+            }
+            retries++;
+        }
+
+        if (frame != last_frame){
+            frames++;
+            last_frame = frame;
+        }
+
+        if (now >= next_report){
+            printf("frame %llu  pc %03X  keys %04X  lit %4d  frames seen %llu  retries %llu\n",
+                   (unsigned long long)frame, pc, keypad, lit,
+                   (unsigned long long)frames, (unsigned long long)retries);
+            next_report += 1.0;
+        }
+
+        struct timespec idle = { 0, 2000000 }; //poll at ~500 Hz
+        nanosleep(&idle, NULL);
+    }
+
+    if (keys >= 0){
+        chip8_shm_set_keys(block, 0);
+    }
+
+    uint64_t display[DISP_HIRES_HEIGHT][2];
+    bool hires;
+    uint32_t seq;
+    do {
+        seq = chip8_shm_read_begin(block);
+        memcpy(display, block->display, sizeof(display));
+        hires = block->hires;
+    } while (chip8_shm_read_retry(block, seq));
+
+    int width = hires ? DISP_HIRES_WIDTH : DISP_WIDTH;
+    int height = hires ? DISP_HIRES_HEIGHT : DISP_HEIGHT;
+    for (int y = 0; y < height; y++){
+        for (int x = 0; x < width; x++){
+            putchar((display[y][x / 64] >> (63 - x % 64)) & 1 ? '#' : '.');
+        }
+        putchar('\n');
+    }
+
+    chip8_shm_close(shm);
+    return 0;
+}
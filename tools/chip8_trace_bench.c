@@ -0,0 +1,79 @@
+//tools/chip8_trace_bench.c
+// Cost of chip8_trace against plain chip8_step.
+//
+// Usage: chip8_trace_bench <rom> [cycles] [trace]
+//
+// Runs the ROM unthrottled for `cycles` instructions (timers ticked every
+// CPU_HZ / TIMER_HZ instructions as in main.c), once plain and once traced
+// into `trace` (default chip8_trace_bench.trace), and reports both rates,
+// the slowdown and the trace size per instruction.
+#include "chip8.h"
+#include "chip8_trace.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CPU_HZ 700.0  //same as main.c
+#define TIMER_HZ 60.0
+
+static double now_seconds(void){
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[]){
+    if (argc < 2){
+        fprintf(stderr, "Usage: %s <rom> [cycles] [trace]\n", argv[0]);
+        return 1;
+    }
+    long cycles = argc > 2 ? atol(argv[2]) : 20000000;
+    const char *path = argc > 3 ? argv[3] : "chip8_trace_bench.trace";
+    int cycles_per_frame = (int)(CPU_HZ / TIMER_HZ);
+
+    Chip8 chip8;
+    chip8_reset(&chip8);
+    load_rom(argv[1], &chip8);
+
+    double start = now_seconds();
+    for (long c = 0; c < cycles; c++){
+        chip8_step(&chip8);
+        if (c % cycles_per_frame == cycles_per_frame - 1){
+            chip8_timer_tick(&chip8);
+        }
+    }
+    double plain = now_seconds() - start;
+
+    chip8_release(&chip8);
+    chip8_reset(&chip8);
+    load_rom(argv[1], &chip8);
+
+    start = now_seconds();
+    Chip8Trace *trace = chip8_trace_open(path, &chip8);
+    if (!trace){
+        return 1;
+    }
+    for (long c = 0; c < cycles; c++){
+        chip8_trace_step(trace, &chip8);
+        if (c % cycles_per_frame == cycles_per_frame - 1){
+            chip8_timer_tick(&chip8);
+        }
+    }
+    chip8_trace_close(trace);
+    double traced = now_seconds() - start;
+
+    FILE *fp = fopen(path, "rb");
+    long bytes = 0;
+    if (fp){
+        fseek(fp, 0, SEEK_END);
+        bytes = ftell(fp);
+        fclose(fp);
+    }
+
+    printf("plain:  %.2f M instructions/s\n", cycles / plain / 1e6);
+    printf("traced: %.2f M instructions/s (%.2fx slower), %.2f bytes/instruction\n",
+           cycles / traced / 1e6, traced / plain, (double)bytes / (double)cycles);
+    return 0;
+}
@@ -0,0 +1,138 @@
+//tools/chip8_trace_dump.c
+// Expand a binary trace written by chip8_trace into the text that
+// debug_step_instruction prints.
+//
+// Usage: chip8_trace_dump <trace> [max_steps]
+#include "chip8.h"
+#include "chip8_trace.h"
+#include "debug.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int read_record(FILE *fp, Chip8TraceRecord *prev, Chip8TraceRecord *record){
+    /*
+    Decode one record. Returns 0 at end of file.
+    */
+    unsigned mask = 0;
+    for (int shift = 0; ; shift += 7){
+        int c = fgetc(fp);
+        if (c == EOF){
+            if (shift){
+                fprintf(stderr, "chip8_trace_dump: truncated record\n");
+            }
+            return 0;
+        }
+        mask |= (unsigned)(c & 0x7F) << shift;
+        if (!(c & 0x80)){
+            break;
+        }
+    }
+
+    chip8_trace_predict(record, prev);
+    uint8_t *bytes = (uint8_t *)record;
+    for (int i = 0; i < (int)sizeof(*record); i++){
+        if (mask & (1u << i)){
+            int c = fgetc(fp);
+            if (c == EOF){
+                fprintf(stderr, "chip8_trace_dump: truncated record\n");
+                return 0;
+            }
+            bytes[i] = (uint8_t)c;
+        }
+    }
+    *prev = *record;
+    return 1;
+}
+
+static void show_opcode(Chip8 *shadow, uint16_t addr, uint16_t opcode){
+    //debug_print_state reads the opcode at PC from memory
+    if (addr <= MEM_SIZE - 2){
+        chip8_mem_write(shadow, addr, (uint8_t)(opcode >> 8));
+        chip8_mem_write(shadow, addr + 1, (uint8_t)opcode);
+    }
+}
+
+int main(int argc, char *argv[]){
+    if (argc < 2){
+        fprintf(stderr, "Usage: %s <trace> [max_steps]\n", argv[0]);
+        return 1;
+    }
+    long max_steps = argc > 2 ? atol(argv[2]) : -1;
+
+    FILE *fp = fopen(argv[1], "rb");
+    if (!fp){
+        perror("chip8_trace_dump: fopen");
+        return 1;
+    }
+
+    Chip8TraceHeader header;
+    if (fread(&header, sizeof(header), 1, fp) != 1 ||
+        memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != TRACE_VERSION){
+        fprintf(stderr, "chip8_trace_dump: %s is not a version %d trace\n", argv[1], TRACE_VERSION);
+        fclose(fp);
+        return 1;
+    }
+
+    Chip8 shadow;
+    chip8_reset(&shadow);
+    memcpy(shadow.V, header.V, sizeof(shadow.V));
+    shadow.I = header.I;
+    shadow.sp = header.sp;
+
+    Chip8TraceRecord prev;
+    memset(&prev, 0, sizeof(prev));
+    prev.next_pc = header.pc;
+
+    Chip8TraceRecord record;
+    Chip8TraceRecord next;
+    int have = read_record(fp, &prev, &record);
+
+    for (long step = 0; have && step != max_steps; step++){
+        shadow.pc = record.pc;
+        shadow.delay_timer = record.delay_timer;
+        shadow.sound_timer = record.sound_timer;
+        show_opcode(&shadow, record.pc, record.opcode);
+
+        printf("\n--- STEP ---\n");
+        printf("Before:");
+        debug_print_state(&shadow);
+
+        shadow.pc = record.next_pc;
+        shadow.I = record.I;
+        shadow.sp = record.sp;
+        if (record.reg != TRACE_NO_REG){
+            shadow.V[record.reg] = record.value;
+        }
+        shadow.V[0xF] = record.vf;
+
+        //extra registers written by the same instruction
+        have = read_record(fp, &prev, &next);
+        while (have && next.pc == TRACE_CONT){
+            shadow.V[next.reg] = next.value;
+            have = read_record(fp, &prev, &next);
+        }
+
+        uint8_t x = (record.opcode >> 8) & 0xF;
+        if ((record.opcode & 0xF0FF) == 0xF015){
+            shadow.delay_timer = shadow.V[x];
+        } else if ((record.opcode & 0xF0FF) == 0xF018){
+            shadow.sound_timer = shadow.V[x];
+        }
+
+        if (have && next.pc == record.next_pc){
+            show_opcode(&shadow, next.pc, next.opcode);
+        }
+
+        printf("After:");
+        debug_print_state(&shadow);
+
+        record = next;
+    }
+
+    fclose(fp);
+    return 0;
+}